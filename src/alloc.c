@@ -21,13 +21,41 @@
 #define OTRNG_ALLOC_PRIVATE
 
 #include "alloc.h"
+#include "error.h"
+#include <pthread.h>
 #include <sodium.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* Fallback allocations keep their size in front of the user data, so the
+ * counters can be updated on free. sodium_malloc puts the end of the block
+ * against a guard page, so the block is only aligned when its size is a
+ * multiple of the alignment: the size asked for is rounded up to one, and
+ * the header keeps the user data aligned. */
+#define FALLBACK_ALIGNMENT 16
+#define FALLBACK_HEADER_BYTES FALLBACK_ALIGNMENT
+
 static void (*oom_handler)(void);
 
+static const size_t pool_chunk_sizes[OTRNG_SECURE_POOL_CLASSES] = {
+    32, 64, 128, 256, 512};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#ifdef OTRNG_TESTS
+/* Atomic, as the clients of a global state can allocate from several
+ * threads */
+static size_t alloc_count;
+#define COUNT_ALLOCATION()                                                     \
+  ((void)__atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED))
+#else
+#define COUNT_ALLOCATION()
+#endif
+
+static pool_region_s pool_regions[OTRNG_SECURE_POOL_CLASSES]
+                                 [OTRNG_SECURE_POOL_MAX_REGIONS];
+static otrng_secure_pool_stats_s pool_stats;
+
 API void otrng_register_out_of_memory_handler(
     /*@null@*/ void (*handler)(void)) /*@modifies internalState @*/ {
   oom_handler = handler;
@@ -35,6 +63,7 @@ API void otrng_register_out_of_memory_handler(
 
 INTERNAL /*@only@*/ /*@notnull@*/ void *otrng_xmalloc(size_t size) {
   void *result = malloc(size);
+  COUNT_ALLOCATION();
   if (result == NULL) {
     if (oom_handler != NULL) {
       oom_handler();
@@ -55,6 +84,7 @@ INTERNAL /*@only@*/ /*@notnull@*/ void *otrng_xmalloc_z(size_t size) {
 INTERNAL /*@only@*/ /*@notnull@*/ void *
 otrng_xrealloc(/*@only@*/ /*@null@*/ void *ptr, size_t size) {
   void *result = realloc(ptr, size);
+  COUNT_ALLOCATION();
   if (result == NULL) {
     if (oom_handler != NULL) {
       oom_handler();
@@ -66,16 +96,201 @@ otrng_xrealloc(/*@only@*/ /*@null@*/ void *ptr, size_t size) {
   return result;
 }
 
+static void secure_alloc_failed(size_t size) {
+  if (oom_handler != NULL) {
+    oom_handler();
+  }
+  fprintf(stderr, "fatal: memory exhausted (secure alloc of %lu bytes).\n",
+          size);
+  exit(EXIT_FAILURE);
+}
+
+tstatic int pool_class_for(size_t size) {
+  int i;
+
+  for (i = 0; i < OTRNG_SECURE_POOL_CLASSES; i++) {
+    if (size <= pool_chunk_sizes[i]) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static otrng_bool pool_region_map(pool_region_s *region, int class) {
+  const size_t chunk_size = pool_chunk_sizes[class];
+  const size_t chunks = OTRNG_SECURE_POOL_REGION_BYTES / chunk_size;
+  size_t i;
+
+  /* sodium_malloc locks the region and surrounds it with guard pages */
+  region->base = sodium_malloc(OTRNG_SECURE_POOL_REGION_BYTES);
+  if (!region->base) {
+    return otrng_false;
+  }
+
+  /* Every free chunk starts with a pointer to the next free chunk */
+  for (i = 0; i < chunks; i++) {
+    void *next = NULL;
+    if (i + 1 < chunks) {
+      next = region->base + (i + 1) * chunk_size;
+    }
+    memcpy(region->base + i * chunk_size, &next, sizeof(void *));
+  }
+
+  region->free_chunks = region->base;
+  region->in_use = 0;
+
+  pool_stats.region_bytes += OTRNG_SECURE_POOL_REGION_BYTES;
+  pool_stats.classes[class].capacity += chunks;
+
+  return otrng_true;
+}
+
+static /*@null@*/ void *pool_take(int class) {
+  pool_region_s *regions = pool_regions[class];
+  otrng_secure_pool_class_stats_s *cls = &pool_stats.classes[class];
+  pool_region_s *region = NULL;
+  void *chunk;
+  int i;
+
+  for (i = 0; i < OTRNG_SECURE_POOL_MAX_REGIONS; i++) {
+    if (regions[i].base && regions[i].free_chunks) {
+      region = &regions[i];
+      break;
+    }
+  }
+
+  for (i = 0; !region && i < OTRNG_SECURE_POOL_MAX_REGIONS; i++) {
+    if (!regions[i].base && pool_region_map(&regions[i], class)) {
+      region = &regions[i];
+    }
+  }
+
+  if (!region) {
+    return NULL;
+  }
+
+  chunk = region->free_chunks;
+  memcpy(&region->free_chunks, chunk, sizeof(void *));
+  region->in_use++;
+
+  cls->in_use++;
+  if (cls->in_use > cls->high_water) {
+    cls->high_water = cls->in_use;
+  }
+  pool_stats.live_bytes += pool_chunk_sizes[class];
+
+  return chunk;
+}
+
+/* Returns otrng_false if the pointer was not allocated from the pool */
+static otrng_bool pool_give_back(void *p) {
+  const uintptr_t addr = (uintptr_t)p;
+  int i, j;
+
+  for (i = 0; i < OTRNG_SECURE_POOL_CLASSES; i++) {
+    for (j = 0; j < OTRNG_SECURE_POOL_MAX_REGIONS; j++) {
+      pool_region_s *region = &pool_regions[i][j];
+      uintptr_t base = (uintptr_t)region->base;
+
+      if (!region->base || addr < base ||
+          addr >= base + OTRNG_SECURE_POOL_REGION_BYTES) {
+        continue;
+      }
+
+      sodium_memzero(p, pool_chunk_sizes[i]);
+      memcpy(p, &region->free_chunks, sizeof(void *));
+      region->free_chunks = p;
+      region->in_use--;
+
+      pool_stats.classes[i].in_use--;
+      pool_stats.live_bytes -= pool_chunk_sizes[i];
+
+      return otrng_true;
+    }
+  }
+
+  return otrng_false;
+}
+
+static /*@null@*/ void *fallback_alloc(size_t size) {
+  uint8_t *header;
+  size_t total;
+
+  if (size > SIZE_MAX - FALLBACK_HEADER_BYTES - (FALLBACK_ALIGNMENT - 1)) {
+    return NULL;
+  }
+
+  total = (size + FALLBACK_HEADER_BYTES + FALLBACK_ALIGNMENT - 1) &
+          ~(size_t)(FALLBACK_ALIGNMENT - 1);
+  header = sodium_malloc(total);
+  if (!header) {
+    return NULL;
+  }
+
+  memcpy(header, &size, sizeof(size_t));
+
+  pthread_mutex_lock(&pool_lock);
+  pool_stats.live_bytes += size;
+  pool_stats.fallback_live++;
+  pool_stats.fallback_total++;
+  pthread_mutex_unlock(&pool_lock);
+
+  return header + FALLBACK_HEADER_BYTES;
+}
+
+static void fallback_free(void *p) {
+  uint8_t *header = (uint8_t *)p - FALLBACK_HEADER_BYTES;
+  size_t size;
+
+  memcpy(&size, header, sizeof(size_t));
+
+  pthread_mutex_lock(&pool_lock);
+  pool_stats.live_bytes -= size;
+  pool_stats.fallback_live--;
+  pthread_mutex_unlock(&pool_lock);
+
+  sodium_free(header);
+}
+
 INTERNAL /*@only@*/ /*@notnull@*/ void *otrng_secure_alloc(size_t size) {
-  void *result = sodium_malloc(size);
+  void *result = NULL;
+  int class = pool_class_for(size);
+
+  COUNT_ALLOCATION();
+
+  if (class >= 0) {
+    pthread_mutex_lock(&pool_lock);
+    result = pool_take(class);
+    pthread_mutex_unlock(&pool_lock);
+  }
+
+  if (!result) {
+    result = fallback_alloc(size);
+  }
+
+  if (!result) {
+    secure_alloc_failed(size);
+  }
+
   memset(result, 0, size);
   return result;
 }
 
 INTERNAL /*@only@*/ /*@notnull@*/ void *otrng_secure_alloc_array(size_t count,
                                                                  size_t size) {
-  return sodium_allocarray(count, size);
+  if (size != 0 && count > SIZE_MAX / size) {
+    secure_alloc_failed(SIZE_MAX);
+  }
+
+  return otrng_secure_alloc(count * size);
+}
+
+#ifdef OTRNG_TESTS
+INTERNAL size_t otrng_alloc_count(void) {
+  return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
 }
+#endif
 
 INTERNAL void otrng_free(/*@notnull@*/ /*@only@*/ void *p) /*@modifies p@*/ {
   free(p);
@@ -83,7 +298,56 @@ INTERNAL void otrng_free(/*@notnull@*/ /*@only@*/ void *p) /*@modifies p@*/ {
 
 INTERNAL void
 otrng_secure_free(/*@notnull@*/ /*@only@*/ void *p) /*@modifies p@*/ {
-  sodium_free(p);
+  otrng_bool pooled;
+
+  if (!p) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool_lock);
+  pooled = pool_give_back(p);
+  pthread_mutex_unlock(&pool_lock);
+
+  if (!pooled) {
+    fallback_free(p);
+  }
+}
+
+API void otrng_secure_pool_get_stats(otrng_secure_pool_stats_s *stats) {
+  int i;
+
+  pthread_mutex_lock(&pool_lock);
+  *stats = pool_stats;
+  pthread_mutex_unlock(&pool_lock);
+
+  for (i = 0; i < OTRNG_SECURE_POOL_CLASSES; i++) {
+    stats->classes[i].chunk_size = pool_chunk_sizes[i];
+  }
+}
+
+API void otrng_secure_pool_free(void) {
+  int i, j;
+
+  pthread_mutex_lock(&pool_lock);
+  for (i = 0; i < OTRNG_SECURE_POOL_CLASSES; i++) {
+    for (j = 0; j < OTRNG_SECURE_POOL_MAX_REGIONS; j++) {
+      pool_region_s *region = &pool_regions[i][j];
+
+      if (!region->base || region->in_use > 0) {
+        continue;
+      }
+
+      /* sodium_free wipes the whole region before unmapping it */
+      sodium_free(region->base);
+      region->base = NULL;
+      region->free_chunks = NULL;
+
+      pool_stats.region_bytes -= OTRNG_SECURE_POOL_REGION_BYTES;
+      pool_stats.classes[i].capacity -=
+          OTRNG_SECURE_POOL_REGION_BYTES / pool_chunk_sizes[i];
+    }
+  }
+  pthread_mutex_unlock(&pool_lock);
 }
 
 INTERNAL void otrng_secure_wipe(/*@notnull@*/ /*@only@*/ void *p,
@@ -22,9 +22,36 @@
 #define OTRNG_ALLOC_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "shared.h"
 
+/*
+ * Small secrets (chain keys, skipped message keys, scratch hashes) are carved
+ * out of a few locked, guard-paged regions instead of paying for a fresh
+ * sodium_malloc (mmap plus guard pages) on every call. Each region serves a
+ * single size class. Allocations bigger than the largest class, or made when
+ * every region of their class is full, fall back to sodium_malloc.
+ */
+#define OTRNG_SECURE_POOL_CLASSES 5
+#define OTRNG_SECURE_POOL_MAX_REGIONS 8
+#define OTRNG_SECURE_POOL_REGION_BYTES 16384
+
+typedef struct otrng_secure_pool_class_stats_s {
+  size_t chunk_size; /* the size of every chunk in this class */
+  size_t in_use;     /* the number of chunks currently handed out */
+  size_t capacity;   /* the number of chunks in the regions mapped so far */
+  size_t high_water; /* the maximum value "in_use" has reached */
+} otrng_secure_pool_class_stats_s;
+
+typedef struct otrng_secure_pool_stats_s {
+  size_t live_bytes;     /* bytes handed out, pooled ones by whole chunks */
+  size_t region_bytes;   /* bytes reserved by the locked regions */
+  size_t fallback_live;  /* live allocations served by sodium_malloc */
+  size_t fallback_total; /* all allocations ever served by sodium_malloc */
+  otrng_secure_pool_class_stats_s classes[OTRNG_SECURE_POOL_CLASSES];
+} otrng_secure_pool_stats_s;
+
 /**
  * @brief The function given to this function will be called if there is no
  * memory left.
@@ -52,7 +79,41 @@ INTERNAL void otrng_free(/*@notnull@*/ /*@only@*/ void *ptr);
 
 INTERNAL void otrng_secure_free(/*@notnull@*/ /*@only@*/ void *ptr);
 
+/**
+ * @brief Takes a snapshot of the secure memory pool counters.
+ *
+ * @param [stats] The structure to fill in.
+ */
+API void otrng_secure_pool_get_stats(otrng_secure_pool_stats_s *stats);
+
+/**
+ * @brief Releases every pool region that has no chunk in use. Regions that
+ * still hold live secrets are kept.
+ */
+API void otrng_secure_pool_free(void);
+
 INTERNAL void otrng_secure_wipe(/*@notnull@*/ /*@only@*/ void *p,
                                 size_t size) /*@modifies p@*/;
 
+#ifdef OTRNG_TESTS
+/**
+ * @brief The number of allocations made through otrng_xmalloc, otrng_xrealloc
+ * and otrng_secure_alloc so far. Only available to the tests and benchmarks,
+ * which use it to check how much a code path allocates.
+ */
+INTERNAL size_t otrng_alloc_count(void);
+#endif
+
+#ifdef OTRNG_ALLOC_PRIVATE
+
+typedef struct pool_region_s {
+  /*@null@*/ uint8_t *base;
+  /*@null@*/ void *free_chunks;
+  size_t in_use;
+} pool_region_s;
+
+tstatic int pool_class_for(size_t size);
+
+#endif
+
 #endif // OTRNG_ALLOC_H
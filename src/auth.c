@@ -167,22 +167,17 @@ static otrng_result otrng_rsig_calculate_c_from_sigma_with_usage_and_domain(
     uint8_t usage, const char *domain_sep, goldilocks_448_scalar_p c,
     const ring_sig_s *src, const otrng_public_key A1, const otrng_public_key A2,
     const otrng_public_key A3, const uint8_t *msg, size_t msg_len) {
-  otrng_public_key gr1, gr2, gr3, A1c1, A2c2, A3c3;
+  otrng_public_key T1, T2, T3;
 
-  goldilocks_448_point_scalarmul(gr1, goldilocks_448_point_base, src->r1);
-  goldilocks_448_point_scalarmul(gr2, goldilocks_448_point_base, src->r2);
-  goldilocks_448_point_scalarmul(gr3, goldilocks_448_point_base, src->r3);
-
-  goldilocks_448_point_scalarmul(A1c1, A1, src->c1);
-  goldilocks_448_point_scalarmul(A2c2, A2, src->c2);
-  goldilocks_448_point_scalarmul(A3c3, A3, src->c3);
-
-  goldilocks_448_point_add(A1c1, A1c1, gr1);
-  goldilocks_448_point_add(A2c2, A2c2, gr2);
-  goldilocks_448_point_add(A3c3, A3c3, gr3);
+  /* Ti = G * ri + Ai * ci. Both the signature and the keys are public, so
+     the faster variable time multiplication, which uses the precomputed
+     table for G, can be used. */
+  goldilocks_448_base_double_scalarmul_non_secret(T1, src->r1, A1, src->c1);
+  goldilocks_448_base_double_scalarmul_non_secret(T2, src->r2, A2, src->c2);
+  goldilocks_448_base_double_scalarmul_non_secret(T3, src->r3, A3, src->c3);
 
   if (!otrng_rsig_calculate_c_with_usage_and_domain(
-          usage, domain_sep, c, A1, A2, A3, A1c1, A2c2, A3c3, msg, msg_len)) {
+          usage, domain_sep, c, A1, A2, A3, T1, T2, T3, msg, msg_len)) {
     return OTRNG_ERROR;
   }
 
@@ -338,6 +333,34 @@ INTERNAL otrng_bool otrng_rsig_verify(const ring_sig_s *src,
       A3, msg, msg_len);
 }
 
+INTERNAL otrng_bool otrng_rsig_verify_batch_with_usage_and_domain(
+    uint8_t usage, const char *domain_sep, rsig_batch_entry_s *entries,
+    size_t len) {
+  otrng_bool all_valid = otrng_true;
+  size_t i;
+
+  /* The challenge is a hash of the Ti, which are not part of the signature,
+     so every Ti has to be computed on its own: the signatures can not be
+     folded into a single random linear combination. */
+  for (i = 0; i < len; i++) {
+    entries[i].valid = otrng_rsig_verify_with_usage_and_domain(
+        usage, domain_sep, entries[i].sigma, entries[i].A1, entries[i].A2,
+        entries[i].A3, entries[i].msg, entries[i].msg_len);
+    if (!entries[i].valid) {
+      all_valid = otrng_false;
+    }
+  }
+
+  return all_valid;
+}
+
+INTERNAL otrng_bool otrng_rsig_verify_batch(rsig_batch_entry_s *entries,
+                                            size_t len) {
+  return otrng_rsig_verify_batch_with_usage_and_domain(
+      OTRNG_PROTOCOL_USAGE_AUTH, OTRNG_PROTOCOL_DOMAIN_SEPARATION, entries,
+      len);
+}
+
 INTERNAL void otrng_ring_sig_destroy(ring_sig_s *src) {
   otrng_ec_scalar_destroy(src->c1);
   otrng_ec_scalar_destroy(src->r1);
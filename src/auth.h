@@ -138,6 +138,46 @@ INTERNAL otrng_bool otrng_rsig_verify_with_usage_and_domain(
     const otrng_public_key A1, const otrng_public_key A2,
     const otrng_public_key A3, const uint8_t *msg, size_t msg_len);
 
+/**
+ * @brief A ring signature to verify with otrng_rsig_verify_batch.
+ *
+ *  [sigma]        the signature of knowledge
+ *  [A1..A3]       the public keys
+ *  [msg, msg_len] the message
+ *  [valid]        set by the verification
+ */
+typedef struct rsig_batch_entry_s {
+  const ring_sig_s *sigma;
+  const goldilocks_448_point_s *A1;
+  const goldilocks_448_point_s *A2;
+  const goldilocks_448_point_s *A3;
+  const uint8_t *msg;
+  size_t msg_len;
+  otrng_bool valid;
+} rsig_batch_entry_s;
+
+/**
+ * @brief Verifies many ring signatures.
+ *
+ * Every entry is verified, and its [valid] field tells whether its signature
+ * is valid, so the failing ones can be told apart.
+ *
+ * @param [entries] The signatures to verify.
+ * @param [len]     The number of entries.
+ *
+ * @return otrng_true if all the signatures are valid.
+ */
+INTERNAL otrng_bool otrng_rsig_verify_batch(rsig_batch_entry_s *entries,
+                                            size_t len);
+
+/**
+ * @brief Verifies many ring signatures, with the hash usage and domain
+ * separation as params. See otrng_rsig_verify_batch.
+ */
+INTERNAL otrng_bool otrng_rsig_verify_batch_with_usage_and_domain(
+    uint8_t usage, const char *domain_sep, rsig_batch_entry_s *entries,
+    size_t len);
+
 /**
  * @brief Zero the values of the Ring Sig.
  *
@@ -1,6 +1,11 @@
 #include "base64.h"
 #include "alloc.h"
 
+#include <string.h>
+
+static const char base64_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
 INTERNAL char *otrng_base64_encode(uint8_t *src, size_t src_len) {
   size_t l;
   char *dst = otrng_xmalloc_z(OTRNG_BASE64_ENCODE_LEN(src_len) + 1);
@@ -10,3 +15,41 @@ INTERNAL char *otrng_base64_encode(uint8_t *src, size_t src_len) {
 
   return dst;
 }
+
+INTERNAL char *otrng_base64_otr_encode_in_place(uint8_t *buffer,
+                                                size_t data_offset,
+                                                size_t data_len) {
+  const uint8_t *src = buffer + data_offset;
+  char *dst = (char *)buffer + 5;
+  size_t remaining = data_len;
+  uint32_t group;
+
+  memcpy(buffer, "?OTR:", 5);
+
+  /* Each group is read in full before its output is written, since the
+     output may reach the start of the group */
+  for (; remaining >= 3; remaining -= 3, src += 3) {
+    group = ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+    *dst++ = base64_alphabet[(group >> 18) & 0x3f];
+    *dst++ = base64_alphabet[(group >> 12) & 0x3f];
+    *dst++ = base64_alphabet[(group >> 6) & 0x3f];
+    *dst++ = base64_alphabet[group & 0x3f];
+  }
+
+  if (remaining) {
+    group = (uint32_t)src[0] << 16;
+    if (remaining == 2) {
+      group |= (uint32_t)src[1] << 8;
+    }
+
+    *dst++ = base64_alphabet[(group >> 18) & 0x3f];
+    *dst++ = base64_alphabet[(group >> 12) & 0x3f];
+    *dst++ = remaining == 2 ? base64_alphabet[(group >> 6) & 0x3f] : '=';
+    *dst++ = '=';
+  }
+
+  *dst++ = '.';
+  *dst = '\0';
+
+  return (char *)buffer;
+}
@@ -5,6 +5,14 @@
 #define OTRNG_BASE64_ENCODE_LEN(x) (((x + 2) / 3) * 4)
 #define OTRNG_BASE64_DECODE_LEN(x) (((x + 3) / 4) * 3)
 
+/* The size of a buffer holding [x] bytes encoded as an OTR message:
+   "?OTR:" || base64 || "." || NUL */
+#define OTRNG_BASE64_OTR_ENCODE_LEN(x) (5 + OTRNG_BASE64_ENCODE_LEN((x)) + 2)
+
+/* Where to place [x] bytes inside a buffer of OTRNG_BASE64_OTR_ENCODE_LEN(x)
+   bytes so they can be encoded in place */
+#define OTRNG_BASE64_OTR_IN_PLACE_OFFSET(x) (5 + ((x) + 2) / 3)
+
 #ifndef S_SPLINT_S
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wstrict-prototypes"
@@ -18,4 +26,23 @@
 
 INTERNAL char *otrng_base64_encode(uint8_t *src, size_t src_len);
 
+/**
+ * @brief Encodes the bytes at [data_offset] in [buffer] as an OTR message,
+ * writing "?OTR:" || base64 || "." from the start of the same buffer.
+ *
+ * Every output group is written behind the input that is still to be read, as
+ * long as [data_offset] is at least
+ * OTRNG_BASE64_OTR_IN_PLACE_OFFSET([data_len]).
+ *
+ * @param [buffer] The buffer, of at least OTRNG_BASE64_OTR_ENCODE_LEN(
+ * [data_len]) bytes, and at least [data_offset] + [data_len].
+ * @param [data_offset] Where the bytes to encode start.
+ * @param [data_len] The number of bytes to encode.
+ *
+ * @return [buffer], now holding the NUL-terminated message.
+ */
+INTERNAL char *otrng_base64_otr_encode_in_place(uint8_t *buffer,
+                                                size_t data_offset,
+                                                size_t data_len);
+
 #endif
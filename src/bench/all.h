@@ -0,0 +1,43 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BENCH_ALL_H__
+#define __BENCH_ALL_H__
+
+void bench_dake_add_cases(void);
+void bench_data_message_add_cases(void);
+void bench_fragment_add_cases(void);
+void bench_keystore_add_cases(void);
+void bench_persistence_add_cases(void);
+void bench_prekey_add_cases(void);
+void bench_smp_add_cases(void);
+
+#define REGISTER_BENCHES                                                       \
+  do {                                                                         \
+    bench_dake_add_cases();                                                    \
+    bench_data_message_add_cases();                                            \
+    bench_fragment_add_cases();                                                \
+    bench_keystore_add_cases();                                                \
+    bench_persistence_add_cases();                                             \
+    bench_prekey_add_cases();                                                  \
+    bench_smp_add_cases();                                                     \
+  } while (0);
+
+#endif // __BENCH_ALL_H__
@@ -0,0 +1,291 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs the benchmark cases and writes one JSON object per case and line, so
+ * the results can be kept and compared between revisions:
+ *
+ *   {"name":"dake/interactive","iterations":50,"ops":50,"ops_per_sec":...,
+ *    "mean_us":...,"p50_us":...,"p90_us":...,"p99_us":...,"max_us":...,
+ *    "allocs_per_op":...}
+ *
+ * Latencies are per operation, and allocations count every otrng_xmalloc,
+ * otrng_xrealloc and otrng_secure_alloc made while timing.
+ */
+
+#include <gcrypt.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "all.h"
+#include "bench.h"
+
+#include "alloc.h"
+#include "otrng.h"
+
+#define MAX_CASES 64
+#define MAX_PREFIXES 16
+
+static const bench_case_s *cases[MAX_CASES];
+static int num_cases;
+
+void bench_add(const bench_case_s *bench_case) {
+  bench_check(num_cases < MAX_CASES, "to add a case");
+  cases[num_cases++] = bench_case;
+}
+
+void bench_check(int cond, const char *what) {
+  if (cond) {
+    return;
+  }
+
+  fprintf(stderr, "bench: failed %s\n", what);
+  exit(EXIT_FAILURE);
+}
+
+void bench_deliver(char *msg, otrng_s *to, otrng_s *from) {
+  while (msg) {
+    otrng_response_s *response = otrng_response_new();
+    otrng_s *sender = to;
+
+    bench_check(otrng_succeeded(otrng_receive_message(response, msg, to)),
+                "to receive a message");
+    otrng_free(msg);
+
+    msg = response->to_send;
+    response->to_send = NULL;
+    otrng_response_free(response);
+
+    to = from;
+    from = sender;
+  }
+}
+
+bench_pair_s *bench_pair_new(void) {
+  bench_pair_s *pair = otrng_xmalloc_z(sizeof(bench_pair_s));
+
+  pair->alice_client = otrng_client_new(ALICE_IDENTITY);
+  pair->bob_client = otrng_client_new(BOB_IDENTITY);
+  pair->alice = set_up(pair->alice_client, 1);
+  pair->bob = set_up(pair->bob_client, 2);
+
+  return pair;
+}
+
+void bench_pair_restart(bench_pair_s *pair) {
+  otrng_policy_s policy = {.allows = OTRNG_ALLOW_V34,
+                           .type = OTRNG_POLICY_ALWAYS};
+
+  otrng_conn_free(pair->alice);
+  otrng_conn_free(pair->bob);
+  pair->alice = otrng_new(pair->alice_client, policy);
+  pair->bob = otrng_new(pair->bob_client, policy);
+}
+
+void bench_pair_do_dake(bench_pair_s *pair) {
+  char *query = NULL;
+
+  bench_check(otrng_succeeded(
+                  otrng_build_query_message(&query, "", pair->alice)),
+              "to build a query message");
+  bench_deliver(query, pair->bob, pair->alice);
+
+  bench_check(pair->alice->state == OTRNG_STATE_ENCRYPTED_MESSAGES &&
+                  pair->bob->state == OTRNG_STATE_ENCRYPTED_MESSAGES,
+              "to finish the DAKE");
+}
+
+void bench_pair_free(bench_pair_s *pair) {
+  otrng_global_state_free(pair->alice_client->global_state);
+  otrng_global_state_free(pair->bob_client->global_state);
+  otrng_conn_free(pair->alice);
+  otrng_conn_free(pair->bob);
+  otrng_free(pair);
+}
+
+static int compare_latencies(const void *a, const void *b) {
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* Nearest rank: the smallest value at least [p] percent of them are under */
+static double percentile(const double *sorted, int len, int p) {
+  int rank = (p * len + 99) / 100;
+
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  return sorted[rank - 1];
+}
+
+static void run_case(const bench_case_s *bench_case, int iterations,
+                     FILE *out) {
+  double *latencies = otrng_xmalloc_z(iterations * sizeof(double));
+  const int ops = iterations * bench_case->ops_per_run;
+  gint64 total = 0;
+  size_t allocs = 0;
+  void *state = bench_case->set_up(bench_case->arg);
+  int i;
+
+  /* The first run warms up, and is not recorded */
+  for (i = -1; i < iterations; i++) {
+    gint64 start, elapsed;
+    size_t allocs_before, allocs_after;
+
+    if (bench_case->prepare) {
+      bench_case->prepare(state);
+    }
+
+    allocs_before = otrng_alloc_count();
+    start = g_get_monotonic_time();
+    bench_case->run(state);
+    elapsed = g_get_monotonic_time() - start;
+    allocs_after = otrng_alloc_count();
+
+    if (bench_case->finish) {
+      bench_case->finish(state);
+    }
+
+    if (i < 0) {
+      continue;
+    }
+
+    latencies[i] = (double)elapsed / bench_case->ops_per_run;
+    total += elapsed;
+    allocs += allocs_after - allocs_before;
+  }
+
+  bench_case->tear_down(state);
+
+  if (total == 0) {
+    total = 1;
+  }
+
+  qsort(latencies, iterations, sizeof(double), compare_latencies);
+
+  fprintf(out,
+          "{\"name\":\"%s\",\"iterations\":%d,\"ops\":%d,"
+          "\"ops_per_sec\":%.1f,\"mean_us\":%.2f,\"p50_us\":%.2f,"
+          "\"p90_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f,"
+          "\"allocs_per_op\":%.1f}\n",
+          bench_case->name, iterations, ops, 1e6 * ops / (double)total,
+          (double)total / ops, percentile(latencies, iterations, 50),
+          percentile(latencies, iterations, 90),
+          percentile(latencies, iterations, 99), latencies[iterations - 1],
+          (double)allocs / ops);
+  fflush(out);
+
+  otrng_free(latencies);
+}
+
+static int is_selected(const char *name, const char **prefixes,
+                       int num_prefixes) {
+  int i;
+
+  if (num_prefixes == 0) {
+    return 1;
+  }
+
+  for (i = 0; i < num_prefixes; i++) {
+    if (strncmp(name, prefixes[i], strlen(prefixes[i])) == 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-l] [-n ITERATIONS] [-o FILE] [-p PREFIX]...\n"
+          "  -l  list the cases and exit\n"
+          "  -n  time every case this many times\n"
+          "  -o  write the results to FILE instead of stdout\n"
+          "  -p  only run the cases whose name starts with PREFIX\n",
+          program);
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  const char *prefixes[MAX_PREFIXES];
+  int num_prefixes = 0;
+  int iterations = 0;
+  int list = 0;
+  FILE *out = stdout;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-l") == 0) {
+      list = 1;
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+      if (iterations < 1) {
+        return usage(argv[0]);
+      }
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      out = fopen(argv[++i], "w");
+      if (!out) {
+        perror(argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc &&
+               num_prefixes < MAX_PREFIXES) {
+      prefixes[num_prefixes++] = argv[++i];
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  if (!gcry_check_version(GCRYPT_VERSION)) {
+    return 2;
+  }
+
+  gcry_control(GCRYCTL_INIT_SECMEM, 0);
+  gcry_control(GCRYCTL_RESUME_SECMEM_WARN);
+  gcry_control(GCRYCTL_INITIALIZATION_FINISHED);
+
+  OTRNG_INIT;
+
+  REGISTER_BENCHES;
+
+  for (i = 0; i < num_cases; i++) {
+    if (!is_selected(cases[i]->name, prefixes, num_prefixes)) {
+      continue;
+    }
+
+    if (list) {
+      fprintf(out, "%s\n", cases[i]->name);
+    } else {
+      run_case(cases[i], iterations ? iterations : cases[i]->iterations, out);
+    }
+  }
+
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  OTRNG_FREE;
+  return EXIT_SUCCESS;
+}
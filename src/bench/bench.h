@@ -0,0 +1,93 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "test_fixtures.h"
+
+/*
+ * A benchmark case. Everything but run is untimed: set_up builds the state
+ * once, prepare and finish (both optional) bring it back to where run expects
+ * it, and tear_down frees it.
+ */
+typedef struct bench_case_s {
+  const char *name;
+  int iterations; /* How many times run is timed, unless overridden */
+  int ops_per_run; /* How many operations one run is made of */
+  const void *arg;
+  void *(*set_up)(const void *arg);
+  /*@null@*/ void (*prepare)(void *state);
+  void (*run)(void *state);
+  /*@null@*/ void (*finish)(void *state);
+  void (*tear_down)(void *state);
+} bench_case_s;
+
+/**
+ * @brief Adds a case to the ones the harness runs. [bench_case] must outlive
+ * the run.
+ *
+ * @param [bench_case] The case.
+ */
+void bench_add(const bench_case_s *bench_case);
+
+/**
+ * @brief Aborts the whole run if [cond] does not hold. The cases use it
+ * instead of asserting, so the numbers never come from a failed run.
+ *
+ * @param [cond] The condition.
+ * @param [what] What was being done, for the error message.
+ */
+void bench_check(int cond, const char *what);
+
+/**
+ * @brief Delivers [msg] to [to], and then every reply back and forth, until
+ * nobody has anything left to send. Takes ownership of [msg].
+ *
+ * @param [msg] The message, or NULL.
+ * @param [to] Who receives [msg].
+ * @param [from] Who sent [msg].
+ */
+void bench_deliver(/*@only@*/ /*@null@*/ char *msg, otrng_s *to, otrng_s *from);
+
+/* Two conversations talking to each other, each on its own client and global
+   state */
+typedef struct bench_pair_s {
+  otrng_client_s *alice_client;
+  otrng_client_s *bob_client;
+  otrng_s *alice;
+  otrng_s *bob;
+} bench_pair_s;
+
+bench_pair_s *bench_pair_new(void);
+
+/**
+ * @brief Replaces both conversations with fresh ones, keeping the clients.
+ */
+void bench_pair_restart(bench_pair_s *pair);
+
+/**
+ * @brief Runs the interactive DAKE, after which the pair is encrypted.
+ */
+void bench_pair_do_dake(bench_pair_s *pair);
+
+void bench_pair_free(bench_pair_s *pair);
+
+#endif // __BENCH_H__
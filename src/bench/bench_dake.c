@@ -0,0 +1,121 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include "otrng.h"
+#include "prekey_ensemble.h"
+
+static void *dake_set_up(const void *arg) {
+  (void)arg;
+  return bench_pair_new();
+}
+
+static void dake_restart(void *state) { bench_pair_restart(state); }
+
+static void dake_tear_down(void *state) { bench_pair_free(state); }
+
+static void run_interactive_dake(void *state) { bench_pair_do_dake(state); }
+
+/* Bob's ensemble comes from the prekey server, so building it is not timed */
+typedef struct non_interactive_state_s {
+  bench_pair_s *pair;
+  prekey_ensemble_s *ensemble;
+} non_interactive_state_s;
+
+static void *non_interactive_set_up(const void *arg) {
+  non_interactive_state_s *state =
+      otrng_xmalloc_z(sizeof(non_interactive_state_s));
+  (void)arg;
+
+  state->pair = bench_pair_new();
+  return state;
+}
+
+static void non_interactive_prepare(void *s) {
+  non_interactive_state_s *state = s;
+
+  bench_pair_restart(state->pair);
+  state->ensemble = otrng_build_prekey_ensemble(state->pair->bob);
+  bench_check(state->ensemble != NULL, "to build a prekey ensemble");
+}
+
+/* Alice validates the ensemble and sends the Non-Interactive-Auth message
+   with her first data message, which Bob receives */
+static void run_non_interactive_dake(void *s) {
+  non_interactive_state_s *state = s;
+  bench_pair_s *pair = state->pair;
+  char *to_bob = NULL;
+
+  bench_check(otrng_succeeded(otrng_prekey_ensemble_validate(state->ensemble)),
+              "to validate a prekey ensemble");
+  bench_check(otrng_succeeded(otrng_send_non_interactive_auth(
+                  &to_bob, state->ensemble, pair->alice)),
+              "to send a Non-Interactive-Auth message");
+  bench_deliver(to_bob, pair->bob, pair->alice);
+
+  bench_check(otrng_succeeded(otrng_send_message(&to_bob, "hi", NULL, 0,
+                                                 pair->alice)),
+              "to send a data message");
+  bench_deliver(to_bob, pair->bob, pair->alice);
+
+  bench_check(pair->bob->state == OTRNG_STATE_ENCRYPTED_MESSAGES,
+              "to finish the non-interactive DAKE");
+}
+
+static void non_interactive_finish(void *s) {
+  non_interactive_state_s *state = s;
+
+  otrng_prekey_ensemble_free(state->ensemble);
+  state->ensemble = NULL;
+}
+
+static void non_interactive_tear_down(void *s) {
+  non_interactive_state_s *state = s;
+
+  bench_pair_free(state->pair);
+  otrng_free(state);
+}
+
+static const bench_case_s interactive_dake[1] = {{
+    .name = "dake/interactive",
+    .iterations = 50,
+    .ops_per_run = 1,
+    .set_up = dake_set_up,
+    .prepare = dake_restart,
+    .run = run_interactive_dake,
+    .tear_down = dake_tear_down,
+}};
+
+static const bench_case_s non_interactive_dake[1] = {{
+    .name = "dake/non-interactive",
+    .iterations = 50,
+    .ops_per_run = 1,
+    .set_up = non_interactive_set_up,
+    .prepare = non_interactive_prepare,
+    .run = run_non_interactive_dake,
+    .finish = non_interactive_finish,
+    .tear_down = non_interactive_tear_down,
+}};
+
+void bench_dake_add_cases(void) {
+  bench_add(interactive_dake);
+  bench_add(non_interactive_dake);
+}
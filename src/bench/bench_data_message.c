@@ -0,0 +1,106 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include "otrng.h"
+
+#define REORDERED_BATCH 8
+
+static const char *message =
+    "A message about the length of a line or two of chat, which is what most "
+    "of the data messages sent in a conversation look like.";
+
+static void *data_message_set_up(const void *arg) {
+  bench_pair_s *pair = bench_pair_new();
+  (void)arg;
+
+  bench_pair_do_dake(pair);
+  return pair;
+}
+
+static void data_message_tear_down(void *state) { bench_pair_free(state); }
+
+static void send_and_deliver(otrng_s *from, otrng_s *to) {
+  char *to_send = NULL;
+
+  bench_check(
+      otrng_succeeded(otrng_send_message(&to_send, message, NULL, 0, from)),
+      "to send a data message");
+  bench_deliver(to_send, to, from);
+}
+
+/* Four messages each way in turn, so the ratchet moves as in a chat */
+static void run_in_order(void *state) {
+  bench_pair_s *pair = state;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    send_and_deliver(pair->alice, pair->bob);
+  }
+
+  for (i = 0; i < 4; i++) {
+    send_and_deliver(pair->bob, pair->alice);
+  }
+}
+
+/* Alice sends a batch that Bob receives backwards, so all but one of them
+   are read from the skipped message keys, and Bob answers */
+static void run_reordered(void *state) {
+  bench_pair_s *pair = state;
+  char *batch[REORDERED_BATCH];
+  int i;
+
+  for (i = 0; i < REORDERED_BATCH; i++) {
+    batch[i] = NULL;
+    bench_check(otrng_succeeded(otrng_send_message(&batch[i], message, NULL, 0,
+                                                   pair->alice)),
+                "to send a data message");
+  }
+
+  for (i = REORDERED_BATCH - 1; i >= 0; i--) {
+    bench_deliver(batch[i], pair->bob, pair->alice);
+  }
+
+  send_and_deliver(pair->bob, pair->alice);
+}
+
+static const bench_case_s in_order[1] = {{
+    .name = "data-message/in-order",
+    .iterations = 250,
+    .ops_per_run = 8,
+    .set_up = data_message_set_up,
+    .run = run_in_order,
+    .tear_down = data_message_tear_down,
+}};
+
+static const bench_case_s reordered[1] = {{
+    .name = "data-message/reordered",
+    .iterations = 250,
+    .ops_per_run = REORDERED_BATCH + 1,
+    .set_up = data_message_set_up,
+    .run = run_reordered,
+    .tear_down = data_message_tear_down,
+}};
+
+void bench_data_message_add_cases(void) {
+  bench_add(in_order);
+  bench_add(reordered);
+}
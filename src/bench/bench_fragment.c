@@ -0,0 +1,113 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "bench.h"
+
+#include "base64.h"
+#include "fragment.h"
+#include "random.h"
+
+/* About the size of an encoded data message with a few KB of text */
+#define PAYLOAD_BYTES 4096
+
+typedef struct fragment_state_s {
+  int max_size;
+  char *msg;
+  fragment_contexts_s contexts;
+} fragment_state_s;
+
+static void *fragment_set_up(const void *arg) {
+  fragment_state_s *state = otrng_xmalloc_z(sizeof(fragment_state_s));
+  uint8_t payload[PAYLOAD_BYTES];
+  char *encoded;
+  size_t len;
+
+  random_bytes(payload, PAYLOAD_BYTES);
+  encoded = otrng_base64_encode(payload, PAYLOAD_BYTES);
+  bench_check(encoded != NULL, "to encode a message");
+
+  len = strlen(encoded);
+  state->msg = otrng_xmalloc_z(len + 7);
+  memcpy(state->msg, "?OTR:", 5);
+  memcpy(state->msg + 5, encoded, len);
+  state->msg[len + 5] = '.';
+  otrng_free(encoded);
+
+  state->max_size = *(const int *)arg;
+  return state;
+}
+
+/* Splits the message and puts it back together, as the sender and the
+   receiver would */
+static void run_fragment(void *s) {
+  fragment_state_s *state = s;
+  otrng_message_to_send_s *fragments = otrng_message_new();
+  char *unfragmented = NULL;
+  int i;
+
+  bench_check(otrng_succeeded(otrng_fragment_message(
+                  state->max_size, fragments, 0x100, 0x101, state->msg)),
+              "to fragment a message");
+
+  for (i = 0; i < fragments->total; i++) {
+    bench_check(otrng_succeeded(otrng_unfragment_message(
+                    &unfragmented, &state->contexts, fragments->pieces[i],
+                    0x101)),
+                "to unfragment a message");
+  }
+
+  bench_check(unfragmented != NULL, "to reassemble a message");
+  otrng_free(unfragmented);
+  otrng_message_free(fragments);
+}
+
+static void fragment_tear_down(void *s) {
+  fragment_state_s *state = s;
+
+  otrng_fragment_contexts_destroy(&state->contexts);
+  otrng_free(state->msg);
+  otrng_free(state);
+}
+
+#define FRAGMENT_CASE(mms)                                                     \
+  static const int max_size_##mms = mms;                                       \
+  static const bench_case_s fragment_##mms[1] = {{                             \
+      .name = "fragment/mms-" #mms,                                            \
+      .iterations = 2000,                                                      \
+      .ops_per_run = 1,                                                        \
+      .arg = &max_size_##mms,                                                  \
+      .set_up = fragment_set_up,                                               \
+      .run = run_fragment,                                                     \
+      .tear_down = fragment_tear_down,                                         \
+  }}
+
+FRAGMENT_CASE(140);
+FRAGMENT_CASE(500);
+FRAGMENT_CASE(1400);
+FRAGMENT_CASE(4096);
+
+void bench_fragment_add_cases(void) {
+  bench_add(fragment_140);
+  bench_add(fragment_500);
+  bench_add(fragment_1400);
+  bench_add(fragment_4096);
+}
@@ -0,0 +1,224 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "bench.h"
+
+#include "fingerprint.h"
+#include "keystore.h"
+#include "messaging.h"
+#include "random.h"
+
+#define ACCOUNTS 50
+#define FINGERPRINTS 100
+
+/* The files a plugin loads for its accounts when it starts */
+typedef struct text_file_s {
+  otrng_result (*write_to)(const otrng_global_state_s *gs, FILE *f);
+  otrng_result (*read_from)(otrng_global_state_s *gs, FILE *f,
+                            otrng_client_id_s (*read_client_id)(FILE *f));
+} text_file_s;
+
+static const text_file_s text_files[] = {
+    {otrng_global_state_private_key_v4_write_to,
+     otrng_global_state_private_key_v4_read_from},
+    {otrng_global_state_forging_key_write_to,
+     otrng_global_state_forging_key_read_from},
+    {otrng_global_state_client_profile_write_to,
+     otrng_global_state_client_profile_read_from},
+    {otrng_global_state_fingerprints_v4_write_to,
+     otrng_global_state_fingerprints_v4_read_from},
+};
+
+#define NUM_TEXT_FILES (sizeof(text_files) / sizeof(text_file_s))
+
+typedef struct keystore_state_s {
+  otrng_global_state_s *stored;
+  FILE *files[NUM_TEXT_FILES];
+  FILE *keystore_file;
+  otrng_keystore_s *keystore;
+  otrng_global_state_s *loaded;
+} keystore_state_s;
+
+static char accounts[ACCOUNTS][32];
+
+static otrng_client_id_s account_id(int i) {
+  return create_client_id("otr", accounts[i]);
+}
+
+static otrng_client_id_s read_client_id(FILE *f) {
+  char line[64];
+  int i;
+  otrng_client_id_s client_id = {NULL, NULL};
+
+  if (fgets(line, sizeof(line), f) != NULL &&
+      sscanf(line, "otr:account%d@", &i) == 1 && i >= 0 && i < ACCOUNTS) {
+    client_id = account_id(i);
+  }
+
+  return client_id;
+}
+
+/* Every account with its keys, its client profile and whom it has talked to */
+static void *keystore_set_up(const void *arg) {
+  keystore_state_s *state = otrng_xmalloc_z(sizeof(keystore_state_s));
+  otrng_fingerprint fp;
+  char peer[32];
+  size_t f;
+  int i, j;
+  (void)arg;
+
+  state->stored = otrng_global_state_new(test_callbacks, otrng_false);
+  for (i = 0; i < ACCOUNTS; i++) {
+    otrng_client_s *client;
+
+    snprintf(accounts[i], sizeof(accounts[i]), "account%d@otr.example", i);
+    client = otrng_client_get(state->stored, account_id(i));
+    set_up_client_keys(client, i);
+
+    for (j = 0; j < FINGERPRINTS; j++) {
+      random_bytes(fp, sizeof(fp));
+      snprintf(peer, sizeof(peer), "peer%d@otr.example", j);
+      otrng_fingerprint_add(client, fp, peer, j % 2 == 0);
+    }
+  }
+
+  for (f = 0; f < NUM_TEXT_FILES; f++) {
+    state->files[f] = tmpfile();
+    bench_check(state->files[f] != NULL, "to create a temporary file");
+    bench_check(
+        otrng_succeeded(text_files[f].write_to(state->stored, state->files[f])),
+        "to store a file");
+  }
+
+  state->keystore_file = tmpfile();
+  bench_check(state->keystore_file != NULL, "to create a temporary file");
+  bench_check(otrng_succeeded(otrng_global_state_keystore_write_to(
+                  state->stored, state->keystore_file)),
+              "to store the keystore");
+  bench_check(fflush(state->keystore_file) == 0, "to store the keystore");
+
+  return state;
+}
+
+static void keystore_tear_down(void *s) {
+  keystore_state_s *state = s;
+  size_t f;
+
+  for (f = 0; f < NUM_TEXT_FILES; f++) {
+    fclose(state->files[f]);
+  }
+  fclose(state->keystore_file);
+  otrng_global_state_free(state->stored);
+  otrng_free(state);
+}
+
+/* Every run starts like the plugin does, without any client */
+static void startup_prepare(void *s) {
+  keystore_state_s *state = s;
+  size_t f;
+
+  for (f = 0; f < NUM_TEXT_FILES; f++) {
+    rewind(state->files[f]);
+  }
+  state->loaded = otrng_global_state_new(test_callbacks, otrng_false);
+}
+
+static void startup_finish(void *s) {
+  keystore_state_s *state = s;
+
+  otrng_keystore_close(state->keystore);
+  state->keystore = NULL;
+  otrng_global_state_free(state->loaded);
+  state->loaded = NULL;
+}
+
+static void run_startup_text(void *s) {
+  keystore_state_s *state = s;
+  size_t f;
+
+  for (f = 0; f < NUM_TEXT_FILES; f++) {
+    bench_check(otrng_succeeded(text_files[f].read_from(
+                    state->loaded, state->files[f], read_client_id)),
+                "to load a file");
+  }
+}
+
+static void run_startup_keystore(void *s) {
+  keystore_state_s *state = s;
+
+  state->keystore = otrng_keystore_open(state->keystore_file);
+  bench_check(state->keystore != NULL, "to open the keystore");
+  bench_check(otrng_succeeded(otrng_global_state_keystore_read_from(
+                  state->loaded, state->keystore)),
+              "to load the keystore");
+}
+
+/* Only the account the user signs in with is read */
+static void run_startup_one_account(void *s) {
+  keystore_state_s *state = s;
+
+  state->keystore = otrng_keystore_open(state->keystore_file);
+  bench_check(state->keystore != NULL, "to open the keystore");
+  bench_check(otrng_succeeded(otrng_keystore_read_client(
+                  state->keystore,
+                  otrng_client_get(state->loaded, account_id(ACCOUNTS / 2)))),
+              "to load an account");
+}
+
+static const bench_case_s startup_text[1] = {{
+    .name = "keystore/startup-text",
+    .iterations = 20,
+    .ops_per_run = 1,
+    .set_up = keystore_set_up,
+    .prepare = startup_prepare,
+    .run = run_startup_text,
+    .finish = startup_finish,
+    .tear_down = keystore_tear_down,
+}};
+
+static const bench_case_s startup_keystore[1] = {{
+    .name = "keystore/startup-binary",
+    .iterations = 20,
+    .ops_per_run = 1,
+    .set_up = keystore_set_up,
+    .prepare = startup_prepare,
+    .run = run_startup_keystore,
+    .finish = startup_finish,
+    .tear_down = keystore_tear_down,
+}};
+
+static const bench_case_s startup_one_account[1] = {{
+    .name = "keystore/startup-one-account",
+    .iterations = 200,
+    .ops_per_run = 1,
+    .set_up = keystore_set_up,
+    .prepare = startup_prepare,
+    .run = run_startup_one_account,
+    .finish = startup_finish,
+    .tear_down = keystore_tear_down,
+}};
+
+void bench_keystore_add_cases(void) {
+  bench_add(startup_text);
+  bench_add(startup_keystore);
+  bench_add(startup_one_account);
+}
@@ -0,0 +1,198 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "fingerprint.h"
+#include "messaging.h"
+#include "random.h"
+
+#define PREKEY_MESSAGES 100
+#define FINGERPRINTS 100
+
+/* One file of the ones a plugin keeps for its accounts */
+typedef struct persisted_s {
+  otrng_result (*write_to)(const otrng_global_state_s *gs, FILE *f);
+  otrng_result (*read_from)(otrng_global_state_s *gs, FILE *f,
+                            otrng_client_id_s (*read_client_id)(FILE *f));
+} persisted_s;
+
+static const persisted_s persisted[] = {
+    {otrng_global_state_private_key_v4_write_to,
+     otrng_global_state_private_key_v4_read_from},
+    {otrng_global_state_forging_key_write_to,
+     otrng_global_state_forging_key_read_from},
+    {otrng_global_state_client_profile_write_to,
+     otrng_global_state_client_profile_read_from},
+    {otrng_global_state_prekey_profile_write_to,
+     otrng_global_state_prekey_profile_read_from},
+    {otrng_global_state_prekey_messages_write_to,
+     otrng_global_state_prekeys_read_from},
+    {otrng_global_state_fingerprints_v4_write_to,
+     otrng_global_state_fingerprints_v4_read_from},
+};
+
+#define NUM_PERSISTED (sizeof(persisted) / sizeof(persisted_s))
+
+typedef struct persistence_state_s {
+  otrng_client_s *client;
+  FILE *files[NUM_PERSISTED];
+} persistence_state_s;
+
+static otrng_client_id_s read_client_id(FILE *f) {
+  char line[64];
+  otrng_client_id_s client_id = {NULL, NULL};
+
+  if (fgets(line, sizeof(line), f) != NULL &&
+      strcmp(line, "otr:" ALICE_ACCOUNT "\n") == 0) {
+    client_id = ALICE_IDENTITY;
+  }
+
+  return client_id;
+}
+
+static void open_files(persistence_state_s *state) {
+  size_t i;
+
+  for (i = 0; i < NUM_PERSISTED; i++) {
+    state->files[i] = tmpfile();
+    bench_check(state->files[i] != NULL, "to create a temporary file");
+  }
+}
+
+static void close_files(persistence_state_s *state) {
+  size_t i;
+
+  for (i = 0; i < NUM_PERSISTED; i++) {
+    fclose(state->files[i]);
+    state->files[i] = NULL;
+  }
+}
+
+static void write_files(persistence_state_s *state) {
+  size_t i;
+
+  for (i = 0; i < NUM_PERSISTED; i++) {
+    bench_check(otrng_succeeded(persisted[i].write_to(
+                    state->client->global_state, state->files[i])),
+                "to store a file");
+    bench_check(fflush(state->files[i]) == 0, "to store a file");
+  }
+}
+
+/* A client with everything a plugin stores for an account */
+static void *persistence_set_up(const void *arg) {
+  persistence_state_s *state = otrng_xmalloc_z(sizeof(persistence_state_s));
+  otrng_fingerprint fp;
+  char peer[32];
+  int i;
+  (void)arg;
+
+  state->client = otrng_client_new(ALICE_IDENTITY);
+  set_up_client(state->client, 1);
+  bench_check(otrng_client_get_prekey_profile(state->client) != NULL,
+              "to create a prekey profile");
+  otrng_free(
+      otrng_client_build_prekey_messages(PREKEY_MESSAGES, state->client));
+
+  for (i = 0; i < FINGERPRINTS; i++) {
+    random_bytes(fp, sizeof(fp));
+    snprintf(peer, sizeof(peer), "peer%d@otr.example", i);
+    otrng_fingerprint_add(state->client, fp, peer, i % 2 == 0);
+  }
+
+  return state;
+}
+
+static void persistence_tear_down(void *s) {
+  persistence_state_s *state = s;
+
+  otrng_global_state_free(state->client->global_state);
+  otrng_free(state);
+}
+
+static void store_prepare(void *s) { open_files(s); }
+
+static void run_store(void *s) { write_files(s); }
+
+static void store_finish(void *s) { close_files(s); }
+
+static void *load_set_up(const void *arg) {
+  persistence_state_s *state = persistence_set_up(arg);
+
+  open_files(state);
+  write_files(state);
+  return state;
+}
+
+static void load_prepare(void *s) {
+  persistence_state_s *state = s;
+  size_t i;
+
+  for (i = 0; i < NUM_PERSISTED; i++) {
+    rewind(state->files[i]);
+  }
+}
+
+static void run_load(void *s) {
+  persistence_state_s *state = s;
+  size_t i;
+
+  for (i = 0; i < NUM_PERSISTED; i++) {
+    bench_check(otrng_succeeded(persisted[i].read_from(
+                    state->client->global_state, state->files[i],
+                    read_client_id)),
+                "to load a file");
+  }
+}
+
+static void load_tear_down(void *s) {
+  close_files(s);
+  persistence_tear_down(s);
+}
+
+static const bench_case_s store[1] = {{
+    .name = "persistence/store",
+    .iterations = 200,
+    .ops_per_run = 1,
+    .set_up = persistence_set_up,
+    .prepare = store_prepare,
+    .run = run_store,
+    .finish = store_finish,
+    .tear_down = persistence_tear_down,
+}};
+
+static const bench_case_s load[1] = {{
+    .name = "persistence/load",
+    .iterations = 200,
+    .ops_per_run = 1,
+    .set_up = load_set_up,
+    .prepare = load_prepare,
+    .run = run_load,
+    .tear_down = load_tear_down,
+}};
+
+void bench_persistence_add_cases(void) {
+  bench_add(store);
+  bench_add(load);
+}
@@ -0,0 +1,102 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "bench.h"
+
+#include "client.h"
+#include "prekey_manager.h"
+
+/* How many prekey messages a client publishes at once */
+#define PUBLISHED_MESSAGES 10
+
+static void *publication_set_up(const void *arg) {
+  otrng_client_s *client = otrng_client_new(ALICE_IDENTITY);
+  (void)arg;
+
+  set_up_client(client, 1);
+  bench_check(otrng_client_get_prekey_profile(client) != NULL,
+              "to create a prekey profile");
+
+  return client;
+}
+
+/* Everything a client does to publish, after the DAKE with the server:
+   generating the prekey messages, and the proofs and MAC over them and both
+   profiles */
+static void run_publication(void *state) {
+  otrng_client_s *client = state;
+  otrng_prekey_publication_message_s *pub_msg;
+  otrng_prekey_dake3_message_s dake_3;
+  uint8_t mac_key[MAC_KEY_BYTES];
+  uint8_t mac[HASH_BYTES];
+  prekey_message_s **messages;
+
+  messages = otrng_client_build_prekey_messages(PUBLISHED_MESSAGES, client);
+  bench_check(messages != NULL, "to build prekey messages");
+  otrng_free(messages);
+
+  pub_msg = otrng_prekey_publication_message_new();
+  otrng_prekey_add_prekey_messages_for_publication(client, pub_msg);
+
+  pub_msg->client_profile = otrng_xmalloc_z(sizeof(otrng_client_profile_s));
+  bench_check(otrng_client_profile_copy(pub_msg->client_profile,
+                                        client->client_profile),
+              "to copy the client profile");
+  pub_msg->prekey_profile = otrng_xmalloc_z(sizeof(otrng_prekey_profile_s));
+  otrng_prekey_profile_copy(pub_msg->prekey_profile, client->prekey_profile);
+
+  memset(&dake_3, 0, sizeof(dake_3));
+  memset(mac_key, 0x1, MAC_KEY_BYTES);
+  memset(mac, 0x2, HASH_BYTES);
+  bench_check(otrng_succeeded(dake3_message_append_prekey_publication_message(
+                  pub_msg, &dake_3, mac_key, mac)),
+              "to build a publication message");
+
+  otrng_free(dake_3.msg);
+  otrng_prekey_publication_message_destroy(pub_msg);
+  otrng_free(pub_msg);
+}
+
+/* Keeps the store from growing between runs */
+static void publication_finish(void *state) {
+  otrng_client_s *client = state;
+
+  otrng_prekey_store_destroy(&client->our_prekeys);
+}
+
+static void publication_tear_down(void *state) {
+  otrng_client_s *client = state;
+
+  otrng_global_state_free(client->global_state);
+}
+
+static const bench_case_s publication[1] = {{
+    .name = "prekey/publication",
+    .iterations = 20,
+    .ops_per_run = 1,
+    .set_up = publication_set_up,
+    .run = run_publication,
+    .finish = publication_finish,
+    .tear_down = publication_tear_down,
+}};
+
+void bench_prekey_add_cases(void) { bench_add(publication); }
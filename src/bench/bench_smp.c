@@ -0,0 +1,70 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "bench.h"
+
+#include "smp.h"
+
+static const char *secret = "the answer to the question";
+
+static void *smp_set_up(const void *arg) {
+  bench_pair_s *pair = bench_pair_new();
+  (void)arg;
+
+  bench_pair_do_dake(pair);
+  return pair;
+}
+
+static void smp_tear_down(void *state) { bench_pair_free(state); }
+
+/* All four SMP messages, with Bob answering as soon as he is asked */
+static void run_smp(void *state) {
+  bench_pair_s *pair = state;
+  char *to_send = NULL;
+
+  bench_check(otrng_succeeded(otrng_smp_start(&to_send, NULL, 0,
+                                              (const uint8_t *)secret,
+                                              strlen(secret), pair->alice)),
+              "to start SMP");
+  bench_deliver(to_send, pair->bob, pair->alice);
+
+  bench_check(otrng_succeeded(otrng_smp_continue(&to_send,
+                                                 (const uint8_t *)secret,
+                                                 strlen(secret), pair->bob)),
+              "to answer SMP");
+  bench_deliver(to_send, pair->alice, pair->bob);
+
+  bench_check(pair->alice->smp->state_expect == SMP_STATE_EXPECT_1 &&
+                  pair->bob->smp->state_expect == SMP_STATE_EXPECT_1,
+              "to finish SMP");
+}
+
+static const bench_case_s smp[1] = {{
+    .name = "smp/full",
+    .iterations = 50,
+    .ops_per_run = 1,
+    .set_up = smp_set_up,
+    .run = run_smp,
+    .tear_down = smp_tear_down,
+}};
+
+void bench_smp_add_cases(void) { bench_add(smp); }
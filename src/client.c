@@ -44,20 +44,66 @@
 #define MAX_NUMBER_PUBLISHED_PREKEY_MSGS 255
 #define HEARTBEAT_INTERVAL 60
 
+tstatic uint32_t get_session_expiry_time_from(otrng_s *otr) {
+  return otr->client->global_state->callbacks->session_expiration_time_for(otr);
+}
+
+tstatic otrng_bool sessions_expire(const otrng_client_s *client) {
+  return client->global_state &&
+         client->global_state->callbacks->session_expiration_time_for;
+}
+
+/* The session keys are not followed as they change: when the timer expires,
+   it is scheduled again if newer keys have been generated since */
+tstatic void session_timer_expired(void *data, time_t now) {
+  otrng_conversation_s *conv = data;
+  otrng_s *otr = conv->conn;
+  time_t last_generated = otr->keys->last_generated;
+  time_t expiration_time = get_session_expiry_time_from(otr);
+  time_t deadline = now + expiration_time;
+  otrng_bool is_due = otrng_false;
+
+  if (last_generated != 0) {
+    is_due = last_generated + expiration_time < now;
+    if (!is_due) {
+      deadline = last_generated + expiration_time + 1;
+    }
+  }
+
+  /* Scheduled first, as expiring the session can free the conversation */
+  otrng_timer_wheel_schedule(otrng_client_get_timers(otr->client),
+                             &conv->session_timer, deadline);
+  if (is_due) {
+    otrng_client_expire_session(conv);
+  }
+}
+
 tstatic otrng_conversation_s *new_conversation_with(const char *recipient,
                                                     otrng_s *conn) {
   otrng_conversation_s *conv = otrng_xmalloc_z(sizeof(otrng_conversation_s));
+  timer_wheel_s *timers = NULL;
 
   conv->recipient = otrng_xstrdup(recipient);
 
   conv->conn = conn;
 
+  otrng_timer_init(&conv->session_timer, session_timer_expired, conv);
+  if (conn && sessions_expire(conn->client)) {
+    timers = otrng_client_get_timers(conn->client);
+  }
+  if (timers) {
+    otrng_timer_wheel_schedule(
+        timers, &conv->session_timer,
+        timers->now + get_session_expiry_time_from(conn));
+  }
+
   return conv;
 }
 
 tstatic void conversation_free(void *data) {
   otrng_conversation_s *conv = data;
 
+  otrng_timer_cancel(&conv->session_timer);
   otrng_free(conv->recipient);
   otrng_conn_free(conv->conn);
 
@@ -87,6 +133,7 @@ API otrng_client_s *otrng_client_new(const otrng_client_id_s client_id) {
   client->max_published_prekey_msg = 100;
   client->minimum_stored_prekey_msg = 20;
   client->should_heartbeat = should_heartbeat;
+  client->conversation_index = otrng_hash_table_new();
 
 #define EXTRA_CLIENT_PROFILE_EXPIRATION_SECONDS 2 * 24 * 60 * 60; /* 2 days */
   client->profiles_extra_valid_time = EXTRA_CLIENT_PROFILE_EXPIRATION_SECONDS;
@@ -99,12 +146,11 @@ API otrng_client_s *otrng_client_new(const otrng_client_id_s client_id) {
 
 #define FRAGMENTS_EXPIRATION_SECONDS 1 * 7 * 24 * 60 * 60; /* 1 weeks */
   client->fragments_exp_time = FRAGMENTS_EXPIRATION_SECONDS;
+  client->max_fragmented_msg_len = OTRNG_FRAGMENT_MAX_MESSAGE_BYTES;
 
-  return client;
-}
+  client->timers = otrng_timer_wheel_new(time(NULL));
 
-tstatic void prekey_message_free_from_list(void *prekeys) {
-  otrng_prekey_message_free(prekeys);
+  return client;
 }
 
 API void otrng_client_free(otrng_client_s *client) {
@@ -117,11 +163,12 @@ API void otrng_client_free(otrng_client_s *client) {
     otrng_ec_point_destroy(*client->forging_key);
   }
   otrng_free(client->forging_key);
-  otrng_list_free(client->our_prekeys, prekey_message_free_from_list);
+  otrng_prekey_store_destroy(&client->our_prekeys);
   otrng_client_profile_free(client->client_profile);
   otrng_client_profile_free(client->exp_client_profile);
   otrng_prekey_profile_free(client->prekey_profile);
   otrng_prekey_profile_free(client->exp_prekey_profile);
+  otrng_hash_table_free(client->conversation_index, NULL);
   otrng_list_free(client->conversations, conversation_free);
   if (client->fingerprints) {
     otrng_known_fingerprints_free(client->fingerprints);
@@ -131,24 +178,33 @@ API void otrng_client_free(otrng_client_s *client) {
 
   otrng_prekey_manager_free(client->prekey_manager);
 
+  /* Freed last, as the conversations and the prekey manager cancel their
+     timers when they are freed */
+  otrng_timer_wheel_free(client->timers);
+
   otrng_free(client);
 }
 
+tstatic void add_conversation(otrng_conversation_s *conv,
+                              otrng_client_s *client) {
+  client->conversations = otrng_list_prepend(conv, client->conversations);
+  if (client->conversations->next) {
+    otrng_conversation_s *older = client->conversations->next->data;
+    older->link = &client->conversations->next;
+  }
+  conv->node = client->conversations;
+  conv->link = &client->conversations;
+
+  otrng_hash_table_put(client->conversation_index, conv->recipient,
+                       strlen(conv->recipient), conv);
+}
+
 // TODO: @instance_tag There may be multiple conversations with the same
 // recipient if they use multiple instance tags. We are not allowing this yet.
 tstatic /*@null@*/ otrng_conversation_s *
-get_conversation_with(const char *recipient, list_element_s *conversations) {
-  const list_element_s *el = NULL;
-  otrng_conversation_s *conv = NULL;
-
-  for (el = conversations; el; el = el->next) {
-    conv = el->data;
-    if (!strcmp(conv->recipient, recipient)) {
-      return conv;
-    }
-  }
-
-  return NULL;
+get_conversation_with(const char *recipient, const otrng_client_s *client) {
+  return otrng_hash_table_get(client->conversation_index, recipient,
+                              strlen(recipient));
 }
 
 tstatic otrng_policy_s get_policy_for(otrng_client_s *client) {
@@ -225,7 +281,7 @@ get_or_create_conversation_with(const char *recipient, otrng_client_s *client) {
   otrng_conversation_s *conv = NULL;
   otrng_s *conn = NULL;
 
-  conv = get_conversation_with(recipient, client->conversations);
+  conv = get_conversation_with(recipient, client);
   if (conv) {
     return conv;
   }
@@ -241,7 +297,7 @@ get_or_create_conversation_with(const char *recipient, otrng_client_s *client) {
     return NULL;
   }
 
-  client->conversations = otrng_list_add(conv, client->conversations);
+  add_conversation(conv, client);
 
   return conv;
 }
@@ -253,7 +309,7 @@ otrng_client_get_conversation(int force_create, const char *recipient,
     return get_or_create_conversation_with(recipient, client);
   }
 
-  return get_conversation_with(recipient, client->conversations);
+  return get_conversation_with(recipient, client);
 }
 
 // TODO: @client this should allow TLVs to be added to the message
@@ -486,8 +542,8 @@ API otrng_result otrng_client_receive(char **new_msg, char **to_display,
 
   *to_display = NULL;
   if (response->to_display) {
-    char *plain = otrng_xstrdup(response->to_display);
-    *to_display = plain;
+    *to_display = response->to_display;
+    response->to_display = NULL;
     otrng_response_free(response);
     return OTRNG_SUCCESS;
   }
@@ -497,12 +553,22 @@ API otrng_result otrng_client_receive(char **new_msg, char **to_display,
   return result;
 }
 
-tstatic void destroy_client_conversation(const otrng_conversation_s *conv,
+tstatic void destroy_client_conversation(otrng_conversation_s *conv,
                                          otrng_client_s *client) {
-  list_element_s *elem = otrng_list_get_by_value(conv, client->conversations);
-  client->conversations =
-      otrng_list_remove_element(elem, client->conversations);
+  list_element_s *elem = conv->node;
+
+  otrng_hash_table_remove(client->conversation_index, conv->recipient,
+                          strlen(conv->recipient));
+
+  *conv->link = elem->next;
+  if (elem->next) {
+    otrng_conversation_s *older = elem->next->data;
+    older->link = conv->link;
+  }
+  elem->next = NULL;
   otrng_list_free_nodes(elem);
+  conv->node = NULL;
+  conv->link = NULL;
 }
 
 INTERNAL otrng_result otrng_client_disconnect_conversation(
@@ -519,18 +585,13 @@ INTERNAL otrng_result otrng_client_disconnect_conversation(
 
 API otrng_result otrng_client_disconnect(char **new_msg, const char *recipient,
                                          otrng_client_s *client) {
-  otrng_conversation_s *conv =
-      get_conversation_with(recipient, client->conversations);
+  otrng_conversation_s *conv = get_conversation_with(recipient, client);
   if (!conv) {
     return OTRNG_ERROR;
   }
   return otrng_client_disconnect_conversation(new_msg, conv);
 }
 
-tstatic uint32_t get_session_expiry_time_from(otrng_s *otr) {
-  return otr->client->global_state->callbacks->session_expiration_time_for(otr);
-}
-
 INTERNAL void otrng_client_expire_session(otrng_conversation_s *conv) {
   string_p msg = NULL;
   otrng_result res;
@@ -563,19 +624,25 @@ INTERNAL void otrng_client_expire_session(otrng_conversation_s *conv) {
 
 INTERNAL void otrng_client_expire_sessions(otrng_client_s *client) {
   const list_element_s *el = NULL;
+  const list_element_s *next = NULL;
   otrng_conversation_s *conv = NULL;
   time_t now;
   uint32_t expiration_time;
 
-  now = time(NULL);
+  if (!sessions_expire(client)) {
+    return;
+  }
 
-  for (el = client->conversations; el; el = el->next) {
+  now = time(NULL);
 
+  /* Expiring a session can remove its conversation from the list */
+  for (el = client->conversations; el; el = next) {
+    next = el->next;
+    conv = el->data;
     if (!conv) {
-      return;
+      continue;
     }
 
-    conv = el->data;
     expiration_time = get_session_expiry_time_from(conv->conn);
 
     if (conv->conn->keys->last_generated < now - expiration_time) {
@@ -584,6 +651,17 @@ INTERNAL void otrng_client_expire_sessions(otrng_client_s *client) {
   }
 }
 
+API void otrng_client_poll(otrng_client_s *client) {
+  /* Expires the sessions and fragments that are due */
+  otrng_timer_wheel_advance(client->timers, time(NULL));
+  otrng_prekey_check_account_request(client);
+}
+
+API otrng_bool otrng_client_next_deadline(time_t *deadline,
+                                          const otrng_client_s *client) {
+  return otrng_timer_wheel_next_deadline(deadline, client->timers);
+}
+
 INTERNAL otrng_result otrng_client_expire_fragments(otrng_client_s *client) {
   const list_element_s *el = NULL;
   otrng_conversation_s *conv = NULL;
@@ -632,7 +710,7 @@ INTERNAL void otrng_client_store_my_prekey_message(prekey_message_s *msg,
     return;
   }
 
-  client->our_prekeys = otrng_list_add(msg, client->our_prekeys);
+  otrng_prekey_store_add(&client->our_prekeys, msg);
 }
 
 API /*@null@*/ prekey_message_s **
@@ -640,6 +718,8 @@ otrng_client_build_prekey_messages(uint8_t num_messages,
                                    otrng_client_s *client) {
   uint32_t instance_tag;
   prekey_message_s **messages;
+  ecdh_keypair_s *ecdh;
+  dh_keypair_s *dh;
   int i, j;
 
   if (num_messages > MAX_NUMBER_PUBLISHED_PREKEY_MSGS) {
@@ -651,28 +731,42 @@ otrng_client_build_prekey_messages(uint8_t num_messages,
 
   instance_tag = otrng_client_get_instance_tag(client);
 
+  /* The keypairs are the expensive part, so they are generated together,
+     possibly by several threads. */
+  ecdh = otrng_secure_alloc_array(num_messages, sizeof(ecdh_keypair_s));
+  dh = otrng_secure_alloc_array(num_messages, sizeof(dh_keypair_s));
+  if (!otrng_keypair_pool_take_batch(ecdh, dh, num_messages,
+                                     otrng_client_get_keypair_pool(client))) {
+    otrng_secure_free(ecdh);
+    otrng_secure_free(dh);
+    return NULL;
+  }
+
   messages = otrng_xmalloc_z(num_messages * sizeof(prekey_message_s *));
 
   for (i = 0; i < num_messages; i++) {
-    ecdh_keypair_s ecdh;
-    dh_keypair_s dh;
-    if (!otrng_generate_ephemeral_keys(&ecdh, &dh)) {
-      otrng_free(messages);
-      return NULL;
-    }
-
-    messages[i] = otrng_prekey_message_build(instance_tag, &ecdh, &dh);
-    otrng_dh_keypair_destroy(&dh);
-
+    messages[i] = otrng_prekey_message_build(instance_tag, &ecdh[i], &dh[i]);
     if (!messages[i]) {
       for (j = 0; j < i; j++) {
         otrng_prekey_message_free(messages[j]);
       }
       otrng_free(messages);
-      return NULL;
+      messages = NULL;
+      break;
     }
+  }
 
-    otrng_client_store_my_prekey_message(messages[i], client);
+  for (i = 0; i < num_messages; i++) {
+    otrng_ecdh_keypair_destroy(&ecdh[i]);
+    otrng_dh_keypair_destroy(&dh[i]);
+  }
+  otrng_secure_free(ecdh);
+  otrng_secure_free(dh);
+
+  if (messages) {
+    for (i = 0; i < num_messages; i++) {
+      otrng_prekey_store_add(&client->our_prekeys, messages[i]);
+    }
   }
 
   return messages;
@@ -890,7 +984,7 @@ API otrng_result otrng_client_add_exp_client_profile(
 
   client->exp_client_profile = otrng_xmalloc_z(sizeof(otrng_client_profile_s));
 
-  if (otrng_client_profile_copy(client->exp_client_profile, exp_profile)) {
+  if (!otrng_client_profile_copy(client->exp_client_profile, exp_profile)) {
     return OTRNG_ERROR;
   }
 
@@ -996,6 +1090,8 @@ INTERNAL unsigned int otrng_client_get_instance_tag(otrng_client_s *client) {
 
   //  fprintf(stderr,"first: %s\n",
   //  client->global_state->user_state_v3->instag_root->accountname);
+  /* Held while the callback creates the instance tag, so it is created once */
+  otrng_global_state_lock_v3(client->global_state);
   instag =
       otrl_instag_find(client->global_state->user_state_v3,
                        client->client_id.account, client->client_id.protocol);
@@ -1008,6 +1104,7 @@ INTERNAL unsigned int otrng_client_get_instance_tag(otrng_client_s *client) {
   instag =
       otrl_instag_find(client->global_state->user_state_v3,
                        client->client_id.account, client->client_id.protocol);
+  otrng_global_state_unlock_v3(client->global_state);
 
   if (!instag) {
     return (unsigned int)0;
@@ -1016,6 +1113,19 @@ INTERNAL unsigned int otrng_client_get_instance_tag(otrng_client_s *client) {
   return instag->instag;
 }
 
+INTERNAL /*@null@*/ keypair_pool_s *
+otrng_client_get_keypair_pool(const otrng_client_s *client) {
+  if (!client->global_state) {
+    return NULL;
+  }
+
+  return client->global_state->keypair_pool;
+}
+
+INTERNAL timer_wheel_s *otrng_client_get_timers(const otrng_client_s *client) {
+  return client->timers;
+}
+
 INTERNAL otrng_result otrng_client_add_instance_tag(otrng_client_s *client,
                                                     unsigned int instag) {
   OtrlInsTag *p;
@@ -1028,9 +1138,11 @@ INTERNAL otrng_result otrng_client_add_instance_tag(otrng_client_s *client,
     return OTRNG_ERROR;
   }
 
+  otrng_global_state_lock_v3(client->global_state);
   p = otrl_instag_find(client->global_state->user_state_v3,
                        client->client_id.account, client->client_id.protocol);
   if (p) {
+    otrng_global_state_unlock_v3(client->global_state);
     return OTRNG_ERROR;
   }
 
@@ -1038,51 +1150,28 @@ INTERNAL otrng_result otrng_client_add_instance_tag(otrng_client_s *client,
                              client->client_id.account, instag);
 
   if (!p) {
+    otrng_global_state_unlock_v3(client->global_state);
     return OTRNG_ERROR;
   }
 
   otrl_userstate_instance_tag_add(client->global_state->user_state_v3, p);
-  return OTRNG_SUCCESS;
-}
-
-tstatic /*@null@*/ list_element_s *
-get_stored_prekey_node_by_id(uint32_t id, list_element_s *l) {
-  while (l) {
-    const prekey_message_s *s = l->data;
-    if (!s) {
-      continue;
-    }
-
-    if (s->id == id) {
-      return l;
-    }
+  otrng_global_state_unlock_v3(client->global_state);
 
-    l = l->next;
-  }
-
-  return NULL;
+  return OTRNG_SUCCESS;
 }
 
 INTERNAL /*@null@*/ const prekey_message_s *
 otrng_client_get_prekey_by_id(uint32_t id, const otrng_client_s *client) {
-  list_element_s *node = get_stored_prekey_node_by_id(id, client->our_prekeys);
-  if (!node) {
-    return NULL;
-  }
-
-  return node->data;
+  return otrng_prekey_store_get(&client->our_prekeys, id);
 }
 
 INTERNAL void
 otrng_client_delete_my_prekey_message_by_id(uint32_t id,
                                             otrng_client_s *client) {
-  list_element_s *node = get_stored_prekey_node_by_id(id, client->our_prekeys);
-  if (!node) {
+  if (!otrng_prekey_store_delete(&client->our_prekeys, id)) {
     return;
   }
 
-  client->our_prekeys = otrng_list_remove_element(node, client->our_prekeys);
-  otrng_list_free(node, prekey_message_free_from_list);
   client->global_state->callbacks->store_prekey_messages(client);
 }
 
@@ -1105,6 +1194,14 @@ API void otrng_client_set_max_stored_msg_keys(unsigned int max_stored_msg_keys,
   client->max_stored_msg_keys = max_stored_msg_keys;
 }
 
+API void
+otrng_client_set_max_fragmented_msg_len(size_t max_fragmented_msg_len,
+                                        otrng_client_s *client) {
+  assert(client != NULL);
+
+  client->max_fragmented_msg_len = max_fragmented_msg_len;
+}
+
 API void
 otrng_client_set_max_published_prekey_msg(unsigned int max_published_prekey_msg,
                                           otrng_client_s *client) {
@@ -1159,23 +1256,14 @@ API otrng_bool otrng_client_should_publish(otrng_client_s *client) {
 }
 
 API void otrng_client_failed_published(otrng_client_s *client) {
-  list_element_s *current;
-
   client->client_profile->is_publishing = otrng_false;
   client->prekey_profile->is_publishing = otrng_false;
-  for (current = client->our_prekeys; current != NULL;
-       current = current->next) {
-    prekey_message_s *pm = current->data;
-    pm->is_publishing = otrng_false;
-  }
+  otrng_prekey_store_failed_published(&client->our_prekeys);
 
   client->is_publishing = otrng_false;
 }
 
 API void otrng_client_published(otrng_client_s *client) {
-  list_element_s *current;
-  otrng_bool has_any_pms = otrng_false;
-
   if (client->client_profile->is_publishing) {
     client->client_profile->should_publish = otrng_false;
     client->client_profile->is_publishing = otrng_false;
@@ -1188,16 +1276,7 @@ API void otrng_client_published(otrng_client_s *client) {
     client->global_state->callbacks->store_prekey_profile(client);
   }
 
-  for (current = client->our_prekeys; current != NULL;
-       current = current->next) {
-    prekey_message_s *pm = current->data;
-    if (pm->is_publishing) {
-      has_any_pms = otrng_true;
-      pm->should_publish = otrng_false;
-      pm->is_publishing = otrng_false;
-    }
-  }
-  if (has_any_pms) {
+  if (otrng_prekey_store_published(&client->our_prekeys)) {
     client->global_state->callbacks->store_prekey_messages(client);
   }
 
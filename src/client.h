@@ -28,10 +28,14 @@
 #pragma clang diagnostic pop
 #endif
 
+#include "hash_table.h"
+#include "keypair_pool.h"
 #include "list.h"
 #include "otrng.h"
 #include "prekey_manager.h"
+#include "prekey_store.h"
 #include "shared.h"
+#include "timer_wheel.h"
 
 // TODO: @client REMOVE
 typedef struct otrng_conversation_s {
@@ -42,6 +46,14 @@ typedef struct otrng_conversation_s {
 
   char *recipient;
   otrng_s *conn;
+
+  /* Expires the session once its keys are too old */
+  timer_s session_timer;
+
+  /* The node of the conversation in the client's list, and the pointer that
+     points to it, so the conversation is removed without walking the list */
+  list_element_s *node;
+  list_element_s **link;
 } otrng_conversation_s;
 
 typedef struct otrng_client_id_s {
@@ -52,6 +64,9 @@ typedef struct otrng_client_id_s {
 /* A client handle messages from/to a sender to/from multiple recipients. */
 typedef struct otrng_client_s {
   list_element_s *conversations;
+  /* Indexes the conversations by recipient. The key could be extended with
+     the instance tag once several conversations per recipient are allowed. */
+  hash_table_s *conversation_index;
 
   otrng_client_id_s client_id;
 
@@ -64,7 +79,7 @@ typedef struct otrng_client_s {
   otrng_client_profile_s *exp_client_profile;
   otrng_prekey_profile_s *prekey_profile;
   otrng_prekey_profile_s *exp_prekey_profile;
-  list_element_s *our_prekeys; /* prekey_message_s */
+  prekey_store_s our_prekeys;
 
   unsigned int max_stored_msg_keys;
   unsigned int max_published_prekey_msg;
@@ -76,6 +91,7 @@ typedef struct otrng_client_s {
   uint64_t profiles_buffer_time;
 
   uint32_t fragments_exp_time;
+  size_t max_fragmented_msg_len;
 
   otrng_bool (*should_heartbeat)(long last_sent);
   size_t padding;
@@ -99,6 +115,10 @@ typedef struct otrng_client_s {
   */
   // TODO: @prekey - this should be freed
   /*@null@*/ otrng_prekey_manager_s *prekey_manager;
+
+  /* When the sessions and fragments of the client expire. Each client has its
+     own, so clients used by different threads share nothing here. */
+  timer_wheel_s *timers;
 } otrng_client_s;
 
 API otrng_client_s *otrng_client_new(const otrng_client_id_s client_id);
@@ -162,6 +182,32 @@ API otrng_result otrng_client_disconnect(char **new_msg, const char *recipient,
 
 INTERNAL void otrng_client_expire_session(otrng_conversation_s *conv);
 
+/**
+ * @brief Does the work of otrng_poll for one client: expires the sessions and
+ * fragments that are due, and checks the account of the prekey server. It is
+ * called from the thread using the client.
+ *
+ * @param [client] The client.
+ */
+API void otrng_client_poll(otrng_client_s *client);
+
+/**
+ * @brief Finds when the next session or fragment of the client expires, so
+ * otrng_client_poll can be called right then.
+ *
+ * @param [deadline] Receives the time, as returned by time(). It may already
+ * have passed.
+ * @param [client]   The client.
+ *
+ * @return otrng_false if nothing is waiting to expire.
+ */
+API otrng_bool otrng_client_next_deadline(time_t *deadline,
+                                          const otrng_client_s *client);
+
+/**
+ * @brief Expires every session whose keys are too old. otrng_client_poll does
+ * not need it, as each conversation has a timer for this.
+ */
 INTERNAL void otrng_client_expire_sessions(otrng_client_s *client);
 
 /**
@@ -186,7 +232,12 @@ API /*@null@*/ prekey_message_s **
 otrng_client_build_prekey_messages(uint8_t num_messages,
                                    otrng_client_s *client);
 
-INTERNAL OtrlPrivKey *
+/**
+ * @brief Finds the v3 private key of the client. The key belongs to the v3
+ * user state, so the caller must hold otrng_global_state_lock_v3 for as long
+ * as it uses it.
+ */
+INTERNAL /*@null@*/ OtrlPrivKey *
 otrng_client_get_private_key_v3(const otrng_client_s *client);
 
 INTERNAL otrng_keypair_s *otrng_client_get_keypair_v4(otrng_client_s *client);
@@ -233,6 +284,18 @@ API otrng_result otrng_client_add_exp_prekey_profile(
 
 INTERNAL unsigned int otrng_client_get_instance_tag(otrng_client_s *client);
 
+/**
+ * @brief The pool the client takes its ephemeral keypairs from, or NULL if the
+ * client does not belong to a global state yet.
+ */
+INTERNAL /*@null@*/ keypair_pool_s *
+otrng_client_get_keypair_pool(const otrng_client_s *client);
+
+/**
+ * @brief The wheel the timers of the client are scheduled in.
+ */
+INTERNAL timer_wheel_s *otrng_client_get_timers(const otrng_client_s *client);
+
 INTERNAL otrng_result otrng_client_add_instance_tag(otrng_client_s *client,
                                                     unsigned int instag);
 
@@ -248,6 +311,10 @@ API void otrng_client_set_padding(size_t granularity, otrng_client_s *client);
 API void otrng_client_set_max_stored_msg_keys(unsigned int max_stored_msg_keys,
                                               otrng_client_s *client);
 
+API void
+otrng_client_set_max_fragmented_msg_len(size_t max_fragmented_msg_len,
+                                        otrng_client_s *client);
+
 API void otrng_client_state_set_max_published_prekey_msg(
     unsigned int max_published_prekey_msg, otrng_client_s *client);
 
@@ -289,6 +356,20 @@ API void otrng_conversation_debug_print(FILE *, int, otrng_conversation_s *);
 
 #ifdef OTRNG_CLIENT_PRIVATE
 
+tstatic otrng_conversation_s *new_conversation_with(const char *recipient,
+                                                    otrng_s *conn);
+
+tstatic void conversation_free(void *data);
+
+tstatic void add_conversation(otrng_conversation_s *conv,
+                              otrng_client_s *client);
+
+tstatic /*@null@*/ otrng_conversation_s *
+get_conversation_with(const char *recipient, const otrng_client_s *client);
+
+tstatic void destroy_client_conversation(otrng_conversation_s *conv,
+                                         otrng_client_s *client);
+
 tstatic uint64_t
 otrng_client_get_client_profile_exp_time(otrng_client_s *client);
 
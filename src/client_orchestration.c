@@ -443,7 +443,8 @@ tstatic void create_new_prekey_messages(otrng_client_s *client) {
   prekey_message_s **messages;
   size_t ix;
   uint8_t to_publish =
-      client->max_published_prekey_msg - otrng_list_len(client->our_prekeys);
+      client->max_published_prekey_msg -
+      otrng_prekey_store_len(&client->our_prekeys);
 
   if (client->prekey_msgs_num_to_publish > to_publish) {
     to_publish = client->prekey_msgs_num_to_publish;
@@ -454,8 +455,14 @@ tstatic void create_new_prekey_messages(otrng_client_s *client) {
     client->prekey_msgs_num_to_publish = 0;
 
     messages = otrng_client_build_prekey_messages(to_publish, client);
+    if (!messages) {
+      otrng_debug_exit("create_new_prekey_messages > 0");
+      return;
+    }
+
     for (ix = 0; ix < to_publish; ix++) {
-      messages[ix]->should_publish = otrng_true;
+      otrng_prekey_store_set_should_publish(&client->our_prekeys,
+                                            messages[ix], otrng_true);
     }
     otrng_free(messages);
 
@@ -470,7 +477,7 @@ tstatic void load_prekey_messages_from_storage(otrng_client_s *client) {
 }
 
 tstatic otrng_bool verify_enough_prekey_messages(otrng_client_s *client) {
-  if (otrng_list_len(client->our_prekeys) >=
+  if (otrng_prekey_store_len(&client->our_prekeys) >=
       client->minimum_stored_prekey_msg) {
     return otrng_true;
   }
@@ -501,12 +508,13 @@ tstatic otrng_bool ensure_enough_prekey_messages(otrng_client_s *client) {
 }
 
 tstatic otrng_bool verify_valid_long_term_key_v3(otrng_client_s *client) {
-  if (otrl_privkey_find(client->global_state->user_state_v3,
-                        client->client_id.account,
-                        client->client_id.protocol) != NULL) {
-    return otrng_true;
-  }
-  return otrng_false;
+  otrng_bool found;
+
+  otrng_global_state_lock_v3(client->global_state);
+  found = otrng_client_get_private_key_v3(client) ? otrng_true : otrng_false;
+  otrng_global_state_unlock_v3(client->global_state);
+
+  return found;
 }
 
 tstatic otrng_bool ensure_valid_long_term_key_v3(otrng_client_s *client) {
@@ -556,7 +564,7 @@ tstatic void load_fingerprints_v3_from_storage(otrng_client_s *client) {
 }
 
 tstatic void create_fingerprints(otrng_client_s *client) {
-  client->fingerprints = otrng_xmalloc_z(sizeof(otrng_known_fingerprints_s));
+  client->fingerprints = otrng_known_fingerprints_new();
 }
 
 tstatic void create_fingerprints_v3(otrng_client_s *client) {
@@ -46,20 +46,25 @@ INTERNAL void otrng_data_message_free(data_message_s *data_msg) {
   otrng_ec_point_destroy(data_msg->ecdh);
   otrng_dh_mpi_release(data_msg->dh);
   otrng_secure_wipe(data_msg->nonce, DATA_MSG_NONCE_BYTES);
-  otrng_free(data_msg->enc_msg);
+  if (!data_msg->enc_msg_borrowed) {
+    otrng_free(data_msg->enc_msg);
+  }
   otrng_secure_wipe(data_msg->mac, DATA_MSG_MAC_BYTES);
 
   otrng_free(data_msg);
 }
 
-INTERNAL otrng_result otrng_data_message_body_serialize(
-    uint8_t **body, size_t *body_len, const data_message_s *data_msg) {
-  size_t size = DATA_MSG_MAX_BYTES + data_msg->enc_msg_len;
-  uint8_t *cursor;
+INTERNAL otrng_result
+otrng_data_message_header_serialize(uint8_t *dst, size_t dst_len,
+                                    size_t *written,
+                                    const data_message_s *data_msg) {
+  uint8_t *cursor = dst;
   size_t len = 0;
-  uint8_t *dst = otrng_xmalloc_z(size);
 
-  cursor = dst;
+  if (dst_len < DATA_MSG_MAX_BYTES - 4) {
+    return OTRNG_ERROR;
+  }
+
   cursor += otrng_serialize_uint16(cursor, OTRNG_PROTOCOL_VERSION_4);
   cursor += otrng_serialize_uint8(cursor, DATA_MSG_TYPE);
   cursor += otrng_serialize_uint32(cursor, data_msg->sender_instance_tag);
@@ -71,19 +76,39 @@ INTERNAL otrng_result otrng_data_message_body_serialize(
   cursor += otrng_serialize_ec_point(cursor, data_msg->ecdh);
 
   // TODO: @freeing @sanitizer This could be NULL. We need to test.
-  if (!otrng_serialize_dh_public_key(cursor, (size - (cursor - dst)), &len,
+  if (!otrng_serialize_dh_public_key(cursor, (dst_len - (cursor - dst)), &len,
                                      data_msg->dh)) {
-    otrng_free(dst);
     return OTRNG_ERROR;
   }
   cursor += len;
   cursor += otrng_serialize_bytes_array(cursor, data_msg->nonce,
                                         DATA_MSG_NONCE_BYTES);
+
+  *written = cursor - dst;
+
+  return OTRNG_SUCCESS;
+}
+
+INTERNAL otrng_result otrng_data_message_body_serialize(
+    uint8_t **body, size_t *body_len, const data_message_s *data_msg) {
+  size_t size = DATA_MSG_MAX_BYTES + data_msg->enc_msg_len;
+  uint8_t *cursor;
+  size_t len = 0;
+  uint8_t *dst = otrng_xmalloc_z(size);
+
+  if (!otrng_data_message_header_serialize(dst, size, &len, data_msg)) {
+    otrng_free(dst);
+    return OTRNG_ERROR;
+  }
+
+  cursor = dst + len;
   cursor +=
       otrng_serialize_data(cursor, data_msg->enc_msg, data_msg->enc_msg_len);
 
   if (body) {
     *body = dst;
+  } else {
+    otrng_free(dst);
   }
 
   if (body_len) {
@@ -102,6 +127,7 @@ INTERNAL otrng_result otrng_data_message_deserialize(data_message_s *dst,
   size_t read = 0;
   uint16_t protocol_version = 0;
   uint8_t msg_type = 0;
+  const uint8_t *enc_msg = NULL;
 
   (void)nread;
 
@@ -197,14 +223,21 @@ INTERNAL otrng_result otrng_data_message_deserialize(data_message_s *dst,
   cursor += DATA_MSG_NONCE_BYTES;
   len -= DATA_MSG_NONCE_BYTES;
 
-  if (!otrng_deserialize_data(&dst->enc_msg, &dst->enc_msg_len, cursor, len,
-                              &read)) {
+  if (!otrng_deserialize_data_view(&enc_msg, &dst->enc_msg_len, cursor, len,
+                                   &read)) {
     return OTRNG_ERROR;
   }
 
+  /* The ciphertext is decrypted straight out of the received buffer */
+  dst->enc_msg = (uint8_t *)enc_msg;
+  dst->enc_msg_borrowed = otrng_true;
+
   cursor += read;
   len -= read;
 
+  dst->body = buffer;
+  dst->body_len = cursor - buffer;
+
   return otrng_deserialize_bytes_array((uint8_t *)&dst->mac, DATA_MSG_MAC_BYTES,
                                        cursor, len);
 }
@@ -214,23 +247,14 @@ INTERNAL otrng_result otrng_data_message_authenticator(uint8_t *dst,
                                                        const k_msg_mac mac_key,
                                                        const uint8_t *body,
                                                        size_t body_len) {
-  uint8_t *sections = otrng_secure_alloc(HASH_BYTES);
-
   if (dst_len < DATA_MSG_MAC_BYTES) {
     return OTRNG_ERROR;
   }
 
   /* Authenticator = KDF_1(usage_authenticator || MKmac ||
    * data_message_sections, 64) */
-  if (!otrng_key_manager_calculate_authenticator(dst, mac_key, body,
-                                                 body_len)) {
-    otrng_secure_free(sections);
-    return OTRNG_ERROR;
-  }
-
-  otrng_secure_free(sections);
-
-  return OTRNG_SUCCESS;
+  return otrng_key_manager_calculate_authenticator(dst, mac_key, body,
+                                                   body_len);
 }
 
 INTERNAL otrng_bool otrng_valid_data_message(k_msg_mac mac_key,
@@ -239,19 +263,27 @@ INTERNAL otrng_bool otrng_valid_data_message(k_msg_mac mac_key,
   size_t body_len = 0;
   // We don't need this tag to be in secure memory
   uint8_t mac_tag[DATA_MSG_MAC_BYTES];
-
-  if (!otrng_data_message_body_serialize(&body, &body_len, data_msg)) {
-    return otrng_false;
+  otrng_result result;
+
+  if (data_msg->body) {
+    result = otrng_data_message_authenticator(mac_tag, DATA_MSG_MAC_BYTES,
+                                              mac_key, data_msg->body,
+                                              data_msg->body_len);
+  } else {
+    /* Not received, so there are no wire bytes to authenticate */
+    if (!otrng_data_message_body_serialize(&body, &body_len, data_msg)) {
+      return otrng_false;
+    }
+
+    result = otrng_data_message_authenticator(mac_tag, DATA_MSG_MAC_BYTES,
+                                              mac_key, body, body_len);
+    otrng_free(body);
   }
 
-  if (!otrng_data_message_authenticator(mac_tag, DATA_MSG_MAC_BYTES, mac_key,
-                                        body, body_len)) {
-    otrng_free(body);
+  if (otrng_failed(result)) {
     return otrng_false;
   }
 
-  otrng_free(body);
-
   if (sodium_memcmp(mac_tag, data_msg->mac, DATA_MSG_MAC_BYTES) != 0) {
     otrng_secure_wipe(mac_tag, DATA_MSG_MAC_BYTES);
     return otrng_false;
@@ -43,12 +43,37 @@ typedef struct data_message_s {
   uint8_t *enc_msg;
   size_t enc_msg_len;
   uint8_t mac[DATA_MSG_MAC_BYTES];
+
+  /* Set for received messages: enc_msg then points into the buffer the
+     message was deserialized from, like body, and is not freed with it. */
+  otrng_bool enc_msg_borrowed;
+
+  /* The authenticated sections of a received message, as they were on the
+     wire. This points into the buffer the message was deserialized from, and
+     is only valid as long as that buffer is. NULL for messages we build. */
+  const uint8_t *body;
+  size_t body_len;
 } data_message_s;
 
 INTERNAL data_message_s *otrng_data_message_new(void);
 
 INTERNAL void otrng_data_message_free(data_message_s *data_msg);
 
+/**
+ * @brief Serializes the sections of a data message that come before the
+ * encrypted message: everything from the protocol version to the nonce.
+ *
+ * @param [dst] The buffer to write to.
+ * @param [dst_len] The size of [dst]. It must have room for at least
+ * DATA_MSG_MAX_BYTES - 4 bytes.
+ * @param [written] The number of bytes written.
+ * @param [data_msg] The data message.
+ */
+INTERNAL otrng_result
+otrng_data_message_header_serialize(uint8_t *dst, size_t dst_len,
+                                    size_t *written,
+                                    const data_message_s *data_msg);
+
 INTERNAL otrng_result otrng_data_message_body_serialize(
     uint8_t **body, size_t *bodylen, const data_message_s *data_msg);
 
@@ -63,6 +88,15 @@ INTERNAL otrng_result otrng_data_message_authenticator(uint8_t *dst,
                                                        const uint8_t *body,
                                                        size_t bodylen);
 
+/**
+ * @brief Verifies the MAC and the public keys of a data message.
+ *
+ * A received message is authenticated over the bytes it was received as,
+ * without encoding it again.
+ *
+ * @param [mac_key]   The message MAC key.
+ * @param [data_msg]  The data message.
+ */
 INTERNAL otrng_bool otrng_valid_data_message(k_msg_mac mac_key,
                                              const data_message_s *data_msg);
 
@@ -21,6 +21,7 @@
 #define OTRNG_DEBUG_PRIVATE
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -69,17 +70,24 @@ API void otrng_debug_enable(void) {
 
 API void otrng_debug_disable(void) { debug_printing_enabled = 0; }
 
+/* The indentation is shared by every thread, so the lock also keeps the lines
+   printed by different threads from mixing */
 static int debug_indent = 0;
+static pthread_mutex_t debug_lock = PTHREAD_MUTEX_INITIALIZER;
 
 API void otrng_debug_enter(const char *name) {
   otrng_debug_fprintf(stderr, "-> %s()\n", name);
+  pthread_mutex_lock(&debug_lock);
   debug_indent++;
+  pthread_mutex_unlock(&debug_lock);
 }
 
 API void otrng_debug_exit(const char *name) {
+  pthread_mutex_lock(&debug_lock);
   debug_indent--;
 
   assert(debug_indent >= 0);
+  pthread_mutex_unlock(&debug_lock);
 
   otrng_debug_fprintf(stderr, "<- %s()\n", name);
 }
@@ -88,6 +96,7 @@ API void otrng_debug_fprintf(FILE *f, const char *fmt, ...) {
   int ix;
   va_list args;
   if (debug_printing_enabled) {
+    pthread_mutex_lock(&debug_lock);
     for (ix = 0; ix < debug_indent; ix++) {
       fprintf(f, "  ");
     }
@@ -98,5 +107,6 @@ API void otrng_debug_fprintf(FILE *f, const char *fmt, ...) {
     (void)vfprintf(f, fmt, args);
 #pragma clang diagnostic pop
     va_end(args);
+    pthread_mutex_unlock(&debug_lock);
   }
 }
@@ -143,6 +143,47 @@ INTERNAL otrng_result otrng_deserialize_data(uint8_t **dst, size_t *dst_len,
   return OTRNG_SUCCESS;
 }
 
+INTERNAL otrng_result otrng_deserialize_data_view(const uint8_t **dst,
+                                                  size_t *dst_len,
+                                                  const uint8_t *buffer,
+                                                  size_t buff_len,
+                                                  size_t *read) {
+  size_t r = 0;
+  uint32_t s = 0;
+
+  *dst = NULL;
+  *dst_len = 0;
+
+  /* 4 bytes len */
+  if (!otrng_deserialize_uint32(&s, buffer, buff_len, &r)) {
+    if (read != NULL) {
+      *read = r;
+    }
+
+    return OTRNG_ERROR;
+  }
+
+  if (read) {
+    *read = r;
+  }
+
+  if (!s) {
+    return OTRNG_SUCCESS;
+  }
+
+  if (buff_len - r < s) {
+    return OTRNG_ERROR;
+  }
+
+  *dst = buffer + r;
+  *dst_len = s;
+  if (read) {
+    *read += s;
+  }
+
+  return OTRNG_SUCCESS;
+}
+
 INTERNAL otrng_result otrng_deserialize_bytes_array(uint8_t *dst,
                                                     size_t dst_len,
                                                     const uint8_t *buffer,
@@ -45,6 +45,16 @@ INTERNAL otrng_result otrng_deserialize_data(uint8_t **dst, size_t *dst_len,
                                              const uint8_t *buffer,
                                              size_t buff_len, size_t *read);
 
+/**
+ * @brief Like otrng_deserialize_data, but [dst] points into [buffer] instead
+ * of to a copy. It is NULL if the data is empty.
+ */
+INTERNAL otrng_result otrng_deserialize_data_view(const uint8_t **dst,
+                                                  size_t *dst_len,
+                                                  const uint8_t *buffer,
+                                                  size_t buff_len,
+                                                  size_t *read);
+
 INTERNAL otrng_result otrng_deserialize_bytes_array(uint8_t *dst,
                                                     size_t dst_len,
                                                     const uint8_t *buffer,
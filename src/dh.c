@@ -19,6 +19,7 @@
  */
 
 #include <assert.h>
+#include <string.h>
 
 #define OTRNG_DH_PRIVATE
 
@@ -73,6 +74,93 @@ static /*@null@*/ gcry_mpi_t DH3072_GENERATOR = NULL;
 
 static int dh_initialized = 0;
 
+/* Window of otrng_dh_multi_powm: every base needs a table of its first
+   2^(w-1) odd powers */
+#define DH_MULTI_POWM_WINDOW 4
+#define DH_MULTI_POWM_TABLE_LEN (1 << (DH_MULTI_POWM_WINDOW - 1))
+
+/* Splits [exp] into odd windows of at most DH_MULTI_POWM_WINDOW bits, so that
+   exp = sum(digits[i] * 2^i). [digits] must be zeroed. */
+static void dh_exponent_windows(uint8_t *digits, const dh_mpi exp,
+                                unsigned int nbits) {
+  unsigned int i = 0, j;
+
+  while (i < nbits) {
+    if (!gcry_mpi_test_bit(exp, i)) {
+      i++;
+      continue;
+    }
+
+    for (j = 0; j < DH_MULTI_POWM_WINDOW && i + j < nbits; j++) {
+      digits[i] |= (uint8_t)(gcry_mpi_test_bit(exp, i + j) << j);
+    }
+    i += DH_MULTI_POWM_WINDOW;
+  }
+}
+
+INTERNAL void otrng_dh_multi_powm(dh_mpi dst, const dh_mpi *bases,
+                                  const dh_mpi *exps, size_t len) {
+  gcry_mpi_t *table;
+  uint8_t *digits;
+  gcry_mpi_t square;
+  unsigned int nbits = 0, bits;
+  size_t i, j;
+  int started = 0;
+
+  gcry_mpi_set_ui(dst, 1);
+
+  for (i = 0; i < len; i++) {
+    bits = gcry_mpi_get_nbits(exps[i]);
+    if (bits > nbits) {
+      nbits = bits;
+    }
+  }
+
+  if (nbits == 0) {
+    return;
+  }
+
+  table = otrng_xmalloc_z(len * DH_MULTI_POWM_TABLE_LEN * sizeof(gcry_mpi_t));
+  digits = otrng_xmalloc_z(len * nbits);
+  square = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+
+  for (i = 0; i < len; i++) {
+    gcry_mpi_t *powers = &table[i * DH_MULTI_POWM_TABLE_LEN];
+
+    dh_exponent_windows(&digits[i * nbits], exps[i], nbits);
+
+    powers[0] = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+    gcry_mpi_mod(powers[0], bases[i], DH3072_MODULUS);
+    gcry_mpi_mulm(square, powers[0], powers[0], DH3072_MODULUS);
+    for (j = 1; j < DH_MULTI_POWM_TABLE_LEN; j++) {
+      powers[j] = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+      gcry_mpi_mulm(powers[j], powers[j - 1], square, DH3072_MODULUS);
+    }
+  }
+
+  for (bits = nbits; bits > 0; bits--) {
+    if (started) {
+      gcry_mpi_mulm(dst, dst, dst, DH3072_MODULUS);
+    }
+
+    for (i = 0; i < len; i++) {
+      uint8_t digit = digits[i * nbits + bits - 1];
+      if (digit) {
+        gcry_mpi_mulm(dst, dst, table[i * DH_MULTI_POWM_TABLE_LEN + digit / 2],
+                      DH3072_MODULUS);
+        started = 1;
+      }
+    }
+  }
+
+  for (i = 0; i < len * DH_MULTI_POWM_TABLE_LEN; i++) {
+    gcry_mpi_release(table[i]);
+  }
+  otrng_free(table);
+  otrng_free(digits);
+  gcry_mpi_release(square);
+}
+
 INTERNAL otrng_result otrng_dh_init(otrng_bool die) {
   gcry_error_t err;
 
@@ -80,8 +168,6 @@ INTERNAL otrng_result otrng_dh_init(otrng_bool die) {
     return OTRNG_SUCCESS;
   }
 
-  dh_initialized = 1;
-
   err = gcry_mpi_scan(&DH3072_MODULUS, GCRYMPI_FMT_HEX,
                       (const unsigned char *)DH3072_MODULUS_S, 0, NULL);
   if (err) {
@@ -129,6 +215,10 @@ INTERNAL otrng_result otrng_dh_init(otrng_bool die) {
 
   gcry_mpi_sub_ui(DH3072_MODULUS_MINUS_2, DH3072_MODULUS, 2);
 
+  /* Only set once everything is ready, as the values are read without a lock
+     by the threads started afterwards */
+  dh_initialized = 1;
+
   return OTRNG_SUCCESS;
 }
 
@@ -65,6 +65,19 @@ INTERNAL void otrng_dh_priv_key_destroy(dh_keypair_s *keypair);
 
 INTERNAL void otrng_dh_keypair_destroy(dh_keypair_s *keypair);
 
+/**
+ * @brief Simultaneous multi-exponentiation:
+ *    dst = bases[0]^exps[0] * ... * bases[len - 1]^exps[len - 1] mod p
+ *
+ * All the bases share one chain of squarings, which makes it much faster than
+ * an exponentiation per base.
+ *
+ * @warning It does not run in constant time, so it must only be used with
+ * public exponents, as when verifying a proof.
+ */
+INTERNAL void otrng_dh_multi_powm(dh_mpi dst, const dh_mpi *bases,
+                                  const dh_mpi *exps, size_t len);
+
 INTERNAL otrng_result otrng_dh_shared_secret(dh_shared_secret buffer,
                                              size_t *written,
                                              const dh_private_key our_priv,
@@ -130,6 +130,118 @@ INTERNAL void otrng_ec_calculate_public_key(ec_point pub,
                                        priv);
 }
 
+/* Width of the non-adjacent form used by otrng_ec_multi_scalarmul: every
+   non-zero digit is odd and in (-2^(w-1), 2^(w-1)), so every point needs a
+   table of its first 2^(w-2) odd multiples. */
+#define EC_MSM_WNAF_WIDTH 4
+#define EC_MSM_TABLE_LEN (1 << (EC_MSM_WNAF_WIDTH - 2))
+#define EC_MSM_MAX_DIGITS (ED448_SCALAR_BYTES * 8)
+
+static unsigned int scalar_bits(const uint8_t s[ED448_SCALAR_BYTES],
+                                size_t bit, size_t count) {
+  size_t byte = bit / 8;
+  unsigned int bits = s[byte] >> (bit % 8);
+
+  if (byte + 1 < ED448_SCALAR_BYTES) {
+    bits |= (unsigned int)s[byte + 1] << (8 - bit % 8);
+  }
+
+  return bits & ((1u << count) - 1);
+}
+
+/* Writes the width-w NAF of [scalar] to [naf], least significant digit first,
+   and returns the number of digits up to the last non-zero one. The scalar is
+   smaller than 2^446, so the final carry always fits. */
+static size_t scalar_wnaf(int8_t naf[EC_MSM_MAX_DIGITS],
+                          const ec_scalar scalar) {
+  uint8_t s[ED448_SCALAR_BYTES];
+  unsigned int carry = 0;
+  size_t bit = 0, len = 0;
+
+  goldilocks_448_scalar_encode(s, scalar);
+  memset(naf, 0, EC_MSM_MAX_DIGITS);
+
+  while (bit < EC_MSM_MAX_DIGITS) {
+    size_t width = EC_MSM_WNAF_WIDTH;
+    int digit;
+
+    if (scalar_bits(s, bit, 1) == carry) {
+      bit++;
+      continue;
+    }
+
+    if (width > EC_MSM_MAX_DIGITS - bit) {
+      width = EC_MSM_MAX_DIGITS - bit;
+    }
+
+    digit = (int)(scalar_bits(s, bit, width) + carry);
+    carry = (digit >> (EC_MSM_WNAF_WIDTH - 1)) & 1;
+    digit -= (int)(carry << EC_MSM_WNAF_WIDTH);
+
+    naf[bit] = (int8_t)digit;
+    bit += width;
+    len = bit - width + 1;
+  }
+
+  return len;
+}
+
+INTERNAL void otrng_ec_multi_scalarmul(ec_point dst, const ec_point *points,
+                                       const ec_scalar *scalars, size_t len) {
+  goldilocks_448_point_s *table;
+  int8_t *naf;
+  size_t digits = 0;
+  size_t i, j;
+  otrng_bool started = otrng_false;
+
+  goldilocks_448_point_copy(dst, goldilocks_448_point_identity);
+  if (len == 0) {
+    return;
+  }
+
+  table = otrng_xmalloc_z(len * EC_MSM_TABLE_LEN * sizeof(*table));
+  naf = otrng_xmalloc_z(len * EC_MSM_MAX_DIGITS);
+
+  for (i = 0; i < len; i++) {
+    goldilocks_448_point_s *multiples = &table[i * EC_MSM_TABLE_LEN];
+    goldilocks_448_point_p twice;
+    size_t n = scalar_wnaf(&naf[i * EC_MSM_MAX_DIGITS], scalars[i]);
+
+    if (n > digits) {
+      digits = n;
+    }
+
+    goldilocks_448_point_copy(&multiples[0], points[i]);
+    goldilocks_448_point_double(twice, points[i]);
+    for (j = 1; j < EC_MSM_TABLE_LEN; j++) {
+      goldilocks_448_point_add(&multiples[j], &multiples[j - 1], twice);
+    }
+  }
+
+  for (j = digits; j > 0; j--) {
+    if (started) {
+      goldilocks_448_point_double(dst, dst);
+    }
+
+    for (i = 0; i < len; i++) {
+      int digit = naf[i * EC_MSM_MAX_DIGITS + j - 1];
+
+      if (digit > 0) {
+        goldilocks_448_point_add(dst, dst,
+                                 &table[i * EC_MSM_TABLE_LEN + digit / 2]);
+        started = otrng_true;
+      } else if (digit < 0) {
+        goldilocks_448_point_sub(dst, dst,
+                                 &table[i * EC_MSM_TABLE_LEN + -digit / 2]);
+        started = otrng_true;
+      }
+    }
+  }
+
+  otrng_free(naf);
+  otrng_free(table);
+}
+
 INTERNAL otrng_result otrng_ecdh_keypair_generate(
     ecdh_keypair_s *keypair, const uint8_t sym[ED448_PRIVATE_BYTES]) {
   /*
@@ -191,6 +191,24 @@ otrng_ec_derive_public_key(uint8_t pub[ED448_POINT_BYTES],
 
 INTERNAL void otrng_ec_calculate_public_key(ec_point pub, const ec_scalar priv);
 
+/**
+ * @brief Multi-scalar multiplication:
+ *    dst = scalars[0] * points[0] + ... + scalars[len - 1] * points[len - 1]
+ *
+ * All the points share one chain of doublings, which makes it much faster than
+ * a scalar multiplication per point.
+ *
+ * @param [dst]     The result.
+ * @param [points]  The points.
+ * @param [scalars] The scalars, one for every point.
+ * @param [len]     The number of points.
+ *
+ * @warning It does not run in constant time, so it must only be used with
+ * public scalars, as when verifying a proof.
+ */
+INTERNAL void otrng_ec_multi_scalarmul(ec_point dst, const ec_point *points,
+                                       const ec_scalar *scalars, size_t len);
+
 /**
  * @brief Keypair generation.
  *
@@ -118,10 +118,51 @@ tstatic void otrng_known_fingerprint_free(otrng_known_fingerprint_s *kf) {
 
 static void free_fp_proxy(void *kf) { otrng_known_fingerprint_free(kf); }
 
+INTERNAL otrng_known_fingerprints_s *otrng_known_fingerprints_new(void) {
+  otrng_known_fingerprints_s *kfs =
+      otrng_xmalloc_z(sizeof(otrng_known_fingerprints_s));
+
+  kfs->by_fp = otrng_hash_table_new();
+  kfs->by_username = otrng_hash_table_new();
+
+  return kfs;
+}
+
+/* Only the first fingerprint with the same bytes, or the same username, is
+   found by them */
+static void index_fingerprint(otrng_known_fingerprints_s *kfs,
+                              otrng_known_fingerprint_s *kf) {
+  size_t username_len = strlen(kf->username);
+
+  if (!otrng_hash_table_get(kfs->by_fp, kf->fp, FPRINT_LEN_BYTES)) {
+    otrng_hash_table_put(kfs->by_fp, kf->fp, FPRINT_LEN_BYTES, kf);
+  }
+
+  if (!otrng_hash_table_get(kfs->by_username, kf->username, username_len)) {
+    otrng_hash_table_put(kfs->by_username, kf->username, username_len, kf);
+  }
+}
+
+INTERNAL void otrng_known_fingerprints_add(otrng_known_fingerprints_s *kfs,
+                                           otrng_known_fingerprint_s *kf) {
+  list_element_s *n = otrng_list_add(kf, NULL);
+
+  if (kfs->last) {
+    kfs->last->next = n;
+  } else {
+    kfs->fps = n;
+  }
+  kfs->last = n;
+
+  index_fingerprint(kfs, kf);
+}
+
 API void otrng_known_fingerprints_free(otrng_known_fingerprints_s *kf) {
   if (kf == NULL) {
     return;
   }
+  otrng_hash_table_free(kf->by_fp, NULL);
+  otrng_hash_table_free(kf->by_username, NULL);
   otrng_list_free(kf->fps, free_fp_proxy);
   otrng_free(kf);
 }
@@ -129,41 +170,27 @@ API void otrng_known_fingerprints_free(otrng_known_fingerprints_s *kf) {
 API /*@null@*/ otrng_known_fingerprint_s *
 otrng_fingerprint_get_by_fp(const otrng_client_s *client,
                             const otrng_fingerprint fp) {
-  list_element_s *c;
   assert(client != NULL);
 
   if (client->fingerprints == NULL) {
     return NULL;
   }
 
-  for (c = client->fingerprints->fps; c; c = c->next) {
-    otrng_known_fingerprint_s *kf = c->data;
-    if (memcmp(fp, kf->fp, FPRINT_LEN_BYTES) == 0) {
-      return kf;
-    }
-  }
-
-  return NULL;
+  return otrng_hash_table_get(client->fingerprints->by_fp, fp,
+                              FPRINT_LEN_BYTES);
 }
 
 API /*@null@*/ otrng_known_fingerprint_s *
 otrng_fingerprint_get_by_username(const otrng_client_s *client,
                                   const char *username) {
-  list_element_s *c;
   assert(client != NULL);
 
   if (client->fingerprints == NULL) {
     return NULL;
   }
 
-  for (c = client->fingerprints->fps; c; c = c->next) {
-    otrng_known_fingerprint_s *kf = c->data;
-    if (strcmp(username, kf->username) == 0) {
-      return kf;
-    }
-  }
-
-  return NULL;
+  return otrng_hash_table_get(client->fingerprints->by_username, username,
+                              strlen(username));
 }
 
 API otrng_known_fingerprint_s *otrng_fingerprint_add(otrng_client_s *client,
@@ -174,7 +201,7 @@ API otrng_known_fingerprint_s *otrng_fingerprint_add(otrng_client_s *client,
   assert(client != NULL);
 
   if (client->fingerprints == NULL) {
-    client->fingerprints = otrng_xmalloc_z(sizeof(otrng_known_fingerprints_s));
+    client->fingerprints = otrng_known_fingerprints_new();
   }
 
   nfp = otrng_xmalloc_z(sizeof(otrng_known_fingerprint_s));
@@ -182,7 +209,7 @@ API otrng_known_fingerprint_s *otrng_fingerprint_add(otrng_client_s *client,
   nfp->trusted = trusted;
   memcpy(nfp->fp, fp, FPRINT_LEN_BYTES);
 
-  client->fingerprints->fps = otrng_list_add(nfp, client->fingerprints->fps);
+  otrng_known_fingerprints_add(client->fingerprints, nfp);
 
   return nfp;
 }
@@ -206,31 +233,57 @@ API void otrng_fingerprints_do_all(const struct otrng_client_s *client,
 
 API void otrng_fingerprint_forget(const otrng_client_s *client,
                                   otrng_known_fingerprint_s *fp) {
+  otrng_known_fingerprints_s *kfs;
   list_element_s *prev = NULL, *c, *work;
+  otrng_fingerprint forgotten_fp;
+  char *forgotten_username;
+  size_t username_len;
   assert(client != NULL);
 
-  if (client->fingerprints == NULL) {
+  kfs = client->fingerprints;
+  if (kfs == NULL) {
     return;
   }
 
-  for (c = client->fingerprints->fps; c;) {
+  if (!otrng_hash_table_get(kfs->by_fp, fp->fp, FPRINT_LEN_BYTES)) {
+    return;
+  }
+
+  /* [fp] may be one of the fingerprints freed below */
+  memcpy(forgotten_fp, fp->fp, FPRINT_LEN_BYTES);
+  forgotten_username = otrng_xstrdup(fp->username);
+  username_len = strlen(forgotten_username);
+
+  /* Indexed again below, if some other fingerprint has them */
+  otrng_hash_table_remove(kfs->by_fp, forgotten_fp, FPRINT_LEN_BYTES);
+  otrng_hash_table_remove(kfs->by_username, forgotten_username, username_len);
+
+  for (c = kfs->fps; c;) {
     otrng_known_fingerprint_s *kf = c->data;
-    if (memcmp(fp->fp, kf->fp, FPRINT_LEN_BYTES) == 0 &&
-        strcmp(fp->username, kf->username) == 0) {
+    int same_fp = memcmp(forgotten_fp, kf->fp, FPRINT_LEN_BYTES) == 0;
+    int same_username = strcmp(forgotten_username, kf->username) == 0;
+
+    if (same_fp && same_username) {
       work = c;
       c = work->next;
       if (prev) {
         prev->next = c;
       } else {
-        client->fingerprints->fps = c;
+        kfs->fps = c;
       }
       otrng_known_fingerprint_free(kf);
       otrng_free(work);
     } else {
+      if (same_fp || same_username) {
+        index_fingerprint(kfs, kf);
+      }
       prev = c;
       c = c->next;
     }
   }
+  kfs->last = prev;
+
+  otrng_free(forgotten_username);
 }
 
 /* This returns the fingerprint of the peer, not the self.
@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "hash_table.h"
 #include "keys.h"
 #include "list.h"
 #include "shared.h"
@@ -64,9 +65,14 @@ typedef struct otrng_known_fingerprint_v3_s {
   Fingerprint *fp;
 } otrng_known_fingerprint_v3_s;
 
-/* a list of known fingerprints */
+/* the known fingerprints, in the order they were added */
 typedef struct otrng_known_fingerprints_s {
   list_element_s *fps;
+  /*@null@*/ list_element_s *last; /* The last element of fps */
+  /* The first fingerprint in fps with some fingerprint bytes, or with some
+     username */
+  hash_table_s *by_fp;
+  hash_table_s *by_username;
 } otrng_known_fingerprints_s;
 
 /**
@@ -99,6 +105,17 @@ INTERNAL otrng_result otrng_serialize_fingerprint(
     otrng_fingerprint fp, const otrng_public_key long_term_pub_key,
     const otrng_public_key long_term_forging_pub_key);
 
+INTERNAL otrng_known_fingerprints_s *otrng_known_fingerprints_new(void);
+
+/**
+ * @brief Add a known fingerprint at the end, and index it.
+ *
+ * @param [kfs]    The known fingerprints.
+ * @param [kf]     The fingerprint. The known fingerprints take ownership.
+ */
+INTERNAL void otrng_known_fingerprints_add(otrng_known_fingerprints_s *kfs,
+                                           otrng_known_fingerprint_s *kf);
+
 /**
  * @brief Free a known fingerprints.
  *
@@ -22,7 +22,6 @@
 #include <gcrypt.h>
 #endif
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -33,10 +32,8 @@
 #include "fragment.h"
 #include "list.h"
 
-/* Example:
-   ?OTR|00000000|00000001|00000002,00001,00002,one , */
-#define FRAGMENT_FORMAT "?OTR|%08x|%08x|%08x,%05hu,%05hu,%.*s,"
-#define UNFRAGMENT_FORMAT "?OTR|%08x|%08x|%08x,%05hu,%05hu,%n%*[^,],%n"
+/* sender instance tag || identifier */
+#define FRAGMENT_CONTEXT_KEY_BYTES 8
 
 otrng_message_to_send_s *otrng_message_new(void) {
   otrng_message_to_send_s *msg =
@@ -46,99 +43,129 @@ otrng_message_to_send_s *otrng_message_new(void) {
 }
 
 tstatic void otrng_message_free(otrng_message_to_send_s *msg) {
-  int i;
-
   if (!msg) {
     return;
   }
 
-  for (i = 0; i < msg->total; i++) {
-    otrng_free(msg->pieces[i]);
-  }
-
   otrng_free(msg->pieces);
+  otrng_free(msg->buffer);
   otrng_free(msg);
 }
 
-tstatic void initialize_fragment_context(fragment_context_s *context) {
-  context->identifier = 0;
-  context->count = 0;
-  context->total = 0;
-  context->last_fragment_received_at = 0;
-  context->total_message_len = 0;
-  context->fragments = NULL;
+tstatic /*@notnull@*/ fragment_context_s *otrng_fragment_context_new(void) {
+  return otrng_xmalloc_z(sizeof(fragment_context_s));
 }
 
-tstatic void free_fragments_in_context(fragment_context_s *context) {
-  unsigned int i;
-
-  if (!context->fragments) {
-    return;
-  }
+INTERNAL void otrng_fragment_context_free(fragment_context_s *context) {
+  otrng_timer_cancel(&context->expiry);
+  otrng_free(context->buffer);
+  otrng_free(context->pieces);
+  otrng_free(context->received);
+  otrng_free(context);
+}
 
-  for (i = 0; i < context->total; i++) {
-    otrng_free(context->fragments[i]);
-    context->fragments[i] = NULL;
-  }
+static void free_fragment_context(void *context) {
+  otrng_fragment_context_free(context);
 }
 
-tstatic void reset_fragment_context(fragment_context_s *context) {
-  free_fragments_in_context(context);
-  initialize_fragment_context(context);
+INTERNAL void otrng_fragment_contexts_destroy(fragment_contexts_s *contexts) {
+  otrng_list_free(contexts->list, free_fragment_context);
+  contexts->list = NULL;
+
+  otrng_hash_table_free(contexts->index, NULL);
+  contexts->index = NULL;
 }
 
-tstatic /*@notnull@*/ fragment_context_s *otrng_fragment_context_new(void) {
-  fragment_context_s *context = otrng_xmalloc_z(sizeof(fragment_context_s));
-  initialize_fragment_context(context);
-  return context;
+static char *write_hex_uint32(char *dst, uint32_t value) {
+  static const char digits[] = "0123456789abcdef";
+  int i;
+
+  for (i = 7; i >= 0; i--) {
+    dst[i] = digits[value & 0xf];
+    value >>= 4;
+  }
+
+  return dst + 8;
 }
 
-INTERNAL void otrng_fragment_context_free(fragment_context_s *context) {
-  free_fragments_in_context(context);
-  otrng_free(context->fragments);
-  otrng_free(context);
+static char *write_dec_uint16(char *dst, uint16_t value) {
+  int i;
+
+  for (i = 4; i >= 0; i--) {
+    dst[i] = (char)('0' + value % 10);
+    value /= 10;
+  }
+
+  return dst + 5;
 }
 
-static otrng_result create_fragment_message(char **dst, const char *piece,
-                                            size_t piece_len,
-                                            uint32_t identifier,
+INTERNAL otrng_result otrng_fragmenter_init(fragmenter_s *fragmenter,
+                                            size_t max_size,
                                             uint32_t our_instance,
                                             uint32_t their_instance,
-                                            uint16_t current, uint16_t total) {
-  int res;
+                                            const char *msg, size_t msg_len) {
+  size_t total;
 
-  if (strlen(piece) < piece_len) {
+  if (max_size <= FRAGMENT_HEADER_LEN || msg_len == 0) {
     return OTRNG_ERROR;
   }
 
-  *dst = otrng_xmalloc_z(FRAGMENT_HEADER_LEN + piece_len + 1);
+  fragmenter->limit = max_size - FRAGMENT_HEADER_LEN;
 
-  res = snprintf(*dst, FRAGMENT_HEADER_LEN + piece_len + 1, FRAGMENT_FORMAT,
-                 identifier, our_instance, their_instance, current, total,
-                 (int)piece_len, piece);
-  if (res < 0) {
+  total = ((msg_len - 1) / fragmenter->limit) + 1;
+  if (total > 65535) {
     return OTRNG_ERROR;
   }
 
-  (*dst)[FRAGMENT_HEADER_LEN + piece_len] = '\0';
+  fragmenter->msg = msg;
+  fragmenter->msg_len = msg_len;
+  fragmenter->our_instance = our_instance;
+  fragmenter->their_instance = their_instance;
+  fragmenter->current = 0;
+  fragmenter->total = (uint16_t)total;
+
+  /* The identifier only tells messages apart, so a nonce is enough */
+  gcry_create_nonce(&fragmenter->identifier, sizeof(uint32_t));
 
   return OTRNG_SUCCESS;
 }
 
-static otrng_result
-init_message_to_send_with_total(otrng_message_to_send_s *fragments, int total) {
-  size_t pieces_len;
-
-  if (total < 1 || total > 65535) {
-    return OTRNG_ERROR;
+/* Example:
+   ?OTR|00000000|00000001|00000002,00001,00002,one , */
+INTERNAL size_t otrng_fragmenter_next(fragmenter_s *fragmenter, char *dst) {
+  size_t piece_len = fragmenter->msg_len < fragmenter->limit
+                         ? fragmenter->msg_len
+                         : fragmenter->limit;
+  char *cursor = dst;
+
+  if (fragmenter->current == fragmenter->total) {
+    return 0;
   }
 
-  fragments->total = total;
-
-  pieces_len = fragments->total * sizeof(string_p);
-  fragments->pieces = otrng_xmalloc_z(pieces_len);
-
-  return OTRNG_SUCCESS;
+  fragmenter->current++;
+
+  memcpy(cursor, "?OTR|", 5);
+  cursor += 5;
+  cursor = write_hex_uint32(cursor, fragmenter->identifier);
+  *cursor++ = '|';
+  cursor = write_hex_uint32(cursor, fragmenter->our_instance);
+  *cursor++ = '|';
+  cursor = write_hex_uint32(cursor, fragmenter->their_instance);
+  *cursor++ = ',';
+  cursor = write_dec_uint16(cursor, fragmenter->current);
+  *cursor++ = ',';
+  cursor = write_dec_uint16(cursor, fragmenter->total);
+  *cursor++ = ',';
+
+  memcpy(cursor, fragmenter->msg, piece_len);
+  cursor += piece_len;
+  *cursor++ = ',';
+  *cursor = '\0';
+
+  fragmenter->msg += piece_len;
+  fragmenter->msg_len -= piece_len;
+
+  return cursor - dst;
 }
 
 INTERNAL otrng_result otrng_fragment_message(int max_size,
@@ -147,37 +174,28 @@ INTERNAL otrng_result otrng_fragment_message(int max_size,
                                              uint32_t their_instance,
                                              const string_p msg) {
   size_t msg_len = strlen(msg);
-  size_t limit = max_size - FRAGMENT_HEADER_LEN;
-  int total = ((msg_len - 1) / limit) + 1;
-  uint32_t *identifier;
+  fragmenter_s fragmenter;
+  char *cursor;
   int i;
 
-  if (otrng_failed(init_message_to_send_with_total(fragments, total))) {
+  if (max_size < 0 ||
+      otrng_failed(otrng_fragmenter_init(&fragmenter, max_size, our_instance,
+                                         their_instance, msg, msg_len))) {
     return OTRNG_ERROR;
   }
 
-  identifier = gcry_random_bytes(4, GCRY_STRONG_RANDOM);
-  if (!identifier) {
-    return OTRNG_ERROR;
-  }
+  /* Every fragment adds a header and a NUL to its piece of the message */
+  fragments->total = fragmenter.total;
+  fragments->pieces = otrng_xmalloc(fragments->total * sizeof(string_p));
+  fragments->buffer =
+      otrng_xmalloc(msg_len + fragments->total * (FRAGMENT_HEADER_LEN + 1));
 
+  cursor = fragments->buffer;
   for (i = 0; i < fragments->total; i++) {
-    int piece_len = msg_len < limit ? msg_len : limit;
-    char **dst = fragments->pieces + i;
-
-    if (otrng_failed(create_fragment_message(dst, msg, piece_len, *identifier,
-                                             our_instance, their_instance,
-                                             i + 1, fragments->total))) {
-      otrng_message_free(fragments);
-      return OTRNG_ERROR;
-    }
-
-    msg += piece_len;
-    msg_len -= piece_len;
+    fragments->pieces[i] = cursor;
+    cursor += otrng_fragmenter_next(&fragmenter, cursor) + 1;
   }
 
-  gcry_free(identifier);
-
   return OTRNG_SUCCESS;
 }
 
@@ -189,50 +207,296 @@ tstatic otrng_bool is_fragment_generic(const string_p msg, const char *prefix) {
   return otrng_false;
 }
 
-tstatic otrng_result initialize_fragments(fragment_context_s *context) {
-  context->fragments = otrng_xmalloc_z(sizeof(string_p) * context->total);
+/* Reads up to 8 hex digits */
+static /*@null@*/ const char *parse_hex_uint32(uint32_t *dst,
+                                               /*@null@*/ const char *cursor) {
+  uint32_t value = 0;
+  int digits;
+
+  if (!cursor) {
+    return NULL;
+  }
+
+  for (digits = 0; digits < 8; digits++, cursor++) {
+    if (*cursor >= '0' && *cursor <= '9') {
+      value = (value << 4) | (uint32_t)(*cursor - '0');
+    } else if (*cursor >= 'a' && *cursor <= 'f') {
+      value = (value << 4) | (uint32_t)(*cursor - 'a' + 10);
+    } else if (*cursor >= 'A' && *cursor <= 'F') {
+      value = (value << 4) | (uint32_t)(*cursor - 'A' + 10);
+    } else {
+      break;
+    }
+  }
+
+  if (digits == 0) {
+    return NULL;
+  }
+
+  *dst = value;
+  return cursor;
+}
+
+/* Reads up to 5 decimal digits */
+static /*@null@*/ const char *parse_dec_uint16(uint16_t *dst,
+                                               /*@null@*/ const char *cursor) {
+  uint32_t value = 0;
+  int digits;
+
+  if (!cursor) {
+    return NULL;
+  }
+
+  for (digits = 0; digits < 5 && *cursor >= '0' && *cursor <= '9';
+       digits++, cursor++) {
+    value = value * 10 + (uint32_t)(*cursor - '0');
+  }
+
+  if (digits == 0 || value > UINT16_MAX) {
+    return NULL;
+  }
+
+  *dst = (uint16_t)value;
+  return cursor;
+}
+
+static /*@null@*/ const char *parse_separator(char separator,
+                                              /*@null@*/ const char *cursor) {
+  if (!cursor || *cursor != separator) {
+    return NULL;
+  }
+
+  return cursor + 1;
+}
+
+/* Parses everything after the prefix of a fragment:
+   identifier|sender_instance_tag|receiver_instance_tag,index,total,piece, */
+tstatic otrng_result parse_fragment(fragment_s *dst, const char *msg) {
+  const char *cursor = msg;
+  const char *end;
+
+  cursor = parse_hex_uint32(&dst->identifier, cursor);
+  cursor = parse_separator('|', cursor);
+  cursor = parse_hex_uint32(&dst->sender_tag, cursor);
+  cursor = parse_separator('|', cursor);
+  cursor = parse_hex_uint32(&dst->receiver_tag, cursor);
+  cursor = parse_separator(',', cursor);
+  cursor = parse_dec_uint16(&dst->index, cursor);
+  cursor = parse_separator(',', cursor);
+  cursor = parse_dec_uint16(&dst->total, cursor);
+  cursor = parse_separator(',', cursor);
+
+  if (!cursor) {
+    return OTRNG_ERROR;
+  }
+
+  end = strchr(cursor, ',');
+  if (!end || end == cursor) {
+    return OTRNG_ERROR;
+  }
+
+  dst->piece = cursor;
+  dst->piece_len = end - cursor;
 
   return OTRNG_SUCCESS;
 }
 
-tstatic otrng_result join_fragments(char **unfrag_msg,
+static void fragment_context_key(uint8_t *key, uint32_t sender_tag,
+                                 uint32_t identifier) {
+  memcpy(key, &sender_tag, sizeof(uint32_t));
+  memcpy(key + sizeof(uint32_t), &identifier, sizeof(uint32_t));
+}
+
+tstatic void add_fragment_context(fragment_contexts_s *contexts,
+                                  fragment_context_s *context) {
+  contexts->list = otrng_list_prepend(context, contexts->list);
+  if (contexts->list->next) {
+    fragment_context_s *older = contexts->list->next->data;
+    older->link = &contexts->list->next;
+  }
+
+  context->node = contexts->list;
+  context->link = &contexts->list;
+  context->owner = contexts;
+}
+
+/* Unlinks the context, without freeing it or its list node */
+static void remove_fragment_context(fragment_contexts_s *contexts,
                                     fragment_context_s *context) {
-  char *end_msg;
-  unsigned int i;
+  list_element_s *node = context->node;
+  uint8_t key[FRAGMENT_CONTEXT_KEY_BYTES];
 
-  *unfrag_msg = otrng_xmalloc_z(context->total_message_len + 1);
+  *context->link = node->next;
+  if (node->next) {
+    fragment_context_s *next = node->next->data;
+    next->link = context->link;
+  }
+  node->next = NULL;
 
-  end_msg = *unfrag_msg;
-  for (i = 0; i < context->total; i++) {
-    end_msg = otrng_stpcpy(end_msg, context->fragments[i]);
+  if (contexts->index) {
+    fragment_context_key(key, context->sender_tag, context->identifier);
+    if (otrng_hash_table_get(contexts->index, key, sizeof(key)) == context) {
+      otrng_hash_table_remove(contexts->index, key, sizeof(key));
+    }
   }
+}
 
-  return OTRNG_SUCCESS;
+static void discard_fragment_context(fragment_contexts_s *contexts,
+                                     fragment_context_s *context) {
+  list_element_s *node = context->node;
+
+  remove_fragment_context(contexts, context);
+  otrng_list_free_nodes(node);
+  otrng_fragment_context_free(context);
+}
+
+static void fragment_context_expired(void *data, time_t now) {
+  fragment_context_s *context = data;
+  (void)now;
+
+  discard_fragment_context(context->owner, context);
+}
+
+static fragment_context_s *get_fragment_context(fragment_contexts_s *contexts,
+                                                const fragment_s *fragment) {
+  uint8_t key[FRAGMENT_CONTEXT_KEY_BYTES];
+  fragment_context_s *context;
+
+  fragment_context_key(key, fragment->sender_tag, fragment->identifier);
+
+  if (!contexts->index) {
+    contexts->index = otrng_hash_table_new();
+  }
+
+  context = otrng_hash_table_get(contexts->index, key, sizeof(key));
+  if (context) {
+    return context;
+  }
+
+  context = otrng_fragment_context_new();
+  context->identifier = fragment->identifier;
+  context->sender_tag = fragment->sender_tag;
+  otrng_timer_init(&context->expiry, fragment_context_expired, context);
+
+  add_fragment_context(contexts, context);
+  otrng_hash_table_put(contexts->index, key, sizeof(key), context);
+
+  return context;
+}
+
+static otrng_bool is_received(const fragment_context_s *context,
+                              uint16_t index) {
+  return (context->received[(index - 1) / 8] >> ((index - 1) % 8)) & 1;
+}
+
+static void mark_received(fragment_context_s *context, uint16_t index) {
+  context->received[(index - 1) / 8] |= (uint8_t)(1 << ((index - 1) % 8));
+}
+
+static size_t max_message_len(const fragment_contexts_s *contexts) {
+  return contexts->max_message_len ? contexts->max_message_len
+                                   : OTRNG_FRAGMENT_MAX_MESSAGE_BYTES;
 }
 
-tstatic otrng_result copy_fragment_to_context(fragment_context_s *context,
-                                              unsigned short i,
-                                              const string_p msg,
-                                              uint32_t fragment_len) {
-  char *fragment = otrng_xmalloc(fragment_len + 1);
+/* Makes room for [len] more bytes and the NUL that ends the message */
+static void reserve_buffer(fragment_context_s *context, size_t len,
+                           size_t max_len) {
+  size_t needed = context->total_message_len + len + 1;
+  size_t size = context->buffer_size;
+
+  if (needed <= size) {
+    return;
+  }
+
+  size = size * 2 > needed ? size * 2 : needed;
+  if (size > max_len + 1) {
+    size = max_len + 1;
+  }
+
+  context->buffer = otrng_xrealloc(context->buffer, size);
+  context->buffer_size = size;
+}
+
+static void record_piece(fragment_context_s *context,
+                         const fragment_s *fragment) {
+  fragment_piece_s *piece;
+
+  if (context->num_pieces == context->pieces_size) {
+    context->pieces_size = context->pieces_size ? context->pieces_size * 2 : 4;
+    context->pieces = otrng_xrealloc(
+        context->pieces, context->pieces_size * sizeof(fragment_piece_s));
+  }
+
+  piece = &context->pieces[context->num_pieces++];
+  piece->index = fragment->index;
+  piece->offset = context->total_message_len;
+  piece->len = fragment->piece_len;
+}
+
+tstatic otrng_result store_fragment(fragment_context_s *context,
+                                    const fragment_s *fragment,
+                                    size_t max_len) {
+  if (fragment->piece_len > max_len - context->total_message_len) {
+    return OTRNG_ERROR;
+  }
+
+  reserve_buffer(context, fragment->piece_len, max_len);
+
+  if (!context->pieces && fragment->index == context->in_order + 1) {
+    context->in_order++;
+    context->in_order_len += fragment->piece_len;
+  } else {
+    record_piece(context, fragment);
+  }
+
+  memcpy(context->buffer + context->total_message_len, fragment->piece,
+         fragment->piece_len);
+  context->total_message_len += fragment->piece_len;
 
-  memcpy(fragment, msg, fragment_len);
-  fragment[fragment_len] = '\0';
-  context->fragments[i - 1] = fragment;
-  context->total_message_len += fragment_len;
   return OTRNG_SUCCESS;
 }
 
+static int compare_pieces(const void *a, const void *b) {
+  const fragment_piece_s *x = a, *y = b;
+
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+/* Every piece is in: returns the message, leaving the context without a
+   buffer */
+static char *join_fragments(fragment_context_s *context) {
+  char *msg, *cursor;
+  unsigned int i;
+
+  if (!context->pieces) {
+    /* They all arrived in order, so the buffer is the message */
+    msg = context->buffer;
+  } else {
+    qsort(context->pieces, context->num_pieces, sizeof(fragment_piece_s),
+          compare_pieces);
+
+    msg = otrng_xmalloc(context->total_message_len + 1);
+    memcpy(msg, context->buffer, context->in_order_len);
+    cursor = msg + context->in_order_len;
+    for (i = 0; i < context->num_pieces; i++) {
+      memcpy(cursor, context->buffer + context->pieces[i].offset,
+             context->pieces[i].len);
+      cursor += context->pieces[i].len;
+    }
+    otrng_free(context->buffer);
+  }
+
+  msg[context->total_message_len] = '\0';
+  context->buffer = NULL;
+
+  return msg;
+}
+
 INTERNAL otrng_result otrng_unfragment_message_generic(
-    char **unfrag_msg, list_element_s **contexts, const string_p msg,
-    const uint32_t our_instance_tag, const char *prefix, const char *format) {
-  int start = 0, end = 0;
-  uint32_t fragment_identifier = 0, sender_tag = 0, receiver_tag = 0;
-  uint16_t i = 0, t = 0;
+    char **unfrag_msg, fragment_contexts_s *contexts, const string_p msg,
+    const uint32_t our_instance_tag, const char *prefix) {
+  fragment_s fragment;
   fragment_context_s *context = NULL;
-  list_element_s *current = NULL;
-  fragment_context_s *ctx = NULL;
-  uint32_t fragment_len = 0;
 
   *unfrag_msg = NULL;
 
@@ -246,112 +510,82 @@ INTERNAL otrng_result otrng_unfragment_message_generic(
     return OTRNG_SUCCESS;
   }
 
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wformat-nonliteral"
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-  if (sscanf(msg, format, &fragment_identifier, &sender_tag, &receiver_tag, &i,
-             &t, &start, &end) == EOF) {
+  if (!parse_fragment(&fragment, msg + strlen(prefix))) {
     return OTRNG_ERROR;
   }
-#pragma GCC diagnostic error "-Wformat-nonliteral"
-#pragma clang diagnostic pop
 
-  if (our_instance_tag != receiver_tag && 0 != receiver_tag) {
+  if (our_instance_tag != fragment.receiver_tag && 0 != fragment.receiver_tag) {
     return OTRNG_SUCCESS;
   }
 
-  if (end <= start) {
-    return OTRNG_ERROR;
-  }
-
-  for (current = *contexts; current; current = current->next) {
-    if (!current->data) {
-      continue;
-    }
-
-    ctx = current->data;
-    if (ctx->identifier == fragment_identifier) {
-      context = ctx;
-      break;
-    }
-  }
-
-  if (!context) {
-    context = otrng_fragment_context_new();
-    context->identifier = fragment_identifier;
-    *contexts = otrng_list_add(context, *contexts);
-  }
+  context = get_fragment_context(contexts, &fragment);
 
-  if (i == 0 || t == 0 || i > t) {
-    reset_fragment_context(context);
+  if (fragment.index == 0 || fragment.total == 0 ||
+      fragment.index > fragment.total) {
+    discard_fragment_context(contexts, context);
     return OTRNG_SUCCESS;
   }
 
-  if (context->total != 0 && context->total != t) {
+  if (context->total != 0 && context->total != fragment.total) {
     return OTRNG_ERROR;
   }
 
-  context->total = t;
-
-  if (context->fragments == NULL) {
-    if (otrng_failed(initialize_fragments(context))) {
-      return OTRNG_ERROR;
-    }
+  if (!context->received) {
+    context->total = fragment.total;
+    context->received = otrng_xmalloc_z((context->total + 7) / 8);
   }
 
-  if (context->fragments[i - 1] != NULL) {
+  if (is_received(context, fragment.index)) {
     return OTRNG_ERROR;
   }
 
-  fragment_len = end - start - 1;
-  if (otrng_failed(
-          copy_fragment_to_context(context, i, msg + start, fragment_len))) {
+  if (!store_fragment(context, &fragment, max_message_len(contexts))) {
+    /* The message is too long to be reassembled */
+    discard_fragment_context(contexts, context);
     return OTRNG_ERROR;
   }
 
+  mark_received(context, fragment.index);
   context->count++;
   context->last_fragment_received_at = time(NULL);
+  if (contexts->timers) {
+    otrng_timer_wheel_schedule(contexts->timers, &context->expiry,
+                               context->last_fragment_received_at +
+                                   contexts->expiration_time);
+  }
 
-  if (context->count == t) {
-    if (otrng_succeeded(join_fragments(unfrag_msg, context))) {
-      list_element_s *to_remove = otrng_list_get_by_value(context, *contexts);
-      *contexts = otrng_list_remove_element(to_remove, *contexts);
-      otrng_fragment_context_free(context);
-      otrng_list_free_nodes(to_remove);
-      return OTRNG_SUCCESS;
-    }
-    return OTRNG_ERROR;
+  if (context->count == context->total) {
+    *unfrag_msg = join_fragments(context);
+    discard_fragment_context(contexts, context);
   }
 
   return OTRNG_SUCCESS;
 }
+
 INTERNAL otrng_result
-otrng_unfragment_message(char **unfrag_msg, list_element_s **contexts,
+otrng_unfragment_message(char **unfrag_msg, fragment_contexts_s *contexts,
                          const string_p msg, const uint32_t our_instance_tag) {
-  return otrng_unfragment_message_generic(
-      unfrag_msg, contexts, msg, our_instance_tag, "?OTR|", UNFRAGMENT_FORMAT);
+  return otrng_unfragment_message_generic(unfrag_msg, contexts, msg,
+                                          our_instance_tag, "?OTR|");
 }
 
 INTERNAL otrng_result otrng_expire_fragments(time_t now,
                                              uint32_t expiration_time,
-                                             list_element_s **contexts) {
-  list_element_s *current = *contexts;
+                                             fragment_contexts_s *contexts) {
+  list_element_s *current = contexts->list;
 
   while (current) {
     fragment_context_s *ctx = current->data;
+    list_element_s *next = current->next;
 
-    list_element_s *to_free = NULL;
     if ((ctx != NULL) &&
-        (difftime(now, ctx->last_fragment_received_at) < expiration_time)) {
-      *contexts = otrng_list_remove_element(current, *contexts);
+        (difftime(now, ctx->last_fragment_received_at) >= expiration_time)) {
+      remove_fragment_context(contexts, ctx);
       otrng_fragment_context_free(ctx);
-      to_free = current;
+      otrng_list_free_nodes(current);
     }
 
-    current = current->next;
-    if (to_free) {
-      otrng_list_free_nodes(to_free);
-    }
+    current = next;
   }
 
   return OTRNG_SUCCESS;
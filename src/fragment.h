@@ -29,9 +29,11 @@
 #define OTRNG_FRAGMENT_H
 
 #include "error.h"
+#include "hash_table.h"
 #include "list.h"
 #include "shared.h"
 #include "str.h"
+#include "timer_wheel.h"
 
 /* ?OTR|identifier|sender_instance_tag|receiver_instance_tag,
  * index,total,,*/
@@ -40,18 +42,126 @@
 typedef struct otrng_message_to_send_s {
   string_p *pieces;
   int total;
+  /* The pieces point into this buffer, one after the other */
+  char *buffer;
 } otrng_message_to_send_s;
 
+/* Writes the fragments of a message one at a time, into a buffer provided by
+   the caller */
+typedef struct fragmenter_s {
+  const char *msg; /* What is left to send */
+  size_t msg_len;
+  size_t limit; /* The most message bytes a fragment carries */
+  uint32_t identifier;
+  uint32_t our_instance;
+  uint32_t their_instance;
+  uint16_t current, total;
+} fragmenter_s;
+
+/* The longest message reassembled when a fragment_contexts_s does not set
+   one */
+#define OTRNG_FRAGMENT_MAX_MESSAGE_BYTES (4 * 1024 * 1024)
+
+struct fragment_contexts_s;
+
+/* Where a piece that arrived out of order is in the reassembly buffer */
+typedef struct fragment_piece_s {
+  uint16_t index;
+  size_t offset, len;
+} fragment_piece_s;
+
 typedef struct fragment_context_s {
   uint32_t identifier;
+  uint32_t sender_tag;
   unsigned int total, count;
   size_t total_message_len;
   time_t last_fragment_received_at;
-  string_p *fragments;
+
+  /* Discards the context when no fragment has arrived for too long */
+  timer_s expiry;
+  /*@null@*/ struct fragment_contexts_s *owner;
+
+  /* The node of the context in the owner's list, and the pointer that points
+     to it, so the context is removed without walking the list */
+  list_element_s *node;
+  list_element_s **link;
+
+  /* The pieces, one after the other in the order they arrived. It grows as
+     they arrive, so what is allocated depends on what was received rather
+     than on the size a fragment claims the message has. While the pieces
+     arrive in order, it is the message itself. */
+  /*@null@*/ char *buffer;
+  size_t buffer_size;
+
+  /* The first in_order pieces arrived in order, and take in_order_len bytes
+     at the start of the buffer. Every piece after them is recorded here, and
+     they are all put back in order once the last one arrives. */
+  unsigned int in_order;
+  size_t in_order_len;
+  /*@null@*/ fragment_piece_s *pieces;
+  unsigned int num_pieces, pieces_size;
+
+  /* One bit per fragment, set once it has been received */
+  /*@null@*/ uint8_t *received;
 } fragment_context_s;
 
+/* The messages being reassembled for a conversation */
+typedef struct fragment_contexts_s {
+  /*@null@*/ list_element_s *list;
+  /* The same contexts, by sender instance tag and identifier. Created with the
+     first context. */
+  /*@null@*/ hash_table_s *index;
+
+  /* If set, a context expires expiration_time seconds after its last fragment
+     arrived, when the wheel gets there */
+  /*@null@*/ timer_wheel_s *timers;
+  uint32_t expiration_time;
+
+  /* A message that would be longer than this is dropped as soon as that is
+     known. OTRNG_FRAGMENT_MAX_MESSAGE_BYTES if 0. */
+  size_t max_message_len;
+} fragment_contexts_s;
+
 INTERNAL void otrng_fragment_context_free(fragment_context_s *context);
 
+/**
+ * @brief Frees every context being reassembled, leaving [contexts] empty.
+ *
+ * @param [contexts] The contexts.
+ */
+INTERNAL void otrng_fragment_contexts_destroy(fragment_contexts_s *contexts);
+
+/**
+ * @brief Prepares to fragment a message. Nothing is allocated, and [msg] must
+ * outlive the fragmenter.
+ *
+ * @param [fragmenter] The fragmenter to initialize.
+ * @param [max_size] The largest fragment the network allows.
+ * @param [our_instance] Our instance tag.
+ * @param [their_instance] Their instance tag.
+ * @param [msg] The message.
+ * @param [msg_len] The length of [msg].
+ *
+ * @return OTRNG_ERROR if the message is empty, or if it can not be split into
+ * fragments of [max_size].
+ */
+INTERNAL otrng_result otrng_fragmenter_init(fragmenter_s *fragmenter,
+                                            size_t max_size,
+                                            uint32_t our_instance,
+                                            uint32_t their_instance,
+                                            const char *msg, size_t msg_len);
+
+/**
+ * @brief Writes the next fragment, NUL-terminated.
+ *
+ * @param [fragmenter] The fragmenter.
+ * @param [dst] Where to write the fragment. It must have room for
+ * [max_size] + 1 bytes.
+ *
+ * @return The length of the fragment, or 0 once every fragment was written.
+ */
+INTERNAL size_t otrng_fragmenter_next(fragmenter_s *fragmenter, char *dst);
+
 INTERNAL otrng_result otrng_fragment_message(int max_size,
                                              otrng_message_to_send_s *fragments,
                                              uint32_t our_instance,
@@ -59,17 +169,22 @@ INTERNAL otrng_result otrng_fragment_message(int max_size,
                                              const string_p msg);
 
 INTERNAL otrng_result otrng_unfragment_message(char **unfrag_msg,
-                                               list_element_s **contexts,
+                                               fragment_contexts_s *contexts,
                                                const string_p msg,
                                                const uint32_t our_instance_tag);
 
 INTERNAL otrng_result otrng_unfragment_message_generic(
-    char **unfrag_msg, list_element_s **contexts, const string_p msg,
-    const uint32_t our_instance_tag, const char *prefix, const char *format);
+    char **unfrag_msg, fragment_contexts_s *contexts, const string_p msg,
+    const uint32_t our_instance_tag, const char *prefix);
 
+/**
+ * @brief Frees every context whose last fragment arrived [expiration_time]
+ * seconds or more before [now]. It is not needed for contexts that have a
+ * timer wheel.
+ */
 INTERNAL otrng_result otrng_expire_fragments(time_t now,
                                              uint32_t expiration_time,
-                                             list_element_s **contexts);
+                                             fragment_contexts_s *contexts);
 
 #ifdef OTRNG_FRAGMENT_PRIVATE
 
@@ -79,6 +194,20 @@ tstatic void otrng_message_free(otrng_message_to_send_s *msg);
 
 tstatic /*@notnull@*/ fragment_context_s *otrng_fragment_context_new(void);
 
+tstatic void add_fragment_context(fragment_contexts_s *contexts,
+                                  fragment_context_s *context);
+
+typedef struct fragment_s {
+  uint32_t identifier;
+  uint32_t sender_tag;
+  uint32_t receiver_tag;
+  uint16_t index, total;
+  const char *piece; /* Points into the parsed message */
+  size_t piece_len;
+} fragment_s;
+
+tstatic otrng_result parse_fragment(fragment_s *dst, const char *msg);
+
 #endif
 
 #endif
@@ -0,0 +1,188 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <sodium.h>
+#include <string.h>
+
+#define OTRNG_HASH_TABLE_PRIVATE
+
+#include "alloc.h"
+#include "hash_table.h"
+#include "random.h"
+
+#define HASH_TABLE_INITIAL_BUCKETS 16
+
+INTERNAL hash_table_s *otrng_hash_table_new(void) {
+  hash_table_s *table = otrng_xmalloc_z(sizeof(hash_table_s));
+
+  table->num_buckets = HASH_TABLE_INITIAL_BUCKETS;
+  table->buckets =
+      otrng_xmalloc_z(table->num_buckets * sizeof(hash_table_entry_s *));
+  random_bytes(table->hash_key, HASH_TABLE_HASH_KEY_BYTES);
+
+  return table;
+}
+
+INTERNAL void otrng_hash_table_free(hash_table_s *table,
+                                    void (*free_value)(void *)) {
+  hash_table_entry_s *entry, *next;
+  size_t i;
+
+  if (!table) {
+    return;
+  }
+
+  for (i = 0; i < table->num_buckets; i++) {
+    for (entry = table->buckets[i]; entry; entry = next) {
+      next = entry->next;
+      if (free_value) {
+        free_value(entry->value);
+      }
+      otrng_free(entry);
+    }
+  }
+
+  otrng_free(table->buckets);
+  otrng_free(table);
+}
+
+INTERNAL size_t otrng_hash_table_len(const hash_table_s *table) {
+  return table->count;
+}
+
+tstatic uint64_t hash_table_hash(const hash_table_s *table, const void *key,
+                                 size_t key_len) {
+  uint8_t out[crypto_shorthash_BYTES];
+  uint64_t hash = 0;
+  size_t i;
+
+  crypto_shorthash(out, key, key_len, table->hash_key);
+  for (i = 0; i < crypto_shorthash_BYTES; i++) {
+    hash = (hash << 8) | out[i];
+  }
+
+  return hash;
+}
+
+static void grow_buckets(hash_table_s *table) {
+  size_t num_buckets = table->num_buckets * 2;
+  hash_table_entry_s **buckets =
+      otrng_xmalloc_z(num_buckets * sizeof(hash_table_entry_s *));
+  hash_table_entry_s *entry, *next;
+  size_t i;
+
+  for (i = 0; i < table->num_buckets; i++) {
+    for (entry = table->buckets[i]; entry; entry = next) {
+      size_t b = entry->hash & (num_buckets - 1);
+      next = entry->next;
+      entry->next = buckets[b];
+      buckets[b] = entry;
+    }
+  }
+
+  otrng_free(table->buckets);
+  table->buckets = buckets;
+  table->num_buckets = num_buckets;
+}
+
+static hash_table_entry_s **find_entry(const hash_table_s *table,
+                                       uint64_t hash, const void *key,
+                                       size_t key_len) {
+  hash_table_entry_s **cursor =
+      &table->buckets[hash & (table->num_buckets - 1)];
+
+  for (; *cursor; cursor = &(*cursor)->next) {
+    if ((*cursor)->hash == hash && (*cursor)->key_len == key_len &&
+        memcmp((*cursor)->key, key, key_len) == 0) {
+      break;
+    }
+  }
+
+  return cursor;
+}
+
+INTERNAL void otrng_hash_table_put(hash_table_s *table, const void *key,
+                                   size_t key_len, void *value) {
+  uint64_t hash = hash_table_hash(table, key, key_len);
+  hash_table_entry_s **cursor = find_entry(table, hash, key, key_len);
+  hash_table_entry_s *entry;
+  size_t b;
+
+  if (*cursor) {
+    (*cursor)->value = value;
+    return;
+  }
+
+  if (table->count >= table->num_buckets) {
+    grow_buckets(table);
+  }
+
+  entry = otrng_xmalloc(sizeof(hash_table_entry_s) + key_len);
+  entry->hash = hash;
+  entry->value = value;
+  entry->key_len = key_len;
+  memcpy(entry->key, key, key_len);
+
+  b = hash & (table->num_buckets - 1);
+  entry->next = table->buckets[b];
+  table->buckets[b] = entry;
+  table->count++;
+}
+
+INTERNAL void *otrng_hash_table_get(const hash_table_s *table,
+                                    const void *key, size_t key_len) {
+  hash_table_entry_s **cursor;
+
+  if (table->count == 0) {
+    return NULL;
+  }
+
+  cursor = find_entry(table, hash_table_hash(table, key, key_len), key,
+                      key_len);
+  if (!*cursor) {
+    return NULL;
+  }
+
+  return (*cursor)->value;
+}
+
+INTERNAL void *otrng_hash_table_remove(hash_table_s *table, const void *key,
+                                       size_t key_len) {
+  hash_table_entry_s **cursor;
+  hash_table_entry_s *entry;
+  void *value;
+
+  if (table->count == 0) {
+    return NULL;
+  }
+
+  cursor = find_entry(table, hash_table_hash(table, key, key_len), key,
+                      key_len);
+  entry = *cursor;
+  if (!entry) {
+    return NULL;
+  }
+
+  *cursor = entry->next;
+  value = entry->value;
+  otrng_free(entry);
+  table->count--;
+
+  return value;
+}
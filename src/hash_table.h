@@ -0,0 +1,107 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * The functions in this file only operate on their arguments, and doesn't touch
+ * any global state. It is safe to call these functions concurrently from
+ * different threads, as long as arguments pointing to the same memory areas are
+ * not used from different threads.
+ */
+
+#ifndef OTRNG_HASH_TABLE_H
+#define OTRNG_HASH_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "shared.h"
+
+#define HASH_TABLE_HASH_KEY_BYTES 16
+
+typedef struct hash_table_entry_s {
+  uint64_t hash;
+  void *value;
+  struct hash_table_entry_s *next;
+  size_t key_len;
+  uint8_t key[]; /* A copy of the key */
+} hash_table_entry_s;
+
+/*
+ * A map from byte strings to values. Keys are hashed with SipHash under a
+ * random per-table key, so peers can not choose names that all collide. The
+ * table does not own its values.
+ */
+typedef struct hash_table_s {
+  hash_table_entry_s **buckets;
+  size_t num_buckets; /* Always a power of two */
+  size_t count;
+  uint8_t hash_key[HASH_TABLE_HASH_KEY_BYTES];
+} hash_table_s;
+
+INTERNAL hash_table_s *otrng_hash_table_new(void);
+
+/**
+ * @brief Frees the table.
+ *
+ * @param [table]      The table.
+ * @param [free_value] If not NULL, called with every value still stored.
+ */
+INTERNAL void otrng_hash_table_free(/*@only@*/ /*@null@*/ hash_table_s *table,
+                                    /*@null@*/ void (*free_value)(void *));
+
+INTERNAL size_t otrng_hash_table_len(const hash_table_s *table);
+
+/**
+ * @brief Maps [key] to [value], replacing any value already mapped to it.
+ *
+ * @param [table]   The table.
+ * @param [key]     The key. It is copied.
+ * @param [key_len] The key length.
+ * @param [value]   The value.
+ */
+INTERNAL void otrng_hash_table_put(hash_table_s *table, const void *key,
+                                   size_t key_len, void *value);
+
+/**
+ * @brief Finds the value mapped to [key].
+ *
+ * @return The value, or NULL.
+ */
+INTERNAL /*@null@*/ void *otrng_hash_table_get(const hash_table_s *table,
+                                               const void *key,
+                                               size_t key_len);
+
+/**
+ * @brief Removes the mapping of [key].
+ *
+ * @return The value that was mapped to [key], or NULL.
+ */
+INTERNAL /*@null@*/ void *otrng_hash_table_remove(hash_table_s *table,
+                                                  const void *key,
+                                                  size_t key_len);
+
+#ifdef OTRNG_HASH_TABLE_PRIVATE
+
+tstatic uint64_t hash_table_hash(const hash_table_s *table, const void *key,
+                                 size_t key_len);
+
+#endif
+
+#endif
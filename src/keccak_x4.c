@@ -0,0 +1,119 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "keccak_x4.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+#define OTRNG_KECCAK_X4_AVX2
+#endif
+
+#ifdef OTRNG_KECCAK_X4_AVX2
+
+#include <immintrin.h>
+
+static const uint64_t round_constants[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+/* The rho offset of word x + 5y */
+static const int rotations[25] = {0,  1,  62, 28, 27, 36, 44, 6,  55,
+                                  20, 3,  10, 43, 25, 39, 41, 45, 15,
+                                  21, 8,  18, 2,  61, 56, 14};
+
+/* Shifting by 64 gives zero, so rotating by 0 needs no special case */
+#define ROTATE(v, n)                                                           \
+  _mm256_or_si256(_mm256_sll_epi64((v), _mm_cvtsi32_si128(n)),                 \
+                  _mm256_srl_epi64((v), _mm_cvtsi32_si128(64 - (n))))
+
+__attribute__((target("avx2"))) static void
+permute_avx2(keccak_x4_state state) {
+  __m256i a[25], b[25], c[5], d;
+  int round, x, y;
+
+  for (x = 0; x < 25; x++) {
+    a[x] = _mm256_loadu_si256((const __m256i *)state[x]);
+  }
+
+  for (round = 0; round < 24; round++) {
+    /* theta */
+    for (x = 0; x < 5; x++) {
+      c[x] = _mm256_xor_si256(
+          _mm256_xor_si256(_mm256_xor_si256(a[x], a[x + 5]),
+                           _mm256_xor_si256(a[x + 10], a[x + 15])),
+          a[x + 20]);
+    }
+
+    for (x = 0; x < 5; x++) {
+      d = _mm256_xor_si256(c[(x + 4) % 5], ROTATE(c[(x + 1) % 5], 1));
+      for (y = 0; y < 25; y += 5) {
+        a[y + x] = _mm256_xor_si256(a[y + x], d);
+      }
+    }
+
+    /* rho and pi */
+    for (y = 0; y < 5; y++) {
+      for (x = 0; x < 5; x++) {
+        b[y + 5 * ((2 * x + 3 * y) % 5)] =
+            ROTATE(a[x + 5 * y], rotations[x + 5 * y]);
+      }
+    }
+
+    /* chi */
+    for (y = 0; y < 25; y += 5) {
+      for (x = 0; x < 5; x++) {
+        a[y + x] = _mm256_xor_si256(
+            b[y + x],
+            _mm256_andnot_si256(b[y + (x + 1) % 5], b[y + (x + 2) % 5]));
+      }
+    }
+
+    /* iota */
+    a[0] = _mm256_xor_si256(
+        a[0], _mm256_set1_epi64x((long long)round_constants[round]));
+  }
+
+  for (x = 0; x < 25; x++) {
+    _mm256_storeu_si256((__m256i *)state[x], a[x]);
+  }
+}
+
+INTERNAL otrng_bool otrng_keccak_x4_available(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? otrng_true : otrng_false;
+}
+
+INTERNAL void otrng_keccak_x4_permute(keccak_x4_state state) {
+  permute_avx2(state);
+}
+
+#else
+
+INTERNAL otrng_bool otrng_keccak_x4_available(void) { return otrng_false; }
+
+INTERNAL void otrng_keccak_x4_permute(keccak_x4_state state) { (void)state; }
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Four Keccak-f[1600] permutations run side by side, for SHAKE computations
+ * that do not depend on each other. Only built for x86 with AVX2, and only
+ * used when the CPU has it; otrng_keccak_x4_available tells.
+ */
+
+#ifndef OTRNG_KECCAK_X4_H
+#define OTRNG_KECCAK_X4_H
+
+#include <stdint.h>
+
+#include "error.h"
+#include "shared.h"
+
+/* Word i of the state of lane l is at [i][l] */
+typedef uint64_t keccak_x4_state[25][4];
+
+/**
+ * @brief Whether otrng_keccak_x4_permute can run on this machine.
+ */
+INTERNAL otrng_bool otrng_keccak_x4_available(void);
+
+/**
+ * @brief Applies Keccak-f[1600] to each of the four states. Must only be
+ * called if otrng_keccak_x4_available.
+ *
+ * @param [state] The states.
+ */
+INTERNAL void otrng_keccak_x4_permute(keccak_x4_state state);
+
+#endif
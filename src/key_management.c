@@ -59,6 +59,7 @@ INTERNAL void otrng_key_manager_init(key_manager_s *manager) {
   manager->our_dh = otrng_secure_alloc(sizeof(dh_keypair_s));
   manager->our_dh->pub = NULL;
   manager->our_dh->priv = NULL;
+  manager->skipped_keys = otrng_skipped_keys_store_new();
 }
 
 INTERNAL key_manager_s *otrng_key_manager_new(void) {
@@ -93,11 +94,13 @@ INTERNAL void otrng_key_manager_destroy(key_manager_s *manager) {
   manager->ssid_half_first = otrng_false;
   otrng_secure_wipe(manager->extra_symmetric_key, EXTRA_SYMMETRIC_KEY_BYTES);
 
-  otrng_list_free(manager->skipped_keys, otrng_secure_free);
+  otrng_skipped_keys_store_free(manager->skipped_keys);
   manager->skipped_keys = NULL;
 
-  otrng_list_free(manager->old_mac_keys, otrng_secure_free);
+  otrng_forget_old_mac_keys(manager);
+  otrng_secure_free(manager->old_mac_keys);
   manager->old_mac_keys = NULL;
+  manager->old_mac_keys_capacity = 0;
 
   otrng_secure_wipe(manager, sizeof(key_manager_s));
 }
@@ -138,6 +141,9 @@ otrng_receiving_ratchet_new(key_manager_s *manager) {
          EXTRA_SYMMETRIC_KEY_BYTES);
 
   ratchet->skipped_keys = manager->skipped_keys;
+  ratchet->skipped_keys_mark =
+      otrng_skipped_keys_store_mark(manager->skipped_keys);
+  ratchet->used_skipped_key = NULL;
 
   return ratchet;
 }
@@ -152,7 +158,8 @@ tstatic void otrng_key_manager_set_their_keys(ec_point their_ecdh,
 }
 
 INTERNAL void otrng_receiving_ratchet_copy(key_manager_s *dst,
-                                           receiving_ratchet_s *src) {
+                                           receiving_ratchet_s *src,
+                                           unsigned int max_stored_keys) {
   if (!dst || !src) {
     return;
   }
@@ -174,7 +181,13 @@ INTERNAL void otrng_receiving_ratchet_copy(key_manager_s *dst,
   memcpy(dst->extra_symmetric_key, src->extra_symmetric_key,
          EXTRA_SYMMETRIC_KEY_BYTES);
 
-  dst->skipped_keys = src->skipped_keys;
+  /* Keep the keys stored while receiving, and forget the one used */
+  if (src->used_skipped_key) {
+    otrng_skipped_keys_store_remove(src->skipped_keys, src->used_skipped_key);
+    src->used_skipped_key = NULL;
+  }
+  otrng_skipped_keys_store_evict(src->skipped_keys, max_stored_keys);
+  src->skipped_keys_mark = otrng_skipped_keys_store_mark(src->skipped_keys);
 }
 
 INTERNAL void otrng_receiving_ratchet_destroy(receiving_ratchet_s *ratchet) {
@@ -194,6 +207,10 @@ INTERNAL void otrng_receiving_ratchet_destroy(receiving_ratchet_s *ratchet) {
   otrng_secure_wipe(ratchet->chain_r, CHAIN_KEY_BYTES);
   otrng_secure_wipe(ratchet->extra_symmetric_key, EXTRA_SYMMETRIC_KEY_BYTES);
 
+  /* Forget the keys stored by a ratchet that was never copied */
+  otrng_skipped_keys_store_rollback(ratchet->skipped_keys,
+                                    ratchet->skipped_keys_mark);
+
   otrng_secure_free(ratchet);
 }
 
@@ -219,24 +236,18 @@ INTERNAL void otrng_key_manager_set_their_dh(const dh_public_key their_dh,
 
 INTERNAL otrng_result
 otrng_key_manager_generate_ephemeral_keys(key_manager_s *manager) {
-  time_t now;
-  uint8_t *sym = otrng_secure_alloc(ED448_PRIVATE_BYTES);
-
-  random_bytes(sym, ED448_PRIVATE_BYTES);
+  time_t now = time(NULL);
 
-  now = time(NULL);
   otrng_ecdh_keypair_destroy(manager->our_ecdh);
   /* @secret the ecdh keypair will last
      1. for the first generation: until the ratchet is initialized
      2. when receiving a new dh ratchet
   */
-  if (!otrng_ecdh_keypair_generate(manager->our_ecdh, sym)) {
-    otrng_secure_free(sym);
+  if (!otrng_keypair_pool_take_ecdh(manager->our_ecdh,
+                                    manager->keypair_pool)) {
     return OTRNG_ERROR;
   }
 
-  otrng_secure_free(sym);
-
   manager->last_generated = now;
 
   if (manager->i % 3 == 0) {
@@ -246,7 +257,7 @@ otrng_key_manager_generate_ephemeral_keys(key_manager_s *manager) {
        1. for the first generation: until the ratchet is initialized
        2. when receiving a new dh ratchet
     */
-    if (!otrng_dh_keypair_generate(manager->our_dh)) {
+    if (!otrng_keypair_pool_take_dh(manager->our_dh, manager->keypair_pool)) {
       return OTRNG_ERROR;
     }
   }
@@ -835,129 +846,41 @@ static uint8_t usage_message_key = 0x17;
 static uint8_t usage_mac_key = 0x18;
 static uint8_t usage_extra_symm_key = 0x19;
 
-static otrng_result
-derive_next_chain_key(key_manager_s *manager,
-                      receiving_ratchet_s *tmp_receiving_ratchet,
-                      const char action) {
-  /* chain_key_s[i-1][j+1] = KDF_1(usage_next_chain_key || chain_key_s[i-1][j],
-   * 64) */
-  assert(action == 's' || action == 'r');
-  if (action == 's') {
-    if (!shake_256_kdf1(manager->current->chain_s, CHAIN_KEY_BYTES,
-                        usage_next_chain_key, manager->current->chain_s,
-                        CHAIN_KEY_BYTES)) {
-      return OTRNG_ERROR;
-    }
-
-  } else if (action == 'r') {
-    if (!shake_256_kdf1(tmp_receiving_ratchet->chain_r, CHAIN_KEY_BYTES,
-                        usage_next_chain_key, tmp_receiving_ratchet->chain_r,
-                        CHAIN_KEY_BYTES)) {
-      return OTRNG_ERROR;
-    }
-  }
+tstatic otrng_result derive_from_chain_key(k_msg_enc enc_key,
+                                           uint8_t *extra_key,
+                                           uint8_t *next_chain_key,
+                                           const uint8_t *chain_key) {
+  uint8_t extra_key_values[1 + CHAIN_KEY_BYTES];
+  otrng_result result;
 
-  return OTRNG_SUCCESS;
-}
-
-static otrng_result derive_encryption_and_mac_keys(
-    k_msg_enc enc_key, k_msg_mac mac_key, key_manager_s *manager,
-    receiving_ratchet_s *tmp_receiving_ratchet, const char action) {
-  assert(action == 's' || action == 'r');
-
-  /* MKenc, MKmac = derive_enc_mac_keys(chain_key_s[i-1][j])
-     MKenc = KDF_1(usage_message_key || chain_key, 64)
-     MKmac = KDF_1(usage_mac_key || MKenc, 64)
+  /* MKenc = KDF_1(usage_message_key || chain_key, 64)
+     extra_symm_key = KDF_1(usage_extra_symm_key || 0xFF || chain_key, 64)
+     next_chain_key = KDF_1(usage_next_chain_key || chain_key, 64)
   */
-  if (action == 's') {
-    if (!shake_256_kdf1(enc_key, ENC_KEY_BYTES, usage_message_key,
-                        manager->current->chain_s, CHAIN_KEY_BYTES)) {
-      return OTRNG_ERROR;
-    }
-  } else if (action == 'r') {
-    if (!shake_256_kdf1(enc_key, ENC_KEY_BYTES, usage_message_key,
-                        tmp_receiving_ratchet->chain_r, CHAIN_KEY_BYTES)) {
-      return OTRNG_ERROR;
-    }
-  }
+  const shake_kdf_s kdfs[] = {
+      {enc_key, ENC_KEY_BYTES, usage_message_key, chain_key, CHAIN_KEY_BYTES},
+      {extra_key, EXTRA_SYMMETRIC_KEY_BYTES, usage_extra_symm_key,
+       extra_key_values, sizeof(extra_key_values)},
+      {next_chain_key, CHAIN_KEY_BYTES, usage_next_chain_key, chain_key,
+       CHAIN_KEY_BYTES},
+  };
 
-  if (!shake_256_kdf1(mac_key, MAC_KEY_BYTES, usage_mac_key, enc_key,
-                      ENC_KEY_BYTES)) {
-    return OTRNG_ERROR;
-  }
+  extra_key_values[0] = 0xFF;
+  memcpy(extra_key_values + 1, chain_key, CHAIN_KEY_BYTES);
 
-  return OTRNG_SUCCESS;
-}
+  result = shake_256_kdf1_batch(kdfs, sizeof(kdfs) / sizeof(shake_kdf_s));
+  otrng_secure_wipe(extra_key_values, sizeof(extra_key_values));
 
-tstatic otrng_result calculate_extra_key(
-    key_manager_s *manager, receiving_ratchet_s *tmp_receiving_ratchet,
-    const char action) {
-  goldilocks_shake256_ctx_p hd;
-  uint8_t *extra_key_buffer = otrng_secure_alloc(EXTRA_SYMMETRIC_KEY_BYTES);
-  uint8_t magic[1] = {0xFF};
-
-  if (!hash_init_with_usage(hd, usage_extra_symm_key)) {
-    otrng_secure_free(extra_key_buffer);
-    return OTRNG_ERROR;
-  }
-
-  if (hash_update(hd, magic, 1) == GOLDILOCKS_FAILURE) {
-    hash_destroy(hd);
-    otrng_secure_free(extra_key_buffer);
-    return OTRNG_ERROR;
-  }
-
-  /* extra_symm_key = KDF_1(usage_extra_symm_key || 0xFF || chain_key_s[i-1][j],
-   * 64) */
-  assert(action == 's' || action == 'r');
-  if (action == 's') {
-    if (hash_update(hd, manager->current->chain_s, CHAIN_KEY_BYTES) ==
-        GOLDILOCKS_FAILURE) {
-      hash_destroy(hd);
-      otrng_secure_free(extra_key_buffer);
-      return OTRNG_ERROR;
-    }
-
-    hash_final(hd, extra_key_buffer, EXTRA_SYMMETRIC_KEY_BYTES);
-    hash_destroy(hd);
-
-    memcpy(manager->extra_symmetric_key, extra_key_buffer,
-           EXTRA_SYMMETRIC_KEY_BYTES);
-  } else if (action == 'r') {
-    if (hash_update(hd, tmp_receiving_ratchet->chain_r, CHAIN_KEY_BYTES) ==
-        GOLDILOCKS_FAILURE) {
-      hash_destroy(hd);
-      otrng_secure_wipe(extra_key_buffer, EXTRA_SYMMETRIC_KEY_BYTES);
-      otrng_free(extra_key_buffer);
-      return OTRNG_ERROR;
-    }
-
-    hash_final(hd, extra_key_buffer, EXTRA_SYMMETRIC_KEY_BYTES);
-    hash_destroy(hd);
-
-    memcpy(tmp_receiving_ratchet->extra_symmetric_key, extra_key_buffer,
-           EXTRA_SYMMETRIC_KEY_BYTES);
-  }
-  otrng_secure_free(extra_key_buffer);
-
-// TODO: add to tmp
-#ifdef DEBUG
-  debug_print("\n");
-  debug_print("EXTRA KEY = ");
-  otrng_memdump(manager->extra_symmetric_key, EXTRA_SYMMETRIC_KEY_BYTES);
-#endif
-
-  return OTRNG_SUCCESS;
+  return result;
 }
 
 tstatic otrng_result store_enc_keys(
     k_msg_enc enc_key, receiving_ratchet_s *tmp_receiving_ratchet,
     const uint32_t until, const unsigned int max_skip, const char ratchet_type,
     const otrng_client_callbacks_s *cb, key_manager_s *manager) {
-  goldilocks_shake256_ctx_p hd;
   uint8_t *extra_key = otrng_secure_alloc(EXTRA_SYMMETRIC_KEY_BYTES);
-  uint8_t magic[1] = {0xFF};
-  skipped_keys_s *skipped_msg_enc_key;
+  uint8_t next_chain_key[CHAIN_KEY_BYTES];
+  uint8_t their_ecdh[ED448_POINT_BYTES];
 
   if ((tmp_receiving_ratchet->k + max_skip) < until) {
     otrng_client_callbacks_handle_event(cb,
@@ -967,72 +890,47 @@ tstatic otrng_result store_enc_keys(
     return OTRNG_SUCCESS;
   }
 
-  if (!otrng_bool_is_true(otrng_is_empty_array(tmp_receiving_ratchet->chain_r,
-                                               CHAIN_KEY_BYTES))) {
-    while (tmp_receiving_ratchet->k < until) {
-      if (!shake_256_kdf1(enc_key, ENC_KEY_BYTES, usage_message_key,
-                          tmp_receiving_ratchet->chain_r, CHAIN_KEY_BYTES)) {
-        otrng_secure_free(extra_key);
-        return OTRNG_ERROR;
-      }
-
-      if (!hash_init_with_usage(hd, usage_extra_symm_key)) {
-        otrng_secure_free(extra_key);
-        return OTRNG_ERROR;
-      }
-
-      if (hash_update(hd, magic, 1) == GOLDILOCKS_FAILURE) {
-        hash_destroy(hd);
-        otrng_secure_free(extra_key);
-        return OTRNG_ERROR;
-      }
-
-      if (hash_update(hd, tmp_receiving_ratchet->chain_r, CHAIN_KEY_BYTES) ==
-          GOLDILOCKS_FAILURE) {
-        hash_destroy(hd);
-        otrng_secure_free(extra_key);
-        return OTRNG_ERROR;
-      }
-
-      hash_final(hd, extra_key, EXTRA_SYMMETRIC_KEY_BYTES);
-      hash_destroy(hd);
-
-      if (!shake_256_kdf1(tmp_receiving_ratchet->chain_r, CHAIN_KEY_BYTES,
-                          usage_next_chain_key, tmp_receiving_ratchet->chain_r,
-                          CHAIN_KEY_BYTES)) {
-        otrng_secure_free(extra_key);
-        return OTRNG_ERROR;
-      }
-
-      skipped_msg_enc_key = otrng_secure_alloc(sizeof(skipped_keys_s));
-
-      assert(ratchet_type == 'd' || ratchet_type == 'c');
+  if (tmp_receiving_ratchet->k >= until ||
+      otrng_bool_is_true(otrng_is_empty_array(tmp_receiving_ratchet->chain_r,
+                                              CHAIN_KEY_BYTES))) {
+    otrng_secure_free(extra_key);
+    return OTRNG_SUCCESS;
+  }
 
-      if (ratchet_type == 'd') {
-        otrng_ec_point_copy(skipped_msg_enc_key->their_ecdh,
-                            manager->their_ecdh);
-      } else if (ratchet_type == 'c') {
-        otrng_ec_point_copy(skipped_msg_enc_key->their_ecdh,
-                            tmp_receiving_ratchet->their_ecdh);
-      }
+  /* Every key stored here belongs to the same ratchet, so its ECDH key is
+   * encoded only once */
+  assert(ratchet_type == 'd' || ratchet_type == 'c');
+  if (!otrng_ec_point_encode(their_ecdh, ED448_POINT_BYTES,
+                             ratchet_type == 'd'
+                                 ? manager->their_ecdh
+                                 : tmp_receiving_ratchet->their_ecdh)) {
+    otrng_secure_free(extra_key);
+    return OTRNG_ERROR;
+  }
 
-      skipped_msg_enc_key->k = tmp_receiving_ratchet->k;
-
-      memcpy(skipped_msg_enc_key->extra_symmetric_key, extra_key,
-             EXTRA_SYMMETRIC_KEY_BYTES);
-      memcpy(skipped_msg_enc_key->enc_key, enc_key, ENC_KEY_BYTES);
-
-      /*
-         @secret: should be deleted when:
-         1. session expired
-         2. the key is retrieved
-      */
-      tmp_receiving_ratchet->skipped_keys = otrng_list_add(
-          skipped_msg_enc_key, tmp_receiving_ratchet->skipped_keys);
-      otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
-      tmp_receiving_ratchet->k++;
+  while (tmp_receiving_ratchet->k < until) {
+    if (!derive_from_chain_key(enc_key, extra_key, next_chain_key,
+                               tmp_receiving_ratchet->chain_r)) {
+      otrng_secure_wipe(next_chain_key, CHAIN_KEY_BYTES);
+      otrng_secure_free(extra_key);
+      return OTRNG_ERROR;
     }
+    memcpy(tmp_receiving_ratchet->chain_r, next_chain_key, CHAIN_KEY_BYTES);
+
+    /*
+       @secret: should be deleted when:
+       1. session expired
+       2. the key is retrieved
+       3. the store is full and this is the oldest key, once the message is
+          known to be valid (see otrng_receiving_ratchet_copy)
+    */
+    otrng_skipped_keys_store_add(tmp_receiving_ratchet->skipped_keys,
+                                 their_ecdh, tmp_receiving_ratchet->k, enc_key,
+                                 extra_key);
+    otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
+    tmp_receiving_ratchet->k++;
   }
+  otrng_secure_wipe(next_chain_key, CHAIN_KEY_BYTES);
   otrng_secure_free(extra_key);
 
   return OTRNG_SUCCESS;
@@ -1046,43 +944,48 @@ INTERNAL otrng_result otrng_key_get_skipped_keys(
     k_msg_enc enc_key, k_msg_mac mac_key, ec_point msg_ecdh,
     unsigned int msg_id, key_manager_s *manager,
     receiving_ratchet_s *tmp_receiving_ratchet) {
-  list_element_s *current = tmp_receiving_ratchet->skipped_keys;
+  uint8_t their_ecdh[ED448_POINT_BYTES];
+  skipped_keys_s *skipped_keys;
   (void)manager;
 
-  while (current) {
-    skipped_keys_s *skipped_keys = current->data;
+  /* This is not an actual error, it is just that the key we need was not
+  skipped */
+  if (otrng_skipped_keys_store_len(tmp_receiving_ratchet->skipped_keys) == 0) {
+    return OTRNG_ERROR;
+  }
 
-    if ((goldilocks_448_point_eq(msg_ecdh, skipped_keys->their_ecdh) ==
-         GOLDILOCKS_TRUE) &&
-        skipped_keys->k == msg_id) {
-      memcpy(enc_key, skipped_keys->enc_key, ENC_KEY_BYTES);
-      if (!shake_256_kdf1(mac_key, MAC_KEY_BYTES, usage_mac_key, enc_key,
-                          ENC_KEY_BYTES)) {
-        return OTRNG_ERROR;
-      }
+  if (!otrng_ec_point_encode(their_ecdh, ED448_POINT_BYTES, msg_ecdh)) {
+    return OTRNG_ERROR;
+  }
 
-      memcpy(tmp_receiving_ratchet->extra_symmetric_key,
-             skipped_keys->extra_symmetric_key, EXTRA_SYMMETRIC_KEY_BYTES);
+  skipped_keys = otrng_skipped_keys_store_get(
+      tmp_receiving_ratchet->skipped_keys, their_ecdh, msg_id);
+  if (!skipped_keys) {
+    return OTRNG_ERROR;
+  }
 
-      tmp_receiving_ratchet->skipped_keys = otrng_list_remove_element(
-          current, tmp_receiving_ratchet->skipped_keys);
-      otrng_list_free(current, otrng_secure_free);
+  memcpy(enc_key, skipped_keys->enc_key, ENC_KEY_BYTES);
+  if (!shake_256_kdf1(mac_key, MAC_KEY_BYTES, usage_mac_key, enc_key,
+                      ENC_KEY_BYTES)) {
+    return OTRNG_ERROR;
+  }
 
-      return OTRNG_SUCCESS;
-    }
+  memcpy(tmp_receiving_ratchet->extra_symmetric_key,
+         skipped_keys->extra_symmetric_key, EXTRA_SYMMETRIC_KEY_BYTES);
 
-    current = current->next;
-  }
+  /* The key is deleted once the message is known to be valid, see
+   * otrng_receiving_ratchet_copy */
+  tmp_receiving_ratchet->used_skipped_key = skipped_keys;
 
-  /* This is not an actual error, it is just that the key we need was not
-  skipped */
-  return OTRNG_ERROR;
+  return OTRNG_SUCCESS;
 }
 
 INTERNAL otrng_result otrng_key_manager_derive_chain_keys(
     k_msg_enc enc_key, k_msg_mac mac_key, key_manager_s *manager,
     receiving_ratchet_s *tmp_receiving_ratchet, unsigned int max_skip,
     uint32_t msg_id, const char action, const otrng_client_callbacks_s *cb) {
+  uint8_t *chain_key, *extra_key;
+  uint8_t next_chain_key[CHAIN_KEY_BYTES];
 
   assert(action == 's' || action == 'r');
   if (action == 'r') {
@@ -1092,19 +995,28 @@ INTERNAL otrng_result otrng_key_manager_derive_chain_keys(
     }
   }
 
-  /* @secret should be deleted after being used to encrypt and mac the message
-   */
-  if (!derive_encryption_and_mac_keys(enc_key, mac_key, manager,
-                                      tmp_receiving_ratchet, action)) {
-    return OTRNG_ERROR;
+  if (action == 's') {
+    chain_key = manager->current->chain_s;
+    extra_key = manager->extra_symmetric_key;
+  } else {
+    chain_key = tmp_receiving_ratchet->chain_r;
+    extra_key = tmp_receiving_ratchet->extra_symmetric_key;
   }
 
-  if (!calculate_extra_key(manager, tmp_receiving_ratchet, action)) {
+  /* @secret should be deleted after being used to encrypt and mac the message
+   */
+  if (!derive_from_chain_key(enc_key, extra_key, next_chain_key, chain_key)) {
+    otrng_secure_wipe(next_chain_key, CHAIN_KEY_BYTES);
     return OTRNG_ERROR;
   }
 
   /* @secret should be deleted when the new chain key is derived */
-  if (!derive_next_chain_key(manager, tmp_receiving_ratchet, action)) {
+  memcpy(chain_key, next_chain_key, CHAIN_KEY_BYTES);
+  otrng_secure_wipe(next_chain_key, CHAIN_KEY_BYTES);
+
+  /* MKmac = KDF_1(usage_mac_key || MKenc, 64) */
+  if (!shake_256_kdf1(mac_key, MAC_KEY_BYTES, usage_mac_key, enc_key,
+                      ENC_KEY_BYTES)) {
     return OTRNG_ERROR;
   }
 
@@ -1153,49 +1065,66 @@ INTERNAL otrng_result otrng_key_manager_derive_dh_ratchet_keys(
 
 INTERNAL otrng_result otrng_store_old_mac_keys(key_manager_s *manager,
                                                k_msg_mac mac_key) {
-  uint8_t *to_store_mac = otrng_secure_alloc(MAC_KEY_BYTES);
+  if (manager->num_old_mac_keys == manager->old_mac_keys_capacity) {
+    size_t capacity = manager->old_mac_keys_capacity
+                          ? manager->old_mac_keys_capacity * 2
+                          : OLD_MAC_KEYS_INITIAL_CAPACITY;
+    uint8_t *grown = otrng_secure_alloc_array(capacity, MAC_KEY_BYTES);
+
+    if (manager->old_mac_keys) {
+      memcpy(grown, manager->old_mac_keys,
+             manager->num_old_mac_keys * MAC_KEY_BYTES);
+      otrng_secure_wipe(manager->old_mac_keys,
+                        manager->old_mac_keys_capacity * MAC_KEY_BYTES);
+      otrng_secure_free(manager->old_mac_keys);
+    }
 
-  memcpy(to_store_mac, mac_key, ENC_KEY_BYTES);
-  manager->old_mac_keys = otrng_list_add(to_store_mac, manager->old_mac_keys);
+    manager->old_mac_keys = grown;
+    manager->old_mac_keys_capacity = capacity;
+  }
+
+  memcpy(manager->old_mac_keys + manager->num_old_mac_keys * MAC_KEY_BYTES,
+         mac_key, MAC_KEY_BYTES);
+  manager->num_old_mac_keys++;
 
   return OTRNG_SUCCESS;
 }
 
+INTERNAL void otrng_forget_old_mac_keys(key_manager_s *manager) {
+  if (manager->old_mac_keys) {
+    otrng_secure_wipe(manager->old_mac_keys,
+                      manager->num_old_mac_keys * MAC_KEY_BYTES);
+  }
+  manager->num_old_mac_keys = 0;
+}
+
 INTERNAL /*@null@*/ uint8_t *
 otrng_reveal_mac_keys_on_tlv(key_manager_s *manager) {
-  size_t num_stored_keys = otrng_list_len(manager->skipped_keys);
-  size_t serlen = num_stored_keys * MAC_KEY_BYTES;
+  size_t num_stored_keys = otrng_skipped_keys_store_len(manager->skipped_keys);
   uint8_t *ser_mac_keys;
-  k_msg_mac mac_key;
-  k_msg_enc enc_key;
-  size_t i;
-
-  if (serlen != 0) {
-    ser_mac_keys = otrng_secure_alloc(serlen);
-
-    memset(enc_key, 0, ENC_KEY_BYTES);
-    memset(mac_key, 0, MAC_KEY_BYTES);
-
-    for (i = 0; i < num_stored_keys; i++) {
-      list_element_s *last = otrng_list_get_last(manager->skipped_keys);
-      skipped_keys_s *skipped_keys = last->data;
-      memcpy(enc_key, skipped_keys->enc_key, ENC_KEY_BYTES);
+  uint8_t *cursor;
+  skipped_keys_s *skipped_keys;
 
-      if (!shake_256_kdf1(mac_key, MAC_KEY_BYTES, usage_mac_key, enc_key,
-                          ENC_KEY_BYTES)) {
-        otrng_secure_free(ser_mac_keys);
-        return NULL;
-      }
+  if (num_stored_keys == 0) {
+    return NULL;
+  }
 
-      memcpy(ser_mac_keys + i * MAC_KEY_BYTES, mac_key, MAC_KEY_BYTES);
-      manager->skipped_keys =
-          otrng_list_remove_element(last, manager->skipped_keys);
-      otrng_list_free(last, otrng_secure_free);
+  ser_mac_keys = otrng_secure_alloc_array(num_stored_keys, MAC_KEY_BYTES);
+  cursor = ser_mac_keys;
+
+  /* Newest first, derived straight into the output buffer */
+  for (skipped_keys = manager->skipped_keys->newest; skipped_keys;
+       skipped_keys = skipped_keys->older) {
+    if (!shake_256_kdf1(cursor, MAC_KEY_BYTES, usage_mac_key,
+                        skipped_keys->enc_key, ENC_KEY_BYTES)) {
+      otrng_secure_wipe(ser_mac_keys, num_stored_keys * MAC_KEY_BYTES);
+      otrng_secure_free(ser_mac_keys);
+      return NULL;
     }
-    otrng_list_free_nodes(manager->skipped_keys);
-
-    return ser_mac_keys;
+    cursor += MAC_KEY_BYTES;
   }
 
-  return NULL;
+  otrng_skipped_keys_store_clear(manager->skipped_keys);
+
+  return ser_mac_keys;
 }
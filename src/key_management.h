@@ -32,9 +32,13 @@
 #include "constants.h"
 #include "dh.h"
 #include "ed448.h"
+#include "keypair_pool.h"
 #include "keys.h"
 #include "list.h"
 #include "shared.h"
+#include "skipped_keys.h"
+
+#define OLD_MAC_KEYS_INITIAL_CAPACITY 8
 
 /* the different kind of keys for the key management */
 typedef uint8_t k_brace[BRACE_KEY_BYTES];
@@ -55,14 +59,6 @@ typedef struct ratchet_s {
   k_receiving_chain chain_r;
 } ratchet_s;
 
-/* the list of stored message and extra symmetric keys */
-typedef struct skipped_keys_s {
-  ec_point their_ecdh; /* Current their_ecdh key */
-  uint32_t k;          /* Counter of the receiving messages */
-  k_extra_symmetric extra_symmetric_key;
-  k_msg_enc enc_key;
-} skipped_keys_s;
-
 /* a temporary structure used to hold the values of the receiving ratchet */
 typedef struct receiving_ratchet_s {
   ec_scalar our_ecdh_priv;
@@ -83,7 +79,11 @@ typedef struct receiving_ratchet_s {
 
   k_extra_symmetric extra_symmetric_key;
 
-  list_element_s *skipped_keys;
+  /* borrowed from the key manager: keys stored after skipped_keys_mark are
+   * rolled back when the ratchet is destroyed without being copied */
+  skipped_keys_store_s *skipped_keys;
+  uint64_t skipped_keys_mark;
+  /*@null@*/ skipped_keys_s *used_skipped_key;
 } receiving_ratchet_s;
 
 /* represents the different values needed for key management */
@@ -117,10 +117,18 @@ typedef struct key_manager_s {
   k_extra_symmetric extra_symmetric_key;
   uint8_t tmp_key[HASH_BYTES];
 
-  list_element_s *skipped_keys;
-  list_element_s *old_mac_keys;
+  skipped_keys_store_s *skipped_keys;
+
+  /* MAC keys of received messages, oldest first, to be revealed on the next
+   * DH ratchet. The buffer is kept across reveals. */
+  uint8_t *old_mac_keys;
+  size_t num_old_mac_keys;
+  size_t old_mac_keys_capacity;
 
   time_t last_generated;
+
+  /* Where new ephemeral keypairs are taken from. Not owned, and can be NULL. */
+  keypair_pool_s *keypair_pool;
 } key_manager_s;
 
 /*
@@ -171,13 +179,17 @@ INTERNAL /*@null@*/ receiving_ratchet_s *
 otrng_receiving_ratchet_new(key_manager_s *manager);
 
 /**
- * @brief Copy a temporary receiving ratchet into the key manager.
+ * @brief Copy a temporary receiving ratchet into the key manager, once the
+ * message it was created for is known to be valid. This is when the skipped
+ * keys over [max_stored_keys] are evicted.
  *
- * @param [dst]   The key manager.
- * @param [src]   The receiving ratchet.
+ * @param [dst]              The key manager.
+ * @param [src]              The receiving ratchet.
+ * @param [max_stored_keys]  The maximum number of stored skipped keys.
  */
 INTERNAL void otrng_receiving_ratchet_copy(key_manager_s *dst,
-                                           receiving_ratchet_s *src);
+                                           receiving_ratchet_s *src,
+                                           unsigned int max_stored_keys);
 
 /**
  * @brief Destroy a temporary receiving ratchet to be used to prevent a ratchet
@@ -217,7 +229,8 @@ INTERNAL void otrng_key_manager_set_their_dh(const dh_public_key their_dh,
                                              key_manager_s *manager);
 
 /**
- * @brief Generate the ephemeral ecdh and dh keys.
+ * @brief Generate the ephemeral ecdh and dh keys, or take them from the
+ * manager's keypair pool when it has one.
  *
  * @param [manager]   The key manager.
  */
@@ -335,6 +348,22 @@ INTERNAL otrng_result otrng_key_manager_derive_dh_ratchet_keys(
 INTERNAL otrng_result otrng_store_old_mac_keys(key_manager_s *manager,
                                                k_msg_mac mac_key);
 
+/**
+ * @brief Wipes the stored old mac keys. The buffer is kept for reuse.
+ *
+ * @param [manager]   The key manager.
+ */
+INTERNAL void otrng_forget_old_mac_keys(key_manager_s *manager);
+
+/**
+ * @brief Derives the mac keys of every skipped message key, newest first,
+ * and forgets the skipped keys.
+ *
+ * @param [manager]   The key manager.
+ *
+ * @return The serialized mac keys, or NULL if there are none. The caller owns
+ * the buffer and must free it with otrng_secure_free.
+ */
 INTERNAL /*@null@*/ uint8_t *
 otrng_reveal_mac_keys_on_tlv(key_manager_s *manager);
 
@@ -367,14 +396,32 @@ tstatic otrng_result key_manager_derive_ratchet_keys(
 tstatic otrng_result calculate_ssid(key_manager_s *manager);
 
 /**
- * @brief Calculate the extra symmetric key.
+ * @brief Derive the message key, the extra symmetric key and the next chain
+ * key from a chain key, all at once.
  *
- * @param [manager]   The key manager.
- * @param [action]    's' for sending chain, 'r' for receiving
+ * @param [enc_key]        The message key.
+ * @param [extra_key]      The extra symmetric key.
+ * @param [next_chain_key] The next chain key. Must not be [chain_key].
+ * @param [chain_key]      The chain key.
  */
-tstatic otrng_result calculate_extra_key(
-    key_manager_s *manager, receiving_ratchet_s *tmp_receiving_ratchet,
-    const char action);
+tstatic otrng_result derive_from_chain_key(k_msg_enc enc_key,
+                                           uint8_t *extra_key,
+                                           uint8_t *next_chain_key,
+                                           const uint8_t *chain_key);
+
+/**
+ * @brief Store the message keys of the messages skipped in the receiving
+ * chain, up to the message [until].
+ *
+ * @param [tmp_receiving_ratchet] The receiving ratchet.
+ * @param [max_skip]              The maximum number of enc_keys to be stored.
+ * @param [ratchet_type]          'd' for the previous DH ratchet, 'c' for the
+ *                                current chain.
+ */
+tstatic otrng_result store_enc_keys(
+    k_msg_enc enc_key, receiving_ratchet_s *tmp_receiving_ratchet,
+    const uint32_t until, const unsigned int max_skip, const char ratchet_type,
+    const otrng_client_callbacks_s *cb, key_manager_s *manager);
 
 #endif
 
@@ -0,0 +1,313 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "keypair_pool.h"
+#include "random.h"
+
+INTERNAL keypair_pool_s *otrng_keypair_pool_new(size_t depth) {
+  keypair_pool_s *pool = otrng_xmalloc_z(sizeof(keypair_pool_s));
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pool->num_threads = 1;
+  otrng_keypair_pool_set_depth(pool, depth);
+
+  return pool;
+}
+
+INTERNAL void otrng_keypair_pool_free(keypair_pool_s *pool) {
+  if (!pool) {
+    return;
+  }
+
+  otrng_keypair_pool_set_depth(pool, 0);
+  pthread_mutex_destroy(&pool->lock);
+  otrng_free(pool);
+}
+
+/* Moves the first [count] entries of [entries] to a newly allocated array of
+   [depth] entries. The old array is wiped when freed. */
+static void *resize_entries(void *entries, size_t count, size_t depth,
+                            size_t size) {
+  void *result = NULL;
+
+  if (depth > 0) {
+    result = otrng_secure_alloc_array(depth, size);
+    if (count > 0) {
+      memcpy(result, entries, count * size);
+    }
+  }
+
+  if (entries) {
+    otrng_secure_free(entries);
+  }
+
+  return result;
+}
+
+INTERNAL void otrng_keypair_pool_set_depth(keypair_pool_s *pool,
+                                           size_t depth) {
+  pthread_mutex_lock(&pool->lock);
+
+  while (pool->num_ecdh > depth) {
+    otrng_ecdh_keypair_destroy(&pool->ecdh[--pool->num_ecdh]);
+  }
+
+  while (pool->num_dh > depth) {
+    otrng_dh_keypair_destroy(&pool->dh[--pool->num_dh]);
+  }
+
+  if (depth != pool->depth) {
+    pool->ecdh = resize_entries(pool->ecdh, pool->num_ecdh, depth,
+                                sizeof(ecdh_keypair_s));
+    pool->dh =
+        resize_entries(pool->dh, pool->num_dh, depth, sizeof(dh_keypair_s));
+    pool->depth = depth;
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static otrng_result generate_ecdh(ecdh_keypair_s *dst) {
+  uint8_t *sym = otrng_secure_alloc(ED448_PRIVATE_BYTES);
+  otrng_result result;
+
+  random_bytes(sym, ED448_PRIVATE_BYTES);
+  result = otrng_ecdh_keypair_generate(dst, sym);
+  otrng_secure_free(sym);
+
+  return result;
+}
+
+static otrng_bool ecdh_wanted(keypair_pool_s *pool) {
+  otrng_bool wanted;
+
+  pthread_mutex_lock(&pool->lock);
+  wanted = pool->num_ecdh < pool->depth;
+  pthread_mutex_unlock(&pool->lock);
+
+  return wanted;
+}
+
+static otrng_bool dh_wanted(keypair_pool_s *pool) {
+  otrng_bool wanted;
+
+  pthread_mutex_lock(&pool->lock);
+  wanted = pool->num_dh < pool->depth;
+  pthread_mutex_unlock(&pool->lock);
+
+  return wanted;
+}
+
+INTERNAL otrng_result otrng_keypair_pool_refill(keypair_pool_s *pool) {
+  ecdh_keypair_s ecdh;
+  dh_keypair_s dh;
+
+  /* The pool can be taken from, refilled or resized by another thread while
+     a keypair is being generated, so it is checked again before the keypair
+     is stored. */
+  while (ecdh_wanted(pool)) {
+    if (!generate_ecdh(&ecdh)) {
+      otrng_secure_wipe(&ecdh, sizeof(ecdh_keypair_s));
+      return OTRNG_ERROR;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->num_ecdh < pool->depth) {
+      pool->ecdh[pool->num_ecdh++] = ecdh;
+    } else {
+      otrng_ecdh_keypair_destroy(&ecdh);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+  otrng_secure_wipe(&ecdh, sizeof(ecdh_keypair_s));
+
+  while (dh_wanted(pool)) {
+    if (!otrng_dh_keypair_generate(&dh)) {
+      return OTRNG_ERROR;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->num_dh < pool->depth) {
+      pool->dh[pool->num_dh++] = dh;
+    } else {
+      otrng_dh_keypair_destroy(&dh);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return OTRNG_SUCCESS;
+}
+
+INTERNAL otrng_result otrng_keypair_pool_take_ecdh(ecdh_keypair_s *dst,
+                                                   keypair_pool_s *pool) {
+  if (pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->num_ecdh > 0) {
+      ecdh_keypair_s *entry = &pool->ecdh[--pool->num_ecdh];
+      *dst = *entry;
+      otrng_secure_wipe(entry, sizeof(ecdh_keypair_s));
+      pthread_mutex_unlock(&pool->lock);
+      return OTRNG_SUCCESS;
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return generate_ecdh(dst);
+}
+
+INTERNAL otrng_result otrng_keypair_pool_take_dh(dh_keypair_s *dst,
+                                                 keypair_pool_s *pool) {
+  if (pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->num_dh > 0) {
+      dh_keypair_s *entry = &pool->dh[--pool->num_dh];
+      *dst = *entry;
+      entry->priv = NULL;
+      entry->pub = NULL;
+      pthread_mutex_unlock(&pool->lock);
+      return OTRNG_SUCCESS;
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return otrng_dh_keypair_generate(dst);
+}
+
+INTERNAL void otrng_keypair_pool_set_threads(keypair_pool_s *pool,
+                                             unsigned int num_threads) {
+  pthread_mutex_lock(&pool->lock);
+  pool->num_threads = num_threads > 0 ? num_threads : 1;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* The share of a batch generated by one thread: the keypairs at [first],
+   [first] + [step], ... that were not taken from the pool. */
+typedef struct batch_worker_s {
+  pthread_t thread;
+  otrng_bool started;
+  ecdh_keypair_s *ecdh;
+  dh_keypair_s *dh;
+  size_t count;
+  size_t ecdh_taken;
+  size_t dh_taken;
+  size_t first;
+  size_t step;
+  otrng_result result;
+} batch_worker_s;
+
+static void *generate_batch(void *data) {
+  batch_worker_s *worker = data;
+  size_t i;
+
+  worker->result = OTRNG_SUCCESS;
+  for (i = worker->first; i < worker->count; i += worker->step) {
+    if (i >= worker->ecdh_taken && !generate_ecdh(&worker->ecdh[i])) {
+      worker->result = OTRNG_ERROR;
+      break;
+    }
+
+    if (i >= worker->dh_taken && !otrng_dh_keypair_generate(&worker->dh[i])) {
+      worker->result = OTRNG_ERROR;
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+INTERNAL otrng_result otrng_keypair_pool_take_batch(ecdh_keypair_s *ecdh,
+                                                    dh_keypair_s *dh,
+                                                    size_t count,
+                                                    keypair_pool_s *pool) {
+  size_t ecdh_taken = 0, dh_taken = 0;
+  size_t num_threads = 1;
+  batch_worker_s *workers;
+  otrng_result result = OTRNG_SUCCESS;
+  size_t i;
+
+  memset(dh, 0, count * sizeof(dh_keypair_s));
+
+  if (pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (ecdh_taken < count && pool->num_ecdh > 0) {
+      ecdh_keypair_s *entry = &pool->ecdh[--pool->num_ecdh];
+      ecdh[ecdh_taken++] = *entry;
+      otrng_secure_wipe(entry, sizeof(ecdh_keypair_s));
+    }
+    while (dh_taken < count && pool->num_dh > 0) {
+      dh_keypair_s *entry = &pool->dh[--pool->num_dh];
+      dh[dh_taken++] = *entry;
+      entry->priv = NULL;
+      entry->pub = NULL;
+    }
+    num_threads = pool->num_threads;
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  if (num_threads > count) {
+    num_threads = count > 0 ? count : 1;
+  }
+
+  workers = otrng_xmalloc_z(num_threads * sizeof(batch_worker_s));
+  for (i = 0; i < num_threads; i++) {
+    workers[i].ecdh = ecdh;
+    workers[i].dh = dh;
+    workers[i].count = count;
+    workers[i].ecdh_taken = ecdh_taken;
+    workers[i].dh_taken = dh_taken;
+    workers[i].first = i;
+    workers[i].step = num_threads;
+  }
+
+  /* The first share is generated by the calling thread, as is any share a
+     thread could not be started for. */
+  for (i = 1; i < num_threads; i++) {
+    workers[i].started = pthread_create(&workers[i].thread, NULL,
+                                        generate_batch, &workers[i]) == 0;
+  }
+
+  generate_batch(&workers[0]);
+  for (i = 1; i < num_threads; i++) {
+    if (workers[i].started) {
+      pthread_join(workers[i].thread, NULL);
+    } else {
+      generate_batch(&workers[i]);
+    }
+  }
+
+  for (i = 0; i < num_threads; i++) {
+    if (!workers[i].result) {
+      result = OTRNG_ERROR;
+    }
+  }
+  otrng_free(workers);
+
+  if (!result) {
+    for (i = 0; i < count; i++) {
+      otrng_ecdh_keypair_destroy(&ecdh[i]);
+      otrng_dh_keypair_destroy(&dh[i]);
+    }
+  }
+
+  return result;
+}
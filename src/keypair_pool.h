@@ -0,0 +1,129 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * A pool of pre-generated ephemeral ECDH and DH keypairs. Generating a 3072-bit
+ * DH keypair takes milliseconds, so instead of doing it when a message is sent
+ * the keypairs can be generated ahead of time, from otrng_poll or from a
+ * thread of the application, and handed out from here.
+ *
+ * Batches of keypairs, as needed to build prekey messages, can be generated
+ * by several threads at once.
+ *
+ * All functions in this file can be called concurrently on the same pool.
+ */
+
+#ifndef OTRNG_KEYPAIR_POOL_H
+#define OTRNG_KEYPAIR_POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "dh.h"
+#include "ed448.h"
+#include "shared.h"
+
+typedef struct keypair_pool_s {
+  pthread_mutex_t lock;
+  size_t depth; /* The number of keypairs of each kind to keep around */
+  unsigned int num_threads; /* The threads used to generate a batch */
+
+  ecdh_keypair_s *ecdh;
+  size_t num_ecdh;
+
+  dh_keypair_s *dh;
+  size_t num_dh;
+} keypair_pool_s;
+
+/**
+ * @brief Creates an empty pool.
+ *
+ * @param [depth] The number of keypairs of each kind the pool will be refilled
+ * to. A depth of 0 disables the pool: every keypair is then generated when it
+ * is taken.
+ */
+INTERNAL keypair_pool_s *otrng_keypair_pool_new(size_t depth);
+
+/**
+ * @brief Securely destroys all the keypairs still in the pool, and frees it.
+ */
+INTERNAL void otrng_keypair_pool_free(/*@only@*/ keypair_pool_s *pool);
+
+/**
+ * @brief Changes the depth of the pool. Keypairs that do not fit in the new
+ * depth are securely destroyed.
+ */
+INTERNAL void otrng_keypair_pool_set_depth(keypair_pool_s *pool, size_t depth);
+
+/**
+ * @brief Generates keypairs until the pool is full. The pool is not locked
+ * while the keypairs are generated, so it can be used by other threads in the
+ * meantime.
+ *
+ * @return OTRNG_ERROR if a keypair could not be generated.
+ */
+INTERNAL otrng_result otrng_keypair_pool_refill(keypair_pool_s *pool);
+
+/**
+ * @brief Takes an ECDH keypair from the pool, or generates one if the pool is
+ * empty.
+ *
+ * @param [dst]  Where the keypair is written. The caller owns it.
+ * @param [pool] The pool. Can be NULL, in which case a keypair is generated.
+ */
+INTERNAL otrng_result otrng_keypair_pool_take_ecdh(ecdh_keypair_s *dst,
+                                                   keypair_pool_s *pool);
+
+/**
+ * @brief Takes a DH keypair from the pool, or generates one if the pool is
+ * empty.
+ *
+ * @param [dst]  Where the keypair is written. The caller owns it.
+ * @param [pool] The pool. Can be NULL, in which case a keypair is generated.
+ */
+INTERNAL otrng_result otrng_keypair_pool_take_dh(dh_keypair_s *dst,
+                                                 keypair_pool_s *pool);
+
+/**
+ * @brief Sets the number of threads used by otrng_keypair_pool_take_batch.
+ * The default is 1, which generates the keypairs in the calling thread.
+ */
+INTERNAL void otrng_keypair_pool_set_threads(keypair_pool_s *pool,
+                                             unsigned int num_threads);
+
+/**
+ * @brief Takes [count] ECDH and DH keypairs. The ones that are not in the
+ * pool are generated by the pool's threads.
+ *
+ * @param [ecdh]  An array of [count] ECDH keypairs, to be written.
+ * @param [dh]    An array of [count] DH keypairs, to be written.
+ * @param [count] The number of keypairs of each kind.
+ * @param [pool]  The pool. Can be NULL, in which case all keypairs are
+ *                generated in the calling thread.
+ *
+ * @return OTRNG_ERROR if a keypair could not be generated. No keypair is
+ * returned in that case.
+ */
+INTERNAL otrng_result otrng_keypair_pool_take_batch(ecdh_keypair_s *ecdh,
+                                                    dh_keypair_s *dh,
+                                                    size_t count,
+                                                    keypair_pool_s *pool);
+
+#endif
@@ -0,0 +1,839 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* For fileno */
+#define _POSIX_C_SOURCE 200112L
+
+#define OTRNG_KEYSTORE_PRIVATE
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "alloc.h"
+#include "deserialize.h"
+#include "fingerprint.h"
+#include "keystore.h"
+#include "prekey_message.h"
+#include "serialize.h"
+#include "str.h"
+
+#define KEYSTORE_MAGIC "OTRNGKS"
+#define KEYSTORE_MAGIC_BYTES sizeof(KEYSTORE_MAGIC)
+#define KEYSTORE_HEADER_BYTES (KEYSTORE_MAGIC_BYTES + 4 + 4 + 8)
+#define KEYSTORE_INDEX_ENTRY_BYTES (8 + 4 + 4 + 8 + 8)
+#define KEYSTORE_RECORD_HEADER_BYTES (1 + 4)
+
+/* An entry of the index */
+typedef struct keystore_entry_s {
+  uint64_t id_offset;
+  uint32_t id_len;
+  uint32_t num_records;
+  uint64_t records_offset;
+  uint64_t records_len;
+} keystore_entry_s;
+
+/* An account while the keystore is written */
+typedef struct keystore_account_s {
+  const otrng_client_s *client;
+  uint8_t *id;
+  size_t id_len;
+  uint32_t num_records;
+  size_t records_offset; /* From the start of the records */
+  size_t records_len;
+} keystore_account_s;
+
+/* The records of all the accounts, while they are written. They hold
+   secrets, so the memory is wiped whenever it is moved or freed. */
+typedef struct keystore_buffer_s {
+  uint8_t *data;
+  size_t len;
+  size_t cap;
+} keystore_buffer_s;
+
+static void buffer_reserve(keystore_buffer_s *buf, size_t more) {
+  uint8_t *data;
+  size_t cap = buf->cap > 0 ? buf->cap : 4096;
+
+  if (buf->len + more <= buf->cap) {
+    return;
+  }
+
+  while (cap < buf->len + more) {
+    cap *= 2;
+  }
+
+  data = otrng_secure_alloc(cap);
+  if (buf->data) {
+    memcpy(data, buf->data, buf->len);
+    otrng_secure_free(buf->data);
+  }
+
+  buf->data = data;
+  buf->cap = cap;
+}
+
+static void buffer_append(keystore_buffer_s *buf, const uint8_t *data,
+                          size_t len) {
+  buffer_reserve(buf, len);
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+}
+
+static otrng_result append_record_header(keystore_buffer_s *buf,
+                                         keystore_account_s *account,
+                                         otrng_keystore_record_type type,
+                                         size_t len) {
+  if (len > UINT32_MAX) {
+    return OTRNG_ERROR;
+  }
+
+  buffer_reserve(buf, KEYSTORE_RECORD_HEADER_BYTES);
+  buf->len += otrng_serialize_uint8(buf->data + buf->len, type);
+  buf->len += otrng_serialize_uint32(buf->data + buf->len, len);
+  account->num_records++;
+
+  return OTRNG_SUCCESS;
+}
+
+static otrng_result append_record(keystore_buffer_s *buf,
+                                  keystore_account_s *account,
+                                  otrng_keystore_record_type type,
+                                  const uint8_t *data, size_t len) {
+  if (!append_record_header(buf, account, type, len)) {
+    return OTRNG_ERROR;
+  }
+
+  buffer_append(buf, data, len);
+
+  return OTRNG_SUCCESS;
+}
+
+static otrng_result
+append_client_profile(keystore_buffer_s *buf, keystore_account_s *account,
+                      otrng_keystore_record_type type,
+                      const otrng_client_profile_s *profile) {
+  uint8_t *ser = NULL;
+  size_t ser_len = 0;
+  otrng_result result;
+
+  if (!otrng_client_profile_serialize_with_metadata(&ser, &ser_len, profile)) {
+    return OTRNG_ERROR;
+  }
+
+  result = append_record(buf, account, type, ser, ser_len);
+  otrng_free(ser);
+
+  return result;
+}
+
+static otrng_result
+append_prekey_profile(keystore_buffer_s *buf, keystore_account_s *account,
+                      otrng_keystore_record_type type,
+                      otrng_prekey_profile_s *profile) {
+  uint8_t *ser = NULL;
+  size_t ser_len = 0;
+  otrng_result result;
+
+  if (!otrng_prekey_profile_serialize_with_metadata(&ser, &ser_len, profile)) {
+    return OTRNG_ERROR;
+  }
+
+  /* It has the private shared prekey */
+  result = append_record(buf, account, type, ser, ser_len);
+  otrng_secure_wipe(ser, ser_len);
+  otrng_free(ser);
+
+  return result;
+}
+
+static otrng_result append_prekey_messages(keystore_buffer_s *buf,
+                                           keystore_account_s *account) {
+  const prekey_store_entry_s *current;
+  uint8_t *ser;
+  size_t ser_len;
+  otrng_result result = OTRNG_SUCCESS;
+
+  if (!account->client->our_prekeys.first) {
+    return OTRNG_SUCCESS;
+  }
+
+  ser = otrng_secure_alloc(PRE_KEY_WITH_METADATA_MAX_BYTES);
+  for (current = account->client->our_prekeys.first; current;
+       current = current->next) {
+    ser_len = 0;
+    result = otrng_prekey_message_serialize_with_metadata(
+        ser, PRE_KEY_WITH_METADATA_MAX_BYTES, &ser_len, current->msg);
+    if (otrng_failed(result)) {
+      break;
+    }
+
+    result = append_record(buf, account, OTRNG_KEYSTORE_PREKEY_MESSAGE, ser,
+                           ser_len);
+    if (otrng_failed(result)) {
+      break;
+    }
+  }
+  otrng_secure_free(ser);
+
+  return result;
+}
+
+static otrng_result append_fingerprints(keystore_buffer_s *buf,
+                                        keystore_account_s *account) {
+  const list_element_s *current;
+  uint8_t trusted;
+
+  if (!account->client->fingerprints) {
+    return OTRNG_SUCCESS;
+  }
+
+  for (current = account->client->fingerprints->fps; current;
+       current = current->next) {
+    const otrng_known_fingerprint_s *kf = current->data;
+    size_t username_len = strlen(kf->username);
+
+    if (!append_record_header(buf, account, OTRNG_KEYSTORE_FINGERPRINT,
+                              FPRINT_LEN_BYTES + 1 + username_len)) {
+      return OTRNG_ERROR;
+    }
+
+    trusted = otrng_bool_is_true(kf->trusted) ? 1 : 0;
+    buffer_append(buf, kf->fp, FPRINT_LEN_BYTES);
+    buffer_append(buf, &trusted, 1);
+    buffer_append(buf, (const uint8_t *)kf->username, username_len);
+  }
+
+  return OTRNG_SUCCESS;
+}
+
+static otrng_result append_client_records(keystore_buffer_s *buf,
+                                          keystore_account_s *account) {
+  const otrng_client_s *client = account->client;
+  uint8_t forging_key[2 + ED448_POINT_BYTES];
+  size_t forging_key_len;
+
+  if (client->keypair &&
+      !append_record(buf, account, OTRNG_KEYSTORE_PRIVATE_KEY_V4,
+                     client->keypair->sym, ED448_PRIVATE_BYTES)) {
+    return OTRNG_ERROR;
+  }
+
+  if (client->forging_key) {
+    forging_key_len =
+        otrng_serialize_forging_key(forging_key, *client->forging_key);
+    if (forging_key_len == 0 ||
+        !append_record(buf, account, OTRNG_KEYSTORE_FORGING_KEY, forging_key,
+                       forging_key_len)) {
+      return OTRNG_ERROR;
+    }
+  }
+
+  if (client->client_profile &&
+      !append_client_profile(buf, account, OTRNG_KEYSTORE_CLIENT_PROFILE,
+                             client->client_profile)) {
+    return OTRNG_ERROR;
+  }
+
+  if (client->exp_client_profile &&
+      !append_client_profile(buf, account,
+                             OTRNG_KEYSTORE_EXPIRED_CLIENT_PROFILE,
+                             client->exp_client_profile)) {
+    return OTRNG_ERROR;
+  }
+
+  if (client->prekey_profile &&
+      !append_prekey_profile(buf, account, OTRNG_KEYSTORE_PREKEY_PROFILE,
+                             client->prekey_profile)) {
+    return OTRNG_ERROR;
+  }
+
+  if (client->exp_prekey_profile &&
+      !append_prekey_profile(buf, account,
+                             OTRNG_KEYSTORE_EXPIRED_PREKEY_PROFILE,
+                             client->exp_prekey_profile)) {
+    return OTRNG_ERROR;
+  }
+
+  if (!append_prekey_messages(buf, account)) {
+    return OTRNG_ERROR;
+  }
+
+  return append_fingerprints(buf, account);
+}
+
+/* The id of an account is "protocol\0account" */
+static uint8_t *client_id_to_id(size_t *id_len,
+                                const otrng_client_id_s client_id) {
+  size_t protocol_len = strlen(client_id.protocol);
+  size_t account_len = strlen(client_id.account);
+  uint8_t *id;
+
+  *id_len = protocol_len + 1 + account_len;
+  id = otrng_xmalloc(*id_len);
+  memcpy(id, client_id.protocol, protocol_len);
+  id[protocol_len] = 0;
+  memcpy(id + protocol_len + 1, client_id.account, account_len);
+
+  return id;
+}
+
+static int compare_ids(const uint8_t *a, size_t a_len, const uint8_t *b,
+                       size_t b_len) {
+  int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+
+  if (cmp != 0) {
+    return cmp;
+  }
+
+  return (a_len > b_len) - (a_len < b_len);
+}
+
+static int compare_accounts(const void *a, const void *b) {
+  const keystore_account_s *x = a, *y = b;
+
+  return compare_ids(x->id, x->id_len, y->id, y->id_len);
+}
+
+static otrng_result write_keystore(FILE *fp, const keystore_account_s *accounts,
+                                   size_t num_accounts,
+                                   const keystore_buffer_s *records) {
+  uint8_t header[KEYSTORE_HEADER_BYTES];
+  uint8_t entry[KEYSTORE_INDEX_ENTRY_BYTES];
+  uint64_t id_offset, records_start;
+  size_t i, w;
+
+  id_offset = KEYSTORE_HEADER_BYTES +
+              (uint64_t)num_accounts * KEYSTORE_INDEX_ENTRY_BYTES;
+  records_start = id_offset;
+  for (i = 0; i < num_accounts; i++) {
+    records_start += accounts[i].id_len;
+  }
+
+  memcpy(header, KEYSTORE_MAGIC, KEYSTORE_MAGIC_BYTES);
+  w = KEYSTORE_MAGIC_BYTES;
+  w += otrng_serialize_uint32(header + w, OTRNG_KEYSTORE_VERSION);
+  w += otrng_serialize_uint32(header + w, num_accounts);
+  otrng_serialize_uint64(header + w, KEYSTORE_HEADER_BYTES);
+
+  if (fwrite(header, 1, sizeof(header), fp) != sizeof(header)) {
+    return OTRNG_ERROR;
+  }
+
+  for (i = 0; i < num_accounts; i++) {
+    w = otrng_serialize_uint64(entry, id_offset);
+    w += otrng_serialize_uint32(entry + w, accounts[i].id_len);
+    w += otrng_serialize_uint32(entry + w, accounts[i].num_records);
+    w += otrng_serialize_uint64(entry + w,
+                                records_start + accounts[i].records_offset);
+    otrng_serialize_uint64(entry + w, accounts[i].records_len);
+    id_offset += accounts[i].id_len;
+
+    if (fwrite(entry, 1, sizeof(entry), fp) != sizeof(entry)) {
+      return OTRNG_ERROR;
+    }
+  }
+
+  for (i = 0; i < num_accounts; i++) {
+    if (fwrite(accounts[i].id, 1, accounts[i].id_len, fp) !=
+        accounts[i].id_len) {
+      return OTRNG_ERROR;
+    }
+  }
+
+  if (records->len > 0 &&
+      fwrite(records->data, 1, records->len, fp) != records->len) {
+    return OTRNG_ERROR;
+  }
+
+  /* So it can be opened with otrng_keystore_open right away */
+  if (fflush(fp) != 0) {
+    return OTRNG_ERROR;
+  }
+
+  return OTRNG_SUCCESS;
+}
+
+API otrng_result
+otrng_global_state_keystore_write_to(const otrng_global_state_s *gs, FILE *fp) {
+  size_t num_accounts, i;
+  keystore_account_s *accounts;
+  keystore_buffer_s records = {NULL, 0, 0};
+  const list_element_s *current;
+  otrng_result result = OTRNG_SUCCESS;
+
+  if (!fp) {
+    return OTRNG_ERROR;
+  }
+
+  num_accounts = otrng_list_len(gs->clients);
+  if (num_accounts > UINT32_MAX) {
+    return OTRNG_ERROR;
+  }
+
+  accounts = otrng_xmalloc_z((num_accounts + 1) * sizeof(keystore_account_s));
+  for (i = 0, current = gs->clients; current; i++, current = current->next) {
+    const otrng_client_s *client = current->data;
+
+    accounts[i].client = client;
+    accounts[i].id = client_id_to_id(&accounts[i].id_len, client->client_id);
+  }
+
+  qsort(accounts, num_accounts, sizeof(keystore_account_s), compare_accounts);
+
+  for (i = 0; i < num_accounts; i++) {
+    accounts[i].records_offset = records.len;
+    result = append_client_records(&records, &accounts[i]);
+    if (otrng_failed(result)) {
+      break;
+    }
+    accounts[i].records_len = records.len - accounts[i].records_offset;
+  }
+
+  if (otrng_succeeded(result)) {
+    result = write_keystore(fp, accounts, num_accounts, &records);
+  }
+
+  for (i = 0; i < num_accounts; i++) {
+    otrng_free(accounts[i].id);
+  }
+  otrng_free(accounts);
+  if (records.data) {
+    otrng_secure_free(records.data);
+  }
+
+  return result;
+}
+
+/* Whether [len] bytes at [offset] are inside the keystore */
+static otrng_bool in_keystore(const otrng_keystore_s *ks, uint64_t offset,
+                              uint64_t len) {
+  return offset <= ks->len && len <= ks->len - offset ? otrng_true
+                                                      : otrng_false;
+}
+
+static void read_index_entry(keystore_entry_s *entry,
+                             const otrng_keystore_s *ks, uint32_t i) {
+  const uint8_t *p = ks->index + (size_t)i * KEYSTORE_INDEX_ENTRY_BYTES;
+  size_t len = KEYSTORE_INDEX_ENTRY_BYTES;
+
+  /* These can not fail, as the entry is inside the keystore */
+  (void)otrng_deserialize_uint64(&entry->id_offset, p, len, NULL);
+  (void)otrng_deserialize_uint32(&entry->id_len, p + 8, len - 8, NULL);
+  (void)otrng_deserialize_uint32(&entry->num_records, p + 12, len - 12, NULL);
+  (void)otrng_deserialize_uint64(&entry->records_offset, p + 16, len - 16,
+                                 NULL);
+  (void)otrng_deserialize_uint64(&entry->records_len, p + 24, len - 24, NULL);
+}
+
+static otrng_result read_header(otrng_keystore_s *ks) {
+  uint32_t version, i;
+  uint64_t index_offset;
+  keystore_entry_s entry;
+
+  if (ks->len < KEYSTORE_HEADER_BYTES ||
+      memcmp(ks->data, KEYSTORE_MAGIC, KEYSTORE_MAGIC_BYTES) != 0) {
+    return OTRNG_ERROR;
+  }
+
+  if (!otrng_deserialize_uint32(&version, ks->data + 8, ks->len - 8, NULL) ||
+      version != OTRNG_KEYSTORE_VERSION) {
+    return OTRNG_ERROR;
+  }
+
+  if (!otrng_deserialize_uint32(&ks->num_accounts, ks->data + 12,
+                                ks->len - 12, NULL) ||
+      !otrng_deserialize_uint64(&index_offset, ks->data + 16, ks->len - 16,
+                                NULL)) {
+    return OTRNG_ERROR;
+  }
+
+  if (!in_keystore(ks, index_offset,
+                   (uint64_t)ks->num_accounts * KEYSTORE_INDEX_ENTRY_BYTES)) {
+    return OTRNG_ERROR;
+  }
+  ks->index = ks->data + index_offset;
+
+  /* So nothing needs to be checked again when an account is read */
+  for (i = 0; i < ks->num_accounts; i++) {
+    read_index_entry(&entry, ks, i);
+    if (!in_keystore(ks, entry.id_offset, entry.id_len) ||
+        !in_keystore(ks, entry.records_offset, entry.records_len) ||
+        !memchr(ks->data + entry.id_offset, 0, entry.id_len)) {
+      return OTRNG_ERROR;
+    }
+  }
+
+  return OTRNG_SUCCESS;
+}
+
+API /*@null@*/ otrng_keystore_s *otrng_keystore_open(FILE *fp) {
+  struct stat st;
+  void *data;
+  otrng_keystore_s *ks;
+
+  if (!fp || fstat(fileno(fp), &st) != 0) {
+    return NULL;
+  }
+
+  if (st.st_size < (off_t)KEYSTORE_HEADER_BYTES) {
+    return NULL;
+  }
+
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+
+  ks = otrng_xmalloc_z(sizeof(otrng_keystore_s));
+  ks->data = data;
+  ks->len = st.st_size;
+
+  if (!read_header(ks)) {
+    otrng_keystore_close(ks);
+    return NULL;
+  }
+
+  return ks;
+}
+
+API void otrng_keystore_close(otrng_keystore_s *ks) {
+  if (!ks) {
+    return;
+  }
+
+  munmap((void *)ks->data, ks->len);
+  otrng_free(ks);
+}
+
+static otrng_result read_forging_key(otrng_client_s *client,
+                                     const uint8_t *data, size_t len) {
+  otrng_public_key key;
+
+  if (!otrng_deserialize_forging_key(key, data, len, NULL)) {
+    return OTRNG_ERROR;
+  }
+
+  if (client->forging_key) {
+    otrng_ec_point_destroy(*client->forging_key);
+    otrng_free(client->forging_key);
+    client->forging_key = NULL;
+  }
+
+  return otrng_client_add_forging_key(client, key);
+}
+
+static otrng_result read_client_profile(otrng_client_s *client,
+                                        otrng_keystore_record_type type,
+                                        const uint8_t *data, size_t len) {
+  otrng_client_profile_s profile;
+  otrng_result result;
+
+  memset(&profile, 0, sizeof(otrng_client_profile_s));
+  if (!otrng_client_profile_deserialize_with_metadata(&profile, data, len,
+                                                      NULL)) {
+    otrng_client_profile_destroy(&profile);
+    return OTRNG_ERROR;
+  }
+
+  if (type == OTRNG_KEYSTORE_CLIENT_PROFILE) {
+    otrng_client_profile_free(client->client_profile);
+    client->client_profile = NULL;
+    result = otrng_client_add_client_profile(client, &profile);
+  } else {
+    otrng_client_profile_free(client->exp_client_profile);
+    client->exp_client_profile = NULL;
+    result = otrng_client_add_exp_client_profile(client, &profile);
+  }
+  otrng_client_profile_destroy(&profile);
+
+  return result;
+}
+
+static otrng_result read_prekey_profile(otrng_client_s *client,
+                                        otrng_keystore_record_type type,
+                                        const uint8_t *data, size_t len) {
+  otrng_prekey_profile_s profile;
+  otrng_result result;
+
+  memset(&profile, 0, sizeof(otrng_prekey_profile_s));
+  if (!otrng_prekey_profile_deserialize_with_metadata(&profile, data, len,
+                                                      NULL)) {
+    otrng_prekey_profile_destroy(&profile);
+    return OTRNG_ERROR;
+  }
+
+  if (type == OTRNG_KEYSTORE_PREKEY_PROFILE) {
+    otrng_prekey_profile_free(client->prekey_profile);
+    client->prekey_profile = NULL;
+    result = otrng_client_add_prekey_profile(client, &profile);
+  } else {
+    otrng_prekey_profile_free(client->exp_prekey_profile);
+    client->exp_prekey_profile = NULL;
+    result = otrng_client_add_exp_prekey_profile(client, &profile);
+  }
+  otrng_prekey_profile_destroy(&profile);
+
+  return result;
+}
+
+static otrng_result read_prekey_message(otrng_client_s *client,
+                                        const uint8_t *data, size_t len) {
+  prekey_message_s *msg = otrng_xmalloc_z(sizeof(prekey_message_s));
+
+  if (!otrng_prekey_message_deserialize_with_metadata(msg, data, len, NULL)) {
+    otrng_prekey_message_free(msg);
+    return OTRNG_ERROR;
+  }
+
+  otrng_prekey_store_add(&client->our_prekeys, msg);
+
+  return OTRNG_SUCCESS;
+}
+
+static otrng_result read_fingerprint(otrng_client_s *client,
+                                     const uint8_t *data, size_t len) {
+  otrng_known_fingerprint_s *kf;
+
+  if (len < FPRINT_LEN_BYTES + 1) {
+    return OTRNG_ERROR;
+  }
+
+  if (!client->fingerprints) {
+    client->fingerprints = otrng_known_fingerprints_new();
+  }
+
+  kf = otrng_xmalloc_z(sizeof(otrng_known_fingerprint_s));
+  memcpy(kf->fp, data, FPRINT_LEN_BYTES);
+  kf->trusted = data[FPRINT_LEN_BYTES] ? otrng_true : otrng_false;
+  kf->username = otrng_xstrndup((const char *)data + FPRINT_LEN_BYTES + 1,
+                                len - FPRINT_LEN_BYTES - 1);
+  otrng_known_fingerprints_add(client->fingerprints, kf);
+
+  return OTRNG_SUCCESS;
+}
+
+static otrng_result read_record(otrng_client_s *client, uint8_t type,
+                                const uint8_t *data, size_t len) {
+  switch (type) {
+  case OTRNG_KEYSTORE_PRIVATE_KEY_V4:
+    if (len != ED448_PRIVATE_BYTES) {
+      return OTRNG_ERROR;
+    }
+    otrng_keypair_free(client->keypair);
+    client->keypair = NULL;
+    return otrng_client_add_private_key_v4(client, data);
+  case OTRNG_KEYSTORE_FORGING_KEY:
+    return read_forging_key(client, data, len);
+  case OTRNG_KEYSTORE_CLIENT_PROFILE:
+  case OTRNG_KEYSTORE_EXPIRED_CLIENT_PROFILE:
+    return read_client_profile(client, type, data, len);
+  case OTRNG_KEYSTORE_PREKEY_PROFILE:
+  case OTRNG_KEYSTORE_EXPIRED_PREKEY_PROFILE:
+    return read_prekey_profile(client, type, data, len);
+  case OTRNG_KEYSTORE_PREKEY_MESSAGE:
+    return read_prekey_message(client, data, len);
+  case OTRNG_KEYSTORE_FINGERPRINT:
+    return read_fingerprint(client, data, len);
+  default:
+    /* Written by a later version */
+    return OTRNG_SUCCESS;
+  }
+}
+
+/* Reads every record of [entry] into a new client, so nothing is loaded if
+   one of them is invalid */
+static /*@null@*/ otrng_client_s *read_records(const otrng_keystore_s *ks,
+                                               const keystore_entry_s *entry,
+                                               otrng_client_id_s client_id) {
+  const uint8_t *p = ks->data + entry->records_offset;
+  size_t left = entry->records_len;
+  otrng_client_s *loaded = otrng_client_new(client_id);
+  uint32_t i, len;
+  uint8_t type;
+
+  for (i = 0; i < entry->num_records; i++) {
+    if (left < KEYSTORE_RECORD_HEADER_BYTES) {
+      otrng_client_free(loaded);
+      return NULL;
+    }
+
+    type = p[0];
+    (void)otrng_deserialize_uint32(&len, p + 1, left - 1, NULL);
+    p += KEYSTORE_RECORD_HEADER_BYTES;
+    left -= KEYSTORE_RECORD_HEADER_BYTES;
+
+    if (len > left || !read_record(loaded, type, p, len)) {
+      otrng_client_free(loaded);
+      return NULL;
+    }
+
+    p += len;
+    left -= len;
+  }
+
+  return loaded;
+}
+
+#define SWAP(type, a, b)                                                       \
+  do {                                                                         \
+    type tmp = a;                                                              \
+    a = b;                                                                     \
+    b = tmp;                                                                   \
+  } while (0)
+
+/* Moves what was read into [client], and what it replaces into [loaded],
+   which is then freed. The prekey messages and the fingerprints are always
+   replaced, the keys and profiles only when the keystore has them. */
+static void use_records(otrng_client_s *client, otrng_client_s *loaded) {
+  if (loaded->keypair) {
+    SWAP(otrng_keypair_s *, client->keypair, loaded->keypair);
+  }
+  if (loaded->forging_key) {
+    SWAP(otrng_public_key *, client->forging_key, loaded->forging_key);
+  }
+  if (loaded->client_profile) {
+    SWAP(otrng_client_profile_s *, client->client_profile,
+         loaded->client_profile);
+  }
+  if (loaded->exp_client_profile) {
+    SWAP(otrng_client_profile_s *, client->exp_client_profile,
+         loaded->exp_client_profile);
+  }
+  if (loaded->prekey_profile) {
+    SWAP(otrng_prekey_profile_s *, client->prekey_profile,
+         loaded->prekey_profile);
+  }
+  if (loaded->exp_prekey_profile) {
+    SWAP(otrng_prekey_profile_s *, client->exp_prekey_profile,
+         loaded->exp_prekey_profile);
+  }
+  SWAP(prekey_store_s, client->our_prekeys, loaded->our_prekeys);
+  SWAP(otrng_known_fingerprints_s *, client->fingerprints,
+       loaded->fingerprints);
+
+  otrng_client_free(loaded);
+}
+
+#undef SWAP
+
+static otrng_bool find_account(keystore_entry_s *entry,
+                               const otrng_keystore_s *ks, const uint8_t *id,
+                               size_t id_len) {
+  uint32_t low = 0, high = ks->num_accounts;
+
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    int cmp;
+
+    read_index_entry(entry, ks, middle);
+    cmp = compare_ids(id, id_len, ks->data + entry->id_offset, entry->id_len);
+    if (cmp == 0) {
+      return otrng_true;
+    }
+
+    if (cmp < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+
+  return otrng_false;
+}
+
+API otrng_result otrng_keystore_read_client(const otrng_keystore_s *ks,
+                                            otrng_client_s *client) {
+  keystore_entry_s entry;
+  size_t id_len;
+  uint8_t *id = client_id_to_id(&id_len, client->client_id);
+  otrng_bool found = find_account(&entry, ks, id, id_len);
+
+  otrng_client_s *loaded;
+
+  otrng_free(id);
+  if (!found) {
+    return OTRNG_ERROR;
+  }
+
+  loaded = read_records(ks, &entry, client->client_id);
+  if (!loaded) {
+    return OTRNG_ERROR;
+  }
+
+  use_records(client, loaded);
+
+  return OTRNG_SUCCESS;
+}
+
+API otrng_result otrng_global_state_keystore_read_from(
+    otrng_global_state_s *gs, const otrng_keystore_s *ks) {
+  keystore_entry_s entry;
+  otrng_client_s **loaded;
+  uint32_t i, num_loaded;
+
+  if (ks->num_accounts == 0) {
+    return OTRNG_SUCCESS;
+  }
+
+  /* Every account is read before any client is changed */
+  loaded = otrng_xmalloc_z(ks->num_accounts * sizeof(otrng_client_s *));
+  for (num_loaded = 0; num_loaded < ks->num_accounts; num_loaded++) {
+    otrng_client_id_s client_id;
+    const char *id;
+    size_t protocol_len;
+    char *protocol, *account;
+
+    read_index_entry(&entry, ks, num_loaded);
+    id = (const char *)ks->data + entry.id_offset;
+    protocol_len = strlen(id);
+
+    protocol = otrng_xstrndup(id, protocol_len);
+    account = otrng_xstrndup(id + protocol_len + 1,
+                             entry.id_len - protocol_len - 1);
+    client_id.protocol = protocol;
+    client_id.account = account;
+
+    loaded[num_loaded] = read_records(ks, &entry, client_id);
+
+    otrng_free(protocol);
+    otrng_free(account);
+
+    if (!loaded[num_loaded]) {
+      break;
+    }
+  }
+
+  if (num_loaded < ks->num_accounts) {
+    for (i = 0; i < num_loaded; i++) {
+      otrng_client_free(loaded[i]);
+    }
+    otrng_free(loaded);
+    return OTRNG_ERROR;
+  }
+
+  for (i = 0; i < num_loaded; i++) {
+    use_records(otrng_client_get(gs, loaded[i]->client_id), loaded[i]);
+  }
+  otrng_free(loaded);
+
+  return OTRNG_SUCCESS;
+}
@@ -0,0 +1,132 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * A binary keystore is a single file with everything the text files written
+ * by the otrng_global_state_*_write_to functions hold for every account: the
+ * private key, the forging key, the client and prekey profiles, the prekey
+ * messages and the known fingerprints. It does not hold the OTRv3 data,
+ * which libotr keeps. Unlike the text files, it can be mapped in memory, and
+ * the accounts can be read one at a time, when they are needed.
+ *
+ * All the integers in it are big-endian. It is made of:
+ *
+ * - A header: "OTRNGKS" and a zero byte, the version (uint32), the number of
+ *   accounts (uint32) and the offset of the index (uint64).
+ * - The index, with one entry for each account, sorted by id: the offset
+ *   (uint64) and length (uint32) of the id, which is "protocol\0account", the
+ *   number of records (uint32), and the offset and length (both uint64) of
+ *   the records.
+ * - The ids and the records. A record is a type (uint8), a length (uint32)
+ *   and that many bytes.
+ *
+ * To convert the text files, read them into a global state and call
+ * otrng_global_state_keystore_write_to. To convert a keystore back, call
+ * otrng_global_state_keystore_read_from and write the text files.
+ *
+ * The functions in this file only operate on their arguments, and doesn't
+ * touch any global state. An open keystore is read only, so it can be used
+ * from different threads at the same time.
+ */
+
+#ifndef OTRNG_KEYSTORE_H
+#define OTRNG_KEYSTORE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "client.h"
+#include "messaging.h"
+#include "shared.h"
+
+#define OTRNG_KEYSTORE_VERSION 1
+
+typedef enum {
+  /* The symmetric key */
+  OTRNG_KEYSTORE_PRIVATE_KEY_V4 = 0x01,
+  /* The serialized forging key */
+  OTRNG_KEYSTORE_FORGING_KEY = 0x02,
+  /* The profiles, serialized with their metadata */
+  OTRNG_KEYSTORE_CLIENT_PROFILE = 0x03,
+  OTRNG_KEYSTORE_EXPIRED_CLIENT_PROFILE = 0x04,
+  OTRNG_KEYSTORE_PREKEY_PROFILE = 0x05,
+  OTRNG_KEYSTORE_EXPIRED_PREKEY_PROFILE = 0x06,
+  /* One prekey message, serialized with its metadata */
+  OTRNG_KEYSTORE_PREKEY_MESSAGE = 0x07,
+  /* The fingerprint, whether it is trusted (uint8), and the username */
+  OTRNG_KEYSTORE_FINGERPRINT = 0x08,
+} otrng_keystore_record_type;
+
+/* A keystore mapped in memory */
+typedef struct otrng_keystore_s {
+  const uint8_t *data;
+  size_t len;
+  uint32_t num_accounts;
+  const uint8_t *index;
+} otrng_keystore_s;
+
+/**
+ * @brief Writes a keystore with all the clients of the global state.
+ *
+ * @param [gs] The global state.
+ * @param [fp] The file. It should be empty. It is flushed at the end.
+ */
+API otrng_result
+otrng_global_state_keystore_write_to(const otrng_global_state_s *gs, FILE *fp);
+
+/**
+ * @brief Maps a keystore in memory, read only. [fp] can be closed afterwards.
+ *
+ * The keystore is mapped from the file, not read through [fp], so anything
+ * written to [fp] must have been flushed before. It is not flushed here, as
+ * [fp] can be open for reading only.
+ *
+ * @return The keystore, or NULL if [fp] does not have a valid one.
+ */
+API /*@null@*/ otrng_keystore_s *otrng_keystore_open(FILE *fp);
+
+API void otrng_keystore_close(/*@only@*/ /*@null@*/ otrng_keystore_s *ks);
+
+/**
+ * @brief Reads everything stored for [client], replacing what it has. Its
+ * prekey messages and known fingerprints are replaced even if none are
+ * stored. If one record can not be read, [client] is left as it was.
+ *
+ * @param [ks]     The keystore.
+ * @param [client] The client.
+ *
+ * @return OTRNG_ERROR if [client] is not in the keystore, or if its records
+ * can not be read.
+ */
+API otrng_result otrng_keystore_read_client(const otrng_keystore_s *ks,
+                                            otrng_client_s *client);
+
+/**
+ * @brief Reads every account of the keystore into the global state, creating
+ * the clients that it does not have. If one account can not be read, no
+ * client is changed.
+ */
+API otrng_result otrng_global_state_keystore_read_from(
+    otrng_global_state_s *gs, const otrng_keystore_s *ks);
+
+#ifdef OTRNG_KEYSTORE_PRIVATE
+#endif
+
+#endif
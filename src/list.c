@@ -114,6 +114,15 @@ INTERNAL list_element_s *otrng_list_add(void *data, list_element_s *head) {
   return head;
 }
 
+INTERNAL list_element_s *otrng_list_prepend(void *data, list_element_s *head) {
+  list_element_s *n = list_new();
+
+  n->data = data;
+  n->next = head;
+
+  return n;
+}
+
 INTERNAL /*@null@*/ list_element_s *otrng_list_get_last(list_element_s *head) {
   list_element_s *cursor;
 
@@ -56,6 +56,9 @@ INTERNAL /*@null@*/ list_element_s *otrng_list_copy(list_element_s *head);
 
 INTERNAL list_element_s *otrng_list_add(void *data, list_element_s *head);
 
+// Adds [data] as the new head, without walking the list
+INTERNAL list_element_s *otrng_list_prepend(void *data, list_element_s *head);
+
 INTERNAL /*@null@*/ list_element_s *otrng_list_get_last(list_element_s *head);
 
 INTERNAL /*@null@*/ list_element_s *
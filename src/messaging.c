@@ -18,6 +18,9 @@
  *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/* For PTHREAD_MUTEX_RECURSIVE */
+#define _XOPEN_SOURCE 600
+
 #ifndef S_SPLINT_S
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wstrict-prototypes"
@@ -34,6 +37,9 @@
 #include "persistence.h"
 #include "prekey_manager.h"
 
+/* Client ids up to this size are looked up without allocating */
+#define CLIENT_ID_KEY_BYTES 256
+
 API otrng_global_state_s *
 otrng_global_state_new(const otrng_client_callbacks_s *cb, otrng_bool die) {
   otrng_global_state_s *gs = otrng_xmalloc_z(sizeof(otrng_global_state_s));
@@ -47,7 +53,11 @@ otrng_global_state_new(const otrng_client_callbacks_s *cb, otrng_bool die) {
   }
 
   gs->callbacks = cb;
+  gs->client_index = otrng_hash_table_new();
+  pthread_mutex_init(&gs->clients_lock, NULL);
+  gs->keypair_pool = otrng_keypair_pool_new(0);
   gs->user_state_v3 = otrl_userstate_create();
+  otrng_global_state_init_lock_v3(gs);
   if (gs->user_state_v3 == NULL) {
     if (die) {
       exit(EXIT_FAILURE);
@@ -64,47 +74,102 @@ API void otrng_global_state_free(otrng_global_state_s *gs) {
     return;
   }
 
+  otrng_hash_table_free(gs->client_index, NULL);
   otrng_list_free(gs->clients, free_client);
+  pthread_mutex_destroy(&gs->clients_lock);
   otrl_userstate_free(gs->user_state_v3);
+  pthread_mutex_destroy(&gs->user_state_v3_lock);
+  otrng_keypair_pool_free(gs->keypair_pool);
 
   otrng_free(gs);
 }
 
-tstatic int find_client_by_client_id(const void *current, const void *wanted) {
-  const otrng_client_s *client = current;
-  const otrng_client_id_s *cid = wanted;
-  return strcmp(client->client_id.protocol, cid->protocol) == 0 &&
-         strcmp(client->client_id.account, cid->account) == 0;
+/* The index key is "protocol\0account". It is written to [buffer] when it
+   fits, and allocated otherwise. */
+static uint8_t *client_id_key(size_t *key_len,
+                              uint8_t buffer[CLIENT_ID_KEY_BYTES],
+                              const otrng_client_id_s client_id) {
+  size_t protocol_len = strlen(client_id.protocol);
+  size_t account_len = strlen(client_id.account);
+  uint8_t *key = buffer;
+
+  *key_len = protocol_len + 1 + account_len;
+  if (*key_len > CLIENT_ID_KEY_BYTES) {
+    key = otrng_xmalloc(*key_len);
+  }
+
+  memcpy(key, client_id.protocol, protocol_len);
+  key[protocol_len] = 0;
+  memcpy(key + protocol_len + 1, client_id.account, account_len);
+
+  return key;
+}
+
+/* The caller holds the lock of the clients, or is the only thread using the
+   global state */
+tstatic otrng_client_s *find_client(const otrng_global_state_s *gs,
+                                    const otrng_client_id_s client_id) {
+  uint8_t buffer[CLIENT_ID_KEY_BYTES];
+  size_t key_len;
+  uint8_t *key = client_id_key(&key_len, buffer, client_id);
+  otrng_client_s *client = otrng_hash_table_get(gs->client_index, key, key_len);
+
+  if (key != buffer) {
+    otrng_free(key);
+  }
+
+  return client;
+}
+
+static void add_client_locked(otrng_global_state_s *gs,
+                              otrng_client_s *client) {
+  uint8_t buffer[CLIENT_ID_KEY_BYTES];
+  size_t key_len;
+  uint8_t *key = client_id_key(&key_len, buffer, client->client_id);
+  list_element_s *node = otrng_list_add(client, NULL);
+
+  /* Appended through the last element, so adding many clients does not walk
+     the list each time */
+  client->global_state = gs;
+  if (gs->last_client) {
+    gs->last_client->next = node;
+  } else {
+    gs->clients = node;
+  }
+  gs->last_client = node;
+  otrng_hash_table_put(gs->client_index, key, key_len, client);
+
+  if (key != buffer) {
+    otrng_free(key);
+  }
+}
+
+INTERNAL void otrng_global_state_add_client(otrng_global_state_s *gs,
+                                            otrng_client_s *client) {
+  pthread_mutex_lock(&gs->clients_lock);
+  add_client_locked(gs, client);
+  pthread_mutex_unlock(&gs->clients_lock);
 }
 
 tstatic otrng_client_s *get_client(otrng_global_state_s *gs,
                                    const otrng_client_id_s client_id) {
   otrng_client_s *client;
-  list_element_s *el =
-      otrng_list_get(&client_id, gs->clients, find_client_by_client_id);
-  if (el) {
-    return el->data;
-  }
 
-  client = otrng_client_new(client_id);
+  /* Looking up and adding are done under the same lock, so two threads
+     getting the same new client create it only once */
+  pthread_mutex_lock(&gs->clients_lock);
+  client = find_client(gs, client_id);
   if (!client) {
-    return NULL;
+    client = otrng_client_new(client_id);
+    add_client_locked(gs, client);
   }
-
-  client->global_state = gs;
-  gs->clients = otrng_list_add(client, gs->clients);
+  pthread_mutex_unlock(&gs->clients_lock);
 
   return client;
 }
 
 API otrng_client_s *otrng_client_get(otrng_global_state_s *gs,
-
                                      const otrng_client_id_s client_id) {
-  list_element_s *el =
-      otrng_list_get(&client_id, gs->clients, find_client_by_client_id);
-  if (el) {
-    return el->data;
-  }
   return get_client(gs, client_id);
 }
 
@@ -321,7 +386,11 @@ API otrng_result otrng_global_state_prekey_messages_write_to(
 API otrng_result otrng_global_state_instance_tags_read_from(
     otrng_global_state_s *gs, FILE *instag) {
   /* We use v3 global_state also for v4 instance tags, for now. */
-  gcry_error_t res = otrl_instag_read_FILEp(gs->user_state_v3, instag);
+  gcry_error_t res;
+
+  otrng_global_state_lock_v3(gs);
+  res = otrl_instag_read_FILEp(gs->user_state_v3, instag);
+  otrng_global_state_unlock_v3(gs);
   if (res) {
     return OTRNG_ERROR;
   }
@@ -331,8 +400,12 @@ API otrng_result otrng_global_state_instance_tags_read_from(
 API otrng_result otrng_global_state_private_key_v3_read_from(
     otrng_global_state_s *gs, FILE *keys,
     otrng_client_id_s (*read_client_id_for_key)(FILE *filep)) {
-  gcry_error_t res = otrl_privkey_read_FILEp(gs->user_state_v3, keys);
+  gcry_error_t res;
+
   (void)read_client_id_for_key;
+  otrng_global_state_lock_v3(gs);
+  res = otrl_privkey_read_FILEp(gs->user_state_v3, keys);
+  otrng_global_state_unlock_v3(gs);
   if (res) {
     return OTRNG_ERROR;
   }
@@ -475,16 +548,10 @@ API otrng_result otrng_global_state_expired_prekey_profile_read_from(
                                 otrng_client_expired_prekey_profile_read_from);
 }
 
-tstatic void prekey_global_state_message_free_from_list(void *prekeys) {
-  otrng_prekey_message_free(prekeys);
-}
-
 tstatic void free_prekeys_from(list_element_s *node, void *ignored) {
   otrng_client_s *client = node->data;
   (void)ignored;
-  otrng_list_free(client->our_prekeys,
-                  prekey_global_state_message_free_from_list);
-  client->our_prekeys = NULL;
+  otrng_prekey_store_destroy(&client->our_prekeys);
 }
 
 API otrng_result otrng_global_state_prekeys_read_from(
@@ -499,7 +566,9 @@ API otrng_result otrng_global_state_fingerprints_v3_read_from(
     otrng_global_state_s *gs, FILE *f,
     otrng_client_id_s (*read_client_id_for_key)(FILE *filep)) {
   (void)read_client_id_for_key;
+  otrng_global_state_lock_v3(gs);
   otrl_privkey_read_fingerprints_FILEp(gs->user_state_v3, f, NULL, NULL);
+  otrng_global_state_unlock_v3(gs);
   otrng_global_state_fingerprints_v3_loaded(gs);
   return OTRNG_SUCCESS;
 }
@@ -524,21 +593,24 @@ tstatic void free_fingerprints_from(list_element_s *node, void *ignored) {
   client->fingerprints = NULL;
 }
 
-API otrng_result otrng_global_state_fingerprints_v4_read_from(
-    otrng_global_state_s *gs, FILE *f, otrng_client_id_s (*ignored)(FILE *)) {
-  (void)ignored;
-
+API otrng_result otrng_global_state_fingerprints_v4_read_all_from(
+    otrng_global_state_s *gs, FILE *f,
+    void (*on_bad_line)(size_t line_number, void *context), void *context) {
   otrng_list_foreach(gs->clients, free_fingerprints_from, NULL);
 
   if (!f) {
     return OTRNG_ERROR;
   }
 
-  while (!feof(f)) {
-    (void)otrng_client_fingerprint_v4_read_from(gs, f, get_client);
-  }
+  return otrng_client_fingerprints_v4_read_all_from(gs, f, get_client,
+                                                    on_bad_line, context);
+}
 
-  return OTRNG_SUCCESS;
+API otrng_result otrng_global_state_fingerprints_v4_read_from(
+    otrng_global_state_s *gs, FILE *f, otrng_client_id_s (*ignored)(FILE *)) {
+  (void)ignored;
+
+  return otrng_global_state_fingerprints_v4_read_all_from(gs, f, NULL, NULL);
 }
 
 static void add_fingerprints_v4_to(list_element_s *node, void *fp) {
@@ -597,7 +669,7 @@ API void otrng_global_state_do_all_fingerprints_v3(
   otrng_client_id_s cid;
   ConnContext *cc;
   Fingerprint *fprint;
-  list_element_s *el;
+  const otrng_client_s *client;
   otrng_known_fingerprint_v3_s fp;
 
   for (cc = gs->user_state_v3->context_root; cc; cc = cc->next) {
@@ -605,31 +677,75 @@ API void otrng_global_state_do_all_fingerprints_v3(
     if (cc->their_instance != OTRL_INSTAG_MASTER)
       continue;
 
+    /* Every fingerprint of a context belongs to the same client */
+    cid.protocol = cc->protocol;
+    cid.account = cc->accountname;
+    client = find_client(gs, cid);
+    if (!client) {
+      continue;
+    }
+
     /* Don't bother with the first (fingerprintless) entry. */
     for (fprint = cc->fingerprint_root.next; fprint; fprint = fprint->next) {
-      cid.protocol = cc->protocol;
-      cid.account = cc->accountname;
-      el = otrng_list_get(&cid, gs->clients, find_client_by_client_id);
-      if (el) {
-        fp.username = cc->username;
-        fp.fp = fprint;
-        fn(el->data, &fp, context);
-      }
+      fp.username = cc->username;
+      fp.fp = fprint;
+      fn(client, &fp, context);
     }
   }
 }
 
 tstatic void poll_for_client(list_element_s *node, void *context) {
-  otrng_client_s *client = node->data;
   (void)context;
-  otrng_client_expire_sessions(client);
-  (void)otrng_client_expire_fragments(client);
-  otrng_prekey_check_account_request(client);
+  otrng_client_poll(node->data);
 }
 
 API void otrng_poll(otrng_global_state_s *gs) {
   otrng_list_foreach(gs->clients, poll_for_client, NULL);
+  otrng_global_state_poll(gs);
+}
+
+API void otrng_global_state_poll(otrng_global_state_s *gs) {
+  otrng_global_state_lock_v3(gs);
   otrl_message_poll(gs->user_state_v3, NULL, NULL);
+  otrng_global_state_unlock_v3(gs);
+  (void)otrng_keypair_pool_refill(gs->keypair_pool);
+}
+
+API otrng_bool
+otrng_global_state_next_deadline(time_t *deadline,
+                                 const otrng_global_state_s *gs) {
+  const list_element_s *current;
+  otrng_bool found = otrng_false;
+  time_t client_deadline;
+
+  for (current = gs->clients; current; current = current->next) {
+    if (!otrng_client_next_deadline(&client_deadline, current->data)) {
+      continue;
+    }
+
+    if (!found || client_deadline < *deadline) {
+      *deadline = client_deadline;
+      found = otrng_true;
+    }
+  }
+
+  return found;
+}
+
+API void otrng_global_state_set_keypair_pool_depth(otrng_global_state_s *gs,
+                                                   size_t depth) {
+  otrng_keypair_pool_set_depth(gs->keypair_pool, depth);
+}
+
+API otrng_result
+otrng_global_state_refill_keypair_pool(otrng_global_state_s *gs) {
+  return otrng_keypair_pool_refill(gs->keypair_pool);
+}
+
+API void
+otrng_global_state_set_keypair_generation_threads(otrng_global_state_s *gs,
+                                                  unsigned int num_threads) {
+  otrng_keypair_pool_set_threads(gs->keypair_pool, num_threads);
 }
 
 INTERNAL void
@@ -637,6 +753,23 @@ otrng_global_state_fingerprints_v3_loaded(otrng_global_state_s *gs) {
   gs->fingerprints_v3_loaded = otrng_true;
 }
 
+INTERNAL void otrng_global_state_init_lock_v3(otrng_global_state_s *gs) {
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&gs->user_state_v3_lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+INTERNAL void otrng_global_state_lock_v3(otrng_global_state_s *gs) {
+  pthread_mutex_lock(&gs->user_state_v3_lock);
+}
+
+INTERNAL void otrng_global_state_unlock_v3(otrng_global_state_s *gs) {
+  pthread_mutex_unlock(&gs->user_state_v3_lock);
+}
+
 #ifdef DEBUG_API
 
 #include "debug.h"
@@ -644,8 +777,10 @@ otrng_global_state_fingerprints_v3_loaded(otrng_global_state_s *gs) {
 static const char **debug_print_ignores = NULL;
 static size_t debug_print_ignores_len;
 static size_t debug_print_ignores_cap;
+static pthread_mutex_t debug_print_ignores_lock = PTHREAD_MUTEX_INITIALIZER;
 
 API void otrng_add_debug_print_ignore(const char *ign) {
+  pthread_mutex_lock(&debug_print_ignores_lock);
   if (debug_print_ignores == NULL) {
     debug_print_ignores = otrng_xmalloc(7 * sizeof(char *));
 
@@ -661,18 +796,29 @@ API void otrng_add_debug_print_ignore(const char *ign) {
 
   debug_print_ignores[debug_print_ignores_len] = ign;
   debug_print_ignores_len++;
+  pthread_mutex_unlock(&debug_print_ignores_lock);
 }
 
-API void otrng_clear_debug_print_ignores() { debug_print_ignores_len = 0; }
+API void otrng_clear_debug_print_ignores() {
+  pthread_mutex_lock(&debug_print_ignores_lock);
+  debug_print_ignores_len = 0;
+  pthread_mutex_unlock(&debug_print_ignores_lock);
+}
 
 API otrng_bool otrng_debug_print_should_ignore(const char *ign) {
   size_t ix;
+  otrng_bool ignore = otrng_false;
+
+  pthread_mutex_lock(&debug_print_ignores_lock);
   for (ix = 0; ix < debug_print_ignores_len; ix++) {
     if (strcmp(ign, debug_print_ignores[ix]) == 0) {
-      return otrng_true;
+      ignore = otrng_true;
+      break;
     }
   }
-  return otrng_false;
+  pthread_mutex_unlock(&debug_print_ignores_lock);
+
+  return ignore;
 }
 
 API void otrng_client_id_debug_print(FILE *f,
@@ -51,15 +51,47 @@
  * otrng_messaging_client_receiving(client, alice_talking_to_bob);
  */
 
+/*
+ * Threads
+ *
+ * The clients of a global state can be split in shards, each one used by a
+ * single worker thread. A client, its conversations and everything reached
+ * from them are owned by the thread using the client, and must not be used by
+ * another thread at the same time. The callbacks for a client are called from
+ * the thread using it, and must not use other clients.
+ *
+ * What the clients share is safe to use from any thread: finding and adding
+ * clients with otrng_client_get, the keypair pool and the v3 user state. Each
+ * worker calls otrng_client_poll for its clients, and one of the threads calls
+ * otrng_global_state_poll.
+ *
+ * Creating and freeing the global state, reading and writing keys, profiles
+ * and fingerprints (the *_read_from, *_write_to and do_all functions), and
+ * otrng_poll and otrng_global_state_next_deadline, use every client, and must
+ * not run while the workers do.
+ */
+
+#include <pthread.h>
+
 #include "client.h"
+#include "hash_table.h"
+#include "keypair_pool.h"
 #include "list.h"
 #include "shared.h"
 
 typedef struct otrng_global_state_s {
   list_element_s *clients;
+  /*@null@*/ list_element_s *last_client; /* The last element of clients */
+  hash_table_s *client_index; /* The clients, keyed by protocol and account */
+  pthread_mutex_t clients_lock; /* Protects clients and client_index */
+  keypair_pool_s *keypair_pool; /* Ephemeral keypairs generated ahead of time */
 
   const otrng_client_callbacks_s *callbacks;
   OtrlUserState user_state_v3;
+  /* Held while libotr uses user_state_v3. libotr calls back into the
+     application, which can call back into the library, so the lock is
+     recursive. */
+  pthread_mutex_t user_state_v3_lock;
   otrng_bool fingerprints_v3_loaded;
 } otrng_global_state_s;
 
@@ -68,9 +100,24 @@ otrng_global_state_new(const otrng_client_callbacks_s *cb, otrng_bool die);
 
 API void otrng_global_state_free(otrng_global_state_s *gs);
 
+/**
+ * @brief Finds the client with the given id, creating it if there is none. It
+ * can be called from any thread.
+ */
 API otrng_client_s *otrng_client_get(otrng_global_state_s *gs,
                                      const otrng_client_id_s client_id);
 
+/**
+ * @brief Adds a client to the global state, and makes the global state the
+ * owner of the client.
+ *
+ * @param [gs]      The global state.
+ * @param [client]  The client. No other client with the same client id may
+ *                  have been added.
+ */
+INTERNAL void otrng_global_state_add_client(otrng_global_state_s *gs,
+                                            otrng_client_s *client);
+
 API otrng_result otrng_global_state_instag_generate_into(
     otrng_global_state_s *gs, const otrng_client_id_s client_id, FILE *instag);
 
@@ -157,6 +204,22 @@ API otrng_result otrng_global_state_fingerprints_v4_read_from(
     otrng_global_state_s *gs, FILE *fp,
     otrng_client_id_s (*read_client_id_for_key)(FILE *filep));
 
+/**
+ * @brief Reads all the fingerprints in a v4 fingerprint file at once,
+ * replacing the ones known. The lines that can not be parsed are skipped.
+ *
+ * @param [gs]          The global state.
+ * @param [fp]          The file.
+ * @param [on_bad_line] If not NULL, called with the number, from 1, of each
+ *                      line skipped.
+ * @param [context]     Passed to [on_bad_line].
+ *
+ * @return OTRNG_ERROR only if [fp] could not be read.
+ */
+API otrng_result otrng_global_state_fingerprints_v4_read_all_from(
+    otrng_global_state_s *gs, FILE *fp,
+    void (*on_bad_line)(size_t line_number, void *context), void *context);
+
 API otrng_result otrng_global_state_fingerprints_v3_read_from(
     otrng_global_state_s *gs, FILE *fp,
     otrng_client_id_s (*read_client_id_for_key)(FILE *filep));
@@ -183,12 +246,88 @@ API void otrng_global_state_do_all_fingerprints_v3(
  * The function should be called every few minutes in order to clean
  * up expired resources. If it's not called properly, forward secrecy
  * could be impacted.
+ *
+ * It polls every client, and must not run while other threads use them. When
+ * the clients are used by several threads, call otrng_client_poll and
+ * otrng_global_state_poll instead.
  */
 API void otrng_poll(otrng_global_state_s *gs);
 
+/**
+ * @brief Does the part of otrng_poll that is not about any one client. It can
+ * be called from any thread.
+ */
+API void otrng_global_state_poll(otrng_global_state_s *gs);
+
+/**
+ * @brief Finds when the next session or fragment of any client expires, so
+ * otrng_poll can be called right then instead of at a fixed interval.
+ *
+ * otrng_poll should still be called every few minutes, for the work it does
+ * that has no deadline.
+ *
+ * @param [deadline] Receives the time, as returned by time(), otrng_poll
+ * should be called at. It may already have passed.
+ * @param [gs]       The global state.
+ *
+ * @return otrng_false if nothing is waiting to expire.
+ */
+API otrng_bool
+otrng_global_state_next_deadline(time_t *deadline,
+                                 const otrng_global_state_s *gs);
+
+/**
+ * @brief Sets how many ephemeral ECDH and DH keypairs are generated ahead of
+ * time.
+ *
+ * Without a pool, the keypairs are generated when a conversation ratchets and
+ * when prekey messages are built. With a pool, they are generated by otrng_poll
+ * or otrng_global_state_refill_keypair_pool, and taken from the pool when they
+ * are needed. The default depth is 0, which disables the pool.
+ *
+ * @param [gs]    The global state.
+ * @param [depth] The number of keypairs of each kind to keep in the pool.
+ */
+API void otrng_global_state_set_keypair_pool_depth(otrng_global_state_s *gs,
+                                                   size_t depth);
+
+/**
+ * @brief Fills the keypair pool up to its depth.
+ *
+ * It is called by otrng_poll. It can also be called from a worker thread of
+ * the application, since the pool is locked while being modified.
+ */
+API otrng_result
+otrng_global_state_refill_keypair_pool(otrng_global_state_s *gs);
+
+/**
+ * @brief Sets how many threads generate the keypairs of new prekey messages.
+ * The default is 1, which generates them in the calling thread.
+ *
+ * @param [gs]          The global state.
+ * @param [num_threads] The number of threads.
+ */
+API void
+otrng_global_state_set_keypair_generation_threads(otrng_global_state_s *gs,
+                                                  unsigned int num_threads);
+
 INTERNAL void
 otrng_global_state_fingerprints_v3_loaded(otrng_global_state_s *gs);
 
+/**
+ * @brief Initializes the lock of the v3 user state, which the thread holding
+ * it can take again.
+ */
+INTERNAL void otrng_global_state_init_lock_v3(otrng_global_state_s *gs);
+
+/**
+ * @brief Takes the lock of the v3 user state. It must be held while libotr
+ * uses it.
+ */
+INTERNAL void otrng_global_state_lock_v3(otrng_global_state_s *gs);
+
+INTERNAL void otrng_global_state_unlock_v3(otrng_global_state_s *gs);
+
 #ifdef DEBUG_API
 
 API void otrng_global_state_debug_print(FILE *, int, otrng_global_state_s *gs);
@@ -212,6 +351,9 @@ tstatic otrng_result otrng_global_state_add_forging_key(
 tstatic otrng_client_s *get_client(otrng_global_state_s *gs,
                                    const otrng_client_id_s client_id);
 
+tstatic /*@null@*/ otrng_client_s *
+find_client(const otrng_global_state_s *gs, const otrng_client_id_s client_id);
+
 #endif
 
 #endif
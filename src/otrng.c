@@ -29,6 +29,7 @@
 #pragma clang diagnostic pop
 #endif
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -162,15 +163,18 @@ INTERNAL otrng_s *otrng_new(otrng_client_s *client, otrng_policy_s policy) {
   otr->running_version = OTRNG_PROTOCOL_VERSION_NONE;
 
   otr->keys = otrng_key_manager_new();
+  otr->keys->keypair_pool = otrng_client_get_keypair_pool(client);
   otr->smp = otrng_secure_alloc(sizeof(smp_protocol_s));
 
+  otr->pending_fragments.timers = otrng_client_get_timers(client);
+  otr->pending_fragments.expiration_time = client->fragments_exp_time;
+  otr->pending_fragments.max_message_len = client->max_fragmented_msg_len;
+
   otrng_smp_protocol_init(otr->smp);
 
   return otr;
 }
 
-static void free_fragment_context(void *p) { otrng_fragment_context_free(p); }
-
 tstatic void otrng_destroy(/*@only@ */ otrng_s *otr) {
   otrng_free(otr->peer);
 
@@ -187,8 +191,7 @@ tstatic void otrng_destroy(/*@only@ */ otrng_s *otr) {
   otrng_secure_free(otr->smp);
   otr->smp = NULL;
 
-  otrng_list_free(otr->pending_fragments, free_fragment_context);
-  otr->pending_fragments = NULL;
+  otrng_fragment_contexts_destroy(&otr->pending_fragments);
 
   otrng_v3_conn_free(otr->v3_conn);
   otr->v3_conn = NULL;
@@ -1447,6 +1450,7 @@ tstatic otrng_result receive_identity_message_on_state_start(
 tstatic void forget_our_keys(otrng_s *otr) {
   otrng_key_manager_destroy(otr->keys);
   otrng_key_manager_init(otr->keys);
+  otr->keys->keypair_pool = otrng_client_get_keypair_pool(otr->client);
 }
 
 tstatic otrng_result receive_identity_message_on_waiting_auth_r(
@@ -1798,11 +1802,15 @@ tstatic otrng_result receive_auth_i(char **dst, const uint8_t *buffer,
   return otrng_parse_tlvs(tlvs_start + 1, tlvs_len);
 }
 
+/* The plaintext is the message, a NUL and the TLVs. It is decrypted once into
+   a NUL-terminated buffer that is handed over as the message to display, after
+   the TLVs are parsed out of it and wiped. */
 tstatic otrng_result decrypt_data_message(otrng_response_s *response,
                                           const k_msg_enc enc_key,
                                           const data_message_s *msg) {
   string_p *dst = &response->to_display;
   uint8_t *plain;
+  size_t text_len;
   uint8_t actual_enc_key[ENC_ACTUAL_KEY_BYTES];
   int err;
 
@@ -1815,8 +1823,7 @@ tstatic otrng_result decrypt_data_message(otrng_response_s *response,
   otrng_memdump(msg->nonce, DATA_MSG_NONCE_BYTES);
 #endif
 
-  // TODO: @initialization What if message->enc_msg_len == 0?
-  plain = otrng_secure_alloc(msg->enc_msg_len);
+  plain = otrng_xmalloc(msg->enc_msg_len + 1);
 
   memcpy(actual_enc_key, enc_key, ENC_ACTUAL_KEY_BYTES);
   err = crypto_stream_xor(plain, msg->enc_msg, msg->enc_msg_len, msg->nonce,
@@ -1824,17 +1831,26 @@ tstatic otrng_result decrypt_data_message(otrng_response_s *response,
   otrng_secure_wipe(actual_enc_key, ENC_ACTUAL_KEY_BYTES);
 
   if (err) {
-    otrng_secure_free(plain);
+    otrng_secure_wipe(plain, msg->enc_msg_len);
+    otrng_free(plain);
     return OTRNG_ERROR;
   }
 
-  /* If plain != "" and msg->enc_msg_len != 0 */
-  if (otrng_strnlen((string_p)plain, msg->enc_msg_len)) {
-    *dst = otrng_xstrndup((char *)plain, msg->enc_msg_len);
+  plain[msg->enc_msg_len] = 0;
+  text_len = strlen((char *)plain);
+
+  if (text_len < msg->enc_msg_len) {
+    response->tlvs = deserialize_received_tlvs(plain, msg->enc_msg_len);
+    otrng_secure_wipe(plain + text_len, msg->enc_msg_len - text_len);
   }
 
-  response->tlvs = deserialize_received_tlvs(plain, msg->enc_msg_len);
-  otrng_secure_free(plain);
+  /* Nothing to display */
+  if (text_len == 0) {
+    otrng_free(plain);
+    return OTRNG_SUCCESS;
+  }
+
+  *dst = (string_p)plain;
   return OTRNG_SUCCESS;
 }
 
@@ -1984,9 +2000,6 @@ tstatic otrng_result otrng_receive_data_message_after_dake(
       otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
       otrng_data_message_free(msg);
 
-      if (tmp_receiving_ratchet->skipped_keys) {
-        otrng_list_free(tmp_receiving_ratchet->skipped_keys, otrng_secure_free);
-      }
       otrng_receiving_ratchet_destroy(tmp_receiving_ratchet);
 
       otrng_client_callbacks_handle_event(otr->client->global_state->callbacks,
@@ -2002,10 +2015,6 @@ tstatic otrng_result otrng_receive_data_message_after_dake(
         otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
         otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
 
-        if (tmp_receiving_ratchet->skipped_keys) {
-          otrng_list_free(tmp_receiving_ratchet->skipped_keys,
-                          otrng_secure_free);
-        }
         otrng_receiving_ratchet_destroy(tmp_receiving_ratchet);
 
         otrng_data_message_free(msg);
@@ -2015,10 +2024,6 @@ tstatic otrng_result otrng_receive_data_message_after_dake(
       if (msg->flags == MSG_FLAGS_IGNORE_UNREADABLE) {
         otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
         otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
-        if (tmp_receiving_ratchet->skipped_keys) {
-          otrng_list_free(tmp_receiving_ratchet->skipped_keys,
-                          otrng_secure_free);
-        }
         otrng_receiving_ratchet_destroy(tmp_receiving_ratchet);
         otrng_data_message_free(msg);
 
@@ -2028,7 +2033,8 @@ tstatic otrng_result otrng_receive_data_message_after_dake(
 
     otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
 
-    otrng_receiving_ratchet_copy(otr->keys, tmp_receiving_ratchet);
+    otrng_receiving_ratchet_copy(otr->keys, tmp_receiving_ratchet,
+                                 otr->client->max_stored_msg_keys);
     otrng_receiving_ratchet_destroy(tmp_receiving_ratchet);
 
     if (otrng_failed(receive_tlvs(response, otr))) {
@@ -2344,9 +2350,9 @@ tstatic otrng_result otrng_close_v4(string_p *to_send, otrng_s *otr) {
     return OTRNG_SUCCESS;
   }
 
-  ser_len = otrng_list_len(otr->keys->skipped_keys) * MAC_KEY_BYTES;
+  ser_len =
+      otrng_skipped_keys_store_len(otr->keys->skipped_keys) * MAC_KEY_BYTES;
   ser_mac_keys = otrng_reveal_mac_keys_on_tlv(otr->keys);
-  otr->keys->skipped_keys = NULL;
 
   disconnected = otrng_tlv_list_one(
       otrng_tlv_new(OTRNG_TLV_DISCONNECTED, ser_len, ser_mac_keys));
@@ -2476,7 +2482,11 @@ static otrng_result otrng_v3_init(otrng_bool die) {
   return OTRNG_SUCCESS;
 }
 
-API otrng_result otrng_init(otrng_bool die) {
+/* otrng_init can be called from several threads, but the library is only
+   initialized once. Nothing it sets up changes afterwards. */
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static otrng_result init(otrng_bool die) {
   const char *real;
   otrng_result r;
 
@@ -2519,6 +2529,17 @@ API otrng_result otrng_init(otrng_bool die) {
   }
 
   otrng_debug_init();
+  otrng_shake_init();
 
   return otrng_dh_init(die);
 }
+
+API otrng_result otrng_init(otrng_bool die) {
+  otrng_result r;
+
+  pthread_mutex_lock(&init_lock);
+  r = init(die);
+  pthread_mutex_unlock(&init_lock);
+
+  return r;
+}
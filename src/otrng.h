@@ -28,6 +28,7 @@
 #ifndef OTRNG_OTRNG_H
 #define OTRNG_OTRNG_H
 
+#include "alloc.h"
 #include "client_profile.h"
 #include "data_message.h"
 #include "fragment.h"
@@ -53,7 +54,11 @@
 #define UNUSED_ARG(x) (void)(x)
 
 #define OTRNG_INIT otrng_init(otrng_true)
-#define OTRNG_FREE otrng_dh_free()
+#define OTRNG_FREE                                                             \
+  do {                                                                         \
+    otrng_dh_free();                                                           \
+    otrng_secure_pool_free();                                                  \
+  } while (0)
 
 typedef struct otrng_response_s {
   string_p to_display;
@@ -35,7 +35,25 @@
 #include "otrng.h"
 #include "shared.h"
 
-INTERNAL otrng_result generate_padding(uint8_t **dst, size_t *dst_len,
-                                       size_t msg_len, const otrng_s *otr);
+/**
+ * @brief Calculates the size of the padding TLV for a message.
+ *
+ * @param [msg_len] The length of the message and the TLVs it carries.
+ * @param [otr] The conversation, whose client sets the padding.
+ *
+ * @return The size of the whole TLV, header included, or 0 if the message
+ * needs no padding.
+ */
+INTERNAL size_t otrng_padding_tlv_len(size_t msg_len, const otrng_s *otr);
+
+/**
+ * @brief Writes a padding TLV.
+ *
+ * @param [dst] The buffer to write to. It must have room for [tlv_len] bytes.
+ * @param [tlv_len] The size of the TLV, as returned by otrng_padding_tlv_len.
+ *
+ * @return The number of bytes written.
+ */
+INTERNAL size_t otrng_padding_tlv_serialize(uint8_t *dst, size_t tlv_len);
 
 #endif
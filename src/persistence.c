@@ -227,37 +227,6 @@ tstatic otrng_result otrng_client_read_from_prefix(FILE *fp, uint8_t **dec,
   return OTRNG_SUCCESS;
 }
 
-tstatic uint8_t **split_tab_delimited_file(char *line, size_t max,
-                                           size_t *len) {
-  uint8_t **result = otrng_xmalloc_z(sizeof(uint8_t *) * max);
-  size_t index = 0;
-  char *curr, *last, *eol;
-
-  last = (char *)line;
-
-  eol = strchr((char *)line, '\r');
-  if (!eol) {
-    eol = strchr((char *)line, '\n');
-  }
-  if (eol) {
-    *eol = '\0';
-  }
-
-  while (index < max) {
-    curr = strchr(last, '\t');
-    if (curr == NULL) {
-      result[index++] = (uint8_t *)last;
-      break;
-    }
-    *curr = '\0';
-    result[index++] = (uint8_t *)last;
-    last = curr + 1;
-  }
-
-  *len = index;
-  return result;
-}
-
 static const unsigned int hextable[] = {
     0,  0,  0,  0, 0, 0,  0,  0,  0,  0,  0,  0, 0, 0, 0, 0, 0, 0,  0,  0,
     0,  0,  0,  0, 0, 0,  0,  0,  0,  0,  0,  0, 0, 0, 0, 0, 0, 0,  0,  0,
@@ -297,63 +266,162 @@ tstatic void fingerprint_hex_to_bytes(otrng_known_fingerprint_s *fp,
   }
 }
 
-INTERNAL otrng_result otrng_client_fingerprint_v4_read_from(
-    otrng_global_state_s *gs, FILE *fp,
-    otrng_client_s *(*get_client)(otrng_global_state_s *,
-                                  const otrng_client_id_s)) {
-  char *line = NULL;
-  int len = 0;
-  uint8_t **items = NULL;
+/* Parses, in place, a line of the v4 fingerprint file without its end of
+   line: "username\taccount\tprotocol\tfingerprint[\ttrust]". [client] is the
+   client of the previous line, or NULL, and is replaced by this line's. */
+static otrng_result
+add_fingerprint_v4_line(otrng_global_state_s *gs, char *line,
+                        otrng_client_s *(*get_client)(otrng_global_state_s *,
+                                                      const otrng_client_id_s),
+                        otrng_client_s **client) {
+  char *items[5];
   size_t item_len = 0;
-  uint8_t *fp_human;
-  otrng_bool trusted = otrng_false;
+  size_t i;
+  char *curr = line, *tab;
   otrng_client_id_s client_id;
-  otrng_client_s *client;
   otrng_known_fingerprint_s *fpr;
 
-  assert(fp != NULL);
-  len = get_limited_line(&line, fp);
-  if (len < 0) {
-    return OTRNG_ERROR;
+  while (item_len < 5) {
+    items[item_len++] = curr;
+    tab = strchr(curr, '\t');
+    if (tab == NULL) {
+      break;
+    }
+    *tab = '\0';
+    curr = tab + 1;
   }
 
-  items = split_tab_delimited_file(line, 5, &item_len);
-
   if (item_len != 4 && item_len != 5) {
-    free(line);
-    free(items);
     return OTRNG_ERROR;
   }
 
-  client_id.account = (char *)items[1];
-  client_id.protocol = (char *)items[2];
-  fp_human = items[3];
-
-  if (strlen((char *)fp_human) != FPRINT_LEN_BYTES * 2) {
-    free(line);
-    free(items);
+  if (strlen(items[3]) != FPRINT_LEN_BYTES * 2) {
     return OTRNG_ERROR;
   }
 
-  if (item_len == 5 && strlen((char *)items[4]) > 0) {
-    trusted = otrng_true;
+  for (i = 0; i < FPRINT_LEN_BYTES * 2; i++) {
+    if (hextable_ok[(unsigned char)items[3][i]] == 0) {
+      return OTRNG_ERROR;
+    }
   }
 
-  client = get_client(gs, client_id);
+  client_id.account = items[1];
+  client_id.protocol = items[2];
 
-  if (client->fingerprints == NULL) {
-    client->fingerprints = otrng_xmalloc_z(sizeof(otrng_known_fingerprints_s));
+  /* The lines of a client usually come one after the other */
+  if (*client == NULL ||
+      strcmp((*client)->client_id.account, client_id.account) != 0 ||
+      strcmp((*client)->client_id.protocol, client_id.protocol) != 0) {
+    *client = get_client(gs, client_id);
+  }
+
+  if ((*client)->fingerprints == NULL) {
+    (*client)->fingerprints = otrng_known_fingerprints_new();
   }
 
   fpr = otrng_xmalloc_z(sizeof(otrng_known_fingerprint_s));
-  fpr->username = otrng_xstrdup((char *)items[0]);
-  fpr->trusted = trusted;
-  fingerprint_hex_to_bytes(fpr, (char *)fp_human);
+  fpr->username = otrng_xstrdup(items[0]);
+  if (item_len == 5 && strlen(items[4]) > 0) {
+    fpr->trusted = otrng_true;
+  }
+  fingerprint_hex_to_bytes(fpr, items[3]);
 
-  free(line);
-  free(items);
+  otrng_known_fingerprints_add((*client)->fingerprints, fpr);
 
-  client->fingerprints->fps = otrng_list_add(fpr, client->fingerprints->fps);
+  return OTRNG_SUCCESS;
+}
+
+INTERNAL otrng_result otrng_client_fingerprint_v4_read_from(
+    otrng_global_state_s *gs, FILE *fp,
+    otrng_client_s *(*get_client)(otrng_global_state_s *,
+                                  const otrng_client_id_s)) {
+  char *line = NULL;
+  otrng_client_s *client = NULL;
+  otrng_result result;
+
+  assert(fp != NULL);
+  if (get_limited_line(&line, fp) < 0) {
+    return OTRNG_ERROR;
+  }
+
+  line[strcspn(line, "\r\n")] = '\0';
+  result = add_fingerprint_v4_line(gs, line, get_client, &client);
+  otrng_free(line);
+
+  return result;
+}
+
+/* How much of the file is read at a time. The buffer grows if a line does
+   not fit. */
+#define FINGERPRINTS_READ_BYTES 65536
+
+INTERNAL otrng_result otrng_client_fingerprints_v4_read_all_from(
+    otrng_global_state_s *gs, FILE *fp,
+    otrng_client_s *(*get_client)(otrng_global_state_s *,
+                                  const otrng_client_id_s),
+    void (*on_bad_line)(size_t line_number, void *context), void *context) {
+  size_t buflen = FINGERPRINTS_READ_BYTES;
+  char *buf = otrng_xmalloc(buflen + 1);
+  size_t len = 0, line_number = 0;
+  otrng_bool eof = otrng_false;
+  otrng_client_s *client = NULL;
+
+  assert(fp != NULL);
+
+  while (!eof) {
+    size_t start = 0;
+    size_t got = fread(buf + len, 1, buflen - len, fp);
+
+    if (got < buflen - len) {
+      if (ferror(fp)) {
+        otrng_free(buf);
+        return OTRNG_ERROR;
+      }
+      eof = otrng_true;
+    }
+    len += got;
+
+    while (start < len) {
+      char *line = buf + start;
+      char *eol = memchr(line, '\n', len - start);
+      size_t line_len;
+
+      if (eol) {
+        line_len = eol - line;
+      } else if (eof) {
+        line_len = len - start;
+      } else {
+        break;
+      }
+
+      /* There is room for this past the last line, as buf has buflen + 1 */
+      line[line_len] = '\0';
+      start += line_len + 1;
+      line_number++;
+
+      line[strcspn(line, "\r")] = '\0';
+      if (line[0] == '\0') {
+        continue;
+      }
+
+      if (!add_fingerprint_v4_line(gs, line, get_client, &client) &&
+          on_bad_line) {
+        on_bad_line(line_number, context);
+      }
+    }
+
+    if (start >= len) {
+      len = 0;
+    } else if (start > 0) {
+      memmove(buf, buf + start, len - start);
+      len -= start;
+    } else if (len == buflen) {
+      buflen *= 2;
+      buf = otrng_xrealloc(buf, buflen + 1);
+    }
+  }
+
+  otrng_free(buf);
 
   return OTRNG_SUCCESS;
 }
@@ -431,9 +499,11 @@ INTERNAL otrng_result otrng_client_instance_tag_write_to(otrng_client_s *client,
                                                          FILE *instagf) {
   gcry_error_t ret;
 
+  otrng_global_state_lock_v3(client->global_state);
   ret = otrl_instag_generate_FILEp(client->global_state->user_state_v3, instagf,
                                    client->client_id.account,
                                    client->client_id.protocol);
+  otrng_global_state_unlock_v3(client->global_state);
 
   if (ret) {
     return OTRNG_ERROR;
@@ -449,7 +519,9 @@ otrng_client_instance_tag_read_from(otrng_client_s *client, FILE *instagf) {
     return OTRNG_ERROR;
   }
 
+  otrng_global_state_lock_v3(client->global_state);
   ret = otrl_instag_read_FILEp(client->global_state->user_state_v3, instagf);
+  otrng_global_state_unlock_v3(client->global_state);
 
   if (ret) {
     return OTRNG_ERROR;
@@ -460,8 +532,13 @@ otrng_client_instance_tag_read_from(otrng_client_s *client, FILE *instagf) {
 INTERNAL otrng_result
 otrng_client_private_key_v3_read_from(const otrng_client_s *client, FILE *fp) {
   OtrlUserState us = client->global_state->user_state_v3;
+  gcry_error_t ret;
 
-  if (otrl_privkey_read_FILEp(us, fp)) {
+  otrng_global_state_lock_v3(client->global_state);
+  ret = otrl_privkey_read_FILEp(us, fp);
+  otrng_global_state_unlock_v3(client->global_state);
+
+  if (ret) {
     return OTRNG_ERROR;
   }
 
@@ -654,13 +731,13 @@ static otrng_result serialize_and_store_prekey(const prekey_message_s *prekey,
 INTERNAL otrng_result
 otrng_client_prekeys_write_to(const otrng_client_s *client, FILE *prekeyf) {
   char *storage_id;
-  list_element_s *current;
+  const prekey_store_entry_s *current;
 
   if (!prekeyf) {
     return OTRNG_ERROR;
   }
 
-  if (!client->our_prekeys) {
+  if (!client->our_prekeys.first) {
     return OTRNG_ERROR;
   }
 
@@ -669,9 +746,9 @@ otrng_client_prekeys_write_to(const otrng_client_s *client, FILE *prekeyf) {
     return OTRNG_ERROR;
   }
 
-  current = client->our_prekeys;
+  current = client->our_prekeys.first;
   while (current) {
-    if (!serialize_and_store_prekey(current->data, storage_id, prekeyf)) {
+    if (!serialize_and_store_prekey(current->msg, storage_id, prekeyf)) {
       otrng_free(storage_id);
       return OTRNG_ERROR;
     }
@@ -705,7 +782,7 @@ static otrng_result read_and_deserialize_prekey(otrng_client_s *client,
     return result;
   }
 
-  client->our_prekeys = otrng_list_add(prekey_msg, client->our_prekeys);
+  otrng_prekey_store_add(&client->our_prekeys, prekey_msg);
 
   return OTRNG_SUCCESS;
 }
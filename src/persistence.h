@@ -91,6 +91,25 @@ INTERNAL otrng_result otrng_client_fingerprint_v4_read_from(
     otrng_client_s *(*get_client)(otrng_global_state_s *,
                                   const otrng_client_id_s));
 
+/**
+ * @brief Reads all the v4 fingerprints in [fp], parsing them in the buffer
+ * they are read into. The lines that can not be parsed are skipped.
+ *
+ * @param [gs]          The global state.
+ * @param [fp]          The file.
+ * @param [get_client]  Returns the client of a line.
+ * @param [on_bad_line] If not NULL, called with the number, from 1, of each
+ *                      line skipped.
+ * @param [context]     Passed to [on_bad_line].
+ *
+ * @return OTRNG_ERROR only if [fp] could not be read.
+ */
+INTERNAL otrng_result otrng_client_fingerprints_v4_read_all_from(
+    otrng_global_state_s *gs, FILE *fp,
+    otrng_client_s *(*get_client)(otrng_global_state_s *,
+                                  const otrng_client_id_s),
+    void (*on_bad_line)(size_t line_number, void *context), void *context);
+
 INTERNAL otrng_result
 otrng_client_fingerprints_v4_write_to(const otrng_client_s *client, FILE *fp);
 
@@ -362,6 +362,12 @@ otrng_prekey_ensure_manager(/*@notnull@*/ struct otrng_client_s *client,
 
   client->prekey_manager->our_identity = otrng_xstrdup(identity);
   client->prekey_manager->client = client;
+  client->prekey_manager->pending_fragments.timers =
+      otrng_client_get_timers(client);
+  client->prekey_manager->pending_fragments.expiration_time =
+      client->fragments_exp_time;
+  client->prekey_manager->pending_fragments.max_message_len =
+      client->max_fragmented_msg_len;
   client->prekey_manager->publication_policy =
       otrng_xmalloc_z(sizeof(otrng_prekey_publication_policy_s));
 
@@ -1266,7 +1272,7 @@ static void hash_prekey_profile_for_publication_message(
   }
 }
 
-static otrng_result dake3_message_append_prekey_publication_message(
+tstatic otrng_result dake3_message_append_prekey_publication_message(
     otrng_prekey_publication_message_s *pub_msg,
     otrng_prekey_dake3_message_s *dake_3, uint8_t mac_key[MAC_KEY_BYTES],
     uint8_t mac[HASH_BYTES]) {
@@ -1373,30 +1379,27 @@ API otrng_result otrng_prekey_publish(/*@notnull@*/ char **new_msg,
 API void otrng_prekey_add_prekey_messages_for_publication(
     /*@notnull@*/ otrng_client_s *client,
     /*@notnull@*/ otrng_prekey_publication_message_s *msg) {
-  const size_t max = otrng_list_len(client->our_prekeys);
-  size_t real = 0;
-  prekey_message_s **msg_list = otrng_xmalloc(max * sizeof(prekey_message_s *));
-  list_element_s *current = client->our_prekeys;
+  size_t max, real, i;
+  prekey_message_s **msg_list;
 
   assert(client);
   assert(msg);
 
-  for (; current; current = current->next) {
-    prekey_message_s *pm = current->data;
-    if (pm->should_publish && !pm->is_publishing) {
-      msg_list[real] = otrng_prekey_message_create_copy(pm);
-      pm->is_publishing = otrng_true;
-      real++;
-    }
+  max = otrng_prekey_store_num_unpublished(&client->our_prekeys);
+  msg->num_prekey_messages = 0;
+  if (max == 0) {
+    return;
   }
 
-  assert(real <= max);
+  msg_list = otrng_xmalloc(max * sizeof(prekey_message_s *));
+  real = otrng_prekey_store_start_publishing(msg_list, &client->our_prekeys);
+  assert(real == max);
 
-  if (real != 0) {
-    // Since we are shrinking the array, there is no way this can fail, so no
-    // need to check the result
-    msg->prekey_messages = realloc(msg_list, real * sizeof(prekey_message_s *));
+  for (i = 0; i < real; i++) {
+    msg_list[i] = otrng_prekey_message_create_copy(msg_list[i]);
   }
+
+  msg->prekey_messages = msg_list;
   msg->num_prekey_messages = real;
 }
 
@@ -1423,7 +1426,6 @@ static void otrng_prekey_server_free(otrng_prekey_server_s *server) {
   otrng_free(server);
 }
 
-static void free_fragment_context(void *p) { otrng_fragment_context_free(p); }
 static void free_server_identity(void *p) { otrng_prekey_server_free(p); }
 
 INTERNAL void otrng_prekey_manager_free(otrng_prekey_manager_s *manager) {
@@ -1435,7 +1437,7 @@ INTERNAL void otrng_prekey_manager_free(otrng_prekey_manager_s *manager) {
   otrng_free(manager->publication_policy);
   otrng_free(manager->callbacks);
 
-  otrng_list_free(manager->pending_fragments, free_fragment_context);
+  otrng_fragment_contexts_destroy(&manager->pending_fragments);
   otrng_list_free(manager->server_identities, free_server_identity);
   if (manager->request_for_account != NULL) {
     prekey_request_free(manager->request_for_account);
@@ -33,6 +33,7 @@
 #define OTRNG_PREKEY_MANAGER_H
 
 #include "error.h"
+#include "fragment.h"
 #include "keys.h"
 #include "list.h"
 #include "prekey_client_dake.h"
@@ -168,7 +169,7 @@ typedef struct {
    */
   time_t request_for_account_at;
 
-  /*@null@*/ list_element_s *pending_fragments;
+  fragment_contexts_s pending_fragments;
 
   /*@notnull@*/ otrng_prekey_publication_policy_s *publication_policy;
 
@@ -356,6 +357,11 @@ tstatic char *send_dake3(struct otrng_client_s *client,
                          otrng_prekey_request_s *request,
                          const otrng_prekey_dake2_message_s *msg);
 
+tstatic otrng_result dake3_message_append_prekey_publication_message(
+    otrng_prekey_publication_message_s *pub_msg,
+    otrng_prekey_dake3_message_s *dake_3, uint8_t mac_key[MAC_KEY_BYTES],
+    uint8_t mac[HASH_BYTES]);
+
 #endif
 
 #endif
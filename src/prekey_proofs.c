@@ -113,6 +113,7 @@ INTERNAL otrng_bool otrng_ecdh_proof_verify(ecdh_proof_s *px,
   uint8_t *p;
   goldilocks_448_point_p a;
   goldilocks_448_point_p curr;
+  ec_scalar *t;
   size_t p_len = PREKEY_PROOF_LAMBDA * values_len;
   uint8_t *cbuf;
   uint8_t *cbuf_curr;
@@ -130,41 +131,18 @@ INTERNAL otrng_bool otrng_ecdh_proof_verify(ecdh_proof_s *px,
   goldilocks_448_precomputed_scalarmul(a, goldilocks_448_precomputed_base,
                                        px->v);
 
-  goldilocks_448_point_copy(curr, goldilocks_448_point_identity);
-
-  for (i = 0; i + 1 < values_len; i += 2) {
-    goldilocks_448_scalar_p t1, t2;
-    goldilocks_448_point_p res;
-
-    goldilocks_448_scalar_decode_long(t1, p + i * PREKEY_PROOF_LAMBDA,
-                                      PREKEY_PROOF_LAMBDA);
-    goldilocks_448_scalar_decode_long(t2, p + (i + 1) * PREKEY_PROOF_LAMBDA,
-                                      PREKEY_PROOF_LAMBDA);
-
-    goldilocks_448_point_double_scalarmul(res, values_pub[i], t1,
-                                          values_pub[i + 1], t2);
-    goldilocks_448_point_add(curr, curr, res);
-
-    goldilocks_448_scalar_destroy(t1);
-    goldilocks_448_scalar_destroy(t2);
-    goldilocks_448_point_destroy(res);
-  }
-
-  if (i < values_len) {
-    goldilocks_448_scalar_p t;
-    goldilocks_448_point_p res;
-
-    goldilocks_448_scalar_decode_long(t, p + i * PREKEY_PROOF_LAMBDA,
+  t = otrng_xmalloc_z(values_len * sizeof(ec_scalar));
+  for (i = 0; i < values_len; i++) {
+    goldilocks_448_scalar_decode_long(t[i], p + i * PREKEY_PROOF_LAMBDA,
                                       PREKEY_PROOF_LAMBDA);
-    goldilocks_448_point_scalarmul(res, values_pub[i], t);
-    goldilocks_448_point_add(curr, curr, res);
-
-    goldilocks_448_scalar_destroy(t);
-    goldilocks_448_point_destroy(res);
   }
-
   otrng_free(p);
 
+  /* Everything here is public, so the variable time multi-scalar
+     multiplication can be used */
+  otrng_ec_multi_scalarmul(curr, values_pub, (const ec_scalar *)t, values_len);
+  otrng_free(t);
+
   goldilocks_448_point_sub(a, a, curr);
   goldilocks_448_point_destroy(curr);
 
@@ -317,6 +295,15 @@ INTERNAL otrng_result otrng_dh_proof_generate(
   return OTRNG_SUCCESS;
 }
 
+static void release_mpis(dh_mpi *mpis, size_t len) {
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    otrng_dh_mpi_release(mpis[i]);
+  }
+  otrng_free(mpis);
+}
+
 INTERNAL otrng_bool otrng_dh_proof_verify(dh_proof_s *px,
                                           const dh_mpi *values_pub,
                                           const size_t values_len,
@@ -324,6 +311,7 @@ INTERNAL otrng_bool otrng_dh_proof_verify(dh_proof_s *px,
                                           const uint8_t usage) {
   uint8_t *p;
   dh_mpi mod, a, curr;
+  dh_mpi *t;
   size_t i;
   uint8_t *cbuf;
   uint8_t *cbuf_curr;
@@ -345,26 +333,25 @@ INTERNAL otrng_bool otrng_dh_proof_verify(dh_proof_s *px,
 
   mod = otrng_dh_modulus_p();
 
-  curr = gcry_mpi_new(DH3072_MOD_LEN_BITS);
-  gcry_mpi_set_ui(curr, 1);
-
+  t = otrng_xmalloc_z(values_len * sizeof(dh_mpi));
   p_curr = p;
   for (i = 0; i < values_len; i++) {
-    gcry_mpi_t t = NULL;
-    if (!otrng_dh_mpi_deserialize(&t, p_curr, PREKEY_PROOF_LAMBDA, &w)) {
+    if (!otrng_dh_mpi_deserialize(&t[i], p_curr, PREKEY_PROOF_LAMBDA, &w)) {
+      release_mpis(t, i);
       otrng_free(p);
       gcry_mpi_release(a);
-      otrng_dh_mpi_release(curr);
       return otrng_false;
     }
     p_curr += w;
-
-    gcry_mpi_powm(t, values_pub[i], t, mod);
-    gcry_mpi_mulm(curr, curr, t, mod);
-    otrng_dh_mpi_release(t);
   }
-
   otrng_free(p);
+
+  /* Everything here is public, so the variable time multi-exponentiation can
+     be used */
+  curr = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+  otrng_dh_multi_powm(curr, values_pub, (const dh_mpi *)t, values_len);
+  release_mpis(t, values_len);
+
   gcry_mpi_invm(curr, curr, mod);
   gcry_mpi_mulm(a, a, curr, mod);
   otrng_dh_mpi_release(curr);
@@ -0,0 +1,206 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#define OTRNG_PREKEY_STORE_PRIVATE
+
+#include "alloc.h"
+#include "prekey_store.h"
+
+static void count_flags(prekey_store_s *store, const prekey_message_s *msg,
+                        otrng_bool add) {
+  if (msg->should_publish) {
+    store->num_to_publish = add ? store->num_to_publish + 1
+                                : store->num_to_publish - 1;
+  }
+
+  if (msg->is_publishing) {
+    store->num_publishing = add ? store->num_publishing + 1
+                                : store->num_publishing - 1;
+  }
+}
+
+tstatic void prekey_store_unlink(prekey_store_s *store,
+                                 prekey_store_entry_s *entry) {
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    store->first = entry->next;
+  }
+
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    store->last = entry->prev;
+  }
+
+  otrng_hash_table_remove(store->index, &entry->msg->id,
+                          sizeof(entry->msg->id));
+  count_flags(store, entry->msg, otrng_false);
+  store->len--;
+}
+
+INTERNAL void otrng_prekey_store_destroy(prekey_store_s *store) {
+  prekey_store_entry_s *current = store->first;
+
+  while (current) {
+    prekey_store_entry_s *next = current->next;
+    otrng_prekey_message_free(current->msg);
+    otrng_free(current);
+    current = next;
+  }
+
+  otrng_hash_table_free(store->index, NULL);
+  memset(store, 0, sizeof(prekey_store_s));
+}
+
+INTERNAL void otrng_prekey_store_add(prekey_store_s *store,
+                                     prekey_message_s *msg) {
+  prekey_store_entry_s *entry;
+
+  otrng_prekey_store_delete(store, msg->id);
+
+  if (!store->index) {
+    store->index = otrng_hash_table_new();
+  }
+
+  entry = otrng_xmalloc_z(sizeof(prekey_store_entry_s));
+  entry->msg = msg;
+  entry->prev = store->last;
+
+  if (store->last) {
+    store->last->next = entry;
+  } else {
+    store->first = entry;
+  }
+  store->last = entry;
+
+  otrng_hash_table_put(store->index, &msg->id, sizeof(msg->id), entry);
+  count_flags(store, msg, otrng_true);
+  store->len++;
+}
+
+INTERNAL prekey_message_s *otrng_prekey_store_get(const prekey_store_s *store,
+                                                  uint32_t id) {
+  const prekey_store_entry_s *entry;
+
+  if (!store->index) {
+    return NULL;
+  }
+
+  entry = otrng_hash_table_get(store->index, &id, sizeof(id));
+  if (!entry) {
+    return NULL;
+  }
+
+  return entry->msg;
+}
+
+INTERNAL otrng_bool otrng_prekey_store_delete(prekey_store_s *store,
+                                              uint32_t id) {
+  prekey_store_entry_s *entry;
+
+  if (!store->index) {
+    return otrng_false;
+  }
+
+  entry = otrng_hash_table_get(store->index, &id, sizeof(id));
+  if (!entry) {
+    return otrng_false;
+  }
+
+  prekey_store_unlink(store, entry);
+  otrng_prekey_message_free(entry->msg);
+  otrng_free(entry);
+
+  return otrng_true;
+}
+
+INTERNAL size_t otrng_prekey_store_len(const prekey_store_s *store) {
+  return store->len;
+}
+
+INTERNAL size_t otrng_prekey_store_num_published(const prekey_store_s *store) {
+  return store->len - store->num_to_publish;
+}
+
+INTERNAL size_t
+otrng_prekey_store_num_unpublished(const prekey_store_s *store) {
+  return store->num_to_publish - store->num_publishing;
+}
+
+INTERNAL void otrng_prekey_store_set_should_publish(prekey_store_s *store,
+                                                    prekey_message_s *msg,
+                                                    otrng_bool value) {
+  count_flags(store, msg, otrng_false);
+  msg->should_publish = value;
+  count_flags(store, msg, otrng_true);
+}
+
+INTERNAL size_t otrng_prekey_store_start_publishing(prekey_message_s **dst,
+                                                    prekey_store_s *store) {
+  const size_t wanted = otrng_prekey_store_num_unpublished(store);
+  prekey_store_entry_s *current;
+  size_t num = 0;
+
+  for (current = store->first; current && num < wanted;
+       current = current->next) {
+    prekey_message_s *msg = current->msg;
+    if (msg->should_publish && !msg->is_publishing) {
+      msg->is_publishing = otrng_true;
+      dst[num++] = msg;
+    }
+  }
+
+  store->num_publishing += num;
+
+  return num;
+}
+
+static void finish_publishing(prekey_store_s *store, otrng_bool published) {
+  prekey_store_entry_s *current;
+
+  for (current = store->first; current && store->num_publishing > 0;
+       current = current->next) {
+    prekey_message_s *msg = current->msg;
+    if (msg->is_publishing) {
+      count_flags(store, msg, otrng_false);
+      msg->is_publishing = otrng_false;
+      if (published) {
+        msg->should_publish = otrng_false;
+      }
+      count_flags(store, msg, otrng_true);
+    }
+  }
+}
+
+INTERNAL otrng_bool otrng_prekey_store_published(prekey_store_s *store) {
+  if (store->num_publishing == 0) {
+    return otrng_false;
+  }
+
+  finish_publishing(store, otrng_true);
+  return otrng_true;
+}
+
+INTERNAL void otrng_prekey_store_failed_published(prekey_store_s *store) {
+  finish_publishing(store, otrng_false);
+}
@@ -0,0 +1,149 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * The prekey messages a client has created and not yet used, in the order they
+ * were stored. They are indexed by identifier, so the message a non-interactive
+ * DAKE refers to is found without walking the store, and the store keeps count
+ * of how many messages are waiting to be published.
+ */
+
+#ifndef OTRNG_PREKEY_STORE_H
+#define OTRNG_PREKEY_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+#include "prekey_message.h"
+#include "shared.h"
+
+typedef struct prekey_store_entry_s {
+  prekey_message_s *msg;
+  struct prekey_store_entry_s *prev;
+  struct prekey_store_entry_s *next;
+} prekey_store_entry_s;
+
+/*
+ * An all-zero store is empty. The flags of a stored message must only be
+ * changed through the functions in this file, so the counters stay right.
+ */
+typedef struct prekey_store_s {
+  /*@null@*/ prekey_store_entry_s *first;
+  /*@null@*/ prekey_store_entry_s *last;
+  /* The same entries, by identifier. Created with the first entry. */
+  /*@null@*/ hash_table_s *index;
+
+  size_t len;
+  size_t num_to_publish; /* Messages with should_publish set */
+  size_t num_publishing; /* Messages with is_publishing set */
+} prekey_store_s;
+
+/**
+ * @brief Frees every stored message, leaving [store] empty.
+ *
+ * @param [store] The store.
+ */
+INTERNAL void otrng_prekey_store_destroy(prekey_store_s *store);
+
+/**
+ * @brief Stores [msg] after the messages already stored. A stored message with
+ * the same identifier is freed and replaced.
+ *
+ * @param [store] The store.
+ * @param [msg]   The message. The store takes ownership of it.
+ */
+INTERNAL void otrng_prekey_store_add(prekey_store_s *store,
+                                     /*@only@*/ prekey_message_s *msg);
+
+/**
+ * @brief Finds the stored message with identifier [id].
+ *
+ * @return The message, or NULL.
+ */
+INTERNAL /*@null@*/ prekey_message_s *
+otrng_prekey_store_get(const prekey_store_s *store, uint32_t id);
+
+/**
+ * @brief Frees the stored message with identifier [id].
+ *
+ * @return otrng_true if there was such a message.
+ */
+INTERNAL otrng_bool otrng_prekey_store_delete(prekey_store_s *store,
+                                              uint32_t id);
+
+/**
+ * @return The number of stored messages.
+ */
+INTERNAL size_t otrng_prekey_store_len(const prekey_store_s *store);
+
+/**
+ * @return The number of stored messages that have been published.
+ */
+INTERNAL size_t otrng_prekey_store_num_published(const prekey_store_s *store);
+
+/**
+ * @return The number of stored messages waiting to be sent for publication.
+ */
+INTERNAL size_t otrng_prekey_store_num_unpublished(const prekey_store_s *store);
+
+/**
+ * @brief Sets whether the stored message [msg] should be published.
+ *
+ * @param [store] The store.
+ * @param [msg]   A message in [store].
+ * @param [value] The new value of its should_publish flag.
+ */
+INTERNAL void otrng_prekey_store_set_should_publish(prekey_store_s *store,
+                                                    prekey_message_s *msg,
+                                                    otrng_bool value);
+
+/**
+ * @brief Marks the messages waiting to be published as being published.
+ *
+ * @param [dst]   Receives the marked messages, which are still owned by
+ * [store]. It has room for otrng_prekey_store_num_unpublished() messages.
+ * @param [store] The store.
+ *
+ * @return The number of messages written to [dst].
+ */
+INTERNAL size_t otrng_prekey_store_start_publishing(prekey_message_s **dst,
+                                                    prekey_store_s *store);
+
+/**
+ * @brief Marks the messages being published as published.
+ *
+ * @return otrng_true if any message was being published.
+ */
+INTERNAL otrng_bool otrng_prekey_store_published(prekey_store_s *store);
+
+/**
+ * @brief Marks the messages being published as waiting to be published again.
+ */
+INTERNAL void otrng_prekey_store_failed_published(prekey_store_s *store);
+
+#ifdef OTRNG_PREKEY_STORE_PRIVATE
+
+tstatic void prekey_store_unlink(prekey_store_s *store,
+                                 prekey_store_entry_s *entry);
+
+#endif
+
+#endif
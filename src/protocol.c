@@ -20,19 +20,14 @@
 
 #include "protocol.h"
 
+#include "base64.h"
 #include "data_message.h"
 #include "debug.h"
 #include "messaging.h"
 #include "padding.h"
 #include "random.h"
 #include "serialize.h"
-
-#ifndef S_SPLINT_S
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wstrict-prototypes"
-#include <libotr/b64.h>
-#pragma clang diagnostic pop
-#endif
+#include "tlv.h"
 
 INTERNAL void maybe_create_keys(otrng_client_s *client) {
   const otrng_client_callbacks_s *cb = client->global_state->callbacks;
@@ -115,108 +110,91 @@ INTERNAL void otrng_error_message(string_p *to_send, otrng_err_code err_code) {
   }
 }
 
-tstatic otrng_result encrypt_data_message(data_message_s *data_msg,
-                                          const uint8_t *msg, size_t msg_len,
-                                          const k_msg_enc enc_key) {
-  uint8_t *c = NULL;
-  uint8_t actual_enc_key[ENC_ACTUAL_KEY_BYTES];
-  int err;
-
-  random_bytes(data_msg->nonce, DATA_MSG_NONCE_BYTES);
-
-  c = otrng_xmalloc_z(msg_len);
-
-  memcpy(actual_enc_key, enc_key, ENC_ACTUAL_KEY_BYTES);
-
-  err = crypto_stream_xor(c, msg, msg_len, data_msg->nonce, actual_enc_key);
-  otrng_secure_wipe(actual_enc_key, ENC_ACTUAL_KEY_BYTES);
-
-  if (err) {
-    otrng_free(c);
-    return OTRNG_ERROR;
-  }
-
-  data_msg->enc_msg_len = msg_len;
-  data_msg->enc_msg = c;
-
-#ifdef DEBUG
-  debug_print("\n");
-  debug_print("nonce = ");
-  otrng_memdump(data_msg->nonce, DATA_MSG_NONCE_BYTES);
-  debug_print("message = ");
-  otrng_memdump(msg, msg_len);
-  debug_print("cipher = ");
-  otrng_memdump(c, msg_len);
-#endif
-
-  return OTRNG_SUCCESS;
-}
-
-/*@null@*/ tstatic data_message_s *
-generate_data_message(const otrng_s *otr, const uint32_t ratchet_id) {
-  data_message_s *data_msg = otrng_data_message_new();
-  if (!data_msg) {
-    return NULL;
-  }
+tstatic void init_data_message(data_message_s *data_msg, const otrng_s *otr,
+                               const uint32_t ratchet_id,
+                               unsigned char flags) {
+  memset(data_msg, 0, sizeof(data_message_s));
 
   data_msg->sender_instance_tag = our_instance_tag(otr);
   data_msg->receiver_instance_tag = otr->their_instance_tag;
+  data_msg->flags = flags;
   data_msg->previous_chain_n = otr->keys->pn;
   data_msg->ratchet_id = ratchet_id;
   data_msg->message_id = otr->keys->j;
   otrng_ec_point_copy(data_msg->ecdh, our_ecdh(otr));
-  data_msg->dh = otrng_dh_mpi_copy(our_dh(otr));
 
-  return data_msg;
+  /* Borrowed: the message does not outlive the call that sends it */
+  data_msg->dh = our_dh(otr);
 }
 
-tstatic otrng_result serialize_and_encode_data_message(
-    string_p *dst, const k_msg_mac mac_key, uint8_t *to_reveal_mac_keys,
-    size_t to_reveal_mac_keys_len, const data_message_s *data_msg) {
-  uint8_t *body = NULL;
-  size_t body_len = 0;
-  size_t ser_len;
-  uint8_t *ser;
+/* Outgoing data messages are serialized straight into the buffer they are
+   base64-encoded in, at the offset that lets the encoding happen in place */
+tstatic uint8_t *data_message_encoder_new(uint8_t **ser, size_t max_ser_len) {
+  uint8_t *buffer = otrng_xmalloc(OTRNG_BASE64_OTR_ENCODE_LEN(max_ser_len));
 
-  if (!otrng_data_message_body_serialize(&body, &body_len, data_msg)) {
-    return OTRNG_ERROR;
-  }
+  *ser = buffer + OTRNG_BASE64_OTR_IN_PLACE_OFFSET(max_ser_len);
 
-  ser_len = body_len + MAC_KEY_BYTES + to_reveal_mac_keys_len;
-
-  ser = otrng_xmalloc_z(ser_len);
+  return buffer;
+}
 
-  memcpy(ser, body, body_len);
-  otrng_free(body);
+/* Appends the authenticator and the revealed MAC keys to the [body_len] bytes
+   serialized by the encoder, and encodes the result. Takes the buffer. */
+tstatic otrng_result data_message_encoder_finish(
+    string_p *dst, uint8_t *buffer, size_t max_ser_len, size_t body_len,
+    const k_msg_mac mac_key, const uint8_t *old_mac_keys,
+    size_t num_old_mac_keys) {
+  size_t offset = OTRNG_BASE64_OTR_IN_PLACE_OFFSET(max_ser_len);
+  uint8_t *ser = buffer + offset;
+  size_t ser_len = body_len + DATA_MSG_MAC_BYTES;
 
+  /* Authenticator = KDF_1(0x1A || MKmac || KDF_1(usage_authenticator ||
+   * data_message_sections, 64), 64) */
   if (otrng_failed(otrng_data_message_authenticator(
-          ser + body_len, MAC_KEY_BYTES, mac_key, ser, body_len))) {
-    otrng_free(ser);
+          ser + body_len, DATA_MSG_MAC_BYTES, mac_key, ser, body_len))) {
+    otrng_free(buffer);
     return OTRNG_ERROR;
   }
 
-  if (to_reveal_mac_keys) {
-    if (otrng_serialize_bytes_array(ser + body_len + DATA_MSG_MAC_BYTES,
-                                    to_reveal_mac_keys,
-                                    to_reveal_mac_keys_len) == 0) {
-      otrng_free(ser);
-      return OTRNG_ERROR;
-    }
+  if (old_mac_keys) {
+    ser_len += otrng_serialize_old_mac_keys(ser + ser_len, old_mac_keys,
+                                            num_old_mac_keys);
   }
 
-  *dst = otrl_base64_otr_encode(ser, ser_len);
+  *dst = otrng_base64_otr_encode_in_place(buffer, offset, ser_len);
 
-  otrng_free(ser);
   return OTRNG_SUCCESS;
 }
 
-tstatic otrng_result send_data_message(string_p *to_send, const uint8_t *msg,
-                                       size_t msg_len, otrng_s *otr,
+tstatic size_t tlvs_len(const tlv_list_s *tlvs) {
+  const tlv_list_s *current;
+  size_t len = 0;
+
+  for (current = tlvs; current; current = current->next) {
+    len += current->data->len + 4;
+  }
+
+  return len;
+}
+
+/* Builds the whole message in a single buffer: the plaintext (message, TLVs
+   and padding) is written where the ciphertext goes and encrypted in place,
+   then the message is authenticated and base64-encoded in place. */
+tstatic otrng_result send_data_message(string_p *to_send, const string_p msg,
+                                       const tlv_list_s *tlvs, otrng_s *otr,
                                        unsigned char flags) {
-  data_message_s *data_msg = NULL;
+  data_message_s data_msg;
   uint32_t ratchet_id = otr->keys->i;
   k_msg_enc enc_key;
   k_msg_mac mac_key;
+  uint8_t actual_enc_key[ENC_ACTUAL_KEY_BYTES];
+  const tlv_list_s *current;
+  const uint8_t *old_mac_keys = NULL;
+  size_t num_old_mac_keys = 0;
+  size_t msg_len, padding_len, enc_msg_len, max_ser_len;
+  size_t len = 0;
+  uint8_t *buffer, *ser, *enc_msg, *cursor;
+  otrng_result result;
+  int err;
 
   /* if j == 0 */
   if (!otrng_key_manager_derive_dh_ratchet_keys(
@@ -234,122 +212,79 @@ tstatic otrng_result send_data_message(string_p *to_send, const uint8_t *msg,
     return OTRNG_ERROR;
   }
 
-  data_msg = generate_data_message(otr, ratchet_id);
-  if (!data_msg) {
-    otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
-    otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
-    return OTRNG_ERROR;
-  }
-
-  data_msg->flags = flags;
-  data_msg->sender_instance_tag = our_instance_tag(otr);
-  data_msg->receiver_instance_tag = otr->their_instance_tag;
-
-  if (!encrypt_data_message(data_msg, msg, msg_len, enc_key)) {
-    otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
-    otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
-    otrng_data_message_free(data_msg);
-    return OTRNG_ERROR;
-  }
-
-  otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
-
-  /* Authenticator = KDF_1(0x1A || MKmac || KDF_1(usage_authenticator ||
-   * data_message_sections, 64), 64) */
   if (otr->keys->j == 0) {
-    size_t ser_mac_keys_len =
-        otrng_list_len(otr->keys->old_mac_keys) * MAC_KEY_BYTES;
-    uint8_t *ser_mac_keys =
-        otrng_serialize_old_mac_keys(otr->keys->old_mac_keys);
-    otr->keys->old_mac_keys = NULL;
-
-    if (!serialize_and_encode_data_message(to_send, mac_key, ser_mac_keys,
-                                           ser_mac_keys_len, data_msg)) {
-      otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
-      otrng_free(ser_mac_keys);
-      otrng_data_message_free(data_msg);
-
-      return OTRNG_ERROR;
-    }
-    otrng_free(ser_mac_keys);
-  } else {
-    if (!serialize_and_encode_data_message(to_send, mac_key, NULL, 0,
-                                           data_msg)) {
-      otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
-      otrng_data_message_free(data_msg);
-      return OTRNG_ERROR;
-    }
+    old_mac_keys = otr->keys->old_mac_keys;
+    num_old_mac_keys = otr->keys->num_old_mac_keys;
   }
 
-  otr->keys->j++;
+  msg_len = strlen(msg) + 1 + tlvs_len(tlvs);
+  padding_len = otrng_padding_tlv_len(msg_len, otr);
+  enc_msg_len = msg_len + padding_len;
 
-  otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
-  otrng_data_message_free(data_msg);
-
-  return OTRNG_SUCCESS;
-}
-
-tstatic otrng_result serialize_tlvs(uint8_t **dst, size_t *dst_len,
-                                    const tlv_list_s *tlvs) {
-  const tlv_list_s *current = tlvs;
-  uint8_t *cursor = NULL;
+  max_ser_len = DATA_MSG_MAX_BYTES + enc_msg_len + DATA_MSG_MAC_BYTES +
+                num_old_mac_keys * MAC_KEY_BYTES;
+  buffer = data_message_encoder_new(&ser, max_ser_len);
 
-  *dst = NULL;
-  *dst_len = 0;
+  init_data_message(&data_msg, otr, ratchet_id, flags);
+  random_bytes(data_msg.nonce, DATA_MSG_NONCE_BYTES);
 
-  if (!tlvs) {
-    return OTRNG_SUCCESS;
-  }
+  result = otrng_data_message_header_serialize(ser, max_ser_len, &len,
+                                               &data_msg);
+  otrng_ec_point_destroy(data_msg.ecdh);
 
-  for (*dst_len = 0; current; current = current->next) {
-    *dst_len += current->data->len + 4;
+  if (otrng_failed(result)) {
+    otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
+    otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
+    otrng_free(buffer);
+    return OTRNG_ERROR;
   }
 
-  *dst = otrng_xmalloc_z(*dst_len);
+  len += otrng_serialize_uint32(ser + len, enc_msg_len);
+  enc_msg = ser + len;
 
-  cursor = *dst;
+  cursor = (uint8_t *)otrng_stpcpy((char *)enc_msg, msg) + 1;
   for (current = tlvs; current; current = current->next) {
     cursor += otrng_tlv_serialize(cursor, current->data);
   }
+  otrng_padding_tlv_serialize(cursor, padding_len);
 
-  return OTRNG_SUCCESS;
-}
+  memcpy(actual_enc_key, enc_key, ENC_ACTUAL_KEY_BYTES);
+  otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
 
-tstatic otrng_result append_tlvs(uint8_t **dst, size_t *dst_len,
-                                 const string_p msg, const tlv_list_s *tlvs,
-                                 const otrng_s *otr) {
-  uint8_t *ser = NULL;
-  size_t len = 0;
-  size_t msg_len;
-  uint8_t *padding = NULL;
-  size_t padding_len = 0;
-  char *res;
+  err = crypto_stream_xor(enc_msg, enc_msg, enc_msg_len, data_msg.nonce,
+                          actual_enc_key);
+  otrng_secure_wipe(actual_enc_key, ENC_ACTUAL_KEY_BYTES);
 
-  if (!serialize_tlvs(&ser, &len, tlvs)) {
+  if (err) {
+    otrng_secure_wipe(enc_msg, enc_msg_len);
+    otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
+    otrng_free(buffer);
     return OTRNG_ERROR;
   }
 
-  /* Append padding */
-  msg_len = strlen(msg) + 1 + len;
-  if (!generate_padding(&padding, &padding_len, msg_len, otr)) {
-    otrng_free(ser);
-    return OTRNG_ERROR;
-  }
+#ifdef DEBUG
+  debug_print("\n");
+  debug_print("nonce = ");
+  otrng_memdump(data_msg.nonce, DATA_MSG_NONCE_BYTES);
+  debug_print("cipher = ");
+  otrng_memdump(enc_msg, enc_msg_len);
+#endif
 
-  *dst_len = msg_len + padding_len;
-  *dst = otrng_xmalloc_z(*dst_len);
+  len += enc_msg_len;
 
-  res = otrng_stpcpy((char *)*dst, msg);
-  if (ser) {
-    memcpy(res + 1, ser, len);
+  result = data_message_encoder_finish(to_send, buffer, max_ser_len, len,
+                                       mac_key, old_mac_keys, num_old_mac_keys);
+  otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
+
+  if (otr->keys->j == 0) {
+    otrng_forget_old_mac_keys(otr->keys);
   }
 
-  if (padding) {
-    memcpy(*dst + msg_len, padding, padding_len);
+  if (otrng_failed(result)) {
+    return OTRNG_ERROR;
   }
 
-  otrng_free(ser);
-  otrng_free(padding);
+  otr->keys->j++;
 
   return OTRNG_SUCCESS;
 }
@@ -359,10 +294,6 @@ INTERNAL otrng_result otrng_prepare_to_send_data_message(string_p *to_send,
                                                          const tlv_list_s *tlvs,
                                                          otrng_s *otr,
                                                          unsigned char flags) {
-  uint8_t *msg2 = NULL;
-  size_t msg_len = 0;
-  otrng_result result;
-
   if (otr->state == OTRNG_STATE_FINISHED) {
     otrng_client_callbacks_handle_event(otr->client->global_state->callbacks,
                                         OTRNG_MSG_EVENT_CONNECTION_ENDED);
@@ -377,22 +308,13 @@ INTERNAL otrng_result otrng_prepare_to_send_data_message(string_p *to_send,
     return OTRNG_ERROR;
   }
 
-  if (!append_tlvs(&msg2, &msg_len, msg, tlvs, otr)) {
-    return OTRNG_ERROR;
-  }
-
-  result = send_data_message(to_send, msg2, msg_len, otr, flags);
-  if (result == OTRNG_ERROR) {
+  if (!send_data_message(to_send, msg, tlvs, otr, flags)) {
     otrng_client_callbacks_handle_event(otr->client->global_state->callbacks,
                                         OTRNG_MSG_EVENT_ENCRYPTION_ERROR);
-    otrng_free(msg2);
-
     return OTRNG_ERROR;
   }
 
   otr->last_sent = time(NULL);
 
-  otrng_free(msg2);
-
   return OTRNG_SUCCESS;
 }
@@ -29,6 +29,7 @@
 #define OTRNG_PROTOCOL_H
 
 #include "client_profile.h"
+#include "fragment.h"
 #include "key_management.h"
 #include "prekey_profile.h"
 #include "smp_protocol.h"
@@ -93,7 +94,7 @@ typedef struct otrng_s {
   key_manager_s *keys;
   smp_protocol_s *smp;
 
-  list_element_s *pending_fragments;
+  fragment_contexts_s pending_fragments;
 
   time_t last_sent; // TODO: @refactoring not sure if the best place to put
 
@@ -126,9 +127,13 @@ INTERNAL void otrng_error_message(string_p *to_send, otrng_err_code err_code);
 
 #ifdef OTRNG_PROTOCOL_PRIVATE
 
-tstatic otrng_result serialize_and_encode_data_message(
-    string_p *dst, const k_msg_mac mac_key, uint8_t *to_reveal_mac_keys,
-    size_t to_reveal_mac_keys_len, const data_message_s *data_msg);
+tstatic uint8_t *data_message_encoder_new(uint8_t **ser, size_t max_ser_len);
+
+tstatic otrng_result data_message_encoder_finish(
+    string_p *dst, uint8_t *buffer, size_t max_ser_len, size_t body_len,
+    const k_msg_mac mac_key, const uint8_t *old_mac_keys,
+    size_t num_old_mac_keys);
+
 #endif
 
 #endif
@@ -40,6 +40,14 @@ typedef void *(*random_generator)(size_t);
 typedef void (*random_bytes_generator)(void *, size_t);
 
 random_bytes_generator otrng_get_current_randomness(void);
+
+/**
+ * @brief Replaces where random bytes come from, which is only done by tests.
+ * The generator is read without a lock, so it must be replaced before any
+ * other thread uses the library.
+ *
+ * @return The generator that was used before.
+ */
 random_bytes_generator
 otrng_set_current_randomness(random_bytes_generator new_randomness);
 
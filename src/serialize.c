@@ -174,29 +174,19 @@ INTERNAL size_t otrng_serialize_ring_sig(uint8_t *dst,
   return cursor - dst;
 }
 
-/*@null@*/ INTERNAL uint8_t *
-otrng_serialize_old_mac_keys(list_element_s *old_mac_keys) {
-  size_t num_mac_keys = otrng_list_len(old_mac_keys);
-  size_t serlen = num_mac_keys * MAC_KEY_BYTES;
-  uint8_t *ser_mac_keys;
-  unsigned int i;
-
-  if (serlen == 0) {
-    return NULL;
-  }
-
-  ser_mac_keys = otrng_xmalloc(serlen);
+INTERNAL size_t otrng_serialize_old_mac_keys(uint8_t *dst,
+                                             const uint8_t *old_mac_keys,
+                                             size_t num_mac_keys) {
+  uint8_t *cursor = dst;
+  size_t i;
 
-  for (i = 0; i < num_mac_keys; i++) {
-    list_element_s *last = otrng_list_get_last(old_mac_keys);
-    memcpy(ser_mac_keys + i * MAC_KEY_BYTES, last->data, MAC_KEY_BYTES);
-    old_mac_keys = otrng_list_remove_element(last, old_mac_keys);
-    otrng_list_free(last, otrng_secure_free);
+  /* Stored oldest first, revealed newest first */
+  for (i = num_mac_keys; i > 0; i--) {
+    memcpy(cursor, old_mac_keys + (i - 1) * MAC_KEY_BYTES, MAC_KEY_BYTES);
+    cursor += MAC_KEY_BYTES;
   }
 
-  otrng_list_free_nodes(old_mac_keys);
-
-  return ser_mac_keys;
+  return cursor - dst;
 }
 
 INTERNAL size_t otrng_serialize_phi(uint8_t *dst,
@@ -92,12 +92,18 @@ INTERNAL size_t otrng_serialize_shared_prekey(
     uint8_t *dst, const otrng_shared_prekey_pub shared_prekey);
 
 /**
- * @brief Serialize the old mac keys to reveal.
+ * @brief Serialize the old mac keys to reveal, newest first.
  *
- * @param [old_mac_keys]   The list of old mac keys.
+ * @param [dst]            The destination, at least
+ *                         num_mac_keys * MAC_KEY_BYTES long.
+ * @param [old_mac_keys]   The contiguous old mac keys, oldest first.
+ * @param [num_mac_keys]   The number of mac keys.
+ *
+ * @return The number of bytes written.
  */
-/*@null@*/ INTERNAL uint8_t *
-otrng_serialize_old_mac_keys(list_element_s *old_mac_keys);
+INTERNAL size_t otrng_serialize_old_mac_keys(uint8_t *dst,
+                                             const uint8_t *old_mac_keys,
+                                             size_t num_mac_keys);
 
 INTERNAL size_t otrng_serialize_phi(uint8_t *dst,
                                     const char *shared_session_state,
@@ -18,15 +18,47 @@
  *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define OTRNG_SHAKE_PRIVATE
+
+#include <assert.h>
 #include <string.h>
 
+#include "alloc.h"
+#include "keccak_x4.h"
 #include "shake.h"
 
-tstatic otrng_result hash_init_with_dom(goldilocks_shake256_ctx_p hd) {
-  const char *domain = "OTRv4";
+#define KDF_DOMAIN "OTRv4"
+#define PREKEY_SERVER_DOMAIN "OTR-Prekey-Server"
+
+/* Usages below this are cached, which covers all the ones in the spec */
+#define CACHED_USAGES 0x20
+
+/* The contexts right after absorbing a domain, and the domain and each usage,
+   so a KDF starts by copying one */
+typedef struct cached_domain_s {
+  const char *domain;
+  goldilocks_shake256_ctx_p with_domain;
+  goldilocks_shake256_ctx_p with_usage[CACHED_USAGES];
+} cached_domain_s;
+
+static cached_domain_s cached_domains[] = {
+    {.domain = KDF_DOMAIN},
+    {.domain = PREKEY_SERVER_DOMAIN},
+};
 
+#define NUM_CACHED_DOMAINS (sizeof(cached_domains) / sizeof(cached_domain_s))
+
+/* Only written by otrng_shake_init, before there are other threads */
+static otrng_bool cache_ready = otrng_false;
+static otrng_bool use_keccak_x4 = otrng_false;
+
+/* The SHAKE-256 rate */
+#define SHAKE_256_BLOCK_BYTES 136
+
+static otrng_result absorb_domain(goldilocks_shake256_ctx_p hd,
+                                  const char *domain) {
   hash_init(hd);
-  if (hash_update(hd, (const unsigned char *)domain, strlen(domain)) ==
+  if (hash_update(hd, (const uint8_t *)domain, strlen(domain)) ==
       GOLDILOCKS_FAILURE) {
     hash_destroy(hd);
     return OTRNG_ERROR;
@@ -35,13 +67,10 @@ tstatic otrng_result hash_init_with_dom(goldilocks_shake256_ctx_p hd) {
   return OTRNG_SUCCESS;
 }
 
-otrng_result
-hash_init_with_usage_and_domain_separation(goldilocks_shake256_ctx_p hd,
-                                           uint8_t usage, const char *domain) {
-  hash_init(hd);
-  if (hash_update(hd, (const uint8_t *)domain, strlen(domain)) ==
-      GOLDILOCKS_FAILURE) {
-    hash_destroy(hd);
+static otrng_result absorb_domain_and_usage(goldilocks_shake256_ctx_p hd,
+                                            const char *domain,
+                                            uint8_t usage) {
+  if (!absorb_domain(hd, domain)) {
     return OTRNG_ERROR;
   }
 
@@ -53,28 +82,76 @@ hash_init_with_usage_and_domain_separation(goldilocks_shake256_ctx_p hd,
   return OTRNG_SUCCESS;
 }
 
-static otrng_result
-hash_init_with_usage_prekey_server(goldilocks_shake256_ctx_p hash,
-                                   uint8_t usage) {
-  const char *domain = "OTR-Prekey-Server";
-  if (!hash_init_with_usage_and_domain_separation(hash, usage, domain)) {
-    return OTRNG_ERROR;
+INTERNAL void otrng_shake_init(void) {
+  size_t i;
+  uint8_t usage;
+
+  if (cache_ready) {
+    return;
   }
 
-  return OTRNG_SUCCESS;
+  for (i = 0; i < NUM_CACHED_DOMAINS; i++) {
+    cached_domain_s *cached = &cached_domains[i];
+
+    if (!absorb_domain(cached->with_domain, cached->domain)) {
+      return;
+    }
+
+    for (usage = 0; usage < CACHED_USAGES; usage++) {
+      *cached->with_usage[usage] = *cached->with_domain;
+      if (hash_update(cached->with_usage[usage], &usage, 1) ==
+          GOLDILOCKS_FAILURE) {
+        return;
+      }
+    }
+  }
+
+  use_keccak_x4 = otrng_keccak_x4_available();
+  cache_ready = otrng_true;
 }
 
-otrng_result hash_init_with_usage(goldilocks_shake256_ctx_p hd, uint8_t usage) {
-  if (!hash_init_with_dom(hd)) {
-    return OTRNG_ERROR;
+static otrng_result init_with_usage(goldilocks_shake256_ctx_p hd,
+                                    const cached_domain_s *cached,
+                                    uint8_t usage) {
+  if (cache_ready && usage < CACHED_USAGES) {
+    *hd = *cached->with_usage[usage];
+    return OTRNG_SUCCESS;
   }
 
-  if (hash_update(hd, &usage, 1) == GOLDILOCKS_FAILURE) {
-    hash_destroy(hd);
-    return OTRNG_ERROR;
+  return absorb_domain_and_usage(hd, cached->domain, usage);
+}
+
+tstatic otrng_result hash_init_with_dom(goldilocks_shake256_ctx_p hd) {
+  if (cache_ready) {
+    *hd = *cached_domains[0].with_domain;
+    return OTRNG_SUCCESS;
   }
 
-  return OTRNG_SUCCESS;
+  return absorb_domain(hd, KDF_DOMAIN);
+}
+
+otrng_result
+hash_init_with_usage_and_domain_separation(goldilocks_shake256_ctx_p hd,
+                                           uint8_t usage, const char *domain) {
+  size_t i;
+
+  for (i = 0; i < NUM_CACHED_DOMAINS; i++) {
+    if (strcmp(domain, cached_domains[i].domain) == 0) {
+      return init_with_usage(hd, &cached_domains[i], usage);
+    }
+  }
+
+  return absorb_domain_and_usage(hd, domain, usage);
+}
+
+static otrng_result
+hash_init_with_usage_prekey_server(goldilocks_shake256_ctx_p hash,
+                                   uint8_t usage) {
+  return init_with_usage(hash, &cached_domains[1], usage);
+}
+
+otrng_result hash_init_with_usage(goldilocks_shake256_ctx_p hd, uint8_t usage) {
+  return init_with_usage(hd, &cached_domains[0], usage);
 }
 
 otrng_result shake_kkdf(uint8_t *dst, size_t dst_len, const uint8_t *key,
@@ -121,6 +198,92 @@ otrng_result shake_256_kdf1(uint8_t *dst, size_t dst_len, uint8_t usage,
   return OTRNG_SUCCESS;
 }
 
+/* Whether "OTRv4" || usage || values and its padding fit in one block, and
+   the output can be squeezed from it */
+static otrng_bool fits_one_block(const shake_kdf_s *kdf) {
+  return kdf->values_len < SHAKE_256_BLOCK_BYTES - sizeof(KDF_DOMAIN) &&
+         kdf->dst_len <= SHAKE_256_BLOCK_BYTES;
+}
+
+tstatic void shake_256_kdf1_x4(const shake_kdf_s *const *kdfs,
+                               size_t kdfs_len) {
+  keccak_x4_state state;
+  uint8_t block[SHAKE_256_BLOCK_BYTES];
+  size_t lane, i, j;
+
+  assert(kdfs_len <= 4);
+
+  memset(state, 0, sizeof(state));
+  for (lane = 0; lane < kdfs_len; lane++) {
+    const shake_kdf_s *kdf = kdfs[lane];
+    size_t len = sizeof(KDF_DOMAIN) - 1;
+
+    memset(block, 0, sizeof(block));
+    memcpy(block, KDF_DOMAIN, len);
+    block[len++] = kdf->usage;
+    if (kdf->values_len > 0) {
+      memcpy(block + len, kdf->values, kdf->values_len);
+      len += kdf->values_len;
+    }
+    block[len] ^= 0x1F;
+    block[SHAKE_256_BLOCK_BYTES - 1] ^= 0x80;
+
+    for (i = 0; i < SHAKE_256_BLOCK_BYTES / 8; i++) {
+      for (j = 0; j < 8; j++) {
+        state[i][lane] |= (uint64_t)block[8 * i + j] << (8 * j);
+      }
+    }
+  }
+
+  otrng_keccak_x4_permute(state);
+
+  for (lane = 0; lane < kdfs_len; lane++) {
+    const shake_kdf_s *kdf = kdfs[lane];
+
+    for (i = 0; i < kdf->dst_len; i++) {
+      kdf->dst[i] = (uint8_t)(state[i / 8][lane] >> (8 * (i % 8)));
+    }
+  }
+
+  otrng_secure_wipe(block, sizeof(block));
+  otrng_secure_wipe(state, sizeof(state));
+}
+
+otrng_result shake_256_kdf1_batch(const shake_kdf_s *kdfs, size_t kdfs_len) {
+  const shake_kdf_s *lanes[4];
+  size_t i, n = 0;
+
+  for (i = 0; i < kdfs_len; i++) {
+    const shake_kdf_s *kdf = &kdfs[i];
+
+    if (!use_keccak_x4 || !fits_one_block(kdf)) {
+      if (!shake_256_kdf1(kdf->dst, kdf->dst_len, kdf->usage, kdf->values,
+                          kdf->values_len)) {
+        return OTRNG_ERROR;
+      }
+      continue;
+    }
+
+    lanes[n++] = kdf;
+    if (n == 4) {
+      shake_256_kdf1_x4(lanes, n);
+      n = 0;
+    }
+  }
+
+  /* A single job is not worth four lanes */
+  if (n == 1) {
+    return shake_256_kdf1(lanes[0]->dst, lanes[0]->dst_len, lanes[0]->usage,
+                          lanes[0]->values, lanes[0]->values_len);
+  }
+
+  if (n > 1) {
+    shake_256_kdf1_x4(lanes, n);
+  }
+
+  return OTRNG_SUCCESS;
+}
+
 otrng_result shake_256_prekey_server_kdf(uint8_t *dst, size_t dst_len,
                                          uint8_t usage, const uint8_t *values,
                                          size_t values_len) {
@@ -19,10 +19,11 @@
  */
 
 /**
- * The functions in this file only operate on their arguments, and doesn't touch
- * any global state. It is safe to call these functions concurrently from
- * different threads, as long as arguments pointing to the same memory areas are
- * not used from different threads.
+ * The functions in this file only operate on their arguments, and on a table
+ * that otrng_init fills once and that is only read afterwards. It is safe to
+ * call these functions concurrently from different threads, as long as
+ * arguments pointing to the same memory areas are not used from different
+ * threads.
  */
 
 #ifndef OTRNG_SHAKE_H
@@ -38,6 +39,13 @@
 #define hash_destroy goldilocks_shake256_destroy
 #define hash_hash goldilocks_shake256_hash
 
+/**
+ * @brief Absorbs the "OTRv4" and "OTR-Prekey-Server" domains, alone and with
+ * each usage, once, so the KDFs start from a copy instead. Called by
+ * otrng_init. Until it is, the KDFs absorb them every time.
+ */
+INTERNAL void otrng_shake_init(void);
+
 otrng_result
 hash_init_with_usage_and_domain_separation(goldilocks_shake256_ctx_p hash,
                                            uint8_t usage, const char *domain);
@@ -53,6 +61,25 @@ otrng_result shake_kkdf(uint8_t *dst, size_t dst_len, const uint8_t *key,
 otrng_result shake_256_kdf1(uint8_t *dst, size_t dst_len, uint8_t usage,
                             const uint8_t *values, size_t values_len);
 
+/* One KDF_1("OTRv4" || usage || values, dst_len) */
+typedef struct shake_kdf_s {
+  uint8_t *dst;
+  size_t dst_len;
+  uint8_t usage;
+  const uint8_t *values;
+  size_t values_len;
+} shake_kdf_s;
+
+/**
+ * @brief Computes several independent KDF_1, the same as calling
+ * shake_256_kdf1 for each. Where the CPU allows, up to four of them that fit
+ * in one SHAKE-256 block are computed at once.
+ *
+ * @param [kdfs] The KDFs. No [dst] may overlap any of the [values].
+ * @param [kdfs_len] How many there are.
+ */
+otrng_result shake_256_kdf1_batch(const shake_kdf_s *kdfs, size_t kdfs_len);
+
 /* KDF_1("OTR-Prekey-Server" || usageID || values, len) */
 otrng_result shake_256_prekey_server_kdf(uint8_t *dst, size_t dst_len,
                                          uint8_t usage, const uint8_t *values,
@@ -65,6 +92,9 @@ otrng_result shake_256_hash(uint8_t *dst, size_t dst_len, const uint8_t *secret,
 
 tstatic otrng_result hash_init_with_dom(goldilocks_shake256_ctx_p hash);
 
+tstatic void shake_256_kdf1_x4(const shake_kdf_s *const *kdfs,
+                               size_t kdfs_len);
+
 #endif
 
 #endif
@@ -0,0 +1,209 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sodium.h>
+#include <string.h>
+
+#define OTRNG_SKIPPED_KEYS_PRIVATE
+
+#include "alloc.h"
+#include "random.h"
+#include "serialize.h"
+#include "skipped_keys.h"
+
+#define SKIPPED_KEYS_INITIAL_BUCKETS 16
+
+INTERNAL skipped_keys_store_s *otrng_skipped_keys_store_new(void) {
+  skipped_keys_store_s *store = otrng_xmalloc_z(sizeof(skipped_keys_store_s));
+
+  store->num_buckets = SKIPPED_KEYS_INITIAL_BUCKETS;
+  store->buckets =
+      otrng_xmalloc_z(store->num_buckets * sizeof(skipped_keys_s *));
+
+  /* Keys the bucket hash, so a peer can not choose ratchet keys that all
+   * land in the same bucket */
+  random_bytes(store->hash_key, SKIPPED_KEYS_HASH_KEY_BYTES);
+
+  return store;
+}
+
+INTERNAL void otrng_skipped_keys_store_free(skipped_keys_store_s *store) {
+  if (!store) {
+    return;
+  }
+
+  otrng_skipped_keys_store_clear(store);
+  otrng_secure_wipe(store->hash_key, SKIPPED_KEYS_HASH_KEY_BYTES);
+  otrng_free(store->buckets);
+  otrng_free(store);
+}
+
+INTERNAL size_t
+otrng_skipped_keys_store_len(const skipped_keys_store_s *store) {
+  return store->count;
+}
+
+tstatic size_t skipped_keys_bucket(const skipped_keys_store_s *store,
+                                   const uint8_t their_ecdh[ED448_POINT_BYTES],
+                                   uint32_t k) {
+  uint8_t in[ED448_POINT_BYTES + 4];
+  uint8_t out[crypto_shorthash_BYTES];
+  uint64_t hash = 0;
+  size_t i;
+
+  memcpy(in, their_ecdh, ED448_POINT_BYTES);
+  otrng_serialize_uint32(in + ED448_POINT_BYTES, k);
+
+  crypto_shorthash(out, in, sizeof(in), store->hash_key);
+  for (i = 0; i < crypto_shorthash_BYTES; i++) {
+    hash = (hash << 8) | out[i];
+  }
+
+  return (size_t)(hash & (store->num_buckets - 1));
+}
+
+static void link_into_bucket(skipped_keys_store_s *store,
+                             skipped_keys_s *key) {
+  size_t b = skipped_keys_bucket(store, key->their_ecdh, key->k);
+
+  key->next_in_bucket = store->buckets[b];
+  store->buckets[b] = key;
+}
+
+static void grow_buckets(skipped_keys_store_s *store) {
+  skipped_keys_s *key;
+
+  otrng_free(store->buckets);
+  store->num_buckets *= 2;
+  store->buckets =
+      otrng_xmalloc_z(store->num_buckets * sizeof(skipped_keys_s *));
+
+  for (key = store->oldest; key; key = key->newer) {
+    link_into_bucket(store, key);
+  }
+}
+
+static void unlink_key(skipped_keys_store_s *store, skipped_keys_s *key) {
+  size_t b = skipped_keys_bucket(store, key->their_ecdh, key->k);
+  skipped_keys_s **cursor = &store->buckets[b];
+
+  while (*cursor && *cursor != key) {
+    cursor = &(*cursor)->next_in_bucket;
+  }
+  if (*cursor) {
+    *cursor = key->next_in_bucket;
+  }
+
+  if (key->older) {
+    key->older->newer = key->newer;
+  } else {
+    store->oldest = key->newer;
+  }
+
+  if (key->newer) {
+    key->newer->older = key->older;
+  } else {
+    store->newest = key->older;
+  }
+
+  store->count--;
+}
+
+INTERNAL void otrng_skipped_keys_store_remove(skipped_keys_store_s *store,
+                                              skipped_keys_s *key) {
+  unlink_key(store, key);
+  otrng_secure_wipe(key, sizeof(skipped_keys_s));
+  otrng_secure_free(key);
+}
+
+INTERNAL void otrng_skipped_keys_store_add(
+    skipped_keys_store_s *store, const uint8_t their_ecdh[ED448_POINT_BYTES],
+    uint32_t k, const uint8_t enc_key[ENC_KEY_BYTES],
+    const uint8_t extra_key[EXTRA_SYMMETRIC_KEY_BYTES]) {
+  skipped_keys_s *key = otrng_secure_alloc(sizeof(skipped_keys_s));
+
+  memcpy(key->their_ecdh, their_ecdh, ED448_POINT_BYTES);
+  key->k = k;
+  memcpy(key->enc_key, enc_key, ENC_KEY_BYTES);
+  memcpy(key->extra_symmetric_key, extra_key, EXTRA_SYMMETRIC_KEY_BYTES);
+  key->seq = store->next_seq++;
+
+  key->older = store->newest;
+  key->newer = NULL;
+  if (store->newest) {
+    store->newest->newer = key;
+  } else {
+    store->oldest = key;
+  }
+  store->newest = key;
+  store->count++;
+
+  if (store->count > store->num_buckets) {
+    grow_buckets(store);
+  } else {
+    link_into_bucket(store, key);
+  }
+}
+
+INTERNAL void otrng_skipped_keys_store_evict(skipped_keys_store_s *store,
+                                             size_t capacity) {
+  while (store->count > capacity && store->oldest) {
+    otrng_skipped_keys_store_remove(store, store->oldest);
+  }
+}
+
+INTERNAL /*@null@*/ skipped_keys_s *
+otrng_skipped_keys_store_get(const skipped_keys_store_s *store,
+                             const uint8_t their_ecdh[ED448_POINT_BYTES],
+                             uint32_t k) {
+  skipped_keys_s *key;
+
+  if (store->count == 0) {
+    return NULL;
+  }
+
+  key = store->buckets[skipped_keys_bucket(store, their_ecdh, k)];
+  for (; key; key = key->next_in_bucket) {
+    if (key->k == k &&
+        sodium_memcmp(key->their_ecdh, their_ecdh, ED448_POINT_BYTES) == 0) {
+      return key;
+    }
+  }
+
+  return NULL;
+}
+
+INTERNAL void otrng_skipped_keys_store_clear(skipped_keys_store_s *store) {
+  while (store->newest) {
+    otrng_skipped_keys_store_remove(store, store->newest);
+  }
+}
+
+INTERNAL uint64_t
+otrng_skipped_keys_store_mark(const skipped_keys_store_s *store) {
+  return store->next_seq;
+}
+
+INTERNAL void otrng_skipped_keys_store_rollback(skipped_keys_store_s *store,
+                                                uint64_t mark) {
+  while (store->newest && store->newest->seq >= mark) {
+    otrng_skipped_keys_store_remove(store, store->newest);
+  }
+}
@@ -0,0 +1,150 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * The functions in this file only operate on their arguments, and doesn't touch
+ * any global state. It is safe to call these functions concurrently from
+ * different threads, as long as arguments pointing to the same memory areas are
+ * not used from different threads.
+ */
+
+#ifndef OTRNG_SKIPPED_KEYS_H
+#define OTRNG_SKIPPED_KEYS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+#include "ed448.h"
+#include "error.h"
+#include "shared.h"
+
+#define SKIPPED_KEYS_HASH_KEY_BYTES 16
+
+/* a stored message key, kept until it is retrieved, evicted or revealed */
+typedef struct skipped_keys_s {
+  uint8_t their_ecdh[ED448_POINT_BYTES]; /* Encoded their_ecdh key */
+  uint32_t k;                            /* Counter of the receiving messages */
+  uint8_t extra_symmetric_key[EXTRA_SYMMETRIC_KEY_BYTES];
+  uint8_t enc_key[ENC_KEY_BYTES];
+
+  uint64_t seq; /* Insertion order, used to roll back a receiving ratchet */
+  struct skipped_keys_s *newer;
+  struct skipped_keys_s *older;
+  struct skipped_keys_s *next_in_bucket;
+} skipped_keys_s;
+
+/*
+ * The store of skipped message keys. Keys are indexed by a keyed hash of
+ * (their_ecdh, k), so retrieving the key of an out-of-order message does not
+ * depend on how many keys are stored. They are also kept in insertion order,
+ * so the oldest key is the one evicted when the store is full.
+ */
+typedef struct skipped_keys_store_s {
+  skipped_keys_s **buckets;
+  size_t num_buckets; /* Always a power of two */
+  size_t count;
+  uint64_t next_seq;
+  /*@null@*/ skipped_keys_s *oldest;
+  /*@null@*/ skipped_keys_s *newest;
+  uint8_t hash_key[SKIPPED_KEYS_HASH_KEY_BYTES];
+} skipped_keys_store_s;
+
+INTERNAL skipped_keys_store_s *otrng_skipped_keys_store_new(void);
+
+/**
+ * @brief Securely deletes every stored key and frees the store.
+ */
+INTERNAL void otrng_skipped_keys_store_free(
+    /*@only@*/ /*@null@*/ skipped_keys_store_s *store);
+
+INTERNAL size_t
+otrng_skipped_keys_store_len(const skipped_keys_store_s *store);
+
+/**
+ * @brief Stores a message key. Nothing is evicted here: the keys are stored
+ * before the message that skipped them is known to be valid, so a forged
+ * message must not be able to push the stored keys out. See
+ * otrng_skipped_keys_store_evict.
+ *
+ * @param [store]       The store.
+ * @param [their_ecdh]  The encoded ECDH key of the ratchet the key belongs to.
+ * @param [k]           The message id.
+ * @param [enc_key]     The message encryption key.
+ * @param [extra_key]   The extra symmetric key of the message.
+ */
+INTERNAL void otrng_skipped_keys_store_add(
+    skipped_keys_store_s *store, const uint8_t their_ecdh[ED448_POINT_BYTES],
+    uint32_t k, const uint8_t enc_key[ENC_KEY_BYTES],
+    const uint8_t extra_key[EXTRA_SYMMETRIC_KEY_BYTES]);
+
+/**
+ * @brief Securely deletes the oldest stored keys until the store holds at
+ * most [capacity] keys.
+ *
+ * @param [store]       The store.
+ * @param [capacity]    The maximum number of stored keys.
+ */
+INTERNAL void otrng_skipped_keys_store_evict(skipped_keys_store_s *store,
+                                             size_t capacity);
+
+/**
+ * @brief Finds the key stored for (their_ecdh, k).
+ *
+ * @return The stored key, which is still owned by the store, or NULL.
+ */
+INTERNAL /*@null@*/ skipped_keys_s *
+otrng_skipped_keys_store_get(const skipped_keys_store_s *store,
+                             const uint8_t their_ecdh[ED448_POINT_BYTES],
+                             uint32_t k);
+
+/**
+ * @brief Securely deletes a stored key.
+ */
+INTERNAL void otrng_skipped_keys_store_remove(skipped_keys_store_s *store,
+                                              skipped_keys_s *key);
+
+/**
+ * @brief Securely deletes every stored key.
+ */
+INTERNAL void otrng_skipped_keys_store_clear(skipped_keys_store_s *store);
+
+/**
+ * @brief Returns a mark that can later be used to roll back the keys stored
+ * after this call.
+ */
+INTERNAL uint64_t
+otrng_skipped_keys_store_mark(const skipped_keys_store_s *store);
+
+/**
+ * @brief Securely deletes the keys stored since [mark] was taken.
+ */
+INTERNAL void otrng_skipped_keys_store_rollback(skipped_keys_store_s *store,
+                                                uint64_t mark);
+
+#ifdef OTRNG_SKIPPED_KEYS_PRIVATE
+
+tstatic size_t skipped_keys_bucket(const skipped_keys_store_s *store,
+                                   const uint8_t their_ecdh[ED448_POINT_BYTES],
+                                   uint32_t k);
+
+#endif
+
+#endif
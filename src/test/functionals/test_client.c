@@ -19,6 +19,7 @@
  */
 
 #include <glib.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include "test_helpers.h"
@@ -1037,11 +1038,11 @@ static void test_client_expires_old_fragments(void) {
 
   otrng_conversation_s *conv =
       otrng_client_get_conversation(0, BOB_ACCOUNT, alice);
-  g_assert_cmpint(otrng_list_len(conv->conn->pending_fragments), ==, 1);
+  g_assert_cmpint(otrng_list_len(conv->conn->pending_fragments.list), ==, 1);
 
   otrng_client_expire_fragments(alice);
 
-  g_assert_cmpint(otrng_list_len(conv->conn->pending_fragments), ==, 0);
+  g_assert_cmpint(otrng_list_len(conv->conn->pending_fragments.list), ==, 0);
 
   otrng_free(to_display);
   otrng_message_free(fmessage);
@@ -1124,6 +1125,166 @@ static void test_client_sends_fragmented_message(void) {
   otrng_global_state_free(bob->global_state);
 }
 
+#define NUM_SHARDS 4
+#define PAIRS_PER_SHARD 2
+#define NUM_EXCHANGES 4
+
+typedef struct shard_s {
+  otrng_global_state_s *gs;
+  int index;
+  char alice_accounts[PAIRS_PER_SHARD][32];
+  char bob_accounts[PAIRS_PER_SHARD][32];
+  otrng_client_s *alices[PAIRS_PER_SHARD];
+  otrng_client_s *bobs[PAIRS_PER_SHARD];
+} shard_s;
+
+/* Delivers [msg] to [receiver], and returns what it replies */
+static char *deliver(char *msg, const char *sender, otrng_client_s *receiver,
+                     char **to_display) {
+  char *reply = NULL;
+  otrng_bool ignore = otrng_false;
+
+  otrng_assert_is_success(otrng_client_receive(&reply, to_display, msg, sender,
+                                               receiver, &ignore));
+  otrng_free(msg);
+  otrng_assert(!ignore);
+
+  return reply;
+}
+
+static void start_conversation(otrng_client_s *alice, const char *alice_account,
+                               otrng_client_s *bob, const char *bob_account) {
+  otrng_conversation_s *alice_to_bob, *bob_to_alice;
+  char *to_display = NULL;
+  char *msg = otrng_client_init_message(bob_account, "Hi bob", alice);
+  otrng_assert(msg);
+
+  /* Identity message, Auth-R, Auth-I and the initial data message */
+  msg = deliver(msg, alice_account, bob, &to_display);
+  msg = deliver(msg, bob_account, alice, &to_display);
+  msg = deliver(msg, alice_account, bob, &to_display);
+  msg = deliver(msg, bob_account, alice, &to_display);
+  msg = deliver(msg, alice_account, bob, &to_display);
+  otrng_assert(!msg);
+  otrng_assert(!to_display);
+
+  alice_to_bob =
+      otrng_client_get_conversation(NOT_FORCE_CREATE_CONV, bob_account, alice);
+  bob_to_alice =
+      otrng_client_get_conversation(NOT_FORCE_CREATE_CONV, alice_account, bob);
+  otrng_assert(otrng_conversation_is_encrypted(alice_to_bob));
+  otrng_assert(otrng_conversation_is_encrypted(bob_to_alice));
+}
+
+static void exchange_message(otrng_client_s *sender, const char *sender_account,
+                             otrng_client_s *receiver,
+                             const char *receiver_account, const char *text) {
+  char *msg = NULL, *to_display = NULL;
+
+  otrng_assert_is_success(
+      otrng_client_send(&msg, text, receiver_account, sender));
+  otrng_assert(msg);
+
+  msg = deliver(msg, sender_account, receiver, &to_display);
+  otrng_assert(!msg);
+  g_assert_cmpstr(to_display, ==, text);
+  otrng_free(to_display);
+}
+
+/* Drives the clients of one shard, which no other thread uses */
+static void *run_shard(void *data) {
+  shard_s *shard = data;
+  char text[64];
+  time_t deadline;
+  int i, j, byte;
+
+  for (i = 0; i < PAIRS_PER_SHARD; i++) {
+    snprintf(shard->alice_accounts[i], 32, "alice-%d-%d@localhost",
+             shard->index, i);
+    snprintf(shard->bob_accounts[i], 32, "bob-%d-%d@localhost", shard->index,
+             i);
+
+    shard->alices[i] = otrng_client_get(
+        shard->gs, create_client_id("otr", shard->alice_accounts[i]));
+    shard->bobs[i] = otrng_client_get(
+        shard->gs, create_client_id("otr", shard->bob_accounts[i]));
+    otrng_assert(shard->alices[i] == otrng_client_get(
+                     shard->gs,
+                     create_client_id("otr", shard->alice_accounts[i])));
+
+    /* Every client gets its own instance tag in the shared v3 user state */
+    byte = 1 + 2 * (shard->index * PAIRS_PER_SHARD + i);
+    set_up_client_keys(shard->alices[i], byte);
+    set_up_client_keys(shard->bobs[i], byte + 1);
+  }
+
+  for (i = 0; i < PAIRS_PER_SHARD; i++) {
+    start_conversation(shard->alices[i], shard->alice_accounts[i],
+                       shard->bobs[i], shard->bob_accounts[i]);
+  }
+
+  for (j = 0; j < NUM_EXCHANGES; j++) {
+    for (i = 0; i < PAIRS_PER_SHARD; i++) {
+      snprintf(text, sizeof(text), "message %d in shard %d", j, shard->index);
+      if (j % 2 == 0) {
+        exchange_message(shard->alices[i], shard->alice_accounts[i],
+                         shard->bobs[i], shard->bob_accounts[i], text);
+      } else {
+        exchange_message(shard->bobs[i], shard->bob_accounts[i],
+                         shard->alices[i], shard->alice_accounts[i], text);
+      }
+
+      otrng_client_poll(shard->alices[i]);
+      otrng_client_poll(shard->bobs[i]);
+      (void)otrng_client_next_deadline(&deadline, shard->alices[i]);
+    }
+  }
+
+  return NULL;
+}
+
+static void test_clients_used_from_several_threads(void) {
+  otrng_global_state_s *gs =
+      otrng_global_state_new(test_callbacks, otrng_false);
+  shard_s shards[NUM_SHARDS];
+  pthread_t threads[NUM_SHARDS];
+  otrng_client_id_s alice_id;
+  int i, j;
+
+  for (i = 0; i < NUM_SHARDS; i++) {
+    shards[i].gs = gs;
+    shards[i].index = i;
+    g_assert_cmpint(pthread_create(&threads[i], NULL, run_shard, &shards[i]),
+                    ==, 0);
+  }
+
+  /* What is shared can be polled while the workers run */
+  for (i = 0; i < 10; i++) {
+    otrng_global_state_poll(gs);
+  }
+
+  for (i = 0; i < NUM_SHARDS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  g_assert_cmpint(otrng_list_len(gs->clients), ==,
+                  NUM_SHARDS * PAIRS_PER_SHARD * 2);
+
+  for (i = 0; i < NUM_SHARDS; i++) {
+    for (j = 0; j < PAIRS_PER_SHARD; j++) {
+      alice_id = create_client_id("otr", shards[i].alice_accounts[j]);
+      otrng_assert(shards[i].alices[j] == otrng_client_get(gs, alice_id));
+      g_assert_cmpint(otrng_list_len(shards[i].alices[j]->conversations), ==,
+                      1);
+      g_assert_cmpint(otrng_list_len(shards[i].bobs[j]->conversations), ==, 1);
+      g_assert_cmpuint(otrng_client_get_instance_tag(shards[i].alices[j]), ==,
+                       0x100 + 1 + 2 * (i * PAIRS_PER_SHARD + j));
+    }
+  }
+
+  otrng_global_state_free(gs);
+}
+
 void functionals_client_add_tests(void) {
   g_test_add_func("/client/conversation_api", test_client_conversation_api);
   g_test_add_func("/client/sends_fragments",
@@ -1145,4 +1306,6 @@ void functionals_client_add_tests(void) {
   g_test_add_func("/client/conversation_data_message_multiple_locations",
                   test_conversation_with_multiple_locations);
   g_test_add_func("/client/api", test_client_api);
+  g_test_add_func("/client/used_from_several_threads",
+                  test_clients_used_from_several_threads);
 }
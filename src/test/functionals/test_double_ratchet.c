@@ -24,6 +24,8 @@
 
 #include "test_fixtures.h"
 
+#include "serialize.h"
+
 /* Test the an in-order sending and receiving double ratchet */
 static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   otrng_client_s *alice_client = otrng_client_new(ALICE_IDENTITY);
@@ -48,7 +50,7 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   // Alice sends a data message
   result = otrng_send_message(&to_send_1, "hi", NULL, 0, alice);
   assert_message_sent(result, to_send_1);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 2);
@@ -57,7 +59,7 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
 
   result = otrng_send_message(&to_send_2, "how are you?", NULL, 0, alice);
   assert_message_sent(result, to_send_2);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 3);
@@ -66,7 +68,7 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
 
   result = otrng_send_message(&to_send_3, "it's me", NULL, 0, alice);
   assert_message_sent(result, to_send_3);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 4);
@@ -77,11 +79,11 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_1, bob);
   assert_message_rec(result, "hi", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_1);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 2);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 2);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 2);
@@ -90,11 +92,11 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_2, bob);
   assert_message_rec(result, "how are you?", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_2);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 3);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 3);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 3);
@@ -104,7 +106,7 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   result = otrng_send_message(&to_send_4, "oh, hi", NULL, 0, bob);
   assert_message_sent(result, to_send_4);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 0);
 
   g_assert_cmpint(bob->keys->i, ==, 2);
   g_assert_cmpint(bob->keys->j, ==, 1);
@@ -115,11 +117,11 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_3, bob);
   assert_message_rec(result, "it's me", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_3);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 1);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 1);
   g_assert_cmpint(bob->keys->i, ==, 2);
   g_assert_cmpint(bob->keys->j, ==, 1);
   g_assert_cmpint(bob->keys->k, ==, 4);
@@ -129,7 +131,7 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   response_to_bob = otrng_response_new();
   result = otrng_receive_message(response_to_bob, to_send_4, alice);
   assert_message_rec(result, "oh, hi", response_to_bob);
-  g_assert_cmpint(otrng_list_len(alice->keys->old_mac_keys), ==, 1);
+  g_assert_cmpint(alice->keys->num_old_mac_keys, ==, 1);
 
   free_message_and_response(response_to_bob, &to_send_4);
   g_assert_cmpint(alice->keys->i, ==, 2);
@@ -141,7 +143,7 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   result = otrng_send_message(&to_send_5, "I'm good", NULL, 0, bob);
   assert_message_sent(result, to_send_5);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 1);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 1);
 
   g_assert_cmpint(bob->keys->i, ==, 2);
   g_assert_cmpint(bob->keys->j, ==, 2);
@@ -152,7 +154,7 @@ static void test_double_ratchet_new_sending_ratchet_in_order(void) {
   response_to_bob = otrng_response_new();
   result = otrng_receive_message(response_to_bob, to_send_5, alice);
   assert_message_rec(result, "I'm good", response_to_bob);
-  g_assert_cmpint(otrng_list_len(alice->keys->old_mac_keys), ==, 2);
+  g_assert_cmpint(alice->keys->num_old_mac_keys, ==, 2);
 
   free_message_and_response(response_to_bob, &to_send_5);
   g_assert_cmpint(alice->keys->i, ==, 2);
@@ -188,7 +190,7 @@ static void test_double_ratchet_same_ratchet_out_of_order(void) {
 
   result = otrng_send_message(&to_send_1, "hi", NULL, 0, alice);
   assert_message_sent(result, to_send_1);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 2);
@@ -197,7 +199,7 @@ static void test_double_ratchet_same_ratchet_out_of_order(void) {
 
   result = otrng_send_message(&to_send_2, "how are you?", NULL, 0, alice);
   assert_message_sent(result, to_send_2);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 3);
@@ -206,7 +208,7 @@ static void test_double_ratchet_same_ratchet_out_of_order(void) {
 
   result = otrng_send_message(&to_send_3, "it's me", NULL, 0, alice);
   assert_message_sent(result, to_send_3);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 4);
@@ -215,7 +217,7 @@ static void test_double_ratchet_same_ratchet_out_of_order(void) {
 
   result = otrng_send_message(&to_send_4, "ok?", NULL, 0, alice);
   assert_message_sent(result, to_send_4);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 5);
@@ -226,11 +228,11 @@ static void test_double_ratchet_same_ratchet_out_of_order(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_1, bob);
   assert_message_rec(result, "hi", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_1);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 2);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 2);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 2);
@@ -239,39 +241,41 @@ static void test_double_ratchet_same_ratchet_out_of_order(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_4, bob);
   assert_message_rec(result, "ok?", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_4);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 3);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 3);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 5);
   g_assert_cmpint(bob->keys->pn, ==, 0);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 2);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  2);
 
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_3, bob);
   assert_message_rec(result, "it's me", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_3);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 4);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 4);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 5);
   g_assert_cmpint(bob->keys->pn, ==, 0);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 1);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  1);
 
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_2, bob);
   assert_message_rec(result, "how are you?", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_2);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 5);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 5);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 5);
@@ -306,7 +310,7 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
   // Alice sends a data message
   result = otrng_send_message(&to_send_1, "hi", NULL, 0, alice);
   assert_message_sent(result, to_send_1);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 2);
@@ -315,7 +319,7 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
 
   result = otrng_send_message(&to_send_2, "how are you?", NULL, 0, alice);
   assert_message_sent(result, to_send_2);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 3);
@@ -324,7 +328,7 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
 
   result = otrng_send_message(&to_send_3, "it's me", NULL, 0, alice);
   assert_message_sent(result, to_send_3);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 4);
@@ -335,11 +339,11 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_1, bob);
   assert_message_rec(result, "hi", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_1);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 2);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 2);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 2);
@@ -351,8 +355,9 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
 
   free_message_and_response(response_to_alice, &to_send_2);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 3);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 3);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  0);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 3);
@@ -362,7 +367,7 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
   result = otrng_send_message(&to_send_4, "oh, hi", NULL, 0, bob);
   assert_message_sent(result, to_send_4);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 0);
 
   g_assert_cmpint(bob->keys->i, ==, 2);
   g_assert_cmpint(bob->keys->j, ==, 1);
@@ -373,7 +378,7 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
   response_to_bob = otrng_response_new();
   result = otrng_receive_message(response_to_bob, to_send_4, alice);
   assert_message_rec(result, "oh, hi", response_to_bob);
-  g_assert_cmpint(otrng_list_len(alice->keys->old_mac_keys), ==, 1);
+  g_assert_cmpint(alice->keys->num_old_mac_keys, ==, 1);
 
   free_message_and_response(response_to_bob, &to_send_4);
   g_assert_cmpint(alice->keys->i, ==, 2);
@@ -385,7 +390,7 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
   result = otrng_send_message(&to_send_5, "good", NULL, 0, alice);
   assert_message_sent(result, to_send_5);
 
-  g_assert_cmpint(otrng_list_len(alice->keys->old_mac_keys), ==, 0);
+  g_assert_cmpint(alice->keys->num_old_mac_keys, ==, 0);
 
   g_assert_cmpint(alice->keys->i, ==, 3);
   g_assert_cmpint(alice->keys->j, ==, 1);
@@ -396,16 +401,17 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_5, bob);
   assert_message_rec(result, "good", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_5);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 1);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 1);
   g_assert_cmpint(bob->keys->i, ==, 3);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 1);
   g_assert_cmpint(bob->keys->pn, ==, 1);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 1);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  1);
 
   // Bob receives the previous data message
   response_to_alice = otrng_response_new();
@@ -414,8 +420,9 @@ static void test_double_ratchet_new_ratchet_out_of_order(void) {
 
   free_message_and_response(response_to_alice, &to_send_3);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 2);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 2);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  0);
   g_assert_cmpint(bob->keys->i, ==, 3);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 1);
@@ -451,7 +458,7 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   // Alice sends a data message
   result = otrng_send_message(&to_send_1, "hi", NULL, 0, alice);
   assert_message_sent(result, to_send_1);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 2);
@@ -460,7 +467,7 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
 
   result = otrng_send_message(&to_send_2, "how are you?", NULL, 0, alice);
   assert_message_sent(result, to_send_2);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 3);
@@ -469,7 +476,7 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
 
   result = otrng_send_message(&to_send_3, "it's me", NULL, 0, alice);
   assert_message_sent(result, to_send_3);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 4);
@@ -480,11 +487,11 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_1, bob);
   assert_message_rec(result, "hi", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_1);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 2);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 2);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 2);
@@ -496,8 +503,9 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
 
   free_message_and_response(response_to_alice, &to_send_2);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 3);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 3);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  0);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 3);
@@ -507,7 +515,7 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   result = otrng_send_message(&to_send_4, "oh, hi", NULL, 0, bob);
   assert_message_sent(result, to_send_4);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 0);
 
   g_assert_cmpint(bob->keys->i, ==, 2);
   g_assert_cmpint(bob->keys->j, ==, 1);
@@ -518,7 +526,7 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   result = otrng_send_message(&to_send_6, "and test", NULL, 0, bob);
   assert_message_sent(result, to_send_6);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 0);
 
   g_assert_cmpint(bob->keys->i, ==, 2);
   g_assert_cmpint(bob->keys->j, ==, 2);
@@ -529,7 +537,7 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   response_to_bob = otrng_response_new();
   result = otrng_receive_message(response_to_bob, to_send_6, alice);
   assert_message_rec(result, "and test", response_to_bob);
-  g_assert_cmpint(otrng_list_len(alice->keys->old_mac_keys), ==, 1);
+  g_assert_cmpint(alice->keys->num_old_mac_keys, ==, 1);
 
   free_message_and_response(response_to_bob, &to_send_6);
 
@@ -542,7 +550,7 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   response_to_bob = otrng_response_new();
   result = otrng_receive_message(response_to_bob, to_send_4, alice);
   assert_message_rec(result, "oh, hi", response_to_bob);
-  g_assert_cmpint(otrng_list_len(alice->keys->old_mac_keys), ==, 2);
+  g_assert_cmpint(alice->keys->num_old_mac_keys, ==, 2);
 
   free_message_and_response(response_to_bob, &to_send_4);
 
@@ -555,7 +563,7 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   result = otrng_send_message(&to_send_5, "good", NULL, 0, alice);
   assert_message_sent(result, to_send_5);
 
-  g_assert_cmpint(otrng_list_len(alice->keys->old_mac_keys), ==, 0);
+  g_assert_cmpint(alice->keys->num_old_mac_keys, ==, 0);
 
   g_assert_cmpint(alice->keys->i, ==, 3);
   g_assert_cmpint(alice->keys->j, ==, 1);
@@ -566,16 +574,17 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_5, bob);
   assert_message_rec(result, "good", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_5);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 1);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 1);
   g_assert_cmpint(bob->keys->i, ==, 3);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 1);
   g_assert_cmpint(bob->keys->pn, ==, 2);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 1);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  1);
 
   // Bob receives the previous data message
   response_to_alice = otrng_response_new();
@@ -584,8 +593,9 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
 
   free_message_and_response(response_to_alice, &to_send_3);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 2);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 2);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  0);
   g_assert_cmpint(bob->keys->i, ==, 3);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 1);
@@ -596,6 +606,26 @@ static void test_double_ratchet_new_ratchet_out_of_order_2(void) {
   otrng_conn_free_all(alice, bob);
 }
 
+/* Encodes [msg] the way outgoing data messages are, but with whatever it
+   holds as the encrypted message */
+static char *encode_data_message(const data_message_s *msg,
+                                 const k_msg_mac mac_key) {
+  size_t max_ser_len =
+      DATA_MSG_MAX_BYTES + msg->enc_msg_len + DATA_MSG_MAC_BYTES;
+  size_t len = 0;
+  uint8_t *ser;
+  uint8_t *buffer = data_message_encoder_new(&ser, max_ser_len);
+  char *encoded = NULL;
+
+  otrng_assert_is_success(
+      otrng_data_message_header_serialize(ser, max_ser_len, &len, msg));
+  len += otrng_serialize_data(ser + len, msg->enc_msg, msg->enc_msg_len);
+  otrng_assert_is_success(data_message_encoder_finish(
+      &encoded, buffer, max_ser_len, len, mac_key, NULL, 0));
+
+  return encoded;
+}
+
 /* Test the double ratchet when a corrupted message arrives */
 static void test_double_ratchet_corrupted_ratchet(void) {
   otrng_client_s *alice_client = otrng_client_new(ALICE_IDENTITY);
@@ -616,7 +646,7 @@ static void test_double_ratchet_corrupted_ratchet(void) {
   // Alice sends a data message
   result = otrng_send_message(&to_send_1, "hi", NULL, 0, alice);
   assert_message_sent(result, to_send_1);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 2);
@@ -639,18 +669,17 @@ static void test_double_ratchet_corrupted_ratchet(void) {
   memset(corrupted_data_message->nonce, 0, DATA_MSG_NONCE_BYTES);
   k_msg_mac mac_key;
   memset(mac_key, 0, sizeof mac_key);
-  serialize_and_encode_data_message(&to_send_2, mac_key, NULL, 0,
-                                    corrupted_data_message);
+  to_send_2 = encode_data_message(corrupted_data_message, mac_key);
 
   // Bob receives a data message
   response_to_alice = otrng_response_new();
   result = otrng_receive_message(response_to_alice, to_send_1, bob);
   assert_message_rec(result, "hi", response_to_alice);
-  otrng_assert(bob->keys->old_mac_keys);
+  otrng_assert(bob->keys->num_old_mac_keys > 0);
 
   free_message_and_response(response_to_alice, &to_send_1);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 2);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 2);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 2);
@@ -662,8 +691,9 @@ static void test_double_ratchet_corrupted_ratchet(void) {
       otrng_receive_message(response_to_alice, to_send_2, bob));
   free_message_and_response(response_to_alice, &to_send_2);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 2);
-  g_assert_cmpint(otrng_list_len(bob->keys->skipped_keys), ==, 0);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 2);
+  g_assert_cmpint(otrng_skipped_keys_store_len(bob->keys->skipped_keys), ==,
+                  0);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 2);
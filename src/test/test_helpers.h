@@ -21,6 +21,7 @@
 #ifndef __TEST_HELPERS_H__
 #define __TEST_HELPERS_H__
 
+#define OTRNG_ALLOC_PRIVATE
 #define OTRNG_AUTH_PRIVATE
 #define OTRNG_CLIENT_PRIVATE
 #define OTRNG_DAKE_PRIVATE
@@ -0,0 +1,132 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "test_helpers.h"
+
+#include "alloc.h"
+
+static void test_secure_pool_class_for() {
+  g_assert_cmpint(pool_class_for(0), ==, 0);
+  g_assert_cmpint(pool_class_for(32), ==, 0);
+  g_assert_cmpint(pool_class_for(33), ==, 1);
+  g_assert_cmpint(pool_class_for(64), ==, 1);
+  g_assert_cmpint(pool_class_for(512), ==, OTRNG_SECURE_POOL_CLASSES - 1);
+  g_assert_cmpint(pool_class_for(513), ==, -1);
+}
+
+static void test_secure_pool_reuses_wiped_chunks() {
+  otrng_secure_pool_stats_s before, during, after;
+  uint8_t *first, *second;
+  int i;
+
+  otrng_secure_pool_get_stats(&before);
+
+  first = otrng_secure_alloc(64);
+  for (i = 0; i < 64; i++) {
+    g_assert_cmpint(first[i], ==, 0);
+  }
+  memset(first, 0xAB, 64);
+
+  otrng_secure_pool_get_stats(&during);
+  g_assert_cmpuint(during.classes[1].chunk_size, ==, 64);
+  g_assert_cmpuint(during.classes[1].in_use, ==, before.classes[1].in_use + 1);
+  g_assert_cmpuint(during.live_bytes, ==, before.live_bytes + 64);
+  g_assert_cmpuint(during.fallback_total, ==, before.fallback_total);
+
+  otrng_secure_free(first);
+
+  /* the last freed chunk is the first one handed out again */
+  second = otrng_secure_alloc(40);
+  otrng_assert(second == first);
+  for (i = 0; i < 64; i++) {
+    g_assert_cmpint(second[i], ==, 0);
+  }
+  otrng_secure_free(second);
+
+  otrng_secure_pool_get_stats(&after);
+  g_assert_cmpuint(after.classes[1].in_use, ==, before.classes[1].in_use);
+  g_assert_cmpuint(after.live_bytes, ==, before.live_bytes);
+}
+
+static void test_secure_pool_fallback() {
+  otrng_secure_pool_stats_s before, during, after;
+  uint8_t *big = NULL;
+
+  otrng_secure_pool_get_stats(&before);
+
+  big = otrng_secure_alloc(4096);
+  otrng_secure_pool_get_stats(&during);
+  g_assert_cmpuint(during.fallback_live, ==, before.fallback_live + 1);
+  g_assert_cmpuint(during.fallback_total, ==, before.fallback_total + 1);
+  g_assert_cmpuint(during.live_bytes, ==, before.live_bytes + 4096);
+
+  otrng_secure_free(big);
+  otrng_secure_free(NULL);
+
+  /* Aligned even when the size is not a multiple of the alignment */
+  big = otrng_secure_alloc(4097);
+  g_assert_cmpuint((uintptr_t)big % 16, ==, 0);
+  otrng_secure_free(big);
+
+  otrng_secure_pool_get_stats(&after);
+  g_assert_cmpuint(after.fallback_live, ==, before.fallback_live);
+  g_assert_cmpuint(after.live_bytes, ==, before.live_bytes);
+}
+
+static void test_secure_pool_exhaustion() {
+  const size_t count = OTRNG_SECURE_POOL_MAX_REGIONS *
+                           (OTRNG_SECURE_POOL_REGION_BYTES / 32) +
+                       10;
+  otrng_secure_pool_stats_s before, stats;
+  void **chunks = otrng_xmalloc_z(count * sizeof(void *));
+  size_t i;
+
+  otrng_secure_pool_get_stats(&before);
+
+  for (i = 0; i < count; i++) {
+    chunks[i] = otrng_secure_alloc(32);
+  }
+
+  otrng_secure_pool_get_stats(&stats);
+  g_assert_cmpuint(stats.classes[0].capacity, ==, count - 10);
+  g_assert_cmpuint(stats.classes[0].in_use, ==, count - 10);
+  g_assert_cmpuint(stats.fallback_live, >=, before.fallback_live + 10);
+
+  for (i = 0; i < count; i++) {
+    otrng_secure_free(chunks[i]);
+  }
+  otrng_free(chunks);
+
+  otrng_secure_pool_free();
+  otrng_secure_pool_get_stats(&stats);
+  g_assert_cmpuint(stats.classes[0].in_use, ==, before.classes[0].in_use);
+  g_assert_cmpuint(stats.fallback_live, ==, before.fallback_live);
+}
+
+void units_alloc_add_tests(void) {
+  g_test_add_func("/alloc/secure_pool/class_for", test_secure_pool_class_for);
+  g_test_add_func("/alloc/secure_pool/reuses_wiped_chunks",
+                  test_secure_pool_reuses_wiped_chunks);
+  g_test_add_func("/alloc/secure_pool/fallback", test_secure_pool_fallback);
+  g_test_add_func("/alloc/secure_pool/exhaustion",
+                  test_secure_pool_exhaustion);
+}
@@ -99,6 +99,96 @@ static void test_rsig_auth() {
                                  (unsigned char *)msg, strlen(msg)));
 }
 
+static void generate_keypairs(otrng_keypair_s *pairs, size_t len) {
+  uint8_t sym[ED448_PRIVATE_BYTES];
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    random_bytes(sym, ED448_PRIVATE_BYTES);
+    otrng_assert_is_success(otrng_keypair_generate(&pairs[i], sym));
+  }
+}
+
+static void test_rsig_verify_batch() {
+  const char *msgs[4] = {"one", "two", "three", "four"};
+  otrng_keypair_s p[3];
+  ring_sig_s sigmas[4];
+  rsig_batch_entry_s entries[4];
+  int i;
+
+  generate_keypairs(p, 3);
+
+  for (i = 0; i < 4; i++) {
+    otrng_assert_is_success(otrng_rsig_authenticate(
+        &sigmas[i], p[i % 3].priv, p[i % 3].pub, p[0].pub, p[1].pub, p[2].pub,
+        (const uint8_t *)msgs[i], strlen(msgs[i])));
+
+    entries[i].sigma = &sigmas[i];
+    entries[i].A1 = p[0].pub;
+    entries[i].A2 = p[1].pub;
+    entries[i].A3 = p[2].pub;
+    entries[i].msg = (const uint8_t *)msgs[i];
+    entries[i].msg_len = strlen(msgs[i]);
+  }
+
+  otrng_assert(otrng_rsig_verify_batch(entries, 0));
+
+  otrng_assert(otrng_rsig_verify_batch(entries, 4));
+  for (i = 0; i < 4; i++) {
+    otrng_assert(entries[i].valid);
+  }
+
+  /* A signature over another message, and one with other keys */
+  entries[1].msg = (const uint8_t *)msgs[0];
+  entries[1].msg_len = strlen(msgs[0]);
+  entries[3].A1 = p[1].pub;
+  entries[3].A2 = p[0].pub;
+
+  otrng_assert(!otrng_rsig_verify_batch(entries, 4));
+  otrng_assert(entries[0].valid);
+  otrng_assert(!entries[1].valid);
+  otrng_assert(entries[2].valid);
+  otrng_assert(!entries[3].valid);
+
+  /* The same signatures are only valid with their usage and domain */
+  entries[1].msg = (const uint8_t *)msgs[1];
+  entries[1].msg_len = strlen(msgs[1]);
+  entries[3].A1 = p[0].pub;
+  entries[3].A2 = p[1].pub;
+  otrng_assert(!otrng_rsig_verify_batch_with_usage_and_domain(
+      0x11, "OTR-Prekey-Server", entries, 4));
+}
+
+static void test_perf_rsig_verify_batch_100() {
+  const char *msg = "hi";
+  otrng_keypair_s p[3];
+  ring_sig_s sigma;
+  rsig_batch_entry_s entries[100];
+  double elapsed;
+  int i;
+
+  generate_keypairs(p, 3);
+  otrng_assert_is_success(otrng_rsig_authenticate(
+      &sigma, p[0].priv, p[0].pub, p[0].pub, p[1].pub, p[2].pub,
+      (const uint8_t *)msg, strlen(msg)));
+
+  for (i = 0; i < 100; i++) {
+    entries[i].sigma = &sigma;
+    entries[i].A1 = p[0].pub;
+    entries[i].A2 = p[1].pub;
+    entries[i].A3 = p[2].pub;
+    entries[i].msg = (const uint8_t *)msg;
+    entries[i].msg_len = strlen(msg);
+  }
+
+  g_test_timer_start();
+  otrng_assert(otrng_rsig_verify_batch(entries, 100));
+  elapsed = g_test_timer_elapsed();
+
+  g_test_minimized_result(elapsed, "100 ring signatures: %.3f ms",
+                          1e3 * elapsed);
+}
+
 static void test_rsig_compatible_with_prekey_server() {
   otrng_keypair_s p1, p2, p3;
 
@@ -541,4 +631,10 @@ void units_auth_add_tests(void) {
   g_test_add_func("/ring-signature/calculate_c", test_rsig_calculate_c);
   g_test_add_func("/ring-signature/compatible_with_prekey_server",
                   test_rsig_compatible_with_prekey_server);
+  g_test_add_func("/ring-signature/verify_batch", test_rsig_verify_batch);
+
+  if (g_test_perf()) {
+    g_test_add_func("/perf/ring-signature/verify_batch_100",
+                    test_perf_rsig_verify_batch_100);
+  }
 }
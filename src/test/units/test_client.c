@@ -76,9 +76,193 @@ static void test_fingerprint_hash_to_human() {
                   strncmp(expected_fp, fp_human, OTRNG_FPRINT_HUMAN_LEN));
 }
 
+static void test_client_conversation_index() {
+  otrng_client_s *client = otrng_client_new(ALICE_IDENTITY);
+  otrng_conversation_s *bob = new_conversation_with("bob@localhost", NULL);
+  otrng_conversation_s *carol = new_conversation_with("carol@localhost", NULL);
+
+  add_conversation(bob, client);
+  add_conversation(carol, client);
+
+  otrng_assert(get_conversation_with("bob@localhost", client) == bob);
+  otrng_assert(get_conversation_with("carol@localhost", client) == carol);
+  otrng_assert(!get_conversation_with("bob", client));
+
+  destroy_client_conversation(bob, client);
+  conversation_free(bob);
+  otrng_assert(!get_conversation_with("bob@localhost", client));
+  otrng_assert(get_conversation_with("carol@localhost", client) == carol);
+  g_assert_cmpuint(otrng_list_len(client->conversations), ==, 1);
+
+  otrng_client_free(client);
+}
+
+static void test_client_conversation_list() {
+  otrng_client_s *client = otrng_client_new(ALICE_IDENTITY);
+  otrng_conversation_s *convs[5];
+  char recipient[32];
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    snprintf(recipient, sizeof(recipient), "user%d@localhost", i);
+    convs[i] = new_conversation_with(recipient, NULL);
+    add_conversation(convs[i], client);
+  }
+
+  /* The newest conversation comes first */
+  otrng_assert(client->conversations->data == convs[3]);
+  otrng_assert(client->conversations->next->next->next->data == convs[0]);
+
+  /* From the middle, the head and the tail */
+  destroy_client_conversation(convs[1], client);
+  conversation_free(convs[1]);
+  destroy_client_conversation(convs[3], client);
+  conversation_free(convs[3]);
+  destroy_client_conversation(convs[0], client);
+  conversation_free(convs[0]);
+
+  g_assert_cmpuint(otrng_list_len(client->conversations), ==, 1);
+  otrng_assert(client->conversations->data == convs[2]);
+
+  convs[4] = new_conversation_with("user4@localhost", NULL);
+  add_conversation(convs[4], client);
+  destroy_client_conversation(convs[2], client);
+  conversation_free(convs[2]);
+
+  g_assert_cmpuint(otrng_list_len(client->conversations), ==, 1);
+  otrng_assert(client->conversations->data == convs[4]);
+  otrng_assert(get_conversation_with("user4@localhost", client) == convs[4]);
+
+  destroy_client_conversation(convs[4], client);
+  conversation_free(convs[4]);
+  otrng_assert(!client->conversations);
+
+  otrng_client_free(client);
+}
+
+static void test_client_build_prekey_messages_in_parallel() {
+  otrng_client_s *alice = otrng_client_new(ALICE_IDENTITY);
+  prekey_message_s **messages;
+  int i, j;
+
+  set_up_client(alice, 1);
+  otrng_global_state_set_keypair_generation_threads(alice->global_state, 4);
+
+  messages = otrng_client_build_prekey_messages(10, alice);
+  otrng_assert(messages);
+  g_assert_cmpuint(otrng_prekey_store_len(&alice->our_prekeys), ==, 10);
+
+  for (i = 0; i < 10; i++) {
+    otrng_assert(messages[i]->B);
+    for (j = 0; j < i; j++) {
+      otrng_assert(!otrng_ec_point_eq(messages[i]->Y, messages[j]->Y));
+      otrng_assert(gcry_mpi_cmp(messages[i]->B, messages[j]->B) != 0);
+    }
+  }
+
+  otrng_free(messages);
+  otrng_global_state_free(alice->global_state);
+}
+
+static void bench_build_prekey_messages(uint8_t num_messages) {
+  otrng_client_s *alice = otrng_client_new(ALICE_IDENTITY);
+  double serial, parallel;
+
+  set_up_client(alice, 1);
+
+  g_test_timer_start();
+  otrng_free(otrng_client_build_prekey_messages(num_messages, alice));
+  serial = g_test_timer_elapsed();
+
+  otrng_global_state_set_keypair_generation_threads(alice->global_state, 4);
+
+  g_test_timer_start();
+  otrng_free(otrng_client_build_prekey_messages(num_messages, alice));
+  parallel = g_test_timer_elapsed();
+
+  g_test_minimized_result(parallel, "%d prekey messages: %.1f ms, 4 threads",
+                          num_messages, 1e3 * parallel);
+  g_test_message("%d prekey messages: %.1f ms, 1 thread", num_messages,
+                 1e3 * serial);
+
+  otrng_global_state_free(alice->global_state);
+}
+
+static void test_perf_build_prekey_messages_1() {
+  bench_build_prekey_messages(1);
+}
+
+static void test_perf_build_prekey_messages_10() {
+  bench_build_prekey_messages(10);
+}
+
+static void test_perf_build_prekey_messages_100() {
+  bench_build_prekey_messages(100);
+}
+
+static void bench_conversation_lookup(int num_conversations) {
+  otrng_client_s *client = otrng_client_new(ALICE_IDENTITY);
+  const int num_lookups = 100000;
+  char recipient[32];
+  double elapsed;
+  int i;
+
+  for (i = 0; i < num_conversations; i++) {
+    snprintf(recipient, sizeof(recipient), "user%d@localhost", i);
+    add_conversation(new_conversation_with(recipient, NULL), client);
+  }
+
+  g_test_timer_start();
+  for (i = 0; i < num_lookups; i++) {
+    snprintf(recipient, sizeof(recipient), "user%d@localhost",
+             i % num_conversations);
+    otrng_assert(get_conversation_with(recipient, client));
+  }
+  elapsed = g_test_timer_elapsed();
+
+  g_test_minimized_result(elapsed / num_lookups,
+                          "lookup among %d conversations: %.3f us",
+                          num_conversations, 1e6 * elapsed / num_lookups);
+
+  otrng_client_free(client);
+}
+
+static void test_perf_conversation_lookup_10() {
+  bench_conversation_lookup(10);
+}
+
+static void test_perf_conversation_lookup_1k() {
+  bench_conversation_lookup(1000);
+}
+
+static void test_perf_conversation_lookup_100k() {
+  bench_conversation_lookup(100000);
+}
+
 void units_client_add_tests(void) {
   g_test_add_func("/client/fingerprint_to_human",
                   test_fingerprint_hash_to_human);
   g_test_add_func("/client/get_our_fingerprint",
                   test_client_get_our_fingerprint);
+  g_test_add_func("/client/conversation_index",
+                  test_client_conversation_index);
+  g_test_add_func("/client/conversation_list",
+                  test_client_conversation_list);
+  g_test_add_func("/client/build_prekey_messages_in_parallel",
+                  test_client_build_prekey_messages_in_parallel);
+
+  if (g_test_perf()) {
+    g_test_add_func("/perf/client/conversation_lookup_10",
+                    test_perf_conversation_lookup_10);
+    g_test_add_func("/perf/client/conversation_lookup_1k",
+                    test_perf_conversation_lookup_1k);
+    g_test_add_func("/perf/client/conversation_lookup_100k",
+                    test_perf_conversation_lookup_100k);
+    g_test_add_func("/perf/client/build_prekey_messages_1",
+                    test_perf_build_prekey_messages_1);
+    g_test_add_func("/perf/client/build_prekey_messages_10",
+                    test_perf_build_prekey_messages_10);
+    g_test_add_func("/perf/client/build_prekey_messages_100",
+                    test_perf_build_prekey_messages_100);
+  }
 }
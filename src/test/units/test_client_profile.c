@@ -221,6 +221,7 @@ static void test_otrng_client_profile_transitional_signature(void) {
 
   otrng_assert_is_success(otrng_v3_create_private_key(client));
 
+  otrng_global_state_lock_v3(client->global_state);
   OtrlPrivKey *dsa_key = otrng_client_get_private_key_v3(client);
 
   otrng_keypair_s keypair;
@@ -236,6 +237,7 @@ static void test_otrng_client_profile_transitional_signature(void) {
       otrng_client_get_client_profile_exp_time(client));
   otrng_assert_is_success(
       otrng_client_profile_transitional_sign(profile, dsa_key));
+  otrng_global_state_unlock_v3(client->global_state);
   otrng_assert_is_success(
       client_profile_verify_transitional_signature(profile));
 
@@ -255,8 +255,39 @@ static void test_data_message_valid() {
   otrng_data_message_free(data_msg);
 }
 
+static void test_data_message_valid_received() {
+  data_message_s *data_msg = set_up_data_message();
+  k_msg_mac mac_key = {0x42};
+  uint8_t *ser = NULL;
+  size_t ser_len = 0;
+  data_message_s *received = otrng_data_message_new();
+
+  otrng_assert_is_success(
+      otrng_data_message_body_serialize(&ser, &ser_len, data_msg));
+  ser = otrng_xrealloc(ser, ser_len + DATA_MSG_MAC_BYTES);
+  otrng_assert_is_success(otrng_data_message_authenticator(
+      ser + ser_len, DATA_MSG_MAC_BYTES, mac_key, ser, ser_len));
+
+  otrng_assert_is_success(otrng_data_message_deserialize(
+      received, ser, ser_len + DATA_MSG_MAC_BYTES, NULL));
+  otrng_assert(received->body == ser);
+  g_assert_cmpuint(received->body_len, ==, ser_len);
+
+  otrng_assert(otrng_valid_data_message(mac_key, received) == otrng_true);
+
+  // The received bytes are authenticated, not an encoding of the fields
+  ser[ser_len - 1] ^= 0x01;
+  otrng_assert(otrng_valid_data_message(mac_key, received) == otrng_false);
+
+  otrng_data_message_free(data_msg);
+  otrng_data_message_free(received);
+  otrng_free(ser);
+}
+
 void units_data_message_add_tests(void) {
   g_test_add_func("/data_message/valid", test_data_message_valid);
+  g_test_add_func("/data_message/valid_received",
+                  test_data_message_valid_received);
   g_test_add_func("/data_message/serialize", test_data_message_serializes);
   g_test_add_func("/data_message/serialize_absent_dh",
                   test_data_message_serializes_absent_dh);
@@ -183,9 +183,117 @@ static void test_dh_keypair_destroy() {
   otrng_assert(!alice.pub);
 }
 
+/* Random bases, and random exponents of [exp_bytes] bytes, as the DH prekey
+   proofs use */
+static void random_bases_and_exponents(dh_mpi *bases, dh_mpi *exps, size_t len,
+                                       size_t exp_bytes) {
+  uint8_t buf[DH3072_MOD_LEN_BYTES];
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    gcry_randomize(buf, sizeof(buf), GCRY_WEAK_RANDOM);
+    otrng_assert(!gcry_mpi_scan(&bases[i], GCRYMPI_FMT_USG, buf, sizeof(buf),
+                                NULL));
+    gcry_mpi_mod(bases[i], bases[i], otrng_dh_modulus_p());
+
+    gcry_randomize(buf, exp_bytes, GCRY_WEAK_RANDOM);
+    otrng_assert(
+        !gcry_mpi_scan(&exps[i], GCRYMPI_FMT_USG, buf, exp_bytes, NULL));
+  }
+}
+
+static void release_all(dh_mpi *mpis, size_t len) {
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    otrng_dh_mpi_release(mpis[i]);
+  }
+}
+
+static void test_dh_multi_powm() {
+  dh_mpi bases[5], exps[5];
+  dh_mpi expected = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+  dh_mpi result = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+  dh_mpi tmp = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+  size_t len, i;
+
+  random_bases_and_exponents(bases, exps, 5, 44);
+  gcry_mpi_set_ui(exps[1], 0);
+  gcry_mpi_set_ui(exps[2], 1);
+  gcry_mpi_set_ui(exps[3], 0xffff);
+
+  for (len = 0; len <= 5; len++) {
+    gcry_mpi_set_ui(expected, 1);
+    for (i = 0; i < len; i++) {
+      gcry_mpi_powm(tmp, bases[i], exps[i], otrng_dh_modulus_p());
+      gcry_mpi_mulm(expected, expected, tmp, otrng_dh_modulus_p());
+    }
+
+    otrng_dh_multi_powm(result, (const dh_mpi *)bases, (const dh_mpi *)exps,
+                        len);
+    g_assert_cmpint(gcry_mpi_cmp(result, expected), ==, 0);
+  }
+
+  release_all(bases, 5);
+  release_all(exps, 5);
+  otrng_dh_mpi_release(expected);
+  otrng_dh_mpi_release(result);
+  otrng_dh_mpi_release(tmp);
+}
+
+static void bench_dh_multi_powm(size_t len) {
+  dh_mpi *bases = otrng_xmalloc_z(len * sizeof(dh_mpi));
+  dh_mpi *exps = otrng_xmalloc_z(len * sizeof(dh_mpi));
+  dh_mpi result = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+  dh_mpi tmp = gcry_mpi_new(DH3072_MOD_LEN_BITS);
+  double simultaneous, separate;
+  size_t i;
+
+  random_bases_and_exponents(bases, exps, len, 44);
+
+  g_test_timer_start();
+  otrng_dh_multi_powm(result, (const dh_mpi *)bases, (const dh_mpi *)exps,
+                      len);
+  simultaneous = g_test_timer_elapsed();
+
+  /* What the DH prekey proof verification did before */
+  g_test_timer_start();
+  gcry_mpi_set_ui(result, 1);
+  for (i = 0; i < len; i++) {
+    gcry_mpi_powm(tmp, bases[i], exps[i], otrng_dh_modulus_p());
+    gcry_mpi_mulm(result, result, tmp, otrng_dh_modulus_p());
+  }
+  separate = g_test_timer_elapsed();
+
+  g_test_minimized_result(simultaneous, "%zu bases: %.3f ms", len,
+                          1e3 * simultaneous);
+  g_test_message("%zu bases, one gcry_mpi_powm each: %.3f ms", len,
+                 1e3 * separate);
+
+  release_all(bases, len);
+  release_all(exps, len);
+  otrng_free(bases);
+  otrng_free(exps);
+  otrng_dh_mpi_release(result);
+  otrng_dh_mpi_release(tmp);
+}
+
+static void test_perf_dh_multi_powm_1() { bench_dh_multi_powm(1); }
+
+static void test_perf_dh_multi_powm_10() { bench_dh_multi_powm(10); }
+
+static void test_perf_dh_multi_powm_100() { bench_dh_multi_powm(100); }
+
 void units_dh_add_tests(void) {
   g_test_add_func("/dh/api", test_dh_api);
   g_test_add_func("/dh/serialize", test_dh_serialize);
   g_test_add_func("/dh/shared-secret", test_dh_shared_secret);
   g_test_add_func("/dh/destroy", test_dh_keypair_destroy);
+  g_test_add_func("/dh/multi_powm", test_dh_multi_powm);
+
+  if (g_test_perf()) {
+    g_test_add_func("/perf/dh/multi_powm_1", test_perf_dh_multi_powm_1);
+    g_test_add_func("/perf/dh/multi_powm_10", test_perf_dh_multi_powm_10);
+    g_test_add_func("/perf/dh/multi_powm_100", test_perf_dh_multi_powm_100);
+  }
 }
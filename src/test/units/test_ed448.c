@@ -93,6 +93,85 @@ static void test_ed448_signature() {
   otrng_keypair_free(pair);
 }
 
+static void random_points_and_scalars(ec_point *points, ec_scalar *scalars,
+                                      size_t len) {
+  uint8_t buff[ED448_SCALAR_BYTES];
+  ec_scalar s;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    random_bytes(buff, ED448_SCALAR_BYTES);
+    goldilocks_448_scalar_decode_long(s, buff, ED448_SCALAR_BYTES);
+    goldilocks_448_point_scalarmul(points[i], goldilocks_448_point_base, s);
+
+    random_bytes(buff, ED448_SCALAR_BYTES);
+    goldilocks_448_scalar_decode_long(scalars[i], buff, ED448_SCALAR_BYTES);
+  }
+}
+
+static void test_ed448_multi_scalarmul() {
+  ec_point points[7];
+  ec_scalar scalars[7];
+  ec_point expected, res, tmp;
+  size_t len, i;
+
+  random_points_and_scalars(points, scalars, 7);
+  goldilocks_448_scalar_copy(scalars[3], goldilocks_448_scalar_zero);
+  goldilocks_448_scalar_copy(scalars[4], goldilocks_448_scalar_one);
+
+  for (len = 0; len <= 7; len++) {
+    goldilocks_448_point_copy(expected, goldilocks_448_point_identity);
+    for (i = 0; i < len; i++) {
+      goldilocks_448_point_scalarmul(tmp, points[i], scalars[i]);
+      goldilocks_448_point_add(expected, expected, tmp);
+    }
+
+    otrng_ec_multi_scalarmul(res, (const ec_point *)points,
+                             (const ec_scalar *)scalars, len);
+    otrng_assert(otrng_ec_point_eq(expected, res) == otrng_true);
+  }
+}
+
+static void test_perf_ed448_multi_scalarmul() {
+  const size_t sizes[] = {1, 2, 4, 8, 16, 32, 64, 128, 255};
+  ec_point *points = otrng_xmalloc_z(255 * sizeof(ec_point));
+  ec_scalar *scalars = otrng_xmalloc_z(255 * sizeof(ec_scalar));
+  ec_point res, tmp;
+  double msm, pairwise;
+  size_t n, i;
+
+  random_points_and_scalars(points, scalars, 255);
+
+  for (n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+    g_test_timer_start();
+    otrng_ec_multi_scalarmul(res, (const ec_point *)points,
+                             (const ec_scalar *)scalars, sizes[n]);
+    msm = g_test_timer_elapsed();
+
+    /* What the prekey proof verification did before */
+    g_test_timer_start();
+    goldilocks_448_point_copy(res, goldilocks_448_point_identity);
+    for (i = 0; i + 1 < sizes[n]; i += 2) {
+      goldilocks_448_point_double_scalarmul(tmp, points[i], scalars[i],
+                                            points[i + 1], scalars[i + 1]);
+      goldilocks_448_point_add(res, res, tmp);
+    }
+    if (i < sizes[n]) {
+      goldilocks_448_point_scalarmul(tmp, points[i], scalars[i]);
+      goldilocks_448_point_add(res, res, tmp);
+    }
+    pairwise = g_test_timer_elapsed();
+
+    g_test_message("%zu points: %.3f ms, pairwise: %.3f ms", sizes[n],
+                   1e3 * msm, 1e3 * pairwise);
+  }
+
+  g_test_minimized_result(msm, "255 points: %.3f ms", 1e3 * msm);
+
+  otrng_free(points);
+  otrng_free(scalars);
+}
+
 void units_ed448_add_tests(void) {
   g_test_add_func("/edwards448/eddsa_serialization",
                   test_ed448_eddsa_serialization);
@@ -100,4 +179,10 @@ void units_ed448_add_tests(void) {
   g_test_add_func("/edwards448/scalar_serialization",
                   test_ed448_scalar_serialization);
   g_test_add_func("/edwards448/signature", test_ed448_signature);
+  g_test_add_func("/edwards448/multi_scalarmul", test_ed448_multi_scalarmul);
+
+  if (g_test_perf()) {
+    g_test_add_func("/perf/edwards448/multi_scalarmul",
+                    test_perf_ed448_multi_scalarmul);
+  }
 }
@@ -0,0 +1,112 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "test_helpers.h"
+
+#include "client.h"
+#include "fingerprint.h"
+
+static void test_fingerprint_lookups_find_the_first_added() {
+  otrng_client_s client;
+  otrng_fingerprint fp1 = {0x01}, fp2 = {0x02}, fp3 = {0x03};
+  otrng_known_fingerprint_s *kf1, *kf2, *kf3;
+
+  memset(&client, 0, sizeof(client));
+
+  otrng_assert(!otrng_fingerprint_get_by_fp(&client, fp1));
+  otrng_assert(!otrng_fingerprint_get_by_username(&client, "bob@example.org"));
+
+  kf1 = otrng_fingerprint_add(&client, fp1, "bob@example.org", otrng_false);
+  kf2 = otrng_fingerprint_add(&client, fp2, "bob@example.org", otrng_true);
+  kf3 = otrng_fingerprint_add(&client, fp1, "eve@example.org", otrng_false);
+
+  g_assert_cmpint(otrng_list_len(client.fingerprints->fps), ==, 3);
+  otrng_assert(client.fingerprints->fps->data == kf1);
+  otrng_assert(client.fingerprints->fps->next->data == kf2);
+  otrng_assert(client.fingerprints->last->data == kf3);
+
+  otrng_assert(otrng_fingerprint_get_by_fp(&client, fp1) == kf1);
+  otrng_assert(otrng_fingerprint_get_by_fp(&client, fp2) == kf2);
+  otrng_assert(!otrng_fingerprint_get_by_fp(&client, fp3));
+  otrng_assert(otrng_fingerprint_get_by_username(&client, "bob@example.org") ==
+               kf1);
+  otrng_assert(otrng_fingerprint_get_by_username(&client, "eve@example.org") ==
+               kf3);
+  otrng_assert(!otrng_fingerprint_get_by_username(&client, "bob"));
+
+  otrng_known_fingerprints_free(client.fingerprints);
+}
+
+static void test_fingerprint_forget_keeps_the_indexes() {
+  otrng_client_s client;
+  otrng_fingerprint fp1 = {0x01}, fp2 = {0x02}, fp3 = {0x03};
+  otrng_known_fingerprint_s *kf1, *kf2, *kf3, *kf4;
+
+  memset(&client, 0, sizeof(client));
+
+  kf1 = otrng_fingerprint_add(&client, fp1, "bob@example.org", otrng_false);
+  kf2 = otrng_fingerprint_add(&client, fp2, "bob@example.org", otrng_true);
+  kf3 = otrng_fingerprint_add(&client, fp1, "eve@example.org", otrng_false);
+  kf4 = otrng_fingerprint_add(&client, fp3, "eve@example.org", otrng_false);
+
+  /* The fingerprint itself is freed while forgetting it */
+  otrng_fingerprint_forget(&client, kf1);
+
+  g_assert_cmpint(otrng_list_len(client.fingerprints->fps), ==, 3);
+  otrng_assert(client.fingerprints->fps->data == kf2);
+  otrng_assert(otrng_fingerprint_get_by_fp(&client, fp1) == kf3);
+  otrng_assert(otrng_fingerprint_get_by_username(&client, "bob@example.org") ==
+               kf2);
+
+  /* The last one */
+  otrng_fingerprint_forget(&client, kf4);
+  otrng_assert(!otrng_fingerprint_get_by_fp(&client, fp3));
+  otrng_assert(otrng_fingerprint_get_by_username(&client, "eve@example.org") ==
+               kf3);
+  otrng_assert(client.fingerprints->last->data == kf3);
+
+  kf4 = otrng_fingerprint_add(&client, fp3, "eve@example.org", otrng_false);
+  otrng_assert(client.fingerprints->last->data == kf4);
+  otrng_assert(otrng_fingerprint_get_by_fp(&client, fp3) == kf4);
+
+  otrng_fingerprint_forget(&client, kf2);
+  otrng_fingerprint_forget(&client, kf3);
+  otrng_fingerprint_forget(&client, kf4);
+  otrng_assert(!client.fingerprints->fps);
+  otrng_assert(!client.fingerprints->last);
+  otrng_assert(!otrng_fingerprint_get_by_fp(&client, fp1));
+  otrng_assert(!otrng_fingerprint_get_by_username(&client, "bob@example.org"));
+
+  kf1 = otrng_fingerprint_add(&client, fp1, "bob@example.org", otrng_false);
+  otrng_assert(client.fingerprints->fps->data == kf1);
+  otrng_assert(otrng_fingerprint_get_by_fp(&client, fp1) == kf1);
+
+  otrng_known_fingerprints_free(client.fingerprints);
+}
+
+void units_fingerprint_add_tests(void) {
+  g_test_add_func("/fingerprint/lookups_find_the_first_added",
+                  test_fingerprint_lookups_find_the_first_added);
+  g_test_add_func("/fingerprint/forget_keeps_the_indexes",
+                  test_fingerprint_forget_keeps_the_indexes);
+}
@@ -77,56 +77,58 @@ static void test_defragment_valid_message(void) {
   fragments[1] = "?OTR|00000000|00000001|00000002,00002,00002,more,";
 
   fragment_context_s *context = NULL;
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
 
   char *unfrag = NULL;
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, fragments[0], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
 
-  context = list->data;
+  context = contexts.list->data;
   g_assert_cmpint(context->total, ==, 2);
   g_assert_cmpint(context->count, ==, 1);
   otrng_assert(!unfrag);
 
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, fragments[1], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
 
-  otrng_assert(otrng_list_len(list) == 0);
+  otrng_assert(otrng_list_len(contexts.list) == 0);
   g_assert_cmpstr(unfrag, ==, "one more");
 
   otrng_free(unfrag);
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_defragment_single_fragment(void) {
   const string_p message =
       "?OTR|00000000|00000001|00000002,00001,00001,small lol,";
 
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
   char *unfrag = NULL;
 
-  otrng_assert_is_success(otrng_unfragment_message(&unfrag, &list, message, 2));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, message, 2));
 
-  otrng_assert(otrng_list_len(list) == 0);
+  otrng_assert(otrng_list_len(contexts.list) == 0);
   g_assert_cmpstr(unfrag, ==, "small lol");
 
   otrng_free(unfrag);
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_defragment_without_comma_fails(void) {
   const string_p message = "?OTR|00000000|00000001|00000002,00001,00001,blergh";
 
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
 
   char *unfrag = NULL;
-  otrng_assert_is_error(otrng_unfragment_message(&unfrag, &list, message, 2));
+  otrng_assert_is_error(
+      otrng_unfragment_message(&unfrag, &contexts, message, 2));
 
-  otrng_assert(list == NULL);
+  otrng_assert(contexts.list == NULL);
   g_assert_cmpstr(unfrag, ==, NULL);
 
   otrng_free(unfrag);
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_defragment_with_different_total_fails(void) {
@@ -135,27 +137,26 @@ static void test_defragment_with_different_total_fails(void) {
   fragments[1] = "?OTR|00000000|00000001|00000002,00002,00002,total,";
 
   fragment_context_s *context = NULL;
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
 
   char *unfrag = NULL;
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, fragments[0], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
   otrng_assert(!unfrag);
 
-  context = list->data;
+  context = contexts.list->data;
   g_assert_cmpint(context->total, ==, 3);
   g_assert_cmpint(context->count, ==, 1);
 
   otrng_assert_is_error(
-      otrng_unfragment_message(&unfrag, &list, fragments[1], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
 
-  context = list->data;
+  context = contexts.list->data;
   otrng_assert(!unfrag);
   g_assert_cmpint(context->total, ==, 3);
   g_assert_cmpint(context->count, ==, 1);
 
-  otrng_fragment_context_free(context);
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_defragment_fragment_twice_fails(void) {
@@ -164,26 +165,25 @@ static void test_defragment_fragment_twice_fails(void) {
   fragments[1] = "?OTR|00000000|00000001|00000002,00001,00002,same twice,";
 
   fragment_context_s *context = NULL;
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
 
   char *unfrag = NULL;
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, fragments[0], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
 
-  context = list->data;
+  context = contexts.list->data;
   otrng_assert(!unfrag);
   g_assert_cmpint(context->total, ==, 2);
   g_assert_cmpint(context->count, ==, 1);
 
   otrng_assert_is_error(
-      otrng_unfragment_message(&unfrag, &list, fragments[1], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
 
   otrng_assert(!unfrag);
   g_assert_cmpint(context->total, ==, 2);
   g_assert_cmpint(context->count, ==, 1);
 
-  otrng_fragment_context_free(context);
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_defragment_out_of_order_message(void) {
@@ -193,61 +193,63 @@ static void test_defragment_out_of_order_message(void) {
   fragments[2] = "?OTR|00000000|00000001|00000002,00001,00003,one more ,";
 
   fragment_context_s *context = NULL;
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
 
   char *unfrag = NULL;
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, fragments[0], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
 
-  context = list->data;
+  context = contexts.list->data;
   otrng_assert(!unfrag);
   g_assert_cmpint(context->total, ==, 3);
   g_assert_cmpint(context->count, ==, 1);
 
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, fragments[1], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
   otrng_assert(!unfrag);
   g_assert_cmpint(context->total, ==, 3);
   g_assert_cmpint(context->count, ==, 2);
 
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, fragments[2], 2));
+      otrng_unfragment_message(&unfrag, &contexts, fragments[2], 2));
   g_assert_cmpstr(unfrag, ==, "one more fragment send");
 
-  otrng_assert(otrng_list_len(list) == 0);
+  otrng_assert(otrng_list_len(contexts.list) == 0);
 
   otrng_free(unfrag);
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_defragment_fails_for_another_instance(void) {
   const string_p message =
       "?OTR|00000000|00000001|00000002,00001,00001,small lol,";
 
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
   char *unfrag = NULL;
 
-  otrng_assert_is_success(otrng_unfragment_message(&unfrag, &list, message, 1));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, message, 1));
 
-  otrng_assert(list == NULL);
+  otrng_assert(contexts.list == NULL);
   g_assert_cmpstr(unfrag, ==, NULL);
 
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_defragment_regular_otr_message(void) {
   const string_p message = "?OTR:not a fragmented message.";
 
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
   char *unfrag = NULL;
 
-  otrng_assert_is_success(otrng_unfragment_message(&unfrag, &list, message, 1));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, message, 1));
 
-  otrng_assert(list == NULL);
+  otrng_assert(contexts.list == NULL);
   g_assert_cmpstr(unfrag, ==, message);
 
   otrng_free(unfrag);
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_defragment_two_messages(void) {
@@ -261,58 +263,354 @@ static void test_defragment_two_messages(void) {
   message2_fragments[1] =
       "?OTR|00000002|00000001|00000002,00002,00002,message,";
 
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
 
   char *unfrag = NULL;
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, message1_fragments[0], 2));
+      otrng_unfragment_message(&unfrag, &contexts, message1_fragments[0], 2));
 
   otrng_assert(!unfrag);
-  otrng_assert(otrng_list_len(list) == 1);
+  otrng_assert(otrng_list_len(contexts.list) == 1);
 
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, message2_fragments[0], 2));
+      otrng_unfragment_message(&unfrag, &contexts, message2_fragments[0], 2));
   otrng_assert(!unfrag);
-  otrng_assert(otrng_list_len(list) == 2);
+  otrng_assert(otrng_list_len(contexts.list) == 2);
 
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, message2_fragments[1], 2));
+      otrng_unfragment_message(&unfrag, &contexts, message2_fragments[1], 2));
   g_assert_cmpstr(unfrag, ==, "second message");
-  otrng_assert(otrng_list_len(list) == 1);
+  otrng_assert(otrng_list_len(contexts.list) == 1);
 
   otrng_free(unfrag);
   unfrag = NULL;
 
   otrng_assert_is_success(
-      otrng_unfragment_message(&unfrag, &list, message1_fragments[1], 2));
+      otrng_unfragment_message(&unfrag, &contexts, message1_fragments[1], 2));
   g_assert_cmpstr(unfrag, ==, "first message");
-  otrng_assert(otrng_list_len(list) == 0);
+  otrng_assert(otrng_list_len(contexts.list) == 0);
 
   otrng_free(unfrag);
-  otrng_list_free_nodes(list);
+  otrng_fragment_contexts_destroy(&contexts);
+}
+
+static void test_defragment_many_messages(void) {
+  const int num_messages = 100;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
+  char fragment[64], expected[16];
+  char *unfrag = NULL;
+  int i, j;
+
+  for (i = 0; i < num_messages; i++) {
+    snprintf(fragment, sizeof(fragment),
+             "?OTR|%08x|00000001|00000002,00001,00002,m%d ,", i + 1, i);
+    otrng_assert_is_success(
+        otrng_unfragment_message(&unfrag, &contexts, fragment, 2));
+    otrng_assert(!unfrag);
+  }
+  g_assert_cmpint(otrng_list_len(contexts.list), ==, num_messages);
+
+  /* Completed out of the order they were opened in, so contexts are
+     removed from everywhere in the list */
+  for (j = 0; j < num_messages; j++) {
+    i = (j * 37) % num_messages;
+    snprintf(fragment, sizeof(fragment),
+             "?OTR|%08x|00000001|00000002,00002,00002,done,", i + 1);
+    otrng_assert_is_success(
+        otrng_unfragment_message(&unfrag, &contexts, fragment, 2));
+    snprintf(expected, sizeof(expected), "m%d done", i);
+    g_assert_cmpstr(unfrag, ==, expected);
+    otrng_free(unfrag);
+    unfrag = NULL;
+    g_assert_cmpint(otrng_list_len(contexts.list), ==, num_messages - j - 1);
+  }
+
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
 static void test_expiration_of_fragments(void) {
   time_t HOUR_IN_SEC = 3600;
-  list_element_s *list = NULL;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
   fragment_context_s *ctx1 = otrng_fragment_context_new();
   fragment_context_s *ctx2 = otrng_fragment_context_new();
 
   ctx1->last_fragment_received_at = HOUR_IN_SEC;
   ctx2->last_fragment_received_at = HOUR_IN_SEC + 2;
 
-  list = otrng_list_add(ctx1, list);
-  list = otrng_list_add(ctx2, list);
+  add_fragment_context(&contexts, ctx1);
+  add_fragment_context(&contexts, ctx2);
+
+  time_t now = HOUR_IN_SEC + 4;
+  otrng_assert_is_success(otrng_expire_fragments(now, 5, &contexts));
+  otrng_assert(otrng_list_len(contexts.list) == 2);
+
+  now = HOUR_IN_SEC + 5;
+  otrng_assert_is_success(otrng_expire_fragments(now, 5, &contexts));
+  otrng_assert(otrng_list_len(contexts.list) == 1);
+  otrng_assert(contexts.list->data == ctx2);
+
+  now = HOUR_IN_SEC + 7;
+  otrng_assert_is_success(otrng_expire_fragments(now, 5, &contexts));
+  otrng_assert(otrng_list_len(contexts.list) == 0);
+}
+
+static void test_expiration_of_fragments_by_timer(void) {
+  time_t now = time(NULL);
+  timer_wheel_s *timers = otrng_timer_wheel_new(now);
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
+  char *unfrag = NULL;
+  time_t deadline;
+
+  contexts.timers = timers;
+  contexts.expiration_time = 60;
+
+  otrng_assert_is_success(otrng_unfragment_message(
+      &unfrag, &contexts, "?OTR|00000001|00000001|00000002,00001,00002,a,",
+      2));
+  otrng_assert_is_success(otrng_unfragment_message(
+      &unfrag, &contexts, "?OTR|00000002|00000001|00000002,00001,00002,b,",
+      2));
+  otrng_assert(otrng_list_len(contexts.list) == 2);
+
+  /* A finished message leaves nothing to expire */
+  otrng_assert_is_success(otrng_unfragment_message(
+      &unfrag, &contexts, "?OTR|00000002|00000001|00000002,00002,00002,c,",
+      2));
+  g_assert_cmpstr(unfrag, ==, "bc");
+  otrng_free(unfrag);
+  g_assert_cmpuint(otrng_timer_wheel_len(timers), ==, 1);
+
+  otrng_assert(otrng_timer_wheel_next_deadline(&deadline, timers));
+  otrng_assert(deadline >= now + 60);
+
+  otrng_timer_wheel_advance(timers, deadline - 1);
+  otrng_assert(otrng_list_len(contexts.list) == 1);
+
+  otrng_timer_wheel_advance(timers, deadline);
+  otrng_assert(otrng_list_len(contexts.list) == 0);
+  g_assert_cmpuint(otrng_timer_wheel_len(timers), ==, 0);
+
+  otrng_fragment_contexts_destroy(&contexts);
+  otrng_timer_wheel_free(timers);
+}
+
+static void test_parse_fragment(void) {
+  fragment_s fragment;
+
+  otrng_assert_is_success(
+      parse_fragment(&fragment, "0000abcd|00000101|FFFFFFFF,00002,00003,ab,"));
+  g_assert_cmpuint(fragment.identifier, ==, 0xabcd);
+  g_assert_cmpuint(fragment.sender_tag, ==, 0x101);
+  g_assert_cmpuint(fragment.receiver_tag, ==, 0xffffffff);
+  g_assert_cmpuint(fragment.index, ==, 2);
+  g_assert_cmpuint(fragment.total, ==, 3);
+  g_assert_cmpuint(fragment.piece_len, ==, 2);
+  otrng_assert_cmpmem(fragment.piece, "ab", 2);
+
+  otrng_assert_is_error(
+      parse_fragment(&fragment, "0000abcg|00000101|00000102,00002,00003,ab,"));
+  otrng_assert_is_error(
+      parse_fragment(&fragment, "0000abcd|00000101,00000102,00002,00003,ab,"));
+  otrng_assert_is_error(
+      parse_fragment(&fragment, "0000abcd|00000101|00000102,00002,00003,,"));
+  otrng_assert_is_error(
+      parse_fragment(&fragment, "0000abcd|00000101|00000102,00002,70000,ab,"));
+  otrng_assert_is_error(
+      parse_fragment(&fragment, "0000abcd|00000101|00000102,00002,00003"));
+}
+
+static void test_defragment_uneven_fragments(void) {
+  const string_p fragments[3];
+  fragments[0] = "?OTR|00000000|00000001|00000002,00001,00003,abc,";
+  fragments[1] = "?OTR|00000000|00000001|00000002,00002,00003,de,";
+  fragments[2] = "?OTR|00000000|00000001|00000002,00003,00003,fghij,";
 
-  time_t now = HOUR_IN_SEC + 1;
-  otrng_assert_is_success(otrng_expire_fragments(now, 5, &list));
-  otrng_assert(otrng_list_len(list) == 1);
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
+  char *unfrag = NULL;
+
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
+  otrng_assert(!unfrag);
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[2], 2));
+  g_assert_cmpstr(unfrag, ==, "abcdefghij");
+  otrng_free(unfrag);
 
-  now = HOUR_IN_SEC + 3;
-  otrng_assert_is_success(otrng_expire_fragments(now, 5, &list));
-  otrng_assert(otrng_list_len(list) == 0);
+  /* And when they arrive out of order */
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[2], 2));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
+  otrng_assert(!unfrag);
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
+  g_assert_cmpstr(unfrag, ==, "abcdefghij");
+  otrng_free(unfrag);
+
+  otrng_assert(otrng_list_len(contexts.list) == 0);
+  otrng_fragment_contexts_destroy(&contexts);
 }
 
+static void test_defragment_allocates_what_was_received(void) {
+  /* A single fragment claiming to be one of 65535 */
+  const string_p fragment = "?OTR|00000000|00000001|00000002,00002,65535,ab,";
+
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
+  fragment_context_s *context;
+  char *unfrag = NULL;
+
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragment, 2));
+  otrng_assert(!unfrag);
+  otrng_assert(otrng_list_len(contexts.list) == 1);
+
+  context = contexts.list->data;
+  otrng_assert(context->total == 65535);
+  otrng_assert(context->buffer_size <= strlen("ab") + 1);
+
+  otrng_fragment_contexts_destroy(&contexts);
+}
+
+static void test_defragment_too_long_message_fails(void) {
+  const string_p fragments[3];
+  fragments[0] = "?OTR|00000000|00000001|00000002,00001,00003,abcd,";
+  fragments[1] = "?OTR|00000000|00000001|00000002,00002,00003,efgh,";
+  fragments[2] = "?OTR|00000000|00000001|00000002,00003,00003,ij,";
+
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
+  char *unfrag = NULL;
+
+  contexts.max_message_len = 9;
+
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
+  otrng_assert_is_error(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[2], 2));
+  otrng_assert(!unfrag);
+  otrng_assert(otrng_list_len(contexts.list) == 0);
+
+  /* One byte less fits */
+  contexts.max_message_len = 10;
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[2], 2));
+  g_assert_cmpstr(unfrag, ==, "abcdefghij");
+  otrng_free(unfrag);
+
+  otrng_fragment_contexts_destroy(&contexts);
+}
+
+static void test_defragment_same_identifier_from_two_senders(void) {
+  const string_p fragments[4];
+  fragments[0] = "?OTR|00000007|00000101|00000002,00001,00002,from ,";
+  fragments[1] = "?OTR|00000007|00000102|00000002,00001,00002,also ,";
+  fragments[2] = "?OTR|00000007|00000102|00000002,00002,00002,102,";
+  fragments[3] = "?OTR|00000007|00000101|00000002,00002,00002,101,";
+
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
+  char *unfrag = NULL;
+
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[0], 2));
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[1], 2));
+  otrng_assert(otrng_list_len(contexts.list) == 2);
+
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[2], 2));
+  g_assert_cmpstr(unfrag, ==, "also 102");
+  otrng_free(unfrag);
+
+  otrng_assert_is_success(
+      otrng_unfragment_message(&unfrag, &contexts, fragments[3], 2));
+  g_assert_cmpstr(unfrag, ==, "from 101");
+  otrng_free(unfrag);
+
+  otrng_assert(otrng_list_len(contexts.list) == 0);
+  otrng_fragment_contexts_destroy(&contexts);
+}
+
+static void test_fragmenter_writes_into_caller_buffer(void) {
+  const char *message = "one two tree";
+  fragmenter_s fragmenter;
+  char fragment[48 + 1];
+  size_t allocations;
+
+  otrng_assert_is_error(
+      otrng_fragmenter_init(&fragmenter, 45, 1, 2, message, strlen(message)));
+  otrng_assert_is_error(otrng_fragmenter_init(&fragmenter, 48, 1, 2, "", 0));
+
+  allocations = otrng_alloc_count();
+
+  otrng_assert_is_success(
+      otrng_fragmenter_init(&fragmenter, 48, 1, 2, message, strlen(message)));
+  g_assert_cmpint(fragmenter.total, ==, 4);
+
+  g_assert_cmpuint(otrng_fragmenter_next(&fragmenter, fragment), ==, 48);
+  g_assert_cmpstr(fragment + 14, ==, "00000001|00000002,00001,00004,one,");
+  g_assert_cmpuint(otrng_fragmenter_next(&fragmenter, fragment), ==, 48);
+  g_assert_cmpstr(fragment + 14, ==, "00000001|00000002,00002,00004, tw,");
+  g_assert_cmpuint(otrng_fragmenter_next(&fragmenter, fragment), ==, 48);
+  g_assert_cmpstr(fragment + 14, ==, "00000001|00000002,00003,00004,o t,");
+  g_assert_cmpuint(otrng_fragmenter_next(&fragmenter, fragment), ==, 48);
+  g_assert_cmpstr(fragment + 14, ==, "00000001|00000002,00004,00004,ree,");
+  g_assert_cmpuint(otrng_fragmenter_next(&fragmenter, fragment), ==, 0);
+
+  g_assert_cmpuint(otrng_alloc_count(), ==, allocations);
+}
+
+static void bench_fragment_1mb(int max_size) {
+  size_t msg_len = 1024 * 1024;
+  char *message = otrng_xmalloc(msg_len + 1);
+  otrng_message_to_send_s *fragments;
+  fragment_contexts_s contexts = {NULL, NULL, NULL, 0, 0};
+  char *unfrag = NULL;
+  double fragmented, reassembled;
+  int i;
+
+  memset(message, 'A', msg_len);
+  message[msg_len] = '\0';
+
+  fragments = otrng_message_new();
+
+  g_test_timer_start();
+  otrng_assert_is_success(
+      otrng_fragment_message(max_size, fragments, 1, 2, message));
+  fragmented = g_test_timer_elapsed();
+
+  g_test_timer_start();
+  for (i = 0; i < fragments->total; i++) {
+    otrng_assert_is_success(
+        otrng_unfragment_message(&unfrag, &contexts, fragments->pieces[i], 2));
+  }
+  reassembled = g_test_timer_elapsed();
+
+  g_assert_cmpuint(strlen(unfrag), ==, msg_len);
+
+  g_test_minimized_result(fragmented, "fragment 1 MB at MMS %d: %.3f ms",
+                          max_size, 1e3 * fragmented);
+  g_test_message("reassemble %d fragments: %.3f ms", fragments->total,
+                 1e3 * reassembled);
+
+  otrng_free(unfrag);
+  otrng_fragment_contexts_destroy(&contexts);
+  otrng_message_free(fragments);
+  otrng_free(message);
+}
+
+static void test_perf_fragment_1mb_mms_140(void) { bench_fragment_1mb(140); }
+
+static void test_perf_fragment_1mb_mms_1000(void) { bench_fragment_1mb(1000); }
+
+static void test_perf_fragment_1mb_mms_64k(void) { bench_fragment_1mb(65536); }
+
 void units_fragment_add_tests(void) {
   g_test_add_func("/fragment/create_fragments_smaller_than_max_size",
                   test_create_fragments_smaller_than_max_size);
@@ -335,6 +633,30 @@ void units_fragment_add_tests(void) {
                   test_defragment_regular_otr_message);
   g_test_add_func("/fragment/defragment_two_messages",
                   test_defragment_two_messages);
+  g_test_add_func("/fragment/defragment_many_messages",
+                  test_defragment_many_messages);
   g_test_add_func("/fragment/expiration_of_fragments",
                   test_expiration_of_fragments);
+  g_test_add_func("/fragment/expiration_of_fragments_by_timer",
+                  test_expiration_of_fragments_by_timer);
+  g_test_add_func("/fragment/parse_fragment", test_parse_fragment);
+  g_test_add_func("/fragment/defragment_uneven_fragments",
+                  test_defragment_uneven_fragments);
+  g_test_add_func("/fragment/defragment_allocates_what_was_received",
+                  test_defragment_allocates_what_was_received);
+  g_test_add_func("/fragment/defragment_too_long_message_fails",
+                  test_defragment_too_long_message_fails);
+  g_test_add_func("/fragment/defragment_same_identifier_from_two_senders",
+                  test_defragment_same_identifier_from_two_senders);
+  g_test_add_func("/fragment/fragmenter_writes_into_caller_buffer",
+                  test_fragmenter_writes_into_caller_buffer);
+
+  if (g_test_perf()) {
+    g_test_add_func("/perf/fragment/fragment_1mb_mms_140",
+                    test_perf_fragment_1mb_mms_140);
+    g_test_add_func("/perf/fragment/fragment_1mb_mms_1000",
+                    test_perf_fragment_1mb_mms_1000);
+    g_test_add_func("/perf/fragment/fragment_1mb_mms_64k",
+                    test_perf_fragment_1mb_mms_64k);
+  }
 }
@@ -0,0 +1,88 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+
+#include "test_helpers.h"
+
+#include "hash_table.h"
+
+static void test_hash_table_put_and_get() {
+  hash_table_s *table = otrng_hash_table_new();
+  int one = 1, two = 2;
+
+  otrng_assert(!otrng_hash_table_get(table, "alice", 5));
+
+  otrng_hash_table_put(table, "alice", 5, &one);
+  otrng_hash_table_put(table, "bob", 3, &two);
+  g_assert_cmpuint(otrng_hash_table_len(table), ==, 2);
+
+  otrng_assert(otrng_hash_table_get(table, "alice", 5) == &one);
+  otrng_assert(otrng_hash_table_get(table, "bob", 3) == &two);
+  otrng_assert(!otrng_hash_table_get(table, "alic", 4));
+
+  otrng_hash_table_put(table, "alice", 5, &two);
+  g_assert_cmpuint(otrng_hash_table_len(table), ==, 2);
+  otrng_assert(otrng_hash_table_get(table, "alice", 5) == &two);
+
+  otrng_hash_table_free(table, NULL);
+}
+
+static void test_hash_table_remove() {
+  hash_table_s *table = otrng_hash_table_new();
+  int one = 1;
+
+  otrng_assert(!otrng_hash_table_remove(table, "alice", 5));
+
+  otrng_hash_table_put(table, "alice", 5, &one);
+  otrng_assert(otrng_hash_table_remove(table, "alice", 5) == &one);
+  otrng_assert(!otrng_hash_table_get(table, "alice", 5));
+  g_assert_cmpuint(otrng_hash_table_len(table), ==, 0);
+
+  otrng_hash_table_free(table, NULL);
+}
+
+static void test_hash_table_grows() {
+  hash_table_s *table = otrng_hash_table_new();
+  char name[16];
+  int i;
+
+  for (i = 0; i < 1000; i++) {
+    snprintf(name, sizeof(name), "user%d", i);
+    otrng_hash_table_put(table, name, strlen(name), otrng_xstrdup(name));
+  }
+
+  g_assert_cmpuint(otrng_hash_table_len(table), ==, 1000);
+  otrng_assert(table->num_buckets >= 1000);
+
+  for (i = 0; i < 1000; i++) {
+    snprintf(name, sizeof(name), "user%d", i);
+    g_assert_cmpstr(otrng_hash_table_get(table, name, strlen(name)), ==, name);
+  }
+
+  otrng_hash_table_free(table, otrng_free);
+}
+
+void units_hash_table_add_tests(void) {
+  g_test_add_func("/hash_table/put_and_get", test_hash_table_put_and_get);
+  g_test_add_func("/hash_table/remove", test_hash_table_remove);
+  g_test_add_func("/hash_table/grows", test_hash_table_grows);
+}
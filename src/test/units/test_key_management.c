@@ -94,9 +94,14 @@ static void test_calculate_extra_symm_key() {
       0xf8, 0xa0, 0x3d, 0x01, 0xb4, 0x0a, 0xc4, 0xad, 0xd0,
   };
 
+  k_msg_enc enc_key;
+  k_sending_chain next_chain_key;
+
   memcpy(s, manager.current->chain_s, sizeof(k_sending_chain));
 
-  calculate_extra_key(&manager, NULL, 's');
+  otrng_assert_is_success(derive_from_chain_key(enc_key,
+                                                manager.extra_symmetric_key,
+                                                next_chain_key, s));
   otrng_assert_cmpmem(expected_extra_key, manager.extra_symmetric_key,
                       EXTRA_SYMMETRIC_KEY_BYTES);
 
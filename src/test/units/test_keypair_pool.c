@@ -0,0 +1,172 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "test_helpers.h"
+
+#include "key_management.h"
+#include "keypair_pool.h"
+
+static void test_keypair_pool_refill() {
+  keypair_pool_s *pool = otrng_keypair_pool_new(3);
+
+  g_assert_cmpuint(pool->num_ecdh, ==, 0);
+  g_assert_cmpuint(pool->num_dh, ==, 0);
+
+  otrng_assert_is_success(otrng_keypair_pool_refill(pool));
+  g_assert_cmpuint(pool->num_ecdh, ==, 3);
+  g_assert_cmpuint(pool->num_dh, ==, 3);
+
+  otrng_keypair_pool_free(pool);
+}
+
+static void test_keypair_pool_take() {
+  keypair_pool_s *pool = otrng_keypair_pool_new(2);
+  ecdh_keypair_s ecdh;
+  dh_keypair_s dh;
+  ec_point expected_ecdh;
+  dh_public_key expected_dh;
+
+  otrng_assert_is_success(otrng_keypair_pool_refill(pool));
+  otrng_ec_point_copy(expected_ecdh, pool->ecdh[1].pub);
+  expected_dh = pool->dh[1].pub;
+
+  otrng_assert_is_success(otrng_keypair_pool_take_ecdh(&ecdh, pool));
+  otrng_assert_is_success(otrng_keypair_pool_take_dh(&dh, pool));
+  g_assert_cmpuint(pool->num_ecdh, ==, 1);
+  g_assert_cmpuint(pool->num_dh, ==, 1);
+
+  otrng_assert(otrng_ec_point_eq(ecdh.pub, expected_ecdh));
+  otrng_assert(dh.pub == expected_dh);
+  otrng_assert(pool->dh[1].pub == NULL);
+  otrng_assert(pool->dh[1].priv == NULL);
+
+  otrng_ecdh_keypair_destroy(&ecdh);
+  otrng_dh_keypair_destroy(&dh);
+  otrng_keypair_pool_free(pool);
+}
+
+static void test_keypair_pool_take_when_empty() {
+  keypair_pool_s *pool = otrng_keypair_pool_new(0);
+  ecdh_keypair_s ecdh;
+  dh_keypair_s dh = {NULL, NULL};
+
+  otrng_assert_is_success(otrng_keypair_pool_refill(pool));
+  otrng_assert_is_success(otrng_keypair_pool_take_ecdh(&ecdh, pool));
+  otrng_assert_is_success(otrng_keypair_pool_take_dh(&dh, pool));
+  otrng_assert(dh.pub);
+  otrng_assert(dh.priv);
+
+  otrng_ecdh_keypair_destroy(&ecdh);
+  otrng_dh_keypair_destroy(&dh);
+
+  otrng_assert_is_success(otrng_keypair_pool_take_dh(&dh, NULL));
+  otrng_assert(dh.pub);
+  otrng_dh_keypair_destroy(&dh);
+
+  otrng_keypair_pool_free(pool);
+}
+
+static void test_keypair_pool_set_depth() {
+  keypair_pool_s *pool = otrng_keypair_pool_new(4);
+
+  otrng_assert_is_success(otrng_keypair_pool_refill(pool));
+
+  otrng_keypair_pool_set_depth(pool, 1);
+  g_assert_cmpuint(pool->num_ecdh, ==, 1);
+  g_assert_cmpuint(pool->num_dh, ==, 1);
+
+  otrng_keypair_pool_set_depth(pool, 2);
+  g_assert_cmpuint(pool->num_ecdh, ==, 1);
+  otrng_assert_is_success(otrng_keypair_pool_refill(pool));
+  g_assert_cmpuint(pool->num_ecdh, ==, 2);
+  g_assert_cmpuint(pool->num_dh, ==, 2);
+
+  otrng_keypair_pool_free(pool);
+}
+
+static void test_keypair_pool_take_batch() {
+  keypair_pool_s *pool = otrng_keypair_pool_new(2);
+  ecdh_keypair_s ecdh[5];
+  dh_keypair_s dh[5];
+  ec_point expected_ecdh;
+  dh_public_key expected_dh;
+  int i, j;
+
+  otrng_assert_is_success(otrng_keypair_pool_refill(pool));
+  otrng_ec_point_copy(expected_ecdh, pool->ecdh[1].pub);
+  expected_dh = pool->dh[1].pub;
+
+  otrng_keypair_pool_set_threads(pool, 3);
+  otrng_assert_is_success(otrng_keypair_pool_take_batch(ecdh, dh, 5, pool));
+  g_assert_cmpuint(pool->num_ecdh, ==, 0);
+  g_assert_cmpuint(pool->num_dh, ==, 0);
+
+  otrng_assert(otrng_ec_point_eq(ecdh[0].pub, expected_ecdh));
+  otrng_assert(dh[0].pub == expected_dh);
+
+  for (i = 0; i < 5; i++) {
+    otrng_assert(dh[i].priv);
+    for (j = 0; j < i; j++) {
+      otrng_assert(!otrng_ec_point_eq(ecdh[i].pub, ecdh[j].pub));
+      otrng_assert(gcry_mpi_cmp(dh[i].pub, dh[j].pub) != 0);
+    }
+  }
+
+  for (i = 0; i < 5; i++) {
+    otrng_ecdh_keypair_destroy(&ecdh[i]);
+    otrng_dh_keypair_destroy(&dh[i]);
+  }
+  otrng_keypair_pool_free(pool);
+}
+
+static void test_key_manager_takes_from_keypair_pool() {
+  keypair_pool_s *pool = otrng_keypair_pool_new(1);
+  key_manager_s *manager = otrng_key_manager_new();
+  ec_point expected_ecdh;
+  dh_public_key expected_dh;
+
+  otrng_assert_is_success(otrng_keypair_pool_refill(pool));
+  otrng_ec_point_copy(expected_ecdh, pool->ecdh[0].pub);
+  expected_dh = pool->dh[0].pub;
+
+  manager->keypair_pool = pool;
+  otrng_assert_is_success(otrng_key_manager_generate_ephemeral_keys(manager));
+
+  otrng_assert(otrng_ec_point_eq(manager->our_ecdh->pub, expected_ecdh));
+  otrng_assert(manager->our_dh->pub == expected_dh);
+  g_assert_cmpuint(pool->num_ecdh, ==, 0);
+  g_assert_cmpuint(pool->num_dh, ==, 0);
+
+  otrng_key_manager_free(manager);
+  otrng_keypair_pool_free(pool);
+}
+
+void units_keypair_pool_add_tests(void) {
+  g_test_add_func("/keypair_pool/refill", test_keypair_pool_refill);
+  g_test_add_func("/keypair_pool/take", test_keypair_pool_take);
+  g_test_add_func("/keypair_pool/take_when_empty",
+                  test_keypair_pool_take_when_empty);
+  g_test_add_func("/keypair_pool/set_depth", test_keypair_pool_set_depth);
+  g_test_add_func("/keypair_pool/take_batch", test_keypair_pool_take_batch);
+  g_test_add_func("/keypair_pool/key_manager_takes_from_pool",
+                  test_key_manager_takes_from_keypair_pool);
+}
@@ -0,0 +1,265 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_helpers.h"
+
+#include "deserialize.h"
+#include "fingerprint.h"
+#include "keystore.h"
+#include "messaging.h"
+#include "serialize.h"
+#include "test_fixtures.h"
+
+typedef otrng_result (*text_write_to)(const otrng_global_state_s *gs,
+                                      FILE *fp);
+
+static const text_write_to text_files[] = {
+    otrng_global_state_private_key_v4_write_to,
+    otrng_global_state_forging_key_write_to,
+    otrng_global_state_client_profile_write_to,
+    otrng_global_state_expired_client_profile_write_to,
+    otrng_global_state_prekey_profile_write_to,
+    otrng_global_state_expired_prekey_profile_write_to,
+    otrng_global_state_prekey_messages_write_to,
+    otrng_global_state_fingerprints_v4_write_to,
+};
+
+static char *text_file(text_write_to write_to, const otrng_global_state_s *gs) {
+  FILE *fp = tmpfile();
+  long len;
+  char *content;
+
+  write_to(gs, fp);
+  len = ftell(fp);
+  g_assert_cmpint(len, >=, 0);
+
+  content = otrng_xmalloc_z(len + 1);
+  rewind(fp);
+  g_assert_cmpint(fread(content, 1, len, fp), ==, len);
+  fclose(fp);
+
+  return content;
+}
+
+static otrng_keystore_s *keystore_of(const otrng_global_state_s *gs) {
+  FILE *fp = tmpfile();
+  otrng_keystore_s *ks;
+
+  otrng_assert_is_success(otrng_global_state_keystore_write_to(gs, fp));
+  ks = otrng_keystore_open(fp);
+  fclose(fp);
+  otrng_assert(ks);
+
+  return ks;
+}
+
+/* Alice has everything stored for an account, and Bob only fingerprints */
+static otrng_global_state_s *global_state_with_accounts(void) {
+  otrng_client_s *alice = otrng_client_new(ALICE_IDENTITY);
+  otrng_client_s *bob = otrng_client_new(BOB_IDENTITY);
+  otrng_fingerprint fp1 = {0x01}, fp2 = {0x02};
+  otrng_client_profile_s *exp_client_profile;
+  otrng_prekey_profile_s *exp_prekey_profile;
+
+  set_up_client(alice, 1);
+  otrng_assert(otrng_client_get_prekey_profile(alice));
+
+  /* They are stored as they are, so they do not need to have expired */
+  exp_client_profile = otrng_client_build_default_client_profile(alice);
+  otrng_assert_is_success(
+      otrng_client_add_exp_client_profile(alice, exp_client_profile));
+  otrng_client_profile_free(exp_client_profile);
+  exp_prekey_profile = otrng_client_build_default_prekey_profile(alice);
+  otrng_assert_is_success(
+      otrng_client_add_exp_prekey_profile(alice, exp_prekey_profile));
+  otrng_prekey_profile_free(exp_prekey_profile);
+
+  otrng_free(otrng_client_build_prekey_messages(3, alice));
+  otrng_fingerprint_add(alice, fp1, "bob@otr.example", otrng_true);
+  otrng_fingerprint_add(alice, fp2, "eve@otr.example", otrng_false);
+
+  otrng_global_state_add_client(alice->global_state, bob);
+  otrng_fingerprint_add(bob, fp1, "alice@otr.example", otrng_false);
+
+  return alice->global_state;
+}
+
+static void test_keystore_converts_the_text_files() {
+  otrng_global_state_s *gs = global_state_with_accounts();
+  otrng_global_state_s *loaded =
+      otrng_global_state_new(test_callbacks, otrng_false);
+  otrng_keystore_s *ks = keystore_of(gs);
+  size_t i;
+
+  g_assert_cmpuint(ks->num_accounts, ==, 2);
+  otrng_assert_is_success(otrng_global_state_keystore_read_from(loaded, ks));
+  g_assert_cmpint(otrng_list_len(loaded->clients), ==, 2);
+
+  /* The accounts are sorted, which is the order they were added in */
+  for (i = 0; i < sizeof(text_files) / sizeof(text_write_to); i++) {
+    char *expected = text_file(text_files[i], gs);
+    char *got = text_file(text_files[i], loaded);
+
+    g_assert_cmpuint(strlen(expected), >, 0);
+    g_assert_cmpstr(got, ==, expected);
+    otrng_free(expected);
+    otrng_free(got);
+  }
+
+  otrng_keystore_close(ks);
+  otrng_global_state_free(loaded);
+  otrng_global_state_free(gs);
+}
+
+static void test_keystore_reads_one_client() {
+  otrng_global_state_s *gs = global_state_with_accounts();
+  otrng_keystore_s *ks = keystore_of(gs);
+  otrng_client_s *bob = otrng_client_new(BOB_IDENTITY);
+  otrng_client_s *charlie = otrng_client_new(CHARLIE_IDENTITY);
+  otrng_fingerprint fp1 = {0x01};
+  otrng_known_fingerprint_s *kf;
+
+  otrng_assert_is_success(otrng_keystore_read_client(ks, bob));
+  otrng_assert(!bob->keypair);
+  g_assert_cmpint(otrng_list_len(bob->fingerprints->fps), ==, 1);
+  kf = otrng_fingerprint_get_by_fp(bob, fp1);
+  otrng_assert(kf);
+  g_assert_cmpstr(kf->username, ==, "alice@otr.example");
+  otrng_assert(kf->trusted == otrng_false);
+
+  /* Reading it again replaces what it has */
+  otrng_assert_is_success(otrng_keystore_read_client(ks, bob));
+  g_assert_cmpint(otrng_list_len(bob->fingerprints->fps), ==, 1);
+
+  otrng_assert_is_error(otrng_keystore_read_client(ks, charlie));
+
+  otrng_client_free(charlie);
+  otrng_client_free(bob);
+  otrng_keystore_close(ks);
+  otrng_global_state_free(gs);
+}
+
+static void test_keystore_rejects_invalid_files() {
+  otrng_global_state_s *gs = global_state_with_accounts();
+  FILE *fp = tmpfile();
+  FILE *truncated = tmpfile();
+  long len;
+  char *content;
+
+  otrng_assert(!otrng_keystore_open(fp));
+
+  fputs("alice@otr.example\tbob@otr.example\totr\t0102\n", fp);
+  fflush(fp);
+  otrng_assert(!otrng_keystore_open(fp));
+  fclose(fp);
+
+  fp = tmpfile();
+  otrng_assert_is_success(otrng_global_state_keystore_write_to(gs, fp));
+  len = ftell(fp);
+  content = otrng_xmalloc(len);
+  rewind(fp);
+  g_assert_cmpint(fread(content, 1, len, fp), ==, len);
+  fclose(fp);
+
+  /* The records of the last account do not fit */
+  fwrite(content, 1, len - 1, truncated);
+  fflush(truncated);
+  otrng_assert(!otrng_keystore_open(truncated));
+  fclose(truncated);
+
+  /* A later version */
+  content[11] = 2;
+  fp = tmpfile();
+  fwrite(content, 1, len, fp);
+  fflush(fp);
+  otrng_assert(!otrng_keystore_open(fp));
+  fclose(fp);
+
+  otrng_free(content);
+  otrng_global_state_free(gs);
+}
+
+/* Bob's only record is a fingerprint. Its length is made too short for one,
+   which the index does not tell. */
+static void test_keystore_reads_nothing_from_an_invalid_record() {
+  otrng_global_state_s *gs = global_state_with_accounts();
+  otrng_global_state_s *loaded =
+      otrng_global_state_new(test_callbacks, otrng_false);
+  otrng_client_s *bob = otrng_client_new(BOB_IDENTITY);
+  otrng_fingerprint fp2 = {0x02};
+  otrng_keystore_s *ks;
+  uint64_t index_offset, records_offset;
+  FILE *fp = tmpfile();
+  long len;
+  uint8_t *content;
+
+  otrng_assert_is_success(otrng_global_state_keystore_write_to(gs, fp));
+  len = ftell(fp);
+  content = otrng_xmalloc(len);
+  rewind(fp);
+  g_assert_cmpint(fread(content, 1, len, fp), ==, len);
+  fclose(fp);
+
+  /* The second index entry is Bob's */
+  otrng_assert_is_success(
+      otrng_deserialize_uint64(&index_offset, content + 16, len - 16, NULL));
+  otrng_assert_is_success(otrng_deserialize_uint64(
+      &records_offset, content + index_offset + 32 + 16, 8, NULL));
+  g_assert_cmpint(content[records_offset], ==, OTRNG_KEYSTORE_FINGERPRINT);
+  otrng_serialize_uint32(content + records_offset + 1, FPRINT_LEN_BYTES);
+
+  fp = tmpfile();
+  fwrite(content, 1, len, fp);
+  fflush(fp);
+  ks = otrng_keystore_open(fp);
+  fclose(fp);
+  otrng_assert(ks);
+
+  /* Bob keeps what he had */
+  otrng_fingerprint_add(bob, fp2, "eve@otr.example", otrng_true);
+  otrng_assert_is_error(otrng_keystore_read_client(ks, bob));
+  g_assert_cmpint(otrng_list_len(bob->fingerprints->fps), ==, 1);
+  otrng_assert(otrng_fingerprint_get_by_fp(bob, fp2));
+
+  /* Alice's account is valid, but is not read either */
+  otrng_assert_is_error(otrng_global_state_keystore_read_from(loaded, ks));
+  g_assert_cmpint(otrng_list_len(loaded->clients), ==, 0);
+
+  otrng_free(content);
+  otrng_client_free(bob);
+  otrng_keystore_close(ks);
+  otrng_global_state_free(loaded);
+  otrng_global_state_free(gs);
+}
+
+void units_keystore_add_tests(void) {
+  g_test_add_func("/keystore/converts_the_text_files",
+                  test_keystore_converts_the_text_files);
+  g_test_add_func("/keystore/reads_one_client",
+                  test_keystore_reads_one_client);
+  g_test_add_func("/keystore/rejects_invalid_files",
+                  test_keystore_rejects_invalid_files);
+  g_test_add_func("/keystore/reads_nothing_from_an_invalid_record",
+                  test_keystore_reads_nothing_from_an_invalid_record);
+}
@@ -318,7 +318,7 @@ static void test_global_state_prekey_message_management(void) {
   otrng_client_s *client =
       get_client(state, create_client_id("otr", charlie_account));
 
-  otrng_assert(client->our_prekeys);
+  otrng_assert(otrng_prekey_store_len(&client->our_prekeys) > 0);
 
   uint32_t message_id = 831563016;
   const prekey_message_s *stored_prekey = NULL;
@@ -503,6 +503,95 @@ static char *read_full_file(FILE *fp) {
   return buffer;
 }
 
+typedef struct bad_lines_s {
+  size_t numbers[8];
+  size_t len;
+} bad_lines_s;
+
+static void collect_bad_line(size_t line_number, void *context) {
+  bad_lines_s *bad_lines = context;
+  if (bad_lines->len < 8) {
+    bad_lines->numbers[bad_lines->len] = line_number;
+  }
+  bad_lines->len++;
+}
+
+static void test_global_state_fingerprint_reading_all(void) {
+  FILE *fp = tmpfile();
+  otrng_global_state_s *state =
+      otrng_global_state_new(empty_callbacks, otrng_false);
+  bad_lines_s bad_lines = {.len = 0};
+
+  fputs("foo@example.org\talice@otr.im\tprpl-"
+        "jabber\tc188f4a241b21fa0d5a0a15ed63bcaaaf062f47fc188f4a241b21fa0d5a0a1"
+        "5ed63bcaaaf062f47fc188f4a241b21fa0d5a0a15ed63bcAAA\r\n"
+        "\n"
+        "foo2@example.org\talice@otr.im\tMALFORMED\n"
+        "foo3@example.org\talice@otr.im\tprpl-jabber\tc188f4a241b21fa0\n"
+        "foo4@example.org\talice@otr.im\tprpl-"
+        "jabber\tc188f4a241b21fa0d5a0a15ed63bcaaaf062f47fc188f4a241b21fa0d5a0a1"
+        "5ed63bcaaaf062f47fc188f4a241b21fa0d5a0a15ed63bcXYZ\n"
+        "foo5@example.org\talice@otr.im\tprpl-"
+        "jabber\td388f4a241b21fa0d5a0a15ed63bcaaaf062f47fc188f4a241b21fa0d5a0a1"
+        "5ed63bcaaaf062f47fc188f4a241b21fa0d5a0a15ed63bcEEF\tfingerprint",
+        fp);
+  rewind(fp);
+
+  otrng_assert_is_success(otrng_global_state_fingerprints_v4_read_all_from(
+      state, fp, collect_bad_line, &bad_lines));
+  fclose(fp);
+
+  /* The short fingerprint and the one that is not hex are skipped, and the
+     last line needs no end of line */
+  g_assert_cmpuint(bad_lines.len, ==, 3);
+  g_assert_cmpuint(bad_lines.numbers[0], ==, 3);
+  g_assert_cmpuint(bad_lines.numbers[1], ==, 4);
+  g_assert_cmpuint(bad_lines.numbers[2], ==, 5);
+
+  g_assert_cmpint(otrng_list_len(state->clients), ==, 1);
+  otrng_client_s *client = state->clients->data;
+  g_assert_cmpint(otrng_list_len(client->fingerprints->fps), ==, 2);
+  otrng_assert(otrng_fingerprint_get_by_username(client, "foo@example.org"));
+  otrng_known_fingerprint_s *fp5 =
+      otrng_fingerprint_get_by_username(client, "foo5@example.org");
+  otrng_assert(fp5);
+  g_assert(fp5->trusted == otrng_true);
+
+  otrng_global_state_free(state);
+}
+
+static void test_global_state_fingerprint_reading_long_lines(void) {
+  FILE *fp = tmpfile();
+  otrng_global_state_s *state =
+      otrng_global_state_new(empty_callbacks, otrng_false);
+  /* Longer than what is read at a time */
+  size_t username_len = 100000;
+  char *username = otrng_xmalloc(username_len + 1);
+  const char *fingerprint =
+      "c188f4a241b21fa0d5a0a15ed63bcaaaf062f47fc188f4a241b21fa0d5a0a1"
+      "5ed63bcaaaf062f47fc188f4a241b21fa0d5a0a15ed63bcAAA";
+
+  memset(username, 'a', username_len);
+  username[username_len] = '\0';
+
+  fprintf(fp, "%s\talice@otr.im\tprpl-jabber\t%s\n", username, fingerprint);
+  fprintf(fp, "foo@example.org\talice@otr.im\tprpl-jabber\t%s\n",
+          fingerprint);
+  rewind(fp);
+
+  otrng_assert_is_success(
+      otrng_global_state_fingerprints_v4_read_all_from(state, fp, NULL, NULL));
+  fclose(fp);
+
+  otrng_client_s *client = state->clients->data;
+  g_assert_cmpint(otrng_list_len(client->fingerprints->fps), ==, 2);
+  otrng_assert(otrng_fingerprint_get_by_username(client, username));
+  otrng_assert(otrng_fingerprint_get_by_username(client, "foo@example.org"));
+
+  otrng_free(username);
+  otrng_global_state_free(state);
+}
+
 static void test_global_state_fingerprint_writing(void) {
   FILE *fp = tmpfile();
   otrng_global_state_s *state =
@@ -553,6 +642,102 @@ static void test_global_state_fingerprint_writing(void) {
   otrng_global_state_free(state);
 }
 
+static void test_global_state_client_lookup(void) {
+  otrng_global_state_s *state =
+      otrng_global_state_new(empty_callbacks, otrng_false);
+  char long_account[1024];
+  const otrng_client_id_s alice = {.protocol = "otr", .account = "alice"};
+  const otrng_client_id_s split_1 = {.protocol = "ot", .account = "ralice"};
+  const otrng_client_id_s split_2 = {.protocol = "otra", .account = "lice"};
+  otrng_client_id_s long_id = {.protocol = "otr", .account = long_account};
+  otrng_client_s *client;
+
+  memset(long_account, 'a', sizeof(long_account) - 1);
+  long_account[sizeof(long_account) - 1] = 0;
+
+  client = otrng_client_get(state, alice);
+  otrng_assert(client);
+  otrng_assert(client->global_state == state);
+  otrng_assert(otrng_client_get(state, alice) == client);
+
+  otrng_assert(otrng_client_get(state, split_1) != client);
+  otrng_assert(otrng_client_get(state, split_2) != client);
+  otrng_assert(otrng_client_get(state, split_1) !=
+               otrng_client_get(state, split_2));
+
+  client = otrng_client_get(state, long_id);
+  otrng_assert(otrng_client_get(state, long_id) == client);
+
+  g_assert_cmpuint(otrng_list_len(state->clients), ==, 4);
+  g_assert_cmpuint(otrng_hash_table_len(state->client_index), ==, 4);
+
+  /* In the order they were added */
+  otrng_assert(state->clients->data == otrng_client_get(state, alice));
+  otrng_assert(state->last_client->data == client);
+
+  otrng_global_state_free(state);
+}
+
+#define LOCK_THREADS 4
+#define LOCK_INCREMENTS 10000
+
+typedef struct locked_counter_s {
+  otrng_global_state_s gs;
+  int value;
+} locked_counter_s;
+
+static void *increment_under_v3_lock(void *data) {
+  locked_counter_s *counter = data;
+  int i, value;
+
+  for (i = 0; i < LOCK_INCREMENTS; i++) {
+    otrng_global_state_lock_v3(&counter->gs);
+    value = counter->value;
+    /* As when libotr calls back into the library */
+    otrng_global_state_lock_v3(&counter->gs);
+    counter->value = value + 1;
+    otrng_global_state_unlock_v3(&counter->gs);
+    otrng_global_state_unlock_v3(&counter->gs);
+  }
+
+  return NULL;
+}
+
+static void test_global_state_v3_lock_taken_again_by_holder() {
+  locked_counter_s counter;
+
+  memset(&counter, 0, sizeof(counter));
+  otrng_global_state_init_lock_v3(&counter.gs);
+
+  increment_under_v3_lock(&counter);
+  g_assert_cmpint(counter.value, ==, LOCK_INCREMENTS);
+
+  pthread_mutex_destroy(&counter.gs.user_state_v3_lock);
+}
+
+static void test_global_state_v3_lock_excludes_other_threads() {
+  locked_counter_s counter;
+  pthread_t threads[LOCK_THREADS];
+  int i;
+
+  memset(&counter, 0, sizeof(counter));
+  otrng_global_state_init_lock_v3(&counter.gs);
+
+  for (i = 0; i < LOCK_THREADS; i++) {
+    g_assert_cmpint(pthread_create(&threads[i], NULL, increment_under_v3_lock,
+                                   &counter),
+                    ==, 0);
+  }
+
+  for (i = 0; i < LOCK_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  g_assert_cmpint(counter.value, ==, LOCK_THREADS * LOCK_INCREMENTS);
+
+  pthread_mutex_destroy(&counter.gs.user_state_v3_lock);
+}
+
 void units_messaging_add_tests() {
   g_test_add_func("/global_state/key_management",
                   test_global_state_key_management);
@@ -564,8 +749,18 @@ void units_messaging_add_tests() {
                   test_global_state_prekey_message_management);
   g_test_add_func("/global_state/fingerprints/reading",
                   test_global_state_fingerprint_reading);
+  g_test_add_func("/global_state/fingerprints/reading_all",
+                  test_global_state_fingerprint_reading_all);
+  g_test_add_func("/global_state/fingerprints/reading_long_lines",
+                  test_global_state_fingerprint_reading_long_lines);
   g_test_add_func("/global_state/fingerprints/writing",
                   test_global_state_fingerprint_writing);
+  g_test_add_func("/global_state/client_lookup",
+                  test_global_state_client_lookup);
+  g_test_add_func("/global_state/v3_lock/taken_again_by_holder",
+                  test_global_state_v3_lock_taken_again_by_holder);
+  g_test_add_func("/global_state/v3_lock/excludes_other_threads",
+                  test_global_state_v3_lock_excludes_other_threads);
 
   g_test_add_func("/api/instance_tag", test_instance_tag_api);
 }
@@ -108,10 +108,6 @@ static void create_prekey_profile(otrng_client_s *client) {
   client->prekey_profile = create_prekey_profile__assign;
 }
 
-static void prekey_free_from_list(void *prekey) {
-  otrng_prekey_message_free(prekey);
-}
-
 static int load_prekey_messages__called = 0;
 static otrng_client_s *load_prekey_messages__called_with;
 static otrng_bool load_prekey_messages__should_assign;
@@ -121,11 +117,15 @@ static void load_prekey_messages(otrng_client_s *client) {
   load_prekey_messages__called_with = client;
 
   if (load_prekey_messages__should_assign) {
-    if (client->our_prekeys != NULL) {
-      otrng_list_free(client->our_prekeys, prekey_free_from_list);
-    }
+    list_element_s *current;
 
-    client->our_prekeys = load_prekey_messages__assign;
+    otrng_prekey_store_destroy(&client->our_prekeys);
+    for (current = load_prekey_messages__assign; current;
+         current = current->next) {
+      otrng_prekey_store_add(&client->our_prekeys, current->data);
+    }
+    otrng_list_free_nodes(load_prekey_messages__assign);
+    load_prekey_messages__assign = NULL;
   }
 }
 
@@ -313,7 +313,10 @@ static void orchestration_fixture_setup(orchestration_fixture_s *f,
   f->callbacks = otrng_xmalloc_z(sizeof(otrng_client_callbacks_s));
   f->gs = otrng_xmalloc_z(sizeof(otrng_global_state_s));
   f->gs->callbacks = f->callbacks;
+  f->gs->client_index = otrng_hash_table_new();
+  pthread_mutex_init(&f->gs->clients_lock, NULL);
   f->gs->user_state_v3 = otrl_userstate_create();
+  otrng_global_state_init_lock_v3(f->gs);
   f->client_id.protocol = otrng_xstrdup("test-otr");
   f->client_id.account = otrng_xstrdup("sita@otr.im");
 
@@ -321,8 +324,7 @@ static void orchestration_fixture_setup(orchestration_fixture_s *f,
   f->client->max_published_prekey_msg = 3;
   f->client->minimum_stored_prekey_msg = 2;
 
-  f->client->global_state = f->gs;
-  f->gs->clients = otrng_list_add(f->client, f->gs->clients);
+  otrng_global_state_add_client(f->gs, f->client);
 
   f->callbacks->load_privkey_v4 = load_privkey_v4;
   f->callbacks->store_privkey_v4 = store_privkey_v4;
@@ -453,7 +455,10 @@ static void orchestration_fixture_teardown(orchestration_fixture_s *f,
   otrng_free(f->callbacks);
   otrng_client_free(f->client);
   otrng_list_free_nodes(f->gs->clients);
+  otrng_hash_table_free(f->gs->client_index, NULL);
+  pthread_mutex_destroy(&f->gs->clients_lock);
   otrl_userstate_free(f->gs->user_state_v3);
+  pthread_mutex_destroy(&f->gs->user_state_v3_lock);
   otrng_free(f->gs);
   otrng_secure_free(f->long_term_key);
   otrng_secure_free(f->forging_key);
@@ -1584,17 +1589,17 @@ static void test__otrng_client_ensure_correct_state__prekey_messages__creates(
   g_assert_cmpint(load_prekey_messages__called, ==, 1);
   g_assert_cmpint(store_prekey_messages__called, ==, 1);
 
-  g_assert_cmpint(otrng_list_len(f->client->our_prekeys), ==, 3);
+  g_assert_cmpint(otrng_prekey_store_len(&f->client->our_prekeys), ==, 3);
   g_assert_cmpint(f->client->prekey_msgs_num_to_publish, ==, 0);
 
   g_assert(f->client->should_publish == otrng_true);
-  g_assert(
-      ((prekey_message_s *)(f->client->our_prekeys->data))->should_publish ==
-      otrng_false);
-  g_assert(((prekey_message_s *)(f->client->our_prekeys->next->data))
-               ->should_publish == otrng_true);
-  g_assert(((prekey_message_s *)(f->client->our_prekeys->next->next->data))
-               ->should_publish == otrng_true);
+  g_assert(f->client->our_prekeys.first->msg->should_publish == otrng_false);
+  g_assert(f->client->our_prekeys.first->next->msg->should_publish ==
+           otrng_true);
+  g_assert(f->client->our_prekeys.first->next->next->msg->should_publish ==
+           otrng_true);
+  g_assert_cmpuint(
+      otrng_prekey_store_num_unpublished(&f->client->our_prekeys), ==, 2);
 
   f->client->keypair = NULL;
   v3_remove_key(f->v3_key);
@@ -1626,7 +1631,7 @@ test__otrng_client_ensure_correct_state__prekey_messages__creates_based_on_to_pu
   g_assert_cmpint(load_prekey_messages__called, ==, 1);
   g_assert_cmpint(store_prekey_messages__called, ==, 1);
 
-  g_assert_cmpint(otrng_list_len(f->client->our_prekeys), ==, 5);
+  g_assert_cmpint(otrng_prekey_store_len(&f->client->our_prekeys), ==, 5);
   g_assert_cmpint(f->client->prekey_msgs_num_to_publish, ==, 0);
 
   f->client->keypair = NULL;
@@ -1660,7 +1665,7 @@ static void test__otrng_client_ensure_correct_state__prekey_messages__fails(
   g_assert_cmpint(load_prekey_messages__called, ==, 1);
   g_assert_cmpint(store_prekey_messages__called, ==, 0);
 
-  g_assert_cmpint(otrng_list_len(f->client->our_prekeys), ==, 3);
+  g_assert_cmpint(otrng_prekey_store_len(&f->client->our_prekeys), ==, 3);
   g_assert_cmpint(f->client->prekey_msgs_num_to_publish, ==, 0);
 
   f->client->keypair = NULL;
@@ -266,7 +266,7 @@ static void test_otrng_build_prekey_ensemble() {
   // Stores the same prekey message sent
   // TODO: Assert the instance tag
   // TODO: Assert the private part
-  prekey_message_s *stored = client->our_prekeys->data;
+  prekey_message_s *stored = client->our_prekeys.first->msg;
   otrng_assert(stored);
   otrng_assert_ec_public_key_eq(ensemble->message->Y, stored->y->pub);
   otrng_assert_dh_public_key_eq(ensemble->message->B, stored->b->pub);
@@ -475,7 +475,7 @@ void test_start_with_whitespace_tag(void) {
   otrng_assert(response_to_alice->to_send == NULL);
   otrng_assert(response_to_alice->to_display == NULL);
 
-  g_assert_cmpint(otrng_list_len(bob->keys->old_mac_keys), ==, 1);
+  g_assert_cmpint(bob->keys->num_old_mac_keys, ==, 1);
   g_assert_cmpint(bob->keys->i, ==, 1);
   g_assert_cmpint(bob->keys->j, ==, 0);
   g_assert_cmpint(bob->keys->k, ==, 1);
@@ -508,7 +508,7 @@ void test_send_with_padding(void) {
   /* Alice sends a data message */
   result = otrng_send_message(&to_send_1, "hi", NULL, 0, alice);
   assert_message_sent(result, to_send_1);
-  otrng_assert(!alice->keys->old_mac_keys);
+  otrng_assert(alice->keys->num_old_mac_keys == 0);
 
   g_assert_cmpint(alice->keys->i, ==, 1);
   g_assert_cmpint(alice->keys->j, ==, 2);
@@ -524,6 +524,62 @@ void test_send_with_padding(void) {
   otrng_conn_free_all(alice, bob);
 }
 
+/* The buffer the message is encoded in, and the copy of our DH public key
+   made while serializing it */
+#define MAX_SEND_ALLOCATIONS 2
+
+static size_t allocations_to_send(otrng_s *otr, const char *msg,
+                                  tlv_list_s *tlvs) {
+  string_p to_send = NULL;
+  size_t before = otrng_alloc_count();
+  otrng_result result = otrng_send_message(&to_send, msg, tlvs, 0, otr);
+  size_t allocations = otrng_alloc_count() - before;
+
+  assert_message_sent(result, to_send);
+  free(to_send);
+
+  return allocations;
+}
+
+void test_send_allocations_are_constant(void) {
+  otrng_client_s *alice_client = otrng_client_new(ALICE_IDENTITY);
+  otrng_client_s *bob_client = otrng_client_new(BOB_IDENTITY);
+  otrng_s *alice, *bob;
+  tlv_list_s *tlvs;
+  char *long_msg;
+  size_t short_allocations;
+
+  otrng_client_set_padding(256, alice_client);
+
+  alice = set_up(alice_client, 1);
+  bob = set_up(bob_client, 2);
+
+  /* DAKE has finished */
+  do_dake_fixture(alice, bob);
+
+  long_msg = otrng_xmalloc(10000);
+  memset(long_msg, 'a', 9999);
+  long_msg[9999] = 0;
+
+  /* The size of the message or its TLVs does not change how much we allocate
+     to send it */
+  short_allocations = allocations_to_send(alice, "hi", NULL);
+  g_assert_cmpuint(short_allocations, <=, MAX_SEND_ALLOCATIONS);
+  g_assert_cmpuint(allocations_to_send(alice, long_msg, NULL), ==,
+                   short_allocations);
+
+  tlvs = otrng_tlv_list_one(otrng_tlv_new(OTRNG_TLV_SMP_MSG_1, 9999,
+                                          (uint8_t *)long_msg));
+  g_assert_cmpuint(allocations_to_send(alice, "hi", tlvs), ==,
+                   short_allocations);
+
+  otrng_tlv_list_free(tlvs);
+  otrng_free(long_msg);
+  otrng_global_state_free(alice_client->global_state);
+  otrng_global_state_free(bob_client->global_state);
+  otrng_conn_free_all(alice, bob);
+}
+
 void units_otrng_add_tests(void) {
   (void)test_otrng_receives_identity_message_invalid_on_start; // this function
                                                                // is unused
@@ -575,4 +631,6 @@ void units_otrng_add_tests(void) {
   g_test_add_func("/otrng/start_with_whitespace_tag",
                   test_start_with_whitespace_tag);
   g_test_add_func("/otrng/send_with_padding", test_send_with_padding);
+  g_test_add_func("/otrng/send_allocations_are_constant",
+                  test_send_allocations_are_constant);
 }
@@ -47,13 +47,14 @@ test_prekey_manager__otrng_prekey_request_storage_information(void) {
   otrng_result ret;
 
   otrng_global_state_s *gs = otrng_xmalloc_z(sizeof(otrng_global_state_s));
+  gs->client_index = otrng_hash_table_new();
+  pthread_mutex_init(&gs->clients_lock, NULL);
 
   client_id.protocol = otrng_xstrdup("test-otr");
   client_id.account = otrng_xstrdup("sita@otr.im");
 
   client = otrng_client_new(client_id);
-  client->global_state = gs;
-  gs->clients = otrng_list_add(client, gs->clients);
+  otrng_global_state_add_client(gs, client);
 
   set_up_fixed_randomness();
 
@@ -98,6 +99,8 @@ test_prekey_manager__otrng_prekey_request_storage_information(void) {
   otrng_free(output);
   otrng_client_free(client);
   otrng_list_free_nodes(gs->clients);
+  otrng_hash_table_free(gs->client_index, NULL);
+  pthread_mutex_destroy(&gs->clients_lock);
   otrng_free(gs);
   otrng_free((char *)client_id.protocol);
   otrng_free((char *)client_id.account);
@@ -0,0 +1,146 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "test_helpers.h"
+
+#include "alloc.h"
+#include "prekey_store.h"
+
+static prekey_message_s *prekey_message_with_id(uint32_t id) {
+  prekey_message_s *msg = otrng_xmalloc_z(sizeof(prekey_message_s));
+  msg->id = id;
+  return msg;
+}
+
+static void test_prekey_store_add_get_and_delete() {
+  prekey_store_s store;
+  prekey_message_s *first = prekey_message_with_id(1);
+  prekey_message_s *second = prekey_message_with_id(0x2000);
+  prekey_message_s *third = prekey_message_with_id(3);
+
+  memset(&store, 0, sizeof(store));
+  otrng_assert(otrng_prekey_store_get(&store, 1) == NULL);
+  otrng_assert(!otrng_prekey_store_delete(&store, 1));
+
+  otrng_prekey_store_add(&store, first);
+  otrng_prekey_store_add(&store, second);
+  otrng_prekey_store_add(&store, third);
+  g_assert_cmpuint(otrng_prekey_store_len(&store), ==, 3);
+
+  otrng_assert(otrng_prekey_store_get(&store, 1) == first);
+  otrng_assert(otrng_prekey_store_get(&store, 0x2000) == second);
+  otrng_assert(otrng_prekey_store_get(&store, 3) == third);
+  otrng_assert(otrng_prekey_store_get(&store, 4) == NULL);
+
+  otrng_assert(otrng_prekey_store_delete(&store, 0x2000));
+  otrng_assert(!otrng_prekey_store_delete(&store, 0x2000));
+  g_assert_cmpuint(otrng_prekey_store_len(&store), ==, 2);
+  otrng_assert(otrng_prekey_store_get(&store, 0x2000) == NULL);
+
+  /* The order they were stored in is kept */
+  otrng_assert(store.first->msg == first);
+  otrng_assert(store.first->next->msg == third);
+  otrng_assert(store.last->msg == third);
+  otrng_assert(store.last->prev->msg == first);
+
+  otrng_assert(otrng_prekey_store_delete(&store, 1));
+  otrng_assert(otrng_prekey_store_delete(&store, 3));
+  g_assert_cmpuint(otrng_prekey_store_len(&store), ==, 0);
+  otrng_assert(store.first == NULL);
+  otrng_assert(store.last == NULL);
+
+  otrng_prekey_store_destroy(&store);
+}
+
+static void test_prekey_store_replaces_same_id() {
+  prekey_store_s store;
+  prekey_message_s *replacement = prekey_message_with_id(7);
+
+  memset(&store, 0, sizeof(store));
+  otrng_prekey_store_add(&store, prekey_message_with_id(7));
+  otrng_prekey_store_add(&store, prekey_message_with_id(8));
+  otrng_prekey_store_add(&store, replacement);
+
+  g_assert_cmpuint(otrng_prekey_store_len(&store), ==, 2);
+  otrng_assert(otrng_prekey_store_get(&store, 7) == replacement);
+  otrng_assert(store.last->msg == replacement);
+
+  otrng_prekey_store_destroy(&store);
+  g_assert_cmpuint(otrng_prekey_store_len(&store), ==, 0);
+  otrng_assert(store.index == NULL);
+}
+
+static void test_prekey_store_counts_publication() {
+  prekey_store_s store;
+  prekey_message_s *msgs[4];
+  prekey_message_s *publishing[4];
+  uint32_t i;
+
+  memset(&store, 0, sizeof(store));
+  for (i = 0; i < 4; i++) {
+    msgs[i] = prekey_message_with_id(i + 1);
+    otrng_prekey_store_add(&store, msgs[i]);
+  }
+
+  g_assert_cmpuint(otrng_prekey_store_num_published(&store), ==, 4);
+  g_assert_cmpuint(otrng_prekey_store_num_unpublished(&store), ==, 0);
+
+  otrng_prekey_store_set_should_publish(&store, msgs[1], otrng_true);
+  otrng_prekey_store_set_should_publish(&store, msgs[3], otrng_true);
+  g_assert_cmpuint(otrng_prekey_store_num_published(&store), ==, 2);
+  g_assert_cmpuint(otrng_prekey_store_num_unpublished(&store), ==, 2);
+
+  g_assert_cmpuint(otrng_prekey_store_start_publishing(publishing, &store), ==,
+                   2);
+  otrng_assert(publishing[0] == msgs[1]);
+  otrng_assert(publishing[1] == msgs[3]);
+  otrng_assert(msgs[1]->is_publishing);
+  g_assert_cmpuint(otrng_prekey_store_num_unpublished(&store), ==, 0);
+
+  otrng_prekey_store_failed_published(&store);
+  otrng_assert(!msgs[1]->is_publishing);
+  g_assert_cmpuint(otrng_prekey_store_num_unpublished(&store), ==, 2);
+
+  /* A message being published that is used goes out of the counts */
+  g_assert_cmpuint(otrng_prekey_store_start_publishing(publishing, &store), ==,
+                   2);
+  otrng_assert(otrng_prekey_store_delete(&store, 4));
+
+  otrng_assert(otrng_prekey_store_published(&store));
+  otrng_assert(!otrng_prekey_store_published(&store));
+  otrng_assert(!msgs[1]->should_publish);
+  otrng_assert(!msgs[1]->is_publishing);
+  g_assert_cmpuint(otrng_prekey_store_num_published(&store), ==, 3);
+  g_assert_cmpuint(otrng_prekey_store_num_unpublished(&store), ==, 0);
+
+  otrng_prekey_store_destroy(&store);
+}
+
+void units_prekey_store_add_tests(void) {
+  g_test_add_func("/prekey_store/add_get_and_delete",
+                  test_prekey_store_add_get_and_delete);
+  g_test_add_func("/prekey_store/replaces_same_id",
+                  test_prekey_store_replaces_same_id);
+  g_test_add_func("/prekey_store/counts_publication",
+                  test_prekey_store_counts_publication);
+}
@@ -22,6 +22,7 @@
 
 #include "test_helpers.h"
 
+#include "base64.h"
 #include "deserialize.h"
 #include "serialize.h"
 
@@ -79,6 +80,28 @@ static void test_serialize_otrng_deserialize_data() {
   otrng_free(dst);
 }
 
+static void test_deserialize_data_view() {
+  uint8_t ser[9] = {0, 0, 0, 5, 1, 2, 3, 4, 5};
+  const uint8_t *view = NULL;
+  size_t view_len = 0, read = 0;
+
+  otrng_assert_is_success(
+      otrng_deserialize_data_view(&view, &view_len, ser, sizeof(ser), &read));
+  otrng_assert(view == ser + 4);
+  g_assert_cmpuint(view_len, ==, 5);
+  g_assert_cmpuint(read, ==, 9);
+
+  otrng_assert_is_error(
+      otrng_deserialize_data_view(&view, &view_len, ser, 8, &read));
+
+  ser[3] = 0;
+  otrng_assert_is_success(
+      otrng_deserialize_data_view(&view, &view_len, ser, sizeof(ser), &read));
+  otrng_assert(!view);
+  g_assert_cmpuint(view_len, ==, 0);
+  g_assert_cmpuint(read, ==, 4);
+}
+
 static void test_ser_des_otrng_public_key() {
   otrng_keypair_s keypair;
   otrng_public_key deser;
@@ -220,17 +243,82 @@ static void test_serializes_fingerprint() {
   otrng_assert_cmpmem(expected_fp, dst, sizeof(otrng_fingerprint));
 }
 
+static void test_serialize_old_mac_keys() {
+  uint8_t old_mac_keys[3 * MAC_KEY_BYTES];
+  uint8_t dst[3 * MAC_KEY_BYTES];
+  uint8_t expected[3 * MAC_KEY_BYTES];
+
+  memset(old_mac_keys, 0x01, MAC_KEY_BYTES);
+  memset(old_mac_keys + MAC_KEY_BYTES, 0x02, MAC_KEY_BYTES);
+  memset(old_mac_keys + 2 * MAC_KEY_BYTES, 0x03, MAC_KEY_BYTES);
+
+  memset(expected, 0x03, MAC_KEY_BYTES);
+  memset(expected + MAC_KEY_BYTES, 0x02, MAC_KEY_BYTES);
+  memset(expected + 2 * MAC_KEY_BYTES, 0x01, MAC_KEY_BYTES);
+
+  g_assert_cmpuint(otrng_serialize_old_mac_keys(dst, old_mac_keys, 3), ==,
+                   sizeof(dst));
+  otrng_assert_cmpmem(expected, dst, sizeof(dst));
+
+  g_assert_cmpuint(otrng_serialize_old_mac_keys(dst, old_mac_keys, 0), ==, 0);
+}
+
+static char *otr_encode_in_place(const uint8_t *data, size_t data_len) {
+  uint8_t *buffer = otrng_xmalloc(OTRNG_BASE64_OTR_ENCODE_LEN(data_len));
+
+  memcpy(buffer + OTRNG_BASE64_OTR_IN_PLACE_OFFSET(data_len), data, data_len);
+
+  return otrng_base64_otr_encode_in_place(
+      buffer, OTRNG_BASE64_OTR_IN_PLACE_OFFSET(data_len), data_len);
+}
+
+static void test_base64_otr_encode_in_place() {
+  const char *vectors[7][2] = {{"", "?OTR:."},
+                                {"f", "?OTR:Zg==."},
+                                {"fo", "?OTR:Zm8=."},
+                                {"foo", "?OTR:Zm9v."},
+                                {"foob", "?OTR:Zm9vYg==."},
+                                {"fooba", "?OTR:Zm9vYmE=."},
+                                {"foobar", "?OTR:Zm9vYmFy."}};
+  uint8_t data[200];
+  char *encoded, *expected;
+  size_t i;
+
+  for (i = 0; i < 7; i++) {
+    encoded = otr_encode_in_place((const uint8_t *)vectors[i][0],
+                                  strlen(vectors[i][0]));
+    g_assert_cmpstr(encoded, ==, vectors[i][1]);
+    otrng_free(encoded);
+  }
+
+  for (i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)(i * 37 + 11);
+  }
+
+  for (i = 0; i <= sizeof(data); i++) {
+    encoded = otr_encode_in_place(data, i);
+    expected = otrl_base64_otr_encode(data, i);
+    g_assert_cmpstr(encoded, ==, expected);
+    otrng_free(encoded);
+    free(expected);
+  }
+}
+
 // TODO: ADD test for otrng_serialize_ring_sig
 
 void units_serialize_add_tests(void) {
   g_test_add_func("/serialize_and_deserialize/uint", test_ser_deser_uint);
   g_test_add_func("/serialize_and_deserialize/data",
                   test_serialize_otrng_deserialize_data);
+  g_test_add_func("/deserialize/data_view", test_deserialize_data_view);
   g_test_add_func("/serialize/fingerprint", test_serializes_fingerprint);
   g_test_add_func("/serialize/dh-public-key",
                   test_otrng_serialize_dh_public_key);
   g_test_add_func("/serialize/otrng-symmetric-key",
                   test_serialize_otrng_symmetric_key);
+  g_test_add_func("/serialize/old-mac-keys", test_serialize_old_mac_keys);
+  g_test_add_func("/serialize/base64-otr-encode-in-place",
+                  test_base64_otr_encode_in_place);
   g_test_add_func("/serialize_and_deserialize/ed448-public-key",
                   test_ser_des_otrng_public_key);
   g_test_add_func("/serialize_and_deserialize/ed448-forging-public-key",
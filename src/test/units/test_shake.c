@@ -0,0 +1,184 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "test_helpers.h"
+
+#include "keccak_x4.h"
+#include "shake.h"
+
+static void absorbing(uint8_t *dst, size_t dst_len, const char *domain,
+                      uint8_t usage, const uint8_t *values,
+                      size_t values_len) {
+  goldilocks_shake256_ctx_p hd;
+
+  hash_init(hd);
+  hash_update(hd, (const uint8_t *)domain, strlen(domain));
+  hash_update(hd, &usage, 1);
+  hash_update(hd, values, values_len);
+  hash_final(hd, dst, dst_len);
+  hash_destroy(hd);
+}
+
+static void test_shake_kdfs_match_absorbing_the_domain() {
+  const uint8_t values[3] = {0x01, 0x02, 0x03};
+  uint8_t expected[64], got[64];
+  unsigned int usage;
+
+  otrng_shake_init();
+
+  /* The cached usages, and some of the ones past them */
+  for (usage = 0; usage < 0x30; usage++) {
+    absorbing(expected, sizeof(expected), "OTRv4", usage, values,
+              sizeof(values));
+    otrng_assert_is_success(
+        shake_256_kdf1(got, sizeof(got), usage, values, sizeof(values)));
+    otrng_assert_cmpmem(expected, got, sizeof(got));
+
+    absorbing(expected, sizeof(expected), "OTR-Prekey-Server", usage, values,
+              sizeof(values));
+    otrng_assert_is_success(shake_256_prekey_server_kdf(
+        got, sizeof(got), usage, values, sizeof(values)));
+    otrng_assert_cmpmem(expected, got, sizeof(got));
+  }
+}
+
+static void test_shake_other_domains_are_absorbed() {
+  const uint8_t values[3] = {0x01, 0x02, 0x03};
+  uint8_t expected[64], got[64];
+  goldilocks_shake256_ctx_p hd;
+
+  otrng_shake_init();
+
+  absorbing(expected, sizeof(expected), "OTR-Other", 0x05, values,
+            sizeof(values));
+  otrng_assert_is_success(
+      hash_init_with_usage_and_domain_separation(hd, 0x05, "OTR-Other"));
+  hash_update(hd, values, sizeof(values));
+  hash_final(hd, got, sizeof(got));
+  hash_destroy(hd);
+  otrng_assert_cmpmem(expected, got, sizeof(got));
+}
+
+static void test_shake_copies_are_independent() {
+  const uint8_t values[3] = {0x01, 0x02, 0x03};
+  uint8_t first[64], second[64];
+
+  otrng_shake_init();
+
+  /* Squeezing from a copy leaves the cached context as it was */
+  otrng_assert_is_success(
+      shake_256_kdf1(first, sizeof(first), 0x10, values, sizeof(values)));
+  otrng_assert_is_success(shake_256_kdf1(second, sizeof(second), 0x10,
+                                         values + 1, sizeof(values) - 1));
+  otrng_assert_is_success(
+      shake_256_kdf1(second, sizeof(second), 0x10, values, sizeof(values)));
+  otrng_assert_cmpmem(first, second, sizeof(first));
+}
+
+static void test_shake_batch_matches_one_at_a_time() {
+  /* Both sides of the one block limits, and values shared between jobs */
+  const size_t values_lens[] = {0, 1, 64, 65, 129, 130, 200};
+  const size_t dst_lens[] = {32, 64, 136, 137};
+  uint8_t values[200 + 8];
+  uint8_t expected[8][137], got[8][137];
+  shake_kdf_s kdfs[8];
+  size_t i, n;
+
+  otrng_shake_init();
+
+  for (i = 0; i < sizeof(values); i++) {
+    values[i] = (uint8_t)i;
+  }
+
+  for (n = 1; n <= 8; n++) {
+    for (i = 0; i < n; i++) {
+      kdfs[i].dst = got[i];
+      kdfs[i].dst_len = dst_lens[(i + n) % 4];
+      kdfs[i].usage = (uint8_t)(0x10 + i);
+      kdfs[i].values = values + i;
+      kdfs[i].values_len = values_lens[(i + n) % 7];
+
+      otrng_assert_is_success(shake_256_kdf1(expected[i], kdfs[i].dst_len,
+                                             kdfs[i].usage, kdfs[i].values,
+                                             kdfs[i].values_len));
+    }
+
+    otrng_assert_is_success(shake_256_kdf1_batch(kdfs, n));
+    for (i = 0; i < n; i++) {
+      otrng_assert_cmpmem(expected[i], got[i], kdfs[i].dst_len);
+    }
+  }
+}
+
+static void test_shake_four_lanes_match_kdf1() {
+  uint8_t values[4][129];
+  uint8_t expected[4][136], got[4][136];
+  shake_kdf_s kdfs[4];
+  const shake_kdf_s *lanes[4];
+  size_t i, j, n;
+
+  if (!otrng_keccak_x4_available()) {
+    return;
+  }
+
+  otrng_shake_init();
+
+  for (i = 0; i < 4; i++) {
+    for (j = 0; j < sizeof(values[i]); j++) {
+      values[i][j] = (uint8_t)(i * 31 + j);
+    }
+
+    kdfs[i].dst = got[i];
+    kdfs[i].dst_len = 136 - i * 40;
+    kdfs[i].usage = (uint8_t)(0x16 + i);
+    kdfs[i].values = values[i];
+    kdfs[i].values_len = 129 - i * 43;
+    lanes[i] = &kdfs[i];
+
+    otrng_assert_is_success(shake_256_kdf1(expected[i], kdfs[i].dst_len,
+                                           kdfs[i].usage, kdfs[i].values,
+                                           kdfs[i].values_len));
+  }
+
+  /* Unused lanes do not disturb the others */
+  for (n = 2; n <= 4; n++) {
+    memset(got, 0, sizeof(got));
+    shake_256_kdf1_x4(lanes, n);
+    for (i = 0; i < n; i++) {
+      otrng_assert_cmpmem(expected[i], got[i], kdfs[i].dst_len);
+    }
+  }
+}
+
+void units_shake_add_tests(void) {
+  g_test_add_func("/shake/kdfs_match_absorbing_the_domain",
+                  test_shake_kdfs_match_absorbing_the_domain);
+  g_test_add_func("/shake/other_domains_are_absorbed",
+                  test_shake_other_domains_are_absorbed);
+  g_test_add_func("/shake/copies_are_independent",
+                  test_shake_copies_are_independent);
+  g_test_add_func("/shake/batch_matches_one_at_a_time",
+                  test_shake_batch_matches_one_at_a_time);
+  g_test_add_func("/shake/four_lanes_match_kdf1",
+                  test_shake_four_lanes_match_kdf1);
+}
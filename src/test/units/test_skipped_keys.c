@@ -0,0 +1,235 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "test_helpers.h"
+
+#include "key_management.h"
+#include "random.h"
+#include "skipped_keys.h"
+
+static void fill_key(uint8_t *enc_key, uint8_t *extra_key, uint8_t value) {
+  memset(enc_key, value, ENC_KEY_BYTES);
+  memset(extra_key, value ^ 0xFF, EXTRA_SYMMETRIC_KEY_BYTES);
+}
+
+static void test_skipped_keys_store_add_and_get() {
+  skipped_keys_store_s *store = otrng_skipped_keys_store_new();
+  uint8_t ecdh_a[ED448_POINT_BYTES] = {0x0A};
+  uint8_t ecdh_b[ED448_POINT_BYTES] = {0x0B};
+  uint8_t enc_key[ENC_KEY_BYTES];
+  uint8_t extra_key[EXTRA_SYMMETRIC_KEY_BYTES];
+  skipped_keys_s *found;
+  uint32_t k;
+
+  for (k = 0; k < 100; k++) {
+    fill_key(enc_key, extra_key, (uint8_t)k);
+    otrng_skipped_keys_store_add(store, ecdh_a, k, enc_key, extra_key);
+  }
+  fill_key(enc_key, extra_key, 0xAA);
+  otrng_skipped_keys_store_add(store, ecdh_b, 7, enc_key, extra_key);
+
+  g_assert_cmpint(otrng_skipped_keys_store_len(store), ==, 101);
+  otrng_assert(store->num_buckets >= 101);
+
+  found = otrng_skipped_keys_store_get(store, ecdh_a, 7);
+  otrng_assert(found);
+  g_assert_cmpint(found->k, ==, 7);
+  fill_key(enc_key, extra_key, 7);
+  otrng_assert_cmpmem(found->enc_key, enc_key, ENC_KEY_BYTES);
+  otrng_assert_cmpmem(found->extra_symmetric_key, extra_key,
+                      EXTRA_SYMMETRIC_KEY_BYTES);
+
+  found = otrng_skipped_keys_store_get(store, ecdh_b, 7);
+  otrng_assert(found);
+  fill_key(enc_key, extra_key, 0xAA);
+  otrng_assert_cmpmem(found->enc_key, enc_key, ENC_KEY_BYTES);
+
+  otrng_skipped_keys_store_remove(store, found);
+  otrng_assert(!otrng_skipped_keys_store_get(store, ecdh_b, 7));
+  otrng_assert(!otrng_skipped_keys_store_get(store, ecdh_a, 100));
+  g_assert_cmpint(otrng_skipped_keys_store_len(store), ==, 100);
+
+  otrng_skipped_keys_store_free(store);
+}
+
+static void test_skipped_keys_store_evicts_oldest() {
+  skipped_keys_store_s *store = otrng_skipped_keys_store_new();
+  uint8_t ecdh[ED448_POINT_BYTES] = {0x0A};
+  uint8_t enc_key[ENC_KEY_BYTES];
+  uint8_t extra_key[EXTRA_SYMMETRIC_KEY_BYTES];
+  uint32_t k;
+
+  for (k = 0; k < 10; k++) {
+    fill_key(enc_key, extra_key, (uint8_t)k);
+    otrng_skipped_keys_store_add(store, ecdh, k, enc_key, extra_key);
+  }
+  g_assert_cmpint(otrng_skipped_keys_store_len(store), ==, 10);
+
+  otrng_skipped_keys_store_evict(store, 4);
+  g_assert_cmpint(otrng_skipped_keys_store_len(store), ==, 4);
+  g_assert_cmpint(store->oldest->k, ==, 6);
+  g_assert_cmpint(store->newest->k, ==, 9);
+  otrng_assert(!otrng_skipped_keys_store_get(store, ecdh, 5));
+  otrng_assert(otrng_skipped_keys_store_get(store, ecdh, 6));
+
+  /* nothing is kept when there is no room at all */
+  otrng_skipped_keys_store_evict(store, 0);
+  g_assert_cmpint(otrng_skipped_keys_store_len(store), ==, 0);
+  otrng_assert(!store->oldest);
+  otrng_assert(!store->newest);
+
+  otrng_skipped_keys_store_free(store);
+}
+
+static void test_skipped_keys_store_rollback() {
+  skipped_keys_store_s *store = otrng_skipped_keys_store_new();
+  uint8_t ecdh[ED448_POINT_BYTES] = {0x0A};
+  uint8_t enc_key[ENC_KEY_BYTES];
+  uint8_t extra_key[EXTRA_SYMMETRIC_KEY_BYTES];
+  uint64_t mark;
+  uint32_t k;
+
+  fill_key(enc_key, extra_key, 1);
+  otrng_skipped_keys_store_add(store, ecdh, 0, enc_key, extra_key);
+  otrng_skipped_keys_store_add(store, ecdh, 1, enc_key, extra_key);
+
+  mark = otrng_skipped_keys_store_mark(store);
+  for (k = 2; k < 6; k++) {
+    otrng_skipped_keys_store_add(store, ecdh, k, enc_key, extra_key);
+  }
+  g_assert_cmpint(otrng_skipped_keys_store_len(store), ==, 6);
+
+  otrng_skipped_keys_store_rollback(store, mark);
+  g_assert_cmpint(otrng_skipped_keys_store_len(store), ==, 2);
+  otrng_assert(otrng_skipped_keys_store_get(store, ecdh, 1));
+  otrng_assert(!otrng_skipped_keys_store_get(store, ecdh, 2));
+
+  otrng_skipped_keys_store_free(store);
+}
+
+static void test_skipped_keys_forged_message_keeps_stored_keys() {
+  key_manager_s *manager = otrng_key_manager_new();
+  receiving_ratchet_s *ratchet;
+  uint8_t ecdh[ED448_POINT_BYTES] = {0x0A};
+  uint8_t enc_key[ENC_KEY_BYTES];
+  uint8_t extra_key[EXTRA_SYMMETRIC_KEY_BYTES];
+  const unsigned int max_skip = 10;
+  ec_scalar priv;
+  uint32_t k;
+
+  /* The keys of delayed messages, which the store is full of */
+  for (k = 0; k < max_skip; k++) {
+    fill_key(enc_key, extra_key, (uint8_t)k);
+    otrng_skipped_keys_store_add(manager->skipped_keys, ecdh, k, enc_key,
+                                 extra_key);
+  }
+
+  /* A forged message skips as many keys as it is allowed to, which are
+   * stored next to the others until its MAC is checked */
+  random_bytes(manager->current->chain_r, CHAIN_KEY_BYTES);
+  ratchet = otrng_receiving_ratchet_new(manager);
+  otrng_zq_keypair_generate(ratchet->their_ecdh, priv);
+  otrng_assert_is_success(store_enc_keys(enc_key, ratchet, max_skip, max_skip,
+                                         'c', NULL, manager));
+  g_assert_cmpint(otrng_skipped_keys_store_len(manager->skipped_keys), ==,
+                  2 * max_skip);
+
+  /* Its MAC does not verify, so the ratchet is destroyed without being
+   * copied */
+  otrng_receiving_ratchet_destroy(ratchet);
+  g_assert_cmpint(otrng_skipped_keys_store_len(manager->skipped_keys), ==,
+                  max_skip);
+  for (k = 0; k < max_skip; k++) {
+    otrng_assert(otrng_skipped_keys_store_get(manager->skipped_keys, ecdh, k));
+  }
+
+  otrng_ec_scalar_destroy(priv);
+  otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
+  otrng_key_manager_free(manager);
+}
+
+static void bench_out_of_order_delivery(uint32_t num_keys) {
+  key_manager_s *manager = otrng_key_manager_new();
+  receiving_ratchet_s *ratchet;
+  ec_scalar priv;
+  k_msg_enc enc_key;
+  k_msg_mac mac_key;
+  double stored, retrieved;
+  uint32_t k;
+
+  random_bytes(manager->current->chain_r, CHAIN_KEY_BYTES);
+  ratchet = otrng_receiving_ratchet_new(manager);
+  otrng_zq_keypair_generate(ratchet->their_ecdh, priv);
+
+  g_test_timer_start();
+  otrng_assert_is_success(store_enc_keys(enc_key, ratchet, num_keys, num_keys,
+                                         'c', NULL, manager));
+  stored = g_test_timer_elapsed();
+  g_assert_cmpint(otrng_skipped_keys_store_len(manager->skipped_keys), ==,
+                  num_keys);
+
+  /* The messages arrive last to first */
+  g_test_timer_start();
+  for (k = num_keys; k > 0; k--) {
+    otrng_assert_is_success(otrng_key_get_skipped_keys(
+        enc_key, mac_key, ratchet->their_ecdh, k - 1, manager, ratchet));
+    otrng_skipped_keys_store_remove(ratchet->skipped_keys,
+                                    ratchet->used_skipped_key);
+    ratchet->used_skipped_key = NULL;
+  }
+  retrieved = g_test_timer_elapsed();
+  g_assert_cmpint(otrng_skipped_keys_store_len(manager->skipped_keys), ==, 0);
+
+  g_test_minimized_result(retrieved / num_keys,
+                          "retrieve one of %u skipped keys: %.3f us",
+                          num_keys, 1e6 * retrieved / num_keys);
+  g_test_message("store %u skipped keys: %.3f ms", num_keys, 1e3 * stored);
+
+  otrng_ec_scalar_destroy(priv);
+  otrng_secure_wipe(enc_key, ENC_KEY_BYTES);
+  otrng_secure_wipe(mac_key, MAC_KEY_BYTES);
+  otrng_receiving_ratchet_destroy(ratchet);
+  otrng_key_manager_free(manager);
+}
+
+static void test_perf_out_of_order_1k() { bench_out_of_order_delivery(1000); }
+
+static void test_perf_out_of_order_10k() {
+  bench_out_of_order_delivery(10000);
+}
+
+void units_skipped_keys_add_tests(void) {
+  g_test_add_func("/skipped_keys/add_and_get",
+                  test_skipped_keys_store_add_and_get);
+  g_test_add_func("/skipped_keys/evicts_oldest",
+                  test_skipped_keys_store_evicts_oldest);
+  g_test_add_func("/skipped_keys/rollback", test_skipped_keys_store_rollback);
+  g_test_add_func("/skipped_keys/forged_message_keeps_stored_keys",
+                  test_skipped_keys_forged_message_keeps_stored_keys);
+
+  if (g_test_perf()) {
+    g_test_add_func("/perf/skipped_keys/out_of_order_1k",
+                    test_perf_out_of_order_1k);
+    g_test_add_func("/perf/skipped_keys/out_of_order_10k",
+                    test_perf_out_of_order_10k);
+  }
+}
@@ -0,0 +1,225 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "test_helpers.h"
+
+#include "timer_wheel.h"
+
+#define START 1000000
+
+typedef struct test_timer_s {
+  timer_s timer;
+  time_t expired_at;
+  int times_expired;
+  /* Canceled when this timer expires */
+  /*@null@*/ timer_s *to_cancel;
+} test_timer_s;
+
+static void test_timer_expired(void *data, time_t now) {
+  test_timer_s *t = data;
+
+  t->expired_at = now;
+  t->times_expired++;
+
+  if (t->to_cancel) {
+    otrng_timer_cancel(t->to_cancel);
+  }
+}
+
+static void test_timer_init(test_timer_s *t) {
+  t->expired_at = 0;
+  t->times_expired = 0;
+  t->to_cancel = NULL;
+  otrng_timer_init(&t->timer, test_timer_expired, t);
+}
+
+static void test_timer_wheel_expires_when_due() {
+  timer_wheel_s *wheel = otrng_timer_wheel_new(START);
+  test_timer_s soon, later, much_later;
+  time_t deadline;
+
+  test_timer_init(&soon);
+  test_timer_init(&later);
+  test_timer_init(&much_later);
+
+  otrng_assert(!otrng_timer_wheel_next_deadline(&deadline, wheel));
+
+  otrng_timer_wheel_schedule(wheel, &much_later.timer, START + 300000);
+  otrng_timer_wheel_schedule(wheel, &later.timer, START + 100);
+  otrng_timer_wheel_schedule(wheel, &soon.timer, START + 5);
+  g_assert_cmpuint(otrng_timer_wheel_len(wheel), ==, 3);
+
+  otrng_assert(otrng_timer_wheel_next_deadline(&deadline, wheel));
+  g_assert_cmpint(deadline, ==, START + 5);
+
+  otrng_timer_wheel_advance(wheel, START + 4);
+  g_assert_cmpint(soon.times_expired, ==, 0);
+
+  otrng_timer_wheel_advance(wheel, START + 99);
+  g_assert_cmpint(soon.times_expired, ==, 1);
+  g_assert_cmpint(soon.expired_at, ==, START + 5);
+  g_assert_cmpint(later.times_expired, ==, 0);
+  otrng_assert(!otrng_timer_is_scheduled(&soon.timer));
+
+  otrng_assert(otrng_timer_wheel_next_deadline(&deadline, wheel));
+  g_assert_cmpint(deadline, ==, START + 100);
+
+  otrng_timer_wheel_advance(wheel, START + 200000);
+  g_assert_cmpint(later.times_expired, ==, 1);
+  g_assert_cmpint(later.expired_at, ==, START + 100);
+  g_assert_cmpint(much_later.times_expired, ==, 0);
+
+  otrng_timer_wheel_advance(wheel, START + 400000);
+  g_assert_cmpint(much_later.times_expired, ==, 1);
+  g_assert_cmpint(much_later.expired_at, ==, START + 300000);
+  g_assert_cmpuint(otrng_timer_wheel_len(wheel), ==, 0);
+
+  otrng_timer_wheel_free(wheel);
+}
+
+static void test_timer_wheel_cancel_and_reschedule() {
+  timer_wheel_s *wheel = otrng_timer_wheel_new(START);
+  test_timer_s first, second;
+  time_t deadline;
+
+  test_timer_init(&first);
+  test_timer_init(&second);
+
+  otrng_timer_wheel_schedule(wheel, &first.timer, START + 10);
+  otrng_timer_wheel_schedule(wheel, &second.timer, START + 10);
+  otrng_timer_cancel(&first.timer);
+  otrng_timer_cancel(&first.timer);
+  otrng_timer_wheel_schedule(wheel, &second.timer, START + 7000);
+  g_assert_cmpuint(otrng_timer_wheel_len(wheel), ==, 1);
+
+  otrng_assert(otrng_timer_wheel_next_deadline(&deadline, wheel));
+  g_assert_cmpint(deadline, ==, START + 7000);
+
+  otrng_timer_wheel_advance(wheel, START + 6999);
+  g_assert_cmpint(first.times_expired, ==, 0);
+  g_assert_cmpint(second.times_expired, ==, 0);
+
+  otrng_timer_wheel_advance(wheel, START + 7000);
+  g_assert_cmpint(first.times_expired, ==, 0);
+  g_assert_cmpint(second.times_expired, ==, 1);
+
+  otrng_timer_wheel_free(wheel);
+}
+
+static void test_timer_wheel_past_deadline() {
+  timer_wheel_s *wheel = otrng_timer_wheel_new(START);
+  test_timer_s t;
+  time_t deadline;
+
+  test_timer_init(&t);
+
+  otrng_timer_wheel_schedule(wheel, &t.timer, START - 50);
+  otrng_assert(otrng_timer_wheel_next_deadline(&deadline, wheel));
+  g_assert_cmpint(deadline, ==, START + 1);
+
+  /* The clock going back expires nothing */
+  otrng_timer_wheel_advance(wheel, START - 10);
+  g_assert_cmpint(t.times_expired, ==, 0);
+
+  otrng_timer_wheel_advance(wheel, START + 1);
+  g_assert_cmpint(t.times_expired, ==, 1);
+
+  otrng_timer_wheel_free(wheel);
+}
+
+static void test_timer_wheel_expire_cancels_another() {
+  timer_wheel_s *wheel = otrng_timer_wheel_new(START);
+  test_timer_s first, second;
+
+  test_timer_init(&first);
+  test_timer_init(&second);
+  first.to_cancel = &second.timer;
+  second.to_cancel = &first.timer;
+
+  otrng_timer_wheel_schedule(wheel, &first.timer, START + 3);
+  otrng_timer_wheel_schedule(wheel, &second.timer, START + 3);
+  otrng_timer_wheel_advance(wheel, START + 3);
+
+  g_assert_cmpint(first.times_expired + second.times_expired, ==, 1);
+  g_assert_cmpuint(otrng_timer_wheel_len(wheel), ==, 0);
+
+  otrng_timer_wheel_free(wheel);
+}
+
+static void test_timer_wheel_many_timers() {
+  timer_wheel_s *wheel = otrng_timer_wheel_new(START);
+  test_timer_s timers[500];
+  time_t deadlines[500];
+  time_t now = START;
+  uint32_t state = 1;
+  int i;
+
+  for (i = 0; i < 500; i++) {
+    /* Spread over every level, and past them */
+    state = state * 1103515245 + 12345;
+    deadlines[i] = START + 1 + (state >> 8) % ((time_t)1 << (6 * (i % 5) + 2));
+    test_timer_init(&timers[i]);
+    otrng_timer_wheel_schedule(wheel, &timers[i].timer, deadlines[i]);
+  }
+
+  while (otrng_timer_wheel_len(wheel) > 0) {
+    time_t expected = 0, deadline;
+    otrng_bool found = otrng_false;
+
+    for (i = 0; i < 500; i++) {
+      if (timers[i].times_expired == 0 &&
+          (!found || deadlines[i] < expected)) {
+        expected = deadlines[i];
+        found = otrng_true;
+      }
+    }
+
+    otrng_assert(otrng_timer_wheel_next_deadline(&deadline, wheel));
+    g_assert_cmpint(deadline, ==, expected);
+
+    state = state * 1103515245 + 12345;
+    now += 1 + (state >> 8) % 200000;
+    otrng_timer_wheel_advance(wheel, now);
+
+    for (i = 0; i < 500; i++) {
+      if (deadlines[i] <= now) {
+        g_assert_cmpint(timers[i].times_expired, ==, 1);
+        g_assert_cmpint(timers[i].expired_at, ==, deadlines[i]);
+      } else {
+        g_assert_cmpint(timers[i].times_expired, ==, 0);
+      }
+    }
+  }
+
+  otrng_timer_wheel_free(wheel);
+}
+
+void units_timer_wheel_add_tests(void) {
+  g_test_add_func("/timer_wheel/expires_when_due",
+                  test_timer_wheel_expires_when_due);
+  g_test_add_func("/timer_wheel/cancel_and_reschedule",
+                  test_timer_wheel_cancel_and_reschedule);
+  g_test_add_func("/timer_wheel/past_deadline", test_timer_wheel_past_deadline);
+  g_test_add_func("/timer_wheel/expire_cancels_another",
+                  test_timer_wheel_expire_cancels_another);
+  g_test_add_func("/timer_wheel/many_timers", test_timer_wheel_many_timers);
+}
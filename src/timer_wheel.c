@@ -0,0 +1,301 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define OTRNG_TIMER_WHEEL_PRIVATE
+
+#include "alloc.h"
+#include "timer_wheel.h"
+
+#define LEVEL_SHIFT(level) (TIMER_WHEEL_SLOT_BITS * (level))
+#define LEVEL_MASK(level) (((time_t)1 << LEVEL_SHIFT(level)) - 1)
+#define SLOT_INDEX(t, level)                                                   \
+  ((size_t)(((t) >> LEVEL_SHIFT(level)) & (TIMER_WHEEL_SLOTS - 1)))
+
+static void empty_slot(timer_s *head) {
+  head->prev = head;
+  head->next = head;
+}
+
+static otrng_bool is_slot_empty(const timer_s *head) {
+  return head->next == head;
+}
+
+INTERNAL timer_wheel_s *otrng_timer_wheel_new(time_t now) {
+  timer_wheel_s *wheel = otrng_xmalloc_z(sizeof(timer_wheel_s));
+  int level, i;
+
+  wheel->now = now;
+  for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+      empty_slot(&wheel->slots[level][i]);
+    }
+  }
+  empty_slot(&wheel->overflow);
+
+  return wheel;
+}
+
+static void unlink_timer(timer_s *timer) {
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = NULL;
+  timer->next = NULL;
+  timer->wheel->counts[timer->level]--;
+}
+
+static void unlink_all(timer_s *head) {
+  while (!is_slot_empty(head)) {
+    timer_s *timer = head->next;
+    unlink_timer(timer);
+    timer->wheel = NULL;
+  }
+}
+
+INTERNAL void otrng_timer_wheel_free(timer_wheel_s *wheel) {
+  int level, i;
+
+  if (!wheel) {
+    return;
+  }
+
+  for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+      unlink_all(&wheel->slots[level][i]);
+    }
+  }
+  unlink_all(&wheel->overflow);
+
+  otrng_free(wheel);
+}
+
+INTERNAL void otrng_timer_init(timer_s *timer,
+                               void (*expire)(void *data, time_t now),
+                               void *data) {
+  timer->prev = NULL;
+  timer->next = NULL;
+  timer->wheel = NULL;
+  timer->level = 0;
+  timer->deadline = 0;
+  timer->expire = expire;
+  timer->data = data;
+}
+
+/* Timers are placed by how far ahead of the wheel they are due: level 0 holds
+   those due in less than 64 seconds, one slot per second, level 1 those due in
+   less than 64^2 seconds, one slot per 64 seconds, and so on. As the wheel
+   turns, each slot of a higher level is moved down when its time comes. */
+static void place_timer(timer_wheel_s *wheel, timer_s *timer) {
+  time_t ahead = timer->deadline - wheel->now;
+  timer_s *head = &wheel->overflow;
+  int level;
+
+  for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    if (ahead < ((time_t)1 << LEVEL_SHIFT(level + 1))) {
+      head = &wheel->slots[level][SLOT_INDEX(timer->deadline, level)];
+      break;
+    }
+  }
+
+  timer->wheel = wheel;
+  timer->level = level;
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+  wheel->counts[level]++;
+}
+
+INTERNAL void otrng_timer_wheel_schedule(timer_wheel_s *wheel, timer_s *timer,
+                                         time_t deadline) {
+  otrng_timer_cancel(timer);
+
+  /* The slot for the current second has already expired */
+  if (deadline <= wheel->now) {
+    deadline = wheel->now + 1;
+  }
+
+  timer->deadline = deadline;
+  place_timer(wheel, timer);
+}
+
+INTERNAL void otrng_timer_cancel(timer_s *timer) {
+  if (!otrng_timer_is_scheduled(timer)) {
+    return;
+  }
+
+  unlink_timer(timer);
+}
+
+INTERNAL otrng_bool otrng_timer_is_scheduled(const timer_s *timer) {
+  return timer->next != NULL;
+}
+
+static void cascade(timer_wheel_s *wheel, timer_s *head) {
+  timer_s moving;
+
+  if (is_slot_empty(head)) {
+    return;
+  }
+
+  /* Detached first, as a timer can be placed back in the same slot */
+  moving.next = head->next;
+  moving.prev = head->prev;
+  moving.next->prev = &moving;
+  moving.prev->next = &moving;
+  empty_slot(head);
+
+  while (!is_slot_empty(&moving)) {
+    timer_s *timer = moving.next;
+    unlink_timer(timer);
+    place_timer(wheel, timer);
+  }
+}
+
+tstatic void timer_wheel_tick(timer_wheel_s *wheel) {
+  timer_s *head;
+  int level;
+
+  wheel->now++;
+
+  for (level = 1; level <= TIMER_WHEEL_LEVELS; level++) {
+    if ((wheel->now & LEVEL_MASK(level)) != 0) {
+      break;
+    }
+
+    if (level == TIMER_WHEEL_LEVELS) {
+      cascade(wheel, &wheel->overflow);
+    } else {
+      cascade(wheel, &wheel->slots[level][SLOT_INDEX(wheel->now, level)]);
+    }
+  }
+
+  /* Taken one at a time, as expiring a timer can cancel the others */
+  head = &wheel->slots[0][SLOT_INDEX(wheel->now, 0)];
+  while (!is_slot_empty(head)) {
+    timer_s *timer = head->next;
+    unlink_timer(timer);
+    timer->expire(timer->data, wheel->now);
+  }
+}
+
+static int lowest_used_level(const timer_wheel_s *wheel) {
+  int level;
+
+  for (level = 0; level <= TIMER_WHEEL_LEVELS; level++) {
+    if (wheel->counts[level] != 0) {
+      break;
+    }
+  }
+
+  return level;
+}
+
+INTERNAL void otrng_timer_wheel_advance(timer_wheel_s *wheel, time_t now) {
+  while (wheel->now < now) {
+    int level = lowest_used_level(wheel);
+
+    /* With the lower levels empty, nothing happens until the wheel reaches a
+       slot of the lowest level in use */
+    if (level > 0) {
+      time_t skip_to;
+
+      if (level > TIMER_WHEEL_LEVELS) {
+        wheel->now = now;
+        break;
+      }
+
+      skip_to = wheel->now | LEVEL_MASK(level);
+      if (skip_to >= now) {
+        wheel->now = now;
+        break;
+      }
+
+      wheel->now = skip_to;
+    }
+
+    timer_wheel_tick(wheel);
+  }
+}
+
+static time_t earliest_in(const timer_s *head) {
+  const timer_s *timer = head->next;
+  time_t earliest = timer->deadline;
+
+  for (; timer != head; timer = timer->next) {
+    if (timer->deadline < earliest) {
+      earliest = timer->deadline;
+    }
+  }
+
+  return earliest;
+}
+
+INTERNAL otrng_bool
+otrng_timer_wheel_next_deadline(time_t *deadline, const timer_wheel_s *wheel) {
+  otrng_bool found = otrng_false;
+  time_t next = 0;
+  int level, i;
+
+  /* The slots of a level, starting after the current one, are in the order
+     they are due. The earliest timer of a level is in the first slot used. */
+  for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    if (wheel->counts[level] == 0) {
+      continue;
+    }
+
+    for (i = 1; i <= TIMER_WHEEL_SLOTS; i++) {
+      const timer_s *head = &wheel->slots[level][SLOT_INDEX(
+          wheel->now + ((time_t)i << LEVEL_SHIFT(level)), level)];
+      if (!is_slot_empty(head)) {
+        time_t earliest = earliest_in(head);
+        if (!found || earliest < next) {
+          next = earliest;
+          found = otrng_true;
+        }
+        break;
+      }
+    }
+  }
+
+  if (wheel->counts[TIMER_WHEEL_LEVELS] != 0) {
+    time_t earliest = earliest_in(&wheel->overflow);
+    if (!found || earliest < next) {
+      next = earliest;
+      found = otrng_true;
+    }
+  }
+
+  if (found) {
+    *deadline = next;
+  }
+
+  return found;
+}
+
+INTERNAL size_t otrng_timer_wheel_len(const timer_wheel_s *wheel) {
+  size_t len = 0;
+  int level;
+
+  for (level = 0; level <= TIMER_WHEEL_LEVELS; level++) {
+    len += wheel->counts[level];
+  }
+
+  return len;
+}
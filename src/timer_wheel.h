@@ -0,0 +1,143 @@
+/*
+ *  This file is part of the Off-the-Record Next Generation Messaging
+ *  library (libotr-ng).
+ *
+ *  Copyright (C) 2016-2018, the libotr-ng contributors.
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * A hierarchical timer wheel, to find out what expires without looking at
+ * everything that could. Timers are kept in slots by the second they are due,
+ * so advancing the wheel only touches the timers that are due and, once every
+ * 64 seconds or more, a slot of timers that are moved closer.
+ *
+ * Time is counted in whole seconds, as returned by time().
+ */
+
+#ifndef OTRNG_TIMER_WHEEL_H
+#define OTRNG_TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include "error.h"
+#include "shared.h"
+
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_LEVELS 4 /* Level i has slots of 64^i seconds */
+
+struct timer_wheel_s;
+
+/*
+ * A timer is embedded in whatever expires. It must be initialized with
+ * otrng_timer_init, and canceled before it is freed.
+ */
+typedef struct timer_s {
+  /* The other timers in its slot. next is NULL when it is not scheduled. */
+  struct timer_s *prev;
+  struct timer_s *next;
+  struct timer_wheel_s *wheel;
+  int level;
+
+  time_t deadline;
+  void (*expire)(void *data, time_t now);
+  void *data;
+} timer_s;
+
+typedef struct timer_wheel_s {
+  time_t now; /* Every timer due at or before now has expired */
+  /* The timers in each level, the last one being those due too far ahead to
+     fit in any level */
+  size_t counts[TIMER_WHEEL_LEVELS + 1];
+  timer_s slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+  timer_s overflow;
+} timer_wheel_s;
+
+/**
+ * @brief Creates an empty wheel.
+ *
+ * @param [now] The current time.
+ */
+INTERNAL timer_wheel_s *otrng_timer_wheel_new(time_t now);
+
+/**
+ * @brief Frees the wheel. The timers still scheduled are unscheduled, but not
+ * expired.
+ */
+INTERNAL void
+otrng_timer_wheel_free(/*@only@*/ /*@null@*/ timer_wheel_s *wheel);
+
+/**
+ * @brief Initializes an unscheduled timer.
+ *
+ * @param [timer]  The timer.
+ * @param [expire] Called with [data] and the current time of the wheel when
+ * the timer expires. The timer is no longer scheduled by then, so it can be
+ * scheduled again or freed.
+ * @param [data]   Passed to [expire].
+ */
+INTERNAL void otrng_timer_init(timer_s *timer,
+                               void (*expire)(void *data, time_t now),
+                               void *data);
+
+/**
+ * @brief Schedules [timer] to expire at [deadline], moving it if it was
+ * already scheduled. A deadline that has passed is due at the next second.
+ *
+ * @param [wheel]    The wheel.
+ * @param [timer]    The timer.
+ * @param [deadline] When it expires.
+ */
+INTERNAL void otrng_timer_wheel_schedule(timer_wheel_s *wheel, timer_s *timer,
+                                         time_t deadline);
+
+/**
+ * @brief Unschedules [timer]. Does nothing if it is not scheduled.
+ */
+INTERNAL void otrng_timer_cancel(timer_s *timer);
+
+INTERNAL otrng_bool otrng_timer_is_scheduled(const timer_s *timer);
+
+/**
+ * @brief Expires every timer due at or before [now], in the order they are
+ * due. Nothing happens if [now] is before the current time of the wheel.
+ *
+ * @param [wheel] The wheel.
+ * @param [now]   The current time.
+ */
+INTERNAL void otrng_timer_wheel_advance(timer_wheel_s *wheel, time_t now);
+
+/**
+ * @brief Finds when the next timer is due.
+ *
+ * @param [deadline] Receives the deadline of the next timer.
+ * @param [wheel]    The wheel.
+ *
+ * @return otrng_false if no timer is scheduled.
+ */
+INTERNAL otrng_bool otrng_timer_wheel_next_deadline(time_t *deadline,
+                                                    const timer_wheel_s *wheel);
+
+INTERNAL size_t otrng_timer_wheel_len(const timer_wheel_s *wheel);
+
+#ifdef OTRNG_TIMER_WHEEL_PRIVATE
+
+tstatic void timer_wheel_tick(timer_wheel_s *wheel);
+
+#endif
+
+#endif
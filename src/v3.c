@@ -663,11 +663,13 @@ INTERNAL otrng_result otrng_v3_send_message(char **new_msg, const char *msg,
     return OTRNG_ERROR;
   }
 
+  otrng_global_state_lock_v3(conn->client->global_state);
   err = otrl_message_sending(
       conn->client->global_state->user_state_v3, conn->ops, conn->opdata,
       conn->client->client_id.account, conn->client->client_id.protocol,
       conn->peer, OTRL_INSTAG_RECENT, msg, tlvsv3, new_msg,
       OTRL_FRAGMENT_SEND_SKIP, &conn->ctx, NULL, NULL);
+  otrng_global_state_unlock_v3(conn->client->global_state);
 
   if (!err) {
     return OTRNG_SUCCESS;
@@ -693,10 +695,12 @@ INTERNAL otrng_result otrng_v3_receive_message(char **to_send,
     return OTRNG_ERROR;
   }
 
+  otrng_global_state_lock_v3(conn->client->global_state);
   ignore_msg = otrl_message_receiving(
       conn->client->global_state->user_state_v3, conn->ops, conn->opdata,
       conn->client->client_id.account, conn->client->client_id.protocol,
       conn->peer, msg, &new_msg, &tlvs_v3, &conn->ctx, NULL, NULL);
+  otrng_global_state_unlock_v3(conn->client->global_state);
 
   (void)ignore_msg;
 
@@ -734,10 +738,12 @@ INTERNAL otrng_result otrng_v3_close(char **to_send, otrng_v3_conn_s *conn) {
   // TODO: @client there is also: otrl_message_disconnect, which only
   // disconnects one instance
 
+  otrng_global_state_lock_v3(conn->client->global_state);
   otrl_message_disconnect_all_instances(
       conn->client->global_state->user_state_v3, conn->ops, conn->opdata,
       conn->client->client_id.account, conn->client->client_id.protocol,
       conn->peer);
+  otrng_global_state_unlock_v3(conn->client->global_state);
 
   *to_send = otrng_v3_retrieve_injected_message(conn);
 
@@ -747,9 +753,11 @@ INTERNAL otrng_result otrng_v3_close(char **to_send, otrng_v3_conn_s *conn) {
 INTERNAL otrng_result otrng_v3_send_symkey_message(
     char **to_send, otrng_v3_conn_s *conn, unsigned int use,
     const unsigned char *usedata, size_t usedatalen, unsigned char *extra_key) {
+  otrng_global_state_lock_v3(conn->client->global_state);
   otrl_message_symkey(conn->client->global_state->user_state_v3, conn->ops,
                       conn->opdata, conn->ctx, use, usedata, usedatalen,
                       extra_key);
+  otrng_global_state_unlock_v3(conn->client->global_state);
 
   *to_send = otrng_v3_retrieve_injected_message(conn);
   return OTRNG_SUCCESS;
@@ -767,6 +775,7 @@ INTERNAL otrng_result otrng_v3_smp_start(char **to_send,
     q[q_len] = 0;
   }
 
+  otrng_global_state_lock_v3(conn->client->global_state);
   if (question) {
     otrl_message_initiate_smp_q(conn->client->global_state->user_state_v3,
                                 conn->ops, conn->opdata, conn->ctx, q, secret,
@@ -776,6 +785,7 @@ INTERNAL otrng_result otrng_v3_smp_start(char **to_send,
                               conn->ops, conn->opdata, conn->ctx, secret,
                               secretlen);
   }
+  otrng_global_state_unlock_v3(conn->client->global_state);
 
   *to_send = otrng_v3_retrieve_injected_message(conn);
   return OTRNG_SUCCESS;
@@ -785,16 +795,20 @@ INTERNAL otrng_result otrng_v3_smp_continue(char **to_send,
                                             const uint8_t *secret,
                                             const size_t secretlen,
                                             otrng_v3_conn_s *conn) {
+  otrng_global_state_lock_v3(conn->client->global_state);
   otrl_message_respond_smp(conn->client->global_state->user_state_v3, conn->ops,
                            conn->opdata, conn->ctx, secret, secretlen);
+  otrng_global_state_unlock_v3(conn->client->global_state);
 
   *to_send = otrng_v3_retrieve_injected_message(conn);
   return OTRNG_SUCCESS;
 }
 
 INTERNAL otrng_result otrng_v3_smp_abort(otrng_v3_conn_s *conn) {
+  otrng_global_state_lock_v3(conn->client->global_state);
   otrl_message_abort_smp(conn->client->global_state->user_state_v3, conn->ops,
                          conn->opdata, conn->ctx);
+  otrng_global_state_unlock_v3(conn->client->global_state);
   return OTRNG_SUCCESS;
 }
 
@@ -952,6 +966,8 @@ API otrng_result otrng_v3_create_private_key(otrng_client_s *client) {
   p->accountname = otrng_xstrdup(client->client_id.account);
   p->protocol = otrng_xstrdup(client->client_id.protocol);
   p->pubkey_type = OTRL_PUBKEY_TYPE_DSA;
+
+  otrng_global_state_lock_v3(client->global_state);
   p->next = us->privkey_root;
   if (p->next) {
     p->next->tous = &(p->next);
@@ -961,8 +977,10 @@ API otrng_result otrng_v3_create_private_key(otrng_client_s *client) {
 
   if (make_pubkey(&(p->pubkey_data), &(p->pubkey_datalen), p->privkey)) {
     otrl_privkey_forget(p);
+    otrng_global_state_unlock_v3(client->global_state);
     return OTRNG_ERROR;
   }
+  otrng_global_state_unlock_v3(client->global_state);
 
   return OTRNG_SUCCESS;
 }